@@ -48,8 +48,24 @@ CLICK_DECLS
 #endif
 #define GET1(p)		((p)[0])
 
+#if HAVE_MULTITHREAD
+struct FromIPSummaryDump::Chunk {
+    String data;		// whole lines
+    int lineno;			// line number of first line
+    int error_lineno;		// line number of first parse error, or 0
+    Vector<Packet *> packets;
+    int pos;			// next packet to emit
+    bool parsed;
+    Chunk *next;
+};
+#endif
+
 FromIPSummaryDump::FromIPSummaryDump()
-    : _work_packet(0), _task(this), _timer(this)
+    : _work_packet(0), _task(this), _timer(this), _block_nrows(0), _block_row(0),
+      _nthreads(1), _chunk_size(262144), _parse_count(0)
+#if HAVE_MULTITHREAD
+    , _chunk_tail(0)
+#endif
 {
     _ff.set_landmark_pattern("%f:%l");
 }
@@ -70,7 +86,7 @@ FromIPSummaryDump::cast(const char *n)
 int
 FromIPSummaryDump::configure(Vector<String> &conf, ErrorHandler *errh)
 {
-    bool stop = false, active = true, zero = true, checksum = false, multipacket = false, timing = false, allow_nonexistent = false;
+    bool stop = false, active = true, zero = true, checksum = false, multipacket = false, timing = false, allow_nonexistent = false, ordered = false;
     uint8_t default_proto = IP_PROTO_TCP;
     _sampling_prob = (1 << SAMPLING_SHIFT);
     String default_contents, default_flowid;
@@ -90,8 +106,21 @@ FromIPSummaryDump::configure(Vector<String> &conf, ErrorHandler *errh)
 	.read("CONTENTS", AnyArg(), default_contents)
 	.read("FLOWID", AnyArg(), default_flowid)
 	.read("ALLOW_NONEXISTENT", allow_nonexistent)
+	.read("START", _start_time)
+	.read("END", _end_time)
+	.read("THREADS", _nthreads)
+	.read("CHUNK_SIZE", _chunk_size)
+	.read("ORDERED", ordered)
 	.complete() < 0)
 	return -1;
+    if (_nthreads < 1)
+	return errh->error("THREADS must be at least 1");
+#if !HAVE_MULTITHREAD
+    if (_nthreads > 1)
+	return errh->error("'THREADS' requires multithreaded Click");
+#endif
+    if (_chunk_size == 0)
+	return errh->error("CHUNK_SIZE must be positive");
     if (_sampling_prob > (1 << SAMPLING_SHIFT)) {
 	errh->warning("SAMPLE probability reduced to 1");
 	_sampling_prob = (1 << SAMPLING_SHIFT);
@@ -104,10 +133,11 @@ FromIPSummaryDump::configure(Vector<String> &conf, ErrorHandler *errh)
     _zero = zero;
     _checksum = checksum;
     _timing = timing;
+    _ordered = ordered || timing;
     _allow_nonexistent = allow_nonexistent;
     _have_timing = false;
     _multipacket = multipacket;
-    _have_flowid = _have_aggregate = _binary = false;
+    _have_flowid = _have_aggregate = _binary = _columnar = false;
     if (default_contents)
 	bang_data(default_contents, errh);
     if (default_flowid)
@@ -184,16 +214,40 @@ FromIPSummaryDump::initialize(ErrorHandler *errh)
 	}
     }
 
+#if HAVE_MULTITHREAD
+    // start parser threads
+    if (_nthreads > 1) {
+	_chunk_head = _chunk_unclaimed = 0;
+	_chunk_tail = &_chunk_head;
+	_nchunks = 0;
+	_chunk_eof = _workers_stop = false;
+	pthread_mutex_init(&_lock, 0);
+	pthread_cond_init(&_work_cond, 0);
+	pthread_cond_init(&_done_cond, 0);
+	for (int i = 0; i < _nthreads; i++) {
+	    pthread_t t;
+	    if (int err = pthread_create(&t, 0, worker_thread, this))
+		return errh->error("cannot start parser thread: %s", strerror(err));
+	    _workers.push_back(t);
+	}
+    }
+#endif
+
     return 0;
 }
 
 void
 FromIPSummaryDump::cleanup(CleanupStage)
 {
+#if HAVE_MULTITHREAD
+    stop_workers();
+#endif
     _ff.cleanup();
     if (_work_packet)
 	_work_packet->kill();
     _work_packet = 0;
+    _block = String();
+    _block_nrows = _block_row = 0;
 }
 
 int
@@ -316,6 +370,110 @@ FromIPSummaryDump::bang_binary(const String &line, ErrorHandler *errh)
     _ff.set_lineno(1);
 }
 
+void
+FromIPSummaryDump::bang_columnar(const String &line, ErrorHandler *errh)
+{
+    Vector<String> words;
+    cp_spacevec(line, words);
+    if (words.size() != 1)
+	_ff.error(errh, "bad !columnar specification");
+    _binary = _columnar = true;
+    _ff.set_landmark_pattern("%f:record %l");
+    _ff.set_lineno(1);
+    if (_start_time)
+	seek_index(errh);
+}
+
+void
+FromIPSummaryDump::seek_index(ErrorHandler *errh)
+{
+    // The dump ends with a fixed-length "#index_offset" record pointing at
+    // the "#index" record; see ToIPSummaryDump.
+    enum { TRAILER_LENGTH = 4 + 35 };
+    off_t pos = _ff.file_pos(), size = _ff.file_size(), index_pos;
+    int lineno = _ff.lineno();
+    String line;
+    if (size < pos + TRAILER_LENGTH
+	|| _ff.seek(size - TRAILER_LENGTH, errh) < 0
+	|| read_binary(line, errh) != 2
+	|| !line.starts_with("#index_offset ", 14)
+	|| !cp_file_offset(line.substring(14).trim_space(), &index_pos)
+	|| index_pos < pos || index_pos >= size
+	|| _ff.seek(index_pos, errh) < 0
+	|| read_binary(line, errh) != 2
+	|| !line.starts_with("#index\n", 7))
+	goto done;
+
+    // find the first block that might contain START
+    for (int i = 7; i < line.length(); ) {
+	int nl = line.find_left('\n', i);
+	if (nl < 0)
+	    nl = line.length();
+	Vector<String> words;
+	cp_spacevec(line.substring(i, nl - i), words);
+	off_t block_pos;
+	Timestamp last;
+	if (words.size() != 4
+	    || !cp_file_offset(words[0], &block_pos)
+	    || !TimestampArg().parse(words[3], last))
+	    goto done;
+	index_pos = block_pos;
+	if (last >= _start_time)
+	    break;
+	i = nl + 1;
+    }
+    pos = index_pos;
+
+  done:
+    _ff.seek(pos, errh);
+    _ff.set_lineno(lineno);
+}
+
+void
+FromIPSummaryDump::decode_block(const String &block, ErrorHandler *errh)
+{
+    const uint8_t *s = reinterpret_cast<const uint8_t *>(block.data());
+    const uint8_t *end = s + block.length();
+    if (block.length() < IPSummaryDump::COLUMN_BLOCK_HEADER) {
+	_ff.error(errh, "columnar block too short");
+	return;
+    }
+
+    uint32_t nrows = GET4(s);
+    if (_start_time && Timestamp::make_nsec(GET4(s + 12), GET4(s + 16)) < _start_time)
+	return;
+    if (_end_time && Timestamp::make_nsec(GET4(s + 4), GET4(s + 8)) > _end_time)
+	return;
+    s += IPSummaryDump::COLUMN_BLOCK_HEADER;
+
+    _decoded.resize(_fields.size());
+    _column_pos.resize(_fields.size());
+    _column_end.resize(_fields.size());
+    for (int i = 0; i < _fields.size(); ++i) {
+	const IPSummaryDump::FieldReader *f = _fields[i];
+	int width = IPSummaryDump::column_width(f->type);
+	if (f == &IPSummaryDump::null_reader || !f->inb || !f->inject) {
+	    // skip columns we can't use
+	    if (s + 4 > end)
+		goto bad;
+	    s += 4 + (GET4(s) & IPSummaryDump::COLUMN_MAX_LENGTH);
+	    _column_pos[i] = _column_end[i] = 0;
+	} else if (!(s = IPSummaryDump::decode_column(_decoded[i], s, end, width, nrows, _column_pos[i], _column_end[i]))
+		   || (width >= 0 && _column_end[i] - _column_pos[i] != (ptrdiff_t) (nrows * width)))
+	    goto bad;
+	if (s > end)
+	    goto bad;
+    }
+
+    _block = block;
+    _block_nrows = nrows;
+    _block_row = 0;
+    return;
+
+  bad:
+    _ff.error(errh, "bad columnar block");
+}
+
 static void
 set_checksums(WritablePacket *q, click_ip *iph)
 {
@@ -343,54 +501,98 @@ set_checksums(WritablePacket *q, click_ip *iph)
     }
 }
 
+void
+FromIPSummaryDump::bang_line(const String &line, ErrorHandler *errh)
+{
+    const char *data = line.begin(), *end = line.end();
+    if (data + 6 <= end && memcmp(data, "!data", 5) == 0 && isspace((unsigned char) data[5]))
+	bang_data(line, errh);
+    else if (data + 8 <= end && memcmp(data, "!flowid", 7) == 0 && isspace((unsigned char) data[7]))
+	bang_flowid(line, errh);
+    else if (data + 7 <= end && memcmp(data, "!proto", 6) == 0 && isspace((unsigned char) data[6]))
+	bang_proto(line, "!proto", errh);
+    else if (data + 11 <= end && memcmp(data, "!aggregate", 10) == 0 && isspace((unsigned char) data[10]))
+	bang_aggregate(line, errh);
+    else if (data + 8 <= end && memcmp(data, "!binary", 7) == 0 && isspace((unsigned char) data[7]))
+	bang_binary(line, errh);
+    else if (data + 10 <= end && memcmp(data, "!columnar", 9) == 0 && isspace((unsigned char) data[9]))
+	bang_columnar(line, errh);
+    else if (data + 10 <= end && memcmp(data, "!contents", 9) == 0 && isspace((unsigned char) data[9]))
+	bang_data(line, errh);
+}
+
+void
+FromIPSummaryDump::format_complaint(ErrorHandler *errh)
+{
+    if (!_format_complaint) {
+	if (_fields.size() == 0)
+	    _ff.error(errh, "no '!data' provided");
+	else
+	    _ff.error(errh, "packet parse error");
+	_format_complaint = true;
+    }
+}
+
 Packet *
 FromIPSummaryDump::read_packet(ErrorHandler *errh)
 {
+#if HAVE_MULTITHREAD
+    if (_chunk_tail && !_binary)
+	return read_parallel_packet(errh);
+#endif
+
     // read non-packet lines
     bool binary;
     String line;
-    const char *data;
-    const char *end;
 
     while (1) {
-	if ((binary = _binary)) {
+	if (_block_row < _block_nrows) {
+	    binary = true;
+	    break;
+	} else if ((binary = _binary)) {
 	    int result = read_binary(line, errh);
 	    if (result <= 0)
 		goto eof;
-	    else
+	    else if (result == 1 && _columnar) {
+		decode_block(line, errh);
+		continue;
+	    } else
 		binary = (result == 1);
 	} else if (_ff.read_line(line, errh, true) <= 0) {
 	  eof:
 	    _ff.cleanup();
+	    _parse_end = Timestamp::now();
 	    return 0;
 	}
 
-	data = line.begin();
-	end = line.end();
-
-	if (data == end)
+	if (!line)
 	    /* do nothing */;
-	else if (binary || (data[0] != '!' && data[0] != '#'))
+	else if (binary || (line[0] != '!' && line[0] != '#'))
 	    /* real packet */
 	    break;
-
-	// parse bang lines
-	if (data[0] == '!') {
-	    if (data + 6 <= end && memcmp(data, "!data", 5) == 0 && isspace((unsigned char) data[5]))
-		bang_data(line, errh);
-	    else if (data + 8 <= end && memcmp(data, "!flowid", 7) == 0 && isspace((unsigned char) data[7]))
-		bang_flowid(line, errh);
-	    else if (data + 7 <= end && memcmp(data, "!proto", 6) == 0 && isspace((unsigned char) data[6]))
-		bang_proto(line, "!proto", errh);
-	    else if (data + 11 <= end && memcmp(data, "!aggregate", 10) == 0 && isspace((unsigned char) data[10]))
-		bang_aggregate(line, errh);
-	    else if (data + 8 <= end && memcmp(data, "!binary", 7) == 0 && isspace((unsigned char) data[7]))
-		bang_binary(line, errh);
-	    else if (data + 10 <= end && memcmp(data, "!contents", 9) == 0 && isspace((unsigned char) data[9]))
-		bang_data(line, errh);
-	}
+	else if (line[0] == '!')
+	    bang_line(line, errh);
     }
 
+    if (!_parse_start)
+	_parse_start = Timestamp::now();
+    bool parse_error = false;
+    Packet *p = parse_packet(line, binary, errh, &parse_error);
+    if (parse_error)
+	format_complaint(errh);
+    else if (p)
+	_parse_count++;
+    return p;
+}
+
+// Parses one packet record.  For ASCII records, this reads but does not
+// modify element state, so worker threads may call it concurrently.
+Packet *
+FromIPSummaryDump::parse_packet(const String &line, bool binary, ErrorHandler *errh, bool *parse_error)
+{
+    const char *data = line.begin();
+    const char *end = line.end();
+
     // read packet data
     WritablePacket *q = Packet::make(16, (const unsigned char *) 0, 0, 1000);
     if (!q) {
@@ -406,7 +608,31 @@ FromIPSummaryDump::read_packet(ErrorHandler *errh)
     int nfields = 0;
 
     // new code goes here
-    if (_binary) {
+    if (_block_row < _block_nrows) {
+	for (int *fip = _field_order.begin();
+	     fip != _field_order.end() && d.p;
+	     ++fip) {
+	    const IPSummaryDump::FieldReader *f = _fields[*fip];
+	    const uint8_t *pos = _column_pos[*fip];
+	    if (!pos)
+		continue;
+	    // fixed-width columns are indexed by row; others are walked
+	    int width = IPSummaryDump::column_width(f->type);
+	    if (width >= 0)
+		pos += _block_row * width;
+	    d.clear_values();
+	    const uint8_t *next = f->inb(d, pos, _column_end[*fip], f);
+	    if (width < 0)
+		_column_pos[*fip] = next;
+	    if (next) {
+		f->inject(d, f);
+		nfields++;
+	    }
+	}
+	if (++_block_row == _block_nrows)
+	    _block = String();
+
+    } else if (_binary) {
 	Vector<const unsigned char *> args;
 	int nbytes;
 	for (const IPSummaryDump::FieldReader * const *fp = _fields.begin(); fp != _fields.end(); ++fp) {
@@ -498,16 +724,9 @@ FromIPSummaryDump::read_packet(ErrorHandler *errh)
     }
 
     if (!nfields) {	// bad format
-	if (!_format_complaint) {
-	    // don't complain if the line was all blank
-	    if (binary || !cp_is_space(line)) {
-		if (_fields.size() == 0)
-		    _ff.error(errh, "no '!data' provided");
-		else
-		    _ff.error(errh, "packet parse error");
-		_format_complaint = true;
-	    }
-	}
+	// don't complain if the line was all blank
+	if (binary || !cp_is_space(line))
+	    *parse_error = true;
 	if (d.p)
 	    d.p->kill();
 	d.p = 0;
@@ -568,6 +787,224 @@ FromIPSummaryDump::read_packet(ErrorHandler *errh)
     return d.p;
 }
 
+#if HAVE_MULTITHREAD
+void *
+FromIPSummaryDump::worker_thread(void *arg)
+{
+    static_cast<FromIPSummaryDump *>(arg)->worker_loop();
+    return 0;
+}
+
+void
+FromIPSummaryDump::worker_loop()
+{
+    pthread_mutex_lock(&_lock);
+    while (!_workers_stop) {
+	Chunk *c = _chunk_unclaimed;
+	if (!c) {
+	    pthread_cond_wait(&_work_cond, &_lock);
+	    continue;
+	}
+	_chunk_unclaimed = c->next;
+	pthread_mutex_unlock(&_lock);
+
+	parse_chunk(c);
+
+	pthread_mutex_lock(&_lock);
+	c->parsed = true;
+	_parse_count += c->packets.size();
+	pthread_cond_signal(&_done_cond);
+    }
+    pthread_mutex_unlock(&_lock);
+}
+
+namespace {
+struct ChunkEntry {
+    Packet *p;
+    int index;
+};
+
+int
+chunk_entry_compare(const void *ap, const void *bp, void *)
+{
+    const ChunkEntry *a = static_cast<const ChunkEntry *>(ap);
+    const ChunkEntry *b = static_cast<const ChunkEntry *>(bp);
+    if (a->p->timestamp_anno() != b->p->timestamp_anno())
+	return a->p->timestamp_anno() < b->p->timestamp_anno() ? -1 : 1;
+    return a->index - b->index;
+}
+}
+
+void
+FromIPSummaryDump::parse_chunk(Chunk *c)
+{
+    const char *s = c->data.begin(), *end = c->data.end();
+    int lineno = c->lineno;
+    while (s < end) {
+	const char *e = s;
+	while (e < end && *e != '\n' && *e != '\r')
+	    ++e;
+	if (e < end)
+	    e += (*e == '\r' && e + 1 < end && e[1] == '\n' ? 2 : 1);
+	if (*s != '!' && *s != '#') {
+	    bool parse_error = false;
+	    String line = String::make_stable(s, e - s);
+	    if (Packet *p = parse_packet(line, false, 0, &parse_error))
+		c->packets.push_back(p);
+	    else if (parse_error && !c->error_lineno)
+		c->error_lineno = lineno;
+	}
+	s = e;
+	++lineno;
+    }
+
+    // ORDERED output merges sorted chunks; keep equal timestamps in file order
+    if (_ordered) {
+	Vector<ChunkEntry> v(c->packets.size(), ChunkEntry());
+	for (int i = 0; i < v.size(); i++)
+	    v[i].p = c->packets[i], v[i].index = i;
+	click_qsort(v.begin(), v.size(), sizeof(ChunkEntry), chunk_entry_compare);
+	for (int i = 0; i < v.size(); i++)
+	    c->packets[i] = v[i].p;
+    }
+}
+
+bool
+FromIPSummaryDump::read_chunk(ErrorHandler *errh)
+{
+    StringAccum sa;
+    int lineno = _ff.lineno() + 1;
+    String line;
+    while (sa.length() < (int) _chunk_size) {
+	if (_ff.read_line(line, errh, true) <= 0) {
+	    _chunk_eof = true;
+	    break;
+	}
+	if (line && line[0] == '!' && !line.starts_with("!bad", 4)) {
+	    // apply possible state changes after earlier chunks are consumed
+	    _pending_bang = String(line.data(), line.length());
+	    break;
+	}
+	sa.append(line.data(), line.length());
+    }
+    if (!sa)
+	return false;
+
+    Chunk *c = new Chunk;
+    c->data = sa.take_string();
+    c->lineno = lineno;
+    c->error_lineno = 0;
+    c->pos = 0;
+    c->parsed = false;
+    c->next = 0;
+
+    pthread_mutex_lock(&_lock);
+    *_chunk_tail = c;
+    _chunk_tail = &c->next;
+    if (!_chunk_unclaimed)
+	_chunk_unclaimed = c;
+    _nchunks++;
+    pthread_cond_signal(&_work_cond);
+    pthread_mutex_unlock(&_lock);
+    return true;
+}
+
+Packet *
+FromIPSummaryDump::read_parallel_packet(ErrorHandler *errh)
+{
+    if (!_parse_start)
+	_parse_start = Timestamp::now();
+    // ORDERED merges the heads of the first _nthreads chunks
+    int window = (_ordered ? _nthreads : 1);
+
+    while (1) {
+	// keep the workers busy
+	while (_nchunks < 2 * _nthreads && !_chunk_eof && !_pending_bang
+	       && read_chunk(errh))
+	    /* nada */;
+
+	// wait for the window to be parsed, then drop exhausted chunks
+	pthread_mutex_lock(&_lock);
+	while (1) {
+	    Chunk *c = _chunk_head;
+	    int k = 0;
+	    for (; c && k < window && c->parsed; c = c->next)
+		++k;
+	    if (k == window || !c)
+		break;
+	    pthread_cond_wait(&_done_cond, &_lock);
+	}
+	bool popped = false;
+	while (Chunk *c = _chunk_head) {
+	    if (!c->parsed || c->pos < c->packets.size())
+		break;
+	    if (c->error_lineno) {
+		int lineno = _ff.lineno();
+		_ff.set_lineno(c->error_lineno);
+		format_complaint(errh);
+		_ff.set_lineno(lineno);
+	    }
+	    if (!(_chunk_head = c->next))
+		_chunk_tail = &_chunk_head;
+	    _nchunks--;
+	    delete c;
+	    popped = true;
+	}
+	pthread_mutex_unlock(&_lock);
+	if (popped)
+	    continue;
+
+	if (!_chunk_head) {
+	    if (_pending_bang) {
+		String line = _pending_bang;
+		_pending_bang = String();
+		bang_line(line, errh);
+		if (_binary)
+		    return read_packet(errh);
+		continue;
+	    }
+	    _ff.cleanup();
+	    _parse_end = Timestamp::now();
+	    return 0;
+	}
+
+	Chunk *best = _chunk_head;
+	int k = 1;
+	for (Chunk *c = best->next; c && k < window; c = c->next, ++k)
+	    if (c->pos < c->packets.size()
+		&& c->packets[c->pos]->timestamp_anno() < best->packets[best->pos]->timestamp_anno())
+		best = c;
+	return best->packets[best->pos++];
+    }
+}
+
+void
+FromIPSummaryDump::stop_workers()
+{
+    if (!_chunk_tail)
+	return;
+    pthread_mutex_lock(&_lock);
+    _workers_stop = true;
+    pthread_cond_broadcast(&_work_cond);
+    pthread_mutex_unlock(&_lock);
+    for (int i = 0; i < _workers.size(); i++)
+	pthread_join(_workers[i], 0);
+    _workers.clear();
+
+    while (Chunk *c = _chunk_head) {
+	_chunk_head = c->next;
+	for (int i = c->pos; i < c->packets.size(); i++)
+	    c->packets[i]->kill();
+	delete c;
+    }
+    _chunk_tail = 0;
+    _pending_bang = String();
+    pthread_cond_destroy(&_done_cond);
+    pthread_cond_destroy(&_work_cond);
+    pthread_mutex_destroy(&_lock);
+}
+#endif
+
 inline Packet *
 set_packet_lengths(Packet *p, uint32_t extra_length)
 {
@@ -691,6 +1128,10 @@ FromIPSummaryDump::run_task(Task *)
 	    return false;
 	} else if (!p)
 	    break;
+	if ((_start_time || _end_time) && p != _work_packet && !in_time_range(p)) {
+	    p->kill();
+	    continue;
+	}
 	if (p && _timing && !check_timing(p))
 	    return false;
 	if (_multipacket)
@@ -724,6 +1165,10 @@ FromIPSummaryDump::pull(int)
 	    _notifier.sleep();
 	    return 0;
 	}
+	if (p && (_start_time || _end_time) && p != _work_packet && !in_time_range(p)) {
+	    p->kill();
+	    continue;
+	}
 	if (p && _timing && !check_timing(p))
 	    return 0;
 	if (_multipacket)
@@ -741,7 +1186,7 @@ FromIPSummaryDump::pull(int)
 }
 
 
-enum { H_SAMPLING_PROB, H_ACTIVE, H_ENCAP, H_STOP };
+enum { H_SAMPLING_PROB, H_ACTIVE, H_ENCAP, H_STOP, H_PARSE_RATE, H_PARSE_COUNT };
 
 String
 FromIPSummaryDump::read_handler(Element *e, void *thunk)
@@ -754,6 +1199,14 @@ FromIPSummaryDump::read_handler(Element *e, void *thunk)
 	return BoolArg::unparse(fd->_active);
       case H_ENCAP:
 	return "IP";
+      case H_PARSE_RATE: {
+	  Timestamp end = (fd->_parse_end ? fd->_parse_end : Timestamp::now());
+	  if (!fd->_parse_start || end <= fd->_parse_start)
+	      return "0";
+	  return String(fd->_parse_count / (end - fd->_parse_start).doubleval());
+      }
+      case H_PARSE_COUNT:
+	return String(fd->_parse_count);
       default:
 	return "<error>";
     }
@@ -793,6 +1246,8 @@ FromIPSummaryDump::add_handlers()
     add_read_handler("active", read_handler, H_ACTIVE, Handler::CHECKBOX);
     add_write_handler("active", write_handler, H_ACTIVE);
     add_read_handler("encap", read_handler, H_ENCAP);
+    add_read_handler("parse_rate", read_handler, H_PARSE_RATE);
+    add_read_handler("parse_count", read_handler, H_PARSE_COUNT);
     add_write_handler("stop", write_handler, H_STOP, Handler::BUTTON);
     _ff.add_handlers(this);
     if (output_is_push(0))
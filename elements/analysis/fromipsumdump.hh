@@ -8,12 +8,15 @@
 #include <click/ipflowid.hh>
 #include <click/fromfile.hh>
 #include "ipsumdumpinfo.hh"
+#if HAVE_MULTITHREAD
+# include <pthread.h>
+#endif
 CLICK_DECLS
 
 /*
 =c
 
-FromIPSummaryDump(FILENAME [, I<keywords> STOP, TIMING, ACTIVE, ZERO, CHECKSUM, PROTO, MULTIPACKET, SAMPLE, CONTENTS, FLOWID])
+FromIPSummaryDump(FILENAME [, I<keywords> STOP, TIMING, ACTIVE, ZERO, CHECKSUM, PROTO, MULTIPACKET, SAMPLE, CONTENTS, FLOWID, START, END, THREADS, CHUNK_SIZE, ORDERED])
 
 =s traces
 
@@ -28,6 +31,10 @@ output. Optionally stops the driver when there are no more packets.
 The file may be compressed with gzip(1) or bzip2(1); FromIPSummaryDump will
 run zcat(1) or bzcat(1) to uncompress it.
 
+FromIPSummaryDump reads ASCII, BINARY, and COLUMNAR dumps (see
+ToIPSummaryDump).  Columnar dumps are decoded a block at a time, and fields
+the reader does not understand are skipped.
+
 FromIPSummaryDump reads from the file named FILENAME unless FILENAME is a
 single dash 'C<->', in which case it reads from the standard input. It will
 not uncompress the standard input, however.
@@ -100,6 +107,38 @@ destination address, destination port, and, optionally, protocol). Defines the
 IP addresses and ports used by default. Any flow information in the input file
 will override this setting.
 
+=item START
+
+Timestamp. If set, FromIPSummaryDump skips packets with timestamps before
+START. In COLUMNAR dumps, whole blocks are skipped without being decoded,
+and the dump's block index, if any, is used to seek directly to the first
+relevant block.
+
+=item END
+
+Timestamp. If set, FromIPSummaryDump skips packets with timestamps after
+END. In COLUMNAR dumps, later blocks are skipped without being decoded.
+
+=item THREADS
+
+Integer. Number of worker threads used to parse ASCII dumps. If greater than
+1, the file is split at line boundaries into chunks of about CHUNK_SIZE
+bytes, which the workers parse into packets concurrently; packets are still
+emitted in file order. Binary and columnar dumps are always read by the
+element's own thread. Requires multithreaded user-level Click. Default is 1.
+
+=item CHUNK_SIZE
+
+Unsigned integer. Approximate size in bytes of the chunks handed to THREADS
+workers. Default is 262144 (256KB).
+
+=item ORDERED
+
+Boolean. If true, and THREADS is greater than 1, packets from neighboring
+chunks are merged so that they are emitted in timestamp order. This fixes
+small-scale reordering in the dump. TIMING implies ORDERED. Default is
+false.
+
 =item ALLOW_NONEXISTENT
 
 Boolean.  If true, allow nonexistent and empty files: FromIPSummaryDump will
@@ -133,6 +172,15 @@ Value is a Boolean.
 
 Returns 'IP'. Useful for ToDump's USE_ENCAP_FROM option.
 
+=h parse_rate read-only
+
+Returns the number of packets parsed per second since the first packet was
+parsed, measured until the end of the file.
+
+=h parse_count read-only
+
+Returns the number of packets parsed so far.
+
 =h filesize read-only
 
 Returns the length of the FromIPSummaryDump file, in bytes, or "-" if that
@@ -193,6 +241,8 @@ class FromIPSummaryDump : public Element, public IPSummaryDumpInfo { public:
     bool _timing : 1;
     bool _have_timing : 1;
     bool _allow_nonexistent : 1;
+    bool _columnar : 1;
+    bool _ordered : 1;
     Packet *_work_packet;
     uint32_t _multipacket_length;
     Timestamp _multipacket_timestamp_delta;
@@ -206,7 +256,49 @@ class FromIPSummaryDump : public Element, public IPSummaryDumpInfo { public:
     int _minor_version;
     IPFlowID _given_flowid;
 
+    Timestamp _start_time;
+    Timestamp _end_time;
+    String _block;
+    uint32_t _block_nrows;
+    uint32_t _block_row;
+    Vector<StringAccum> _decoded;
+    Vector<const uint8_t *> _column_pos;
+    Vector<const uint8_t *> _column_end;
+
+    int _nthreads;
+    uint32_t _chunk_size;
+    uint64_t _parse_count;
+    Timestamp _parse_start;
+    Timestamp _parse_end;
+#if HAVE_MULTITHREAD
+    struct Chunk;
+    Chunk *_chunk_head;
+    Chunk **_chunk_tail;
+    Chunk *_chunk_unclaimed;
+    int _nchunks;
+    bool _chunk_eof;
+    bool _workers_stop;
+    String _pending_bang;
+    Vector<pthread_t> _workers;
+    pthread_mutex_t _lock;
+    pthread_cond_t _work_cond;
+    pthread_cond_t _done_cond;
+
+    static void *worker_thread(void *);
+    void worker_loop();
+    void parse_chunk(Chunk *);
+    bool read_chunk(ErrorHandler *);
+    Packet *read_parallel_packet(ErrorHandler *);
+    void stop_workers();
+#endif
+
     int read_binary(String &, ErrorHandler *);
+    void decode_block(const String &, ErrorHandler *);
+    void seek_index(ErrorHandler *);
+    bool in_time_range(const Packet *p) const {
+	return (!_start_time || p->timestamp_anno() >= _start_time)
+	    && (!_end_time || p->timestamp_anno() <= _end_time);
+    }
 
     static int sort_fields_compare(const void *, const void *, void *);
     void bang_data(const String &, ErrorHandler *);
@@ -214,9 +306,13 @@ class FromIPSummaryDump : public Element, public IPSummaryDumpInfo { public:
     void bang_flowid(const String &, ErrorHandler *);
     void bang_aggregate(const String &, ErrorHandler *);
     void bang_binary(const String &, ErrorHandler *);
+    void bang_columnar(const String &, ErrorHandler *);
     void check_defaults();
     bool check_timing(Packet *p);
+    void bang_line(const String &, ErrorHandler *);
+    void format_complaint(ErrorHandler *);
     Packet *read_packet(ErrorHandler *);
+    Packet *parse_packet(const String &, bool binary, ErrorHandler *, bool *parse_error);
     Packet *handle_multipacket(Packet *);
 
     static String read_handler(Element *, void *);
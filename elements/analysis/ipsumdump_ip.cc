@@ -585,6 +585,7 @@ void unparse_ip_opt_binary(StringAccum& sa, const uint8_t *opt, int opt_len, int
 	// store all options
 	sa.append((char)opt_len);
 	sa.append(opt, opt_len);
+	return;
     }
 
     const uint8_t *end_opt = opt + opt_len;
@@ -344,6 +344,108 @@ const uint8_t *inb(PacketOdesc& d, const uint8_t *s, const uint8_t *end, const F
 
 
 
+// Columnar blocks store each field's binary values contiguously.  Fixed-width
+// 4- and 8-byte columns (timestamps, addresses, sequence numbers) are usually
+// smaller when each 32-bit lane is stored as a zigzag varint delta from the
+// previous row; encode_column picks whichever encoding is shorter.  Each
+// chunk is preceded by a word holding the encoding in the top byte and the
+// chunk length in the low 24 bits.
+
+int column_width(int type)
+{
+    switch (type) {
+      case B_0:
+      case B_1:
+      case B_2:
+      case B_4:
+      case B_8:
+      case B_16:
+	return type;
+      case B_6PTR:
+	return 6;
+      case B_4NET:
+	return 4;
+      default:
+	return -1;
+    }
+}
+
+void encode_column(StringAccum &sa, const uint8_t *data, uint32_t len, int width)
+{
+    int word = sa.length();
+    sa.extend(4);
+    int encoding = COLUMN_RAW;
+
+    if ((width == 4 || width == 8) && len) {
+	uint32_t prev[2] = {0, 0};
+	for (const uint8_t *end = data + len; data != end; )
+	    for (int lane = 0; lane < width / 4; ++lane, data += 4) {
+		uint32_t v = GET4(data);
+		uint32_t delta = v - prev[lane];
+		uint32_t z = (delta << 1) ^ (uint32_t) ((int32_t) delta >> 31);
+		prev[lane] = v;
+		char *c = sa.extend(5);
+		int n = 0;
+		for (; z >= 0x80; z >>= 7)
+		    c[n++] = (z & 0x7F) | 0x80;
+		c[n++] = z;
+		sa.adjust_length(n - 5);
+	    }
+	data -= len;
+	if ((uint32_t) (sa.length() - word - 4) < len)
+	    encoding = COLUMN_DELTA;
+	else
+	    sa.set_length(word + 4);
+    }
+
+    if (encoding == COLUMN_RAW)
+	sa.append(data, len);
+    uint32_t clen = sa.length() - word - 4;
+    assert(clen <= COLUMN_MAX_LENGTH);
+    PUT4((uint8_t *) sa.data() + word, (encoding << 24) | clen);
+}
+
+const uint8_t *decode_column(StringAccum &sa, const uint8_t *s, const uint8_t *end, int width, uint32_t nrows, const uint8_t *&data, const uint8_t *&data_end)
+{
+    if (s + 4 > end)
+	return 0;
+    uint32_t word = GET4(s);
+    uint32_t clen = word & COLUMN_MAX_LENGTH;
+    s += 4;
+    if (s + clen > end)
+	return 0;
+    if ((word >> 24) == COLUMN_RAW) {
+	data = s;
+	data_end = s + clen;
+	return data_end;
+    } else if ((word >> 24) != COLUMN_DELTA || (width != 4 && width != 8))
+	return 0;
+
+    sa.clear();
+    uint8_t *out = (uint8_t *) sa.extend(nrows * width);
+    if (!out)
+	return 0;
+    uint32_t prev[2] = {0, 0};
+    const uint8_t *x = s, *xend = s + clen;
+    for (uint32_t i = 0; i != nrows; ++i)
+	for (int lane = 0; lane < width / 4; ++lane, out += 4) {
+	    uint32_t z = 0;
+	    for (int shift = 0; ; shift += 7) {
+		if (x == xend || shift > 28)
+		    return 0;
+		z |= (uint32_t) (*x & 0x7F) << shift;
+		if (!(*x++ & 0x80))
+		    break;
+	    }
+	    prev[lane] += (z >> 1) ^ -(z & 1);
+	    PUT4(out, prev[lane]);
+	}
+    data = (const uint8_t *) sa.begin();
+    data_end = (const uint8_t *) sa.end();
+    return xend;
+}
+
+
 void ip_prepare(PacketDesc &d, const FieldWriter *)
 {
     Packet *p = const_cast<Packet *>(d.p);
@@ -190,6 +190,16 @@ void unparse_ip_opt(StringAccum&, const click_ip*, int mask);
 void unparse_ip_opt_binary(StringAccum&, const uint8_t*, int olen, int mask);
 void unparse_ip_opt_binary(StringAccum&, const click_ip*, int mask);
 
+// columnar format
+enum { COLUMN_RAW = 0,		// concatenated binary field values
+       COLUMN_DELTA = 1,	// zigzag varint deltas of 32-bit lanes
+       COLUMN_BLOCK_HEADER = 20,
+       COLUMN_MAX_LENGTH = 0xFFFFFF,
+       COLUMN_MAX_ROWS = 32768 };
+int column_width(int type);
+void encode_column(StringAccum &sa, const uint8_t *data, uint32_t len, int width);
+const uint8_t *decode_column(StringAccum &sa, const uint8_t *s, const uint8_t *end, int width, uint32_t nrows, const uint8_t *&data, const uint8_t *&data_end);
+
 extern const char tcp_flags_word[];
 extern const uint8_t tcp_flag_mapping[256];
 
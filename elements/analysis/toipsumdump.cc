@@ -31,7 +31,7 @@
 CLICK_DECLS
 
 ToIPSummaryDump::ToIPSummaryDump()
-    : _f(0), _task(this)
+    : _f(0), _task(this), _block_rows(0), _max_block_rows(4096), _file_pos(0)
 {
 }
 
@@ -50,6 +50,8 @@ ToIPSummaryDump::configure(Vector<String> &conf, ErrorHandler *errh)
     bool binary = false;
     bool header = true;
     bool extra_length = true;
+    bool columnar = false;
+    bool index = true;
 
     if (Args(conf, this, errh)
 	.read_mp("FILENAME", FilenameArg(), _filename)
@@ -63,8 +65,13 @@ ToIPSummaryDump::configure(Vector<String> &conf, ErrorHandler *errh)
 	.read("CAREFUL_TRUNC", careful_trunc)
 	.read("EXTRA_LENGTH", extra_length)
 	.read("BINARY", binary)
+	.read("COLUMNAR", columnar)
+	.read("BLOCK_ROWS", _max_block_rows)
+	.read("INDEX", index)
 	.complete() < 0)
 	return -1;
+    if (_max_block_rows == 0 || _max_block_rows > IPSummaryDump::COLUMN_MAX_ROWS)
+	return errh->error("BLOCK_ROWS must be between 1 and %d", IPSummaryDump::COLUMN_MAX_ROWS);
 
     Vector<String> v;
     cp_spacevec(save, v);
@@ -92,6 +99,8 @@ ToIPSummaryDump::configure(Vector<String> &conf, ErrorHandler *errh)
 	int s = f->binary_size();
 	if ((s < 0 || !f->outb) && binary)
 	    errh->error("cannot use CONTENTS %s with BINARY", word.c_str());
+	else if ((s < 0 || !f->outb) && columnar)
+	    errh->error("cannot use CONTENTS %s with COLUMNAR", word.c_str());
 	_binary_size += s;
 
 	// remove _multipacket if packet count specified
@@ -105,7 +114,9 @@ ToIPSummaryDump::configure(Vector<String> &conf, ErrorHandler *errh)
     _bad_packets = bad_packets;
     _careful_trunc = careful_trunc;
     _multipacket = multipacket;
-    _binary = binary;
+    _binary = binary || columnar;
+    _columnar = columnar;
+    _index = index;
     _header = header;
     _extra_length = extra_length;
 
@@ -131,6 +142,9 @@ ToIPSummaryDump::initialize(ErrorHandler *errh)
     }
     _active = true;
     _output_count = 0;
+    _file_pos = 0;
+    _block_rows = 0;
+    _columns.assign(_columnar ? _fields.size() : 0, StringAccum());
 
     // magic number
     StringAccum sa;
@@ -161,12 +175,14 @@ ToIPSummaryDump::initialize(ErrorHandler *errh)
     sa << '\n';
 
     // binary marker
-    if (_binary)
+    if (_columnar)
+	sa << "!columnar\n";
+    else if (_binary)
 	sa << "!binary\n";
 
     // print output
     if (_header)
-	ignore_result(fwrite(sa.data(), 1, sa.length(), _f));
+	fwrite_count(sa.data(), sa.length());
 
     return 0;
 }
@@ -174,20 +190,42 @@ ToIPSummaryDump::initialize(ErrorHandler *errh)
 void
 ToIPSummaryDump::cleanup(CleanupStage)
 {
+    if (_f && _columnar) {
+	flush_block();
+	if (_index)
+	    write_index();
+    }
     if (_f && _f != stdout)
 	fclose(_f);
     _f = 0;
 }
 
+void
+ToIPSummaryDump::fwrite_count(const void *data, size_t len)
+{
+    ignore_result(fwrite(data, 1, len, _f));
+    _file_pos += len;
+}
+
 bool
-ToIPSummaryDump::summary(Packet* p, StringAccum& sa, StringAccum* bad_sa) const
+ToIPSummaryDump::summary(Packet* p, StringAccum& sa, StringAccum* bad_sa)
 {
     IPSummaryDump::PacketDesc d(this, p, &sa, bad_sa, _careful_trunc, _extra_length);
 
     for (int i = 0; i < _prepare_fields.size(); i++)
 	_prepare_fields[i]->prepare(d, _prepare_fields[i]);
 
-    if (_binary) {
+    if (_columnar) {
+	// append_row() distributes the fields to their columns
+	_row_marks.resize(_fields.size() + 1);
+	for (int i = 0; i < _fields.size(); i++) {
+	    _row_marks[i] = sa.length();
+	    d.clear_values();
+	    bool ok = _fields[i]->extract(d, _fields[i]);
+	    _fields[i]->outb(d, ok, _fields[i]);
+	}
+	_row_marks[_fields.size()] = sa.length();
+    } else if (_binary) {
 	sa.extend(4);
 	for (int i = 0; i < _fields.size(); i++) {
 	    d.clear_values();
@@ -251,12 +289,64 @@ ToIPSummaryDump::write_packet(Packet* p, int multipacket)
 
 	if (_bad_packets && _bad_sa)
 	    write_line(_bad_sa.take_string());
-	ignore_result(fwrite(_sa.data(), 1, _sa.length(), _f));
+	if (_columnar) {
+	    append_row();
+	    if (_block_rows == 1)
+		_block_first = p->timestamp_anno();
+	    _block_last = p->timestamp_anno();
+	    if (_block_rows == _max_block_rows)
+		flush_block();
+	} else
+	    fwrite_count(_sa.data(), _sa.length());
 
 	_output_count++;
     }
 }
 
+void
+ToIPSummaryDump::append_row()
+{
+    for (int i = 0; i < _fields.size(); i++)
+	_columns[i].append(_sa.data() + _row_marks[i], _row_marks[i + 1] - _row_marks[i]);
+    _block_rows++;
+}
+
+void
+ToIPSummaryDump::flush_block()
+{
+    if (!_block_rows)
+	return;
+
+    StringAccum sa;
+    uint32_t *hdr = reinterpret_cast<uint32_t *>(sa.extend(4 + IPSummaryDump::COLUMN_BLOCK_HEADER));
+    hdr[1] = htonl(_block_rows);
+    hdr[2] = htonl(_block_first.sec());
+    hdr[3] = htonl(_block_first.nsec());
+    hdr[4] = htonl(_block_last.sec());
+    hdr[5] = htonl(_block_last.nsec());
+    for (int i = 0; i < _fields.size(); i++) {
+	IPSummaryDump::encode_column(sa, reinterpret_cast<const uint8_t *>(_columns[i].data()), _columns[i].length(), IPSummaryDump::column_width(_fields[i]->type));
+	_columns[i].clear();
+    }
+    *reinterpret_cast<uint32_t *>(sa.data()) = htonl(sa.length());
+
+    if (_index)
+	_index_sa << _file_pos << ' ' << _block_rows << ' '
+		  << _block_first << ' ' << _block_last << '\n';
+    fwrite_count(sa.data(), sa.length());
+    _block_rows = 0;
+}
+
+void
+ToIPSummaryDump::write_index()
+{
+    off_t index_pos = _file_pos;
+    write_line("#index\n" + _index_sa.take_string());
+    char buf[40];
+    sprintf(buf, "#index_offset %020llu\n", (unsigned long long) index_pos);
+    write_line(buf);
+}
+
 void
 ToIPSummaryDump::push(int, Packet *p)
 {
@@ -287,11 +377,14 @@ ToIPSummaryDump::write_line(const String& s)
 {
     if (s.length()) {
 	assert(s.back() == '\n');
+	// keep metadata in order with the packets around it
+	if (_columnar)
+	    flush_block();
 	if (_binary) {
-	    uint32_t marker = htonl(s.length() | 0x80000000U);
-	    ignore_result(fwrite(&marker, 4, 1, _f));
+	    uint32_t marker = htonl((s.length() + 4) | 0x80000000U);
+	    fwrite_count(&marker, 4);
 	}
-	ignore_result(fwrite(s.data(), 1, s.length(), _f));
+	fwrite_count(s.data(), s.length());
     }
 }
 
@@ -300,14 +393,16 @@ ToIPSummaryDump::add_note(const String &s)
 {
     if (s.length()) {
 	int extra = 1 + (s.back() == '\n' ? 0 : 1);
+	if (_columnar)
+	    flush_block();
 	if (_binary) {
-	    uint32_t marker = htonl((s.length() + extra) | 0x80000000U);
-	    ignore_result(fwrite(&marker, 4, 1, _f));
+	    uint32_t marker = htonl((s.length() + extra + 4) | 0x80000000U);
+	    fwrite_count(&marker, 4);
 	}
-	fputc('#', _f);
-	ignore_result(fwrite(s.data(), 1, s.length(), _f));
+	fwrite_count("#", 1);
+	fwrite_count(s.data(), s.length());
 	if (extra > 1)
-	    fputc('\n', _f);
+	    fwrite_count("\n", 1);
     }
 }
 
@@ -315,6 +410,8 @@ int
 ToIPSummaryDump::flush_handler(const String &, Element *e, void *, ErrorHandler *)
 {
     ToIPSummaryDump *tod = (ToIPSummaryDump *) e;
+    if (tod->_f && tod->_columnar)
+	tod->flush_block();
     if (tod->_f)
 	fflush(tod->_f);
     return 0;
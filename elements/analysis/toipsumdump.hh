@@ -23,7 +23,8 @@ Writes summary information about incoming packets to FILENAME in a simple
 ASCII format---each line corresponds to a packet.  The CONTENTS keyword
 argument determines what information is written.  Writes to standard output if
 FILENAME is a single dash `C<->'.  The BINARY keyword argument writes a packed
-binary format to save space.
+binary format to save space, and the COLUMNAR keyword argument writes a
+block-oriented columnar format that is smaller still and faster to read.
 
 ToIPSummaryDump uses packets' extra-length and extra-packet-count annotations.
 
@@ -137,6 +138,21 @@ of the dump. Ignored if HEADER is false.
 Boolean. If true, then output packet records in a binary format (explained
 below). Defaults to false.
 
+=item COLUMNAR
+
+Boolean. If true, then output packet records in blocks of binary columns
+(explained below). Defaults to false.
+
+=item BLOCK_ROWS
+
+Unsigned integer. The maximum number of packets in each COLUMNAR block.
+Defaults to 4096; at most 32768.
+
+=item INDEX
+
+Boolean. If true, then COLUMNAR dumps end with a block index that
+FromIPSummaryDump uses to seek directly to a START time. Defaults to true.
+
 =item MULTIPACKET
 
 Boolean. If true, and the CONTENTS option doesn't contain 'C<count>', then
@@ -338,6 +354,31 @@ The data stored in a metadata record is just an ASCII string, ending with
 newline, same as in a regular ASCII IPSummaryDump file. 'C<!bad>' records, for
 example, are stored this way.
 
+=head1 COLUMNAR FORMAT
+
+Columnar files use the line 'C<!columnar>' in place of 'C<!binary>'. The
+records that follow are metadata records, as in the binary format, or
+blocks of up to BLOCK_ROWS packets:
+
+   +---------------+---------------+---------------+---------------+
+   |0| block length|   row count   | first ts sec  | first ts nsec |
+   +---------------+---------------+---------------+---------------+
+   |  last ts sec  | last ts nsec  |   column 1    |   column 2... |
+   +---------------+---------------+---------------+---------------+
+
+Each column holds one 'C<!data>' field for all of the block's packets. It
+starts with a word whose top byte is the encoding and whose low 24 bits are
+the column length in bytes. Encoding 0 is the concatenation of the
+field's binary values, as in the table above. Encoding 1, used for 4- and
+8-byte fields when it saves space, stores each 32-bit word as the
+difference from the previous packet's word, zigzag-encoded as a
+little-endian base-128 varint. Readers can skip a block using only its
+header timestamps.
+
+When INDEX is true, the file ends with a 'C<#index>' metadata record, with
+one 'C<OFFSET ROWS FIRST LAST>' line per block, followed by a fixed-length
+'C<#index_offset>' metadata record giving that record's file offset.
+
 =h flush write-only
 
 Flush all internal buffers to disk.
@@ -383,6 +424,8 @@ class ToIPSummaryDump : public Element, public IPSummaryDumpInfo { public:
     bool _binary : 1;
     bool _header : 1;
     bool _extra_length : 1;
+    bool _columnar : 1;
+    bool _index : 1;
     int32_t _binary_size;
     uint32_t _output_count;
     Task _task;
@@ -393,7 +436,20 @@ class ToIPSummaryDump : public Element, public IPSummaryDumpInfo { public:
 
     String _banner;
 
-    bool summary(Packet* p, StringAccum& sa, StringAccum* bad_sa) const;
+    Vector<StringAccum> _columns;
+    Vector<int> _row_marks;
+    uint32_t _block_rows;
+    uint32_t _max_block_rows;
+    Timestamp _block_first;
+    Timestamp _block_last;
+    off_t _file_pos;
+    StringAccum _index_sa;
+
+    void fwrite_count(const void *, size_t);
+    void append_row();
+    void flush_block();
+    void write_index();
+    bool summary(Packet* p, StringAccum& sa, StringAccum* bad_sa);
     void write_packet(Packet* p, int multipacket);
     static int flush_handler(const String &, Element *, void *, ErrorHandler *);
 
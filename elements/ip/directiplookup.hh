@@ -92,6 +92,7 @@ class DirectIPLookup : public IPRouteTable { public:
     const char *class_name() const	{ return "DirectIPLookup"; }
     const char *port_count() const	{ return "1/-"; }
     const char *processing() const	{ return PUSH; }
+    const char *flags() const	{ return "C"; }
 
     int configure(Vector<String> &conf, ErrorHandler *errh);
     void cleanup(CleanupStage stage);
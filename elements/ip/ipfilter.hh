@@ -124,7 +124,12 @@ class IPFilter : public Element { public:
     const char *port_count() const		{ return "1/-"; }
     const char *processing() const		{ return PUSH; }
     // this element does not need AlignmentInfo; override Classifier's "A" flag
+#if HAVE_INDIFFERENT_ALIGNMENT
+    const char *flags() const			{ return "C"; }
+#else
+    // configure() may record an alignment warning in a router attachment
     const char *flags() const			{ return ""; }
+#endif
     bool can_live_reconfigure() const		{ return true; }
 
     int configure(Vector<String> &, ErrorHandler *);
@@ -120,42 +120,64 @@ IPFragmenter::fragment(Packet *p_in)
     output(0).push(first_fragment);
     _fragments++;
 
-    // output the remaining fragments
+    // Build the header of the remaining fragments once.  Its checksum is
+    // computed with zero length and offset, then updated per fragment.
+    uint32_t tmpl_buf[15];
+    click_ip *tmpl = reinterpret_cast<click_ip *>(tmpl_buf);
     int out_hlen = sizeof(click_ip) + optcopy(ip, 0);
-
-    for (int off = first_dlen; off < in_dlen; ) {
+    memcpy(tmpl, ip, sizeof(click_ip));
+    optcopy(ip, tmpl);
+    tmpl->ip_hl = out_hlen >> 2;
+    tmpl->ip_len = tmpl->ip_off = tmpl->ip_sum = 0;
+    uint16_t tmpl_sum = click_in_cksum((const unsigned char *)tmpl, out_hlen);
+
+    // The last fragment reuses the input packet, with its header written
+    // over payload that the earlier fragments have already copied, unless
+    // that header would overlap the first fragment's shared data.
+    int step = (_mtu - out_hlen) & ~7;
+    int last_off = first_dlen;
+    if (in_dlen > first_dlen)
+	last_off += ((in_dlen - first_dlen - 1) / step) * step;
+    bool reuse = last_off - first_dlen >= out_hlen;
+
+    for (int off = first_dlen; off < in_dlen; off += step) {
 	// prepare packet
-	int out_dlen = (_mtu - out_hlen) & ~7;
+	int out_dlen = step;
 	if (out_dlen + off > in_dlen)
 	    out_dlen = in_dlen - off;
 
-	WritablePacket *q = Packet::make(_headroom, 0, out_hlen + out_dlen, 0);
-	if (q) {
+	WritablePacket *q;
+	if (off == last_off && reuse) {
+	    unsigned char *qh = p->transport_header() + off - out_hlen;
+	    p->pull(qh - p->data());
+	    p->take(p->length() - out_hlen - out_dlen);
+	    p->clear_mac_header();
+	    p->set_network_header(p->data(), out_hlen);
+	    q = p;
+	    p = 0;
+	} else if ((q = Packet::make(_headroom, 0, out_hlen + out_dlen, 0))) {
 	    q->set_network_header(q->data(), out_hlen);
-	    click_ip *qip = q->ip_header();
-
-	    memcpy(qip, ip, sizeof(click_ip));
-	    optcopy(ip, qip);
 	    memcpy(q->transport_header(), p->transport_header() + off, out_dlen);
-
-	    qip->ip_hl = out_hlen >> 2;
-	    qip->ip_off = htons(ntohs(ip->ip_off) + (off >> 3));
-	    if (out_dlen + off >= in_dlen && !had_mf)
-		qip->ip_off &= ~htons(IP_MF);
-	    qip->ip_len = htons(out_hlen + out_dlen);
-	    qip->ip_sum = 0;
-	    qip->ip_sum = click_in_cksum((const unsigned char *)qip, out_hlen);
-
 	    q->copy_annotations(p);
-
-	    output(0).push(q);
-	    _fragments++;
-	}
-
-	off += out_dlen;
+	} else
+	    continue;
+
+	click_ip *qip = q->ip_header();
+	memcpy(qip, tmpl, out_hlen);
+	qip->ip_off = htons(ntohs(ip->ip_off) + (off >> 3));
+	if (out_dlen + off >= in_dlen && !had_mf)
+	    qip->ip_off &= ~htons(IP_MF);
+	qip->ip_len = htons(out_hlen + out_dlen);
+	qip->ip_sum = tmpl_sum;
+	click_update_in_cksum(&qip->ip_sum, 0, qip->ip_len);
+	click_update_in_cksum(&qip->ip_sum, 0, qip->ip_off);
+
+	output(0).push(q);
+	_fragments++;
     }
 
-    p->kill();
+    if (p)
+	p->kill();
 }
 
 void
@@ -22,7 +22,11 @@ CLICK_DECLS
  *
  * Copies all annotations to the fragments.
  *
- * Sends the fragments in order, starting with the first.
+ * Sends the fragments in order, starting with the first.  The first fragment
+ * shares the input packet's data, and the last one usually reuses the input
+ * packet itself, so only middle fragments are allocated and copied.  Their
+ * IP header is built once per input packet and its checksum updated for each
+ * fragment's length and offset.
  *
  * It is best to Strip() the MAC header from a packet before sending it to
  * IPFragmenter, since any MAC header is not copied to second and subsequent
@@ -26,6 +26,7 @@
 #if CLICK_USERLEVEL && HAVE_NETDB_H
 # include <netdb.h>
 # include <click/userutils.hh>
+# include <click/sync.hh>
 # ifndef _PATH_PROTOCOLS
 #  define _PATH_PROTOCOLS "/etc/protocols"
 # endif
@@ -148,6 +149,7 @@ class ServicesNameDB : public NameDB { public:
     ServicesNameDB(uint32_t type, ServicesNameDB *other);
     ~ServicesNameDB();
     bool query(const String &name, void *value, size_t vsize);
+    void prepare_concurrent_query();
   private:
     DynamicNameDB *_db;
     bool _read_db;
@@ -306,6 +308,18 @@ ServicesNameDB::read_services()
     } while (db != this);
 }
 
+void
+ServicesNameDB::prepare_concurrent_query()
+{
+    if (!_read_db)
+	read_services();
+    if (_db)
+	_db->prepare_concurrent_query();
+}
+
+// getprotobyname() and friends return static storage.
+static Spinlock netdb_lock;
+
 bool
 ServicesNameDB::query(const String &name, void *value, size_t vsize)
 {
@@ -321,10 +335,13 @@ ServicesNameDB::query(const String &name, void *value, size_t vsize)
 
     if (type() == NameInfo::T_IP_PROTO) {
 	if (!_db) {
-	    if (const struct protoent *proto = getprotobyname(name.c_str())) {
+	    netdb_lock.acquire();
+	    const struct protoent *proto = getprotobyname(name.c_str());
+	    if (proto)
 		*reinterpret_cast<uint32_t*>(value) = proto->p_proto;
+	    netdb_lock.release();
+	    if (proto)
 		return true;
-	    }
 	} else if (_db->query(name, value, vsize))
 	    return true;
     }
@@ -332,19 +349,20 @@ ServicesNameDB::query(const String &name, void *value, size_t vsize)
     if (type() >= NameInfo::T_IP_PORT && type() < NameInfo::T_IP_PORT + 256) {
 	if (!_db) {
 	    int proto = type() - NameInfo::T_IP_PORT;
-	    const char *proto_name;
+	    const char *proto_name = 0;
+	    const struct servent *srv = 0;
+	    netdb_lock.acquire();
 	    if (proto == IP_PROTO_TCP)
 		proto_name = "tcp";
 	    else if (proto == IP_PROTO_UDP)
 		proto_name = "udp";
 	    else if (const struct protoent *pe = getprotobynumber(proto))
 		proto_name = pe->p_name;
-	    else
-		return false;
-	    if (const struct servent *srv = getservbyname(name.c_str(), proto_name)) {
+	    if (proto_name && (srv = getservbyname(name.c_str(), proto_name)))
 		*reinterpret_cast<uint32_t*>(value) = ntohs(srv->s_port);
+	    netdb_lock.release();
+	    if (srv)
 		return true;
-	    }
 	} else if (_db->query(name, value, vsize))
 	    return true;
     }
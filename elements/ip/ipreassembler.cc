@@ -29,17 +29,18 @@
 #include <click/packet_anno.hh>
 #include <click/straccum.hh>
 #include <click/ipflowid.hh>
+#include <click/master.hh>
 CLICK_DECLS
 
 #define PACKET_CHUNK(p)		(*((ChunkLink *)((p)->anno_u8() + IPREASSEMBLER_ANNO_OFFSET)))
 #define PACKET_DLEN(p)		((p)->transport_length())
 #define IP_BYTE_OFF(iph)	((ntohs((iph)->ip_off) & IP_OFFMASK) << 3)
 
+uint32_t IPReassembler::Key::seed;
+
 IPReassembler::IPReassembler()
-    : _stat_frags_seen(0), _stat_good_assem(0), _stat_failed_assem(0), _stat_bad_pkts(0)
+    : _shards(0), _nshards(1)
 {
-    for (int i = 0; i < NMAP; i++)
-	_map[i] = 0;
     static_assert(IPREASSEMBLER_ANNO_OFFSET + IPREASSEMBLER_ANNO_SIZE <= Packet::anno_size, "anno too big");
     static_assert(sizeof(ChunkLink) == IPREASSEMBLER_ANNO_SIZE, "sizeof(ChunkLink) is expected to equal IPREASSEMBLER_ANNO_SIZE.");
 }
@@ -53,42 +54,59 @@ IPReassembler::configure(Vector<String> &conf, ErrorHandler *errh)
 {
     _mem_high_thresh = 256 * 1024;
     int mtu_anno = -1;
+    uint32_t nshards = master()->nthreads();
     if (Args(conf, this, errh)
 	.read("HIMEM", _mem_high_thresh)
 	.read("MAX_MTU_ANNO", AnnoArg(2), mtu_anno)
+	.read("SHARDS", nshards)
 	.complete() < 0)
 	return -1;
     _mtu_anno = mtu_anno;
-    _mem_low_thresh = (_mem_high_thresh >> 2) * 3;
+    for (_nshards = 1; _nshards < (int) nshards && _nshards < MAX_SHARDS; )
+	_nshards <<= 1;
     return 0;
 }
 
 int
 IPReassembler::initialize(ErrorHandler *)
 {
+    while (!Key::seed)
+	Key::seed = click_random();
+    _mem_low_thresh = (_mem_high_thresh >> 2) * 3;
     _mem_used = 0;
-    _reap_time = 0;
+    _wheel_time = 0;
+    _shards = new Shard[_nshards];
+    for (int i = 0; i < _nshards; i++) {
+	Shard &s = _shards[i];
+	s.wheel_time = 0;
+	s.mem_used = 0;
+	s.stat_frags_seen = s.stat_good_assem = s.stat_failed_assem = s.stat_bad_pkts = 0;
+    }
     return 0;
 }
 
 void
 IPReassembler::cleanup(CleanupStage)
 {
-    for (int i = 0; i < NMAP; i++)
-	while (_map[i]) {
-	    WritablePacket *next = (WritablePacket *)(_map[i]->next());
-	    _map[i]->kill();
-	    _map[i] = next;
+    for (int i = 0; _shards && i < _nshards; i++) {
+	Shard &s = _shards[i];
+	for (Table::iterator it = s.table.begin(); it; ) {
+	    Datagram *d = s.table.erase(it);
+	    d->_q->kill();
+	    s.alloc.deallocate(d);
 	}
+    }
+    delete[] _shards;
+    _shards = 0;
 }
 
 void
-IPReassembler::check_error(ErrorHandler *errh, int bucket, const Packet *p, const char *format, ...)
+IPReassembler::check_error(ErrorHandler *errh, int shard, const Packet *p, const char *format, ...)
 {
     va_list val;
     va_start(val, format);
     StringAccum sa;
-    sa << "buck " << bucket << ": ";
+    sa << "shard " << shard << ": ";
     if (p->has_network_header()) {
 	const click_ip *iph = p->ip_header();
 	sa << iph->ip_src << " > " << iph->ip_dst << " [" << ntohs(iph->ip_id) << ':' << PACKET_DLEN(p) << ((iph->ip_off & htons(IP_MF)) ? "+]: " : "]: ");
@@ -103,13 +121,20 @@ IPReassembler::check(ErrorHandler *errh)
 {
     if (!errh)
 	errh = ErrorHandler::default_handler();
-    uint32_t mem_used = 0;
-    for (int b = 0; b < NMAP; b++)
-	for (WritablePacket *q = _map[b]; q; q = (WritablePacket *)(q->next()))
+    // Hold every shard's lock so that the total is consistent.  Fragments
+    // never wait for a second shard's lock, so this cannot deadlock.
+    for (int b = 0; b < _nshards; b++)
+	_shards[b].lock.acquire();
+    uint32_t total_mem_used = 0;
+    for (int b = 0; b < _nshards; b++) {
+	Shard &s = _shards[b];
+	uint32_t mem_used = 0;
+	for (Table::iterator it = s.table.begin(); it; ++it) {
+	    WritablePacket *q = it->_q;
 	    if (q->has_network_header()) {
 		const click_ip *qip = q->ip_header();
-		if (bucketno(qip) != b)
-		    check_error(errh, b, q, "in wrong bucket");
+		if (!(Key(qip) == it->_key) || &shard_for(it->_key) != &s)
+		    check_error(errh, b, q, "in wrong shard");
 		mem_used += IPH_MEM_USED + q->transport_length();
 		ChunkLink *chunk = &PACKET_CHUNK(q);
 		int off = 0;
@@ -136,9 +161,16 @@ IPReassembler::check(ErrorHandler *errh)
 		    chunk = next_chunk(q, chunk);
 		}
 	    } else
-		errh->error("buck %d: missing IP header", b);
-    if (mem_used != _mem_used)
-	errh->error("bad mem_used: have %u, claim %u", mem_used, _mem_used);
+		errh->error("shard %d: missing IP header", b);
+	}
+	if (mem_used != s.mem_used)
+	    errh->error("shard %d: bad mem_used: have %u, claim %u", b, mem_used, s.mem_used);
+	total_mem_used += s.mem_used;
+    }
+    if (total_mem_used != _mem_used.value())
+	errh->error("bad total mem_used: have %u, claim %u", total_mem_used, _mem_used.value());
+    for (int b = 0; b < _nshards; b++)
+	_shards[b].lock.release();
     return 0;
 }
 
@@ -147,53 +179,105 @@ IPReassembler::debug_dump(Element *e, void *)
 {
     IPReassembler *r = (IPReassembler *) e;
     r->check();
+    uint32_t frags_seen = 0, good_assem = 0, failed_assem = 0, bad_pkts = 0;
+    StringAccum chunks;
+    for (int b = 0; b < r->_nshards; b++) {
+	Shard &s = r->_shards[b];
+	s.lock.acquire();
+	frags_seen += s.stat_frags_seen;
+	good_assem += s.stat_good_assem;
+	failed_assem += s.stat_failed_assem;
+	bad_pkts += s.stat_bad_pkts;
+	for (Datagram *d = s.lru.front(); d; d = d->_lru_link.next()) {
+	    WritablePacket *q = d->_q;
+	    const click_ip *qip = q->ip_header();
+	    chunks << ' ' << IPFlowID(qip) << ' ' << ntohs(qip->ip_id);
+	    ChunkLink *chunk = &PACKET_CHUNK(q);
+	    while (chunk &&
+		   (chunk->lastoff > chunk->off) &&
+		   (chunk->lastoff <= q->transport_length())) {
+		chunks << " (" << chunk->off << ',' << chunk->lastoff << ')';
+		chunk = next_chunk(q, chunk);
+	    }
+	    chunks << '\n';
+	}
+	s.lock.release();
+    }
     StringAccum sa;
     sa <<
-	"frags seen total:    " << r->_stat_frags_seen << "\n"
-	"good reassemblies:   " << r->_stat_good_assem << "\n"
-	"failed reassemblies: " << r->_stat_failed_assem << "\n"
-	"bad fragments seen:  " << r->_stat_bad_pkts << "\n"
-	"cached chunk data:\n";
-    for (int b = 0; b < NMAP; b++)
-	for (WritablePacket *q = r->_map[b]; q; q = (WritablePacket *)(q->next()))
-	    if (const click_ip *qip = q->ip_header()) {
-		sa << ' ' << IPFlowID(qip) << ' ' << ntohs(qip->ip_id);
-		ChunkLink *chunk = &PACKET_CHUNK(q);
-		while (chunk &&
-		       (chunk->lastoff > chunk->off) &&
-		       (chunk->lastoff <= q->transport_length())) {
-		    sa << " (" << chunk->off << ',' << chunk->lastoff << ')';
-		    chunk = next_chunk(q, chunk);
-		}
-		sa << '\n';
-	    }
+	"frags seen total:    " << frags_seen << "\n"
+	"good reassemblies:   " << good_assem << "\n"
+	"failed reassemblies: " << failed_assem << "\n"
+	"bad fragments seen:  " << bad_pkts << "\n"
+	"cached chunk data:\n" << chunks;
     return sa.take_string();
 }
 
-WritablePacket *
-IPReassembler::find_queue(Packet *p, WritablePacket ***store_pprev)
+enum { h_count, h_mem_used };
+
+String
+IPReassembler::read_handler(Element *e, void *thunk)
 {
-    const click_ip *iph = p->ip_header();
-    int bucket = bucketno(iph);
-    WritablePacket **pprev = &_map[bucket];
-    WritablePacket *q;
-    for (q = *pprev; q; pprev = (WritablePacket **)&q->next(), q = *pprev) {
-	const click_ip *qiph = q->ip_header();
-	if (same_segment(iph, qiph)) {
-	    *store_pprev = pprev;
-	    return q;
-	}
+    IPReassembler *r = (IPReassembler *) e;
+    uint32_t n = 0;
+    for (int b = 0; b < r->_nshards; b++) {
+	Shard &s = r->_shards[b];
+	s.lock.acquire();
+	n += ((intptr_t) thunk == h_count ? s.table.size() : s.mem_used);
+	s.lock.release();
+    }
+    return String(n);
+}
+
+// Removes d from the table's lists; the caller erases it from the table.
+void
+IPReassembler::unlink(Shard &s, Datagram *d)
+{
+    s.lru.erase(d);
+    s.wheel[d->_expire & (WHEEL_SIZE - 1)].erase(d);
+    uint32_t mem = IPH_MEM_USED + d->_q->transport_length();
+    s.mem_used -= mem;
+    _mem_used -= mem;
+}
+
+// Drops the partial packet d, saving it on the dead list for output 1.
+void
+IPReassembler::fail(Shard &s, Datagram *d, Packet *&dead)
+{
+    unlink(s, d);
+    s.table.erase(d->_key);
+    d->_q->set_next(dead);
+    dead = d->_q;
+    s.alloc.deallocate(d);
+    ++s.stat_failed_assem;
+}
+
+void
+IPReassembler::push_failed(Packet *dead)
+{
+    // dead is newest first; emit the partial packets in the order they died
+    Packet *order = 0;
+    while (Packet *q = dead) {
+	dead = q->next();
+	q->set_next(order);
+	order = q;
+    }
+    while (Packet *q = order) {
+	order = q->next();
+	q->set_next(0);
+	checked_output_push(1, q);
     }
-    *store_pprev = &_map[bucket];
-    return 0;
 }
 
 Packet *
-IPReassembler::emit_whole_packet(WritablePacket *q, WritablePacket **q_pprev,
-				 Packet *p_in)
+IPReassembler::emit_whole_packet(Shard &s, Table::iterator &it, Packet *p_in)
 {
-    ++_stat_good_assem;
-    *q_pprev = (WritablePacket *)q->next();
+    ++s.stat_good_assem;
+    Datagram *d = it.get();
+    WritablePacket *q = d->_q;
+    unlink(s, d);
+    s.table.erase(it);
+    s.alloc.deallocate(d);
 
     click_ip *q_iph = q->ip_header();
     q_iph->ip_len = htons(q->network_length());
@@ -206,29 +290,38 @@ IPReassembler::emit_whole_packet(WritablePacket *q, WritablePacket **q_pprev,
     q->set_next(0);
 
     p_in->kill();
-    _mem_used -= IPH_MEM_USED + q->transport_length();
     return q;
 }
 
-void
-IPReassembler::make_queue(Packet *p, WritablePacket **q_pprev)
+IPReassembler::Datagram *
+IPReassembler::make_queue(Shard &s, Table::iterator &it, Packet *p, int now)
 {
     int p_off = IP_BYTE_OFF(p->ip_header());
     int p_lastoff = p_off + PACKET_DLEN(p);
+    int p_len = p->network_length();	// p is consumed below
     WritablePacket *q;
 
+    void *x = s.alloc.allocate();
+    if (!x) {
+	p->kill();
+	click_chatter("out of memory");
+	return 0;
+    }
+
     if (p_off == 0) {
 	q = p->uniqueify();
 	if (!q) {
+	    s.alloc.deallocate(x);
 	    click_chatter("out of memory");
-	    return;
+	    return 0;
 	}
     } else {
 	q = Packet::make(p->headroom() + p->ip_header_offset(), 0, 20 + p_lastoff, 0);
 	if (!q) {
+	    s.alloc.deallocate(x);
 	    p->kill();
 	    click_chatter("out of memory");
-	    return;
+	    return 0;
 	}
 	q->set_ip_header((click_ip *)q->data(), 20);
 	memcpy(q->ip_header(), p->ip_header(), 20);
@@ -237,22 +330,26 @@ IPReassembler::make_queue(Packet *p, WritablePacket **q_pprev)
 	p->kill();
     }
 
+    s.mem_used += IPH_MEM_USED + p_lastoff;
     _mem_used += IPH_MEM_USED + p_lastoff;
 
     click_ip *q_iph = q->ip_header();
     q_iph->ip_off = (q_iph->ip_off & ~htons(IP_OFFMASK)); // leave MF, DF, RF
 
     if (_mtu_anno >= 0)
-	q->set_anno_u16(_mtu_anno, p->network_length());
+	q->set_anno_u16(_mtu_anno, p_len);
 
     PACKET_CHUNK(q).off = p_off;
     PACKET_CHUNK(q).lastoff = p_lastoff;
 
-    // link it up
-    q->set_next(*q_pprev);
-    *q_pprev = q;
-
-    check();
+    // link it up; the wheel slot stays within WHEEL_SIZE of wheel_time
+    Datagram *d = new(x) Datagram(Key(q_iph));
+    d->_q = q;
+    d->_expire = (now > s.wheel_time ? now : s.wheel_time) + REAP_TIMEOUT + 1;
+    s.wheel[d->_expire & (WHEEL_SIZE - 1)].push_back(d);
+    s.lru.push_back(d);
+    s.table.set(it, d, true);
+    return d;
 }
 
 IPReassembler::ChunkLink *
@@ -273,20 +370,32 @@ IPReassembler::simple_action(Packet *p)
     if (!IP_ISFRAG(iph))
 	return p;
 
-    ++_stat_frags_seen;
+    Key key(iph);
+    Shard &s = shard_for(key);
+    Packet *dead = 0;
 
-    // reap if necessary
+    // expire old partial packets; the first fragment of each second
+    // expires every shard
     int now = p->timestamp_anno().sec();
     if (!now) {
 	p->timestamp_anno().assign_now();
 	now = p->timestamp_anno().sec();
     }
-    if (now >= _reap_time)
-	reap(now);
+    uint32_t wheel_time = _wheel_time.value();
+    if ((uint32_t) now > wheel_time
+	&& _wheel_time.compare_swap(wheel_time, now) == wheel_time)
+	reap_all(now, dead);
+
+    s.lock.acquire();
+    ++s.stat_frags_seen;
+    if (now > s.wheel_time)
+	reap(s, now, dead);
 
     // calculate packet edges
     int p_off = IP_BYTE_OFF(iph);
     int p_lastoff = p_off + ntohs(iph->ip_len) - (iph->ip_hl << 2);
+    Packet *result = 0;
+    Datagram *keep = 0;
 
     // check uncommon, but annoying, case: bad length, bad length + offset,
     // or middle fragment length not a multiple of 8 bytes
@@ -294,179 +403,200 @@ IPReassembler::simple_action(Packet *p)
 	|| ((p_lastoff & 7) != 0 && (iph->ip_off & htons(IP_MF)) != 0)
 	|| PACKET_DLEN(p) < p_lastoff - p_off) {
 	p->kill();
-	++_stat_bad_pkts;
-	return 0;
+	++s.stat_bad_pkts;
+	goto done;
     }
     p->take(PACKET_DLEN(p) - (p_lastoff - p_off));
 
     // otherwise, we need to keep the packet
-
-    // clean up memory if necessary
-    if (_mem_used > _mem_high_thresh)
-	reap_overfull(now);
-
-    // get its Packet queue
-    WritablePacket **q_pprev;
-    WritablePacket *q = find_queue(p, &q_pprev);
-    if (!q) {			// make a new queue
-	make_queue(p, q_pprev);
-	return 0;
-    }
-    WritablePacket *q_bucket_next = (WritablePacket *)(q->next());
-
-    if (_mtu_anno >= 0 && q->anno_u16(_mtu_anno) < p->network_length())
-	q->set_anno_u16(_mtu_anno, p->network_length());
-
-    // extend the packet if necessary
-    if (p_lastoff > q->transport_length()) {
-	// error if packet already completed
-	if (!(q->ip_header()->ip_off & htons(IP_MF))) {
-	    p->kill();
-	    return 0;
+    {
+	// get its partial packet
+	Table::iterator it = s.table.find(key);
+	if (!it) {		// make a new partial packet
+	    keep = make_queue(s, it, p, now);
+	    goto done;
 	}
-	// Figure out how much space to request. Add 8 extra bytes to ensure
-	// room for a ChunkLink, and request extra space if this packet has MF
-	// set. XXX This algorithm could result in a number of intermediate
-	// packet copies linear in the final packet length.
-	int old_transport_length = q->transport_length();
-	assert((old_transport_length & 7) == 0);
-	int want_space = p_lastoff - old_transport_length + 8;
-	if (iph->ip_off & htons(IP_MF))
-	    want_space += (p_lastoff - p_off);
-	// request space
-	if (!(q = q->put(want_space))) {
-	    click_chatter("out of memory");
-	    *q_pprev = q_bucket_next;
-	    _mem_used -= IPH_MEM_USED + old_transport_length;
-	    p->kill();
-	    return 0;
+	Datagram *d = it.get();
+	WritablePacket *q = d->_q;
+	s.lru.erase(d);
+	s.lru.push_back(d);
+
+	if (_mtu_anno >= 0 && q->anno_u16(_mtu_anno) < p->network_length())
+	    q->set_anno_u16(_mtu_anno, p->network_length());
+
+	// extend the packet if necessary
+	if (p_lastoff > q->transport_length()) {
+	    // error if packet already completed
+	    if (!(q->ip_header()->ip_off & htons(IP_MF))) {
+		p->kill();
+		goto done;
+	    }
+	    // Figure out how much space to request. Add 8 extra bytes to ensure
+	    // room for a ChunkLink, and request extra space if this packet has MF
+	    // set. XXX This algorithm could result in a number of intermediate
+	    // packet copies linear in the final packet length.
+	    int old_transport_length = q->transport_length();
+	    assert((old_transport_length & 7) == 0);
+	    int want_space = p_lastoff - old_transport_length + 8;
+	    if (iph->ip_off & htons(IP_MF))
+		want_space += (p_lastoff - p_off);
+	    // request space
+	    unlink(s, d);
+	    if (!(q = q->put(want_space))) {
+		click_chatter("out of memory");
+		s.table.erase(it);
+		s.alloc.deallocate(d);
+		p->kill();
+		goto done;
+	    }
+	    // get rid of extra space
+	    q->take(q->transport_length() - p_lastoff);
+	    // hook up packet, and add final chunk
+	    d->_q = q;
+	    s.lru.push_back(d);
+	    s.wheel[d->_expire & (WHEEL_SIZE - 1)].push_back(d);
+	    ChunkLink *last_chunk = (ChunkLink *)(q->transport_header() + old_transport_length);
+	    last_chunk->off = last_chunk->lastoff = p_lastoff;
+	    s.mem_used += IPH_MEM_USED + p_lastoff;
+	    _mem_used += IPH_MEM_USED + p_lastoff;
 	}
-	// get rid of extra space
-	q->take(q->transport_length() - p_lastoff);
-	// hook up packet, and add final chunk
-	*q_pprev = q;
-	ChunkLink *last_chunk = (ChunkLink *)(q->transport_header() + old_transport_length);
-	last_chunk->off = last_chunk->lastoff = p_lastoff;
-	_mem_used += p_lastoff - old_transport_length;
-    }
 
-    // find chunks before and after p
-    ChunkLink *chunk = &PACKET_CHUNK(q);
-    while (chunk->lastoff < p_off)
-	chunk = next_chunk(q, chunk);
-    ChunkLink *last = chunk;
-    while (last && last->lastoff < p_lastoff)
-	last = next_chunk(q, last);
-
-    // patch chunks
-    assert(chunk && last);
-    if (p_lastoff < last->off) {
-	ChunkLink *new_chunk = (ChunkLink *)(q->transport_header() + p_lastoff);
-	*new_chunk = *last;
-	chunk->lastoff = p_lastoff;
-    } else
-	chunk->lastoff = last->lastoff;
-    if (p_off < chunk->off)
-	chunk->off = p_off;
-
-    // copy p's data into q
-    memcpy(q->transport_header() + p_off, p->transport_header(), p_lastoff - p_off);
-
-    // copy p's annotations and IP header if it is the first packet
-    if (p_off == 0) {
-	uint16_t old_ip_off = q->ip_header()->ip_off;
-	int header_delta = p->ip_header_offset() - q->ip_header_offset();
-	if (header_delta > 0)
-	    q = q->push(header_delta);
-	else if (header_delta < 0)
-	    q->pull(-header_delta);
-	q->set_ip_header((click_ip *)(q->data() + p->ip_header_offset()), p->ip_header_length());
-        if (p->has_mac_header())
-	    q->set_mac_header((q->data() + p->mac_header_offset()), p->mac_header_length());
-	memcpy(q->data(), p->data(), p->ip_header_offset() + p->ip_header_length());
-	q->ip_header()->ip_off = old_ip_off;
-	ChunkLink old_chunk = PACKET_CHUNK(q);
-	if (_mtu_anno >= 0) {
-	    uint16_t old_mtu = q->anno_u16(_mtu_anno);
-	    q->copy_annotations(p);
-	    q->set_anno_u16(_mtu_anno, old_mtu);
-	} else {
-	    q->copy_annotations(p);
+	// find chunks before and after p
+	ChunkLink *chunk = &PACKET_CHUNK(q);
+	while (chunk->lastoff < p_off)
+	    chunk = next_chunk(q, chunk);
+	ChunkLink *last = chunk;
+	while (last && last->lastoff < p_lastoff)
+	    last = next_chunk(q, last);
+
+	// patch chunks
+	assert(chunk && last);
+	if (p_lastoff < last->off) {
+	    ChunkLink *new_chunk = (ChunkLink *)(q->transport_header() + p_lastoff);
+	    *new_chunk = *last;
+	    chunk->lastoff = p_lastoff;
+	} else
+	    chunk->lastoff = last->lastoff;
+	if (p_off < chunk->off)
+	    chunk->off = p_off;
+
+	// copy p's data into q
+	memcpy(q->transport_header() + p_off, p->transport_header(), p_lastoff - p_off);
+
+	// copy p's annotations and IP header if it is the first packet
+	if (p_off == 0) {
+	    uint16_t old_ip_off = q->ip_header()->ip_off;
+	    int header_delta = p->ip_header_offset() - q->ip_header_offset();
+	    if (header_delta > 0)
+		q = d->_q = q->push(header_delta);
+	    else if (header_delta < 0)
+		q->pull(-header_delta);
+	    q->set_ip_header((click_ip *)(q->data() + p->ip_header_offset()), p->ip_header_length());
+	    if (p->has_mac_header())
+		q->set_mac_header((q->data() + p->mac_header_offset()), p->mac_header_length());
+	    memcpy(q->data(), p->data(), p->ip_header_offset() + p->ip_header_length());
+	    q->ip_header()->ip_off = old_ip_off;
+	    ChunkLink old_chunk = PACKET_CHUNK(q);
+	    if (_mtu_anno >= 0) {
+		uint16_t old_mtu = q->anno_u16(_mtu_anno);
+		q->copy_annotations(p);
+		q->set_anno_u16(_mtu_anno, old_mtu);
+	    } else {
+		q->copy_annotations(p);
+	    }
+	    PACKET_CHUNK(q) = old_chunk;
 	}
-	PACKET_CHUNK(q) = old_chunk;
-    }
 
-    // clear MF if incoming packet has it cleared
-    if (!(iph->ip_off & htons(IP_MF)))
-	q->ip_header()->ip_off &= ~htons(IP_MF);
-
-    // Are we done with this packet?
-    if ((q->ip_header()->ip_off & htons(IP_MF)) == 0
-	&& PACKET_CHUNK(q).off == 0
-	&& PACKET_CHUNK(q).lastoff == q->transport_length())
-	return emit_whole_packet(q, q_pprev, p);
+	// clear MF if incoming packet has it cleared
+	if (!(iph->ip_off & htons(IP_MF)))
+	    q->ip_header()->ip_off &= ~htons(IP_MF);
+
+	// Are we done with this packet?
+	if ((q->ip_header()->ip_off & htons(IP_MF)) == 0
+	    && PACKET_CHUNK(q).off == 0
+	    && PACKET_CHUNK(q).lastoff == q->transport_length())
+	    result = emit_whole_packet(s, it, p);
+	else {
+	    // Otherwise, done for now
+	    p->kill();
+	    keep = d;
+	}
+    }
 
-    // Otherwise, done for now
-    //check();
-    p->kill();
-    return 0;
+  done:
+    // clean up memory if necessary
+    if (_mem_used.value() > _mem_high_thresh)
+	reap_overfull(s, keep, dead);
+    s.lock.release();
+    if (dead)
+	push_failed(dead);
+    return result;
 }
 
 void
-IPReassembler::reap_overfull(int now)
+IPReassembler::reap_overfull(Shard &s, Datagram *keep, Packet *&dead)
 {
-    check();
-
-    // First throw away fragments at least 10 seconds old, then at least 5
-    // seconds old, then any fragments.
-    for (int delta = 10; delta >= 0; delta -= 5)
-	for (int bucket = 0; bucket < NMAP; bucket++) {
-	    WritablePacket **pprev = &_map[bucket];
-	    for (WritablePacket *q = *pprev; q; q = *pprev)
-		if (!delta || q->timestamp_anno().sec() < now - delta) {
-		    *pprev = (WritablePacket *)q->next();
-		    _mem_used -= IPH_MEM_USED + q->transport_length();
-		    q->set_next(0);
-		    checked_output_push(1, q);
-		    ++_stat_failed_assem;
-		    if (_mem_used <= _mem_low_thresh)
-			return;
-		} else
-		    pprev = (WritablePacket **)&q->next();
+    // Throw away the least recently extended partial packets, first from
+    // this shard, then from any other shard that is not busy.  keep, the
+    // partial packet just extended, is at the back of its LRU list and
+    // survives.
+    Datagram *d;
+    while (_mem_used.value() > _mem_low_thresh
+	   && (d = s.lru.front()) && d != keep)
+	fail(s, d, dead);
+
+    int b = &s - _shards;
+    for (int i = 1; i < _nshards && _mem_used.value() > _mem_low_thresh; ++i) {
+	Shard &o = _shards[(b + i) & (_nshards - 1)];
+	if (o.lock.attempt()) {
+	    while (_mem_used.value() > _mem_low_thresh && !o.lru.empty())
+		fail(o, o.lru.front(), dead);
+	    o.lock.release();
 	}
+    }
 
-    click_chatter("IPReassembler: cannot free enough memory!");
+    if (_mem_used.value() > _mem_low_thresh)
+	click_chatter("IPReassembler: cannot free enough memory!");
 }
 
 void
-IPReassembler::reap(int now)
+IPReassembler::reap_all(int now, Packet *&dead)
 {
-    // look at all queues. If no activity for 30 seconds, kill that queue
-
-    int kill_time = now - REAP_TIMEOUT;
-
-    for (int i = 0; i < NMAP; i++) {
-	WritablePacket **q_pprev = &_map[i];
-	for (WritablePacket *q = *q_pprev; q; ) {
-	    if (q->timestamp_anno().sec() < kill_time) {
-		*q_pprev = (WritablePacket *)q->next();
-		q->set_next(0);
-		_mem_used -= IPH_MEM_USED + q->transport_length();
-		checked_output_push(1, q);
-	    } else
-		q_pprev = (WritablePacket **)&q->next();
-	    q = *q_pprev;
-	}
+    for (int b = 0; b < _nshards; b++) {
+	Shard &s = _shards[b];
+	s.lock.acquire();
+	if (now > s.wheel_time)
+	    reap(s, now, dead);
+	s.lock.release();
     }
+}
 
-    _reap_time = now + REAP_INTERVAL;
+void
+IPReassembler::reap(Shard &s, int now, Packet *&dead)
+{
+    // Expire partial packets whose first fragment arrived more than
+    // REAP_TIMEOUT seconds ago.  Every pending expiry time lies within
+    // WHEEL_SIZE seconds after wheel_time, so a long gap expires them all.
+    if (now - s.wheel_time >= WHEEL_SIZE)
+	while (!s.lru.empty())
+	    fail(s, s.lru.front(), dead);
+    else
+	for (int t = s.wheel_time + 1; t <= now; ++t) {
+	    WheelList &slot = s.wheel[t & (WHEEL_SIZE - 1)];
+	    while (!slot.empty())
+		fail(s, slot.front(), dead);
+	}
+    s.wheel_time = now;
 }
 
 void
 IPReassembler::add_handlers()
 {
+    add_read_handler("count", read_handler, h_count);
+    add_read_handler("mem_used", read_handler, h_mem_used);
     add_read_handler("dump", debug_dump);
 }
 
 CLICK_ENDDECLS
 EXPORT_ELEMENT(IPReassembler)
+ELEMENT_MT_SAFE(IPReassembler)
@@ -4,7 +4,11 @@
 #include <click/element.hh>
 #include <click/glue.hh>
 #include <clicknet/ip.h>
-#include <click/timer.hh>
+#include <click/hashcontainer.hh>
+#include <click/hashallocator.hh>
+#include <click/list.hh>
+#include <click/sync.hh>
+#include <click/atomic.hh>
 CLICK_DECLS
 
 /*
@@ -26,9 +30,26 @@ seconds, the fragments are generally dropped. If IPReassembler has two
 outputs, however, a single packet containing all the received fragments at
 their proper offsets is pushed onto output 1.
 
+IPReassembler keeps partial packets in a hash table keyed by source,
+destination, protocol and IP ID, which grows with the number of packets in
+reassembly.  The hash function is seeded randomly at startup, so attackers
+cannot aim fragments at a single bucket.  Partial packets expire through a
+timer wheel with one slot per second, so expiry costs time only for the
+packets that actually expire.
+
 IPReassembler's memory usage is bounded. When memory consumption rises above
-HIMEM bytes, IPReassembler throws away old fragments until memory consumption
-drops below 3/4*HIMEM bytes. Default HIMEM is 256K.
+HIMEM bytes, IPReassembler throws away the least recently extended partial
+packets until memory consumption drops below 3/4*HIMEM bytes. Default HIMEM
+is 256K.  A fragment flood therefore evicts other flood fragments first,
+while partial packets that are still receiving fragments survive.  The
+partial packet that the current fragment extends is never evicted.
+
+The table is split into SHARDS independent shards, each with its own lock,
+its own LRU list, and its own timer wheel.  Fragments pick a shard by hash,
+so threads handling different packets rarely contend.  HIMEM bounds the
+shards' total memory: eviction starts in the fragment's own shard, then moves
+to other shards whose locks are free.  The first fragment of each second
+expires old partial packets in every shard.
 
 Output packets have the same MAC header as the fragment that contains
 offset 0.  Other than that, input MAC headers are ignored.
@@ -45,6 +66,11 @@ Keyword arguments are:
 
 The upper bound for memory consumption, in bytes. Default is 256K.
 
+=item SHARDS
+
+Number of shards, rounded up to a power of two no greater than 256.
+Default is the number of Click threads.
+
 =item MAX_MTU_ANNO
 
 Optional. A 2 byte annotation that will be filled with the maximum size of any
@@ -60,6 +86,18 @@ second output.
 
 IPReassembler destroys its input packets' "next packet" annotations.
 
+=h count read-only
+
+Number of partial packets held.
+
+=h mem_used read-only
+
+Bytes of memory charged against HIMEM.
+
+=h dump read-only
+
+Statistics and the chunks received for each partial packet.
+
 =a IPFragmenter */
 
 class IPReassembler : public Element { public:
@@ -89,51 +127,103 @@ class IPReassembler : public Element { public:
   private:
 
     enum { REAP_TIMEOUT = 30, // seconds
-	   REAP_INTERVAL = 10, // seconds
-	   IPH_MEM_USED = 40 };
+	   WHEEL_SIZE = 64, // seconds, > REAP_TIMEOUT
+	   IPH_MEM_USED = 40,
+	   MAX_SHARDS = 256 };
+
+    struct Key {
+	uint32_t src;
+	uint32_t dst;
+	uint16_t id;
+	uint8_t proto;
+	static uint32_t seed;
+	Key(const click_ip *iph)
+	    : src(iph->ip_src.s_addr), dst(iph->ip_dst.s_addr),
+	      id(iph->ip_id), proto(iph->ip_p) {
+	}
+	inline hashcode_t hashcode() const;
+	bool operator==(const Key &x) const {
+	    return src == x.src && dst == x.dst && id == x.id && proto == x.proto;
+	}
+    };
+
+    struct Datagram {
+	Key _key;
+	Datagram *_hashnext;
+	WritablePacket *_q;
+	int _expire;
+	List_member<Datagram> _lru_link;
+	List_member<Datagram> _wheel_link;
+	typedef Key key_type;
+	typedef const Key &key_const_reference;
+	Datagram(const Key &key)
+	    : _key(key), _hashnext(), _q() {
+	}
+	key_const_reference hashkey() const {
+	    return _key;
+	}
+    };
 
-    enum { NMAP = 256 };
-    WritablePacket *_map[NMAP];
+    typedef HashContainer<Datagram> Table;
+    typedef List<Datagram, &Datagram::_lru_link> LRUList;
+    typedef List<Datagram, &Datagram::_wheel_link> WheelList;
 
-    int _reap_time;
+    struct Shard {
+	Spinlock lock;
+	Table table;
+	LRUList lru;		// least recently extended first
+	WheelList wheel[WHEEL_SIZE];
+	int wheel_time;		// last second expired
+	SizedHashAllocator<sizeof(Datagram)> alloc;
+
+	uint32_t mem_used;
+
+	uint32_t stat_frags_seen;
+	uint32_t stat_good_assem;
+	uint32_t stat_failed_assem;
+	uint32_t stat_bad_pkts;
+    };
 
-    uint32_t _stat_frags_seen;
-    uint32_t _stat_good_assem;
-    uint32_t _stat_failed_assem;
-    uint32_t _stat_bad_pkts;
+    Shard *_shards;
+    int _nshards;
 
-    uint32_t _mem_used;
     uint32_t _mem_high_thresh;	// defaults to 256K
-    uint32_t _mem_low_thresh;	// defaults to 3/4 * _mem_high_thresh
+    uint32_t _mem_low_thresh;
+    atomic_uint32_t _mem_used;	// sum of the shards' mem_used
+    atomic_uint32_t _wheel_time; // last second every shard expired
     int8_t _mtu_anno;
 
-    static inline int bucketno(const click_ip *);
-    static inline bool same_segment(const click_ip *, const click_ip *);
+    inline Shard &shard_for(const Key &key) const;
+    static String read_handler(Element *e, void *);
     static String debug_dump(Element *e, void *);
 
-    WritablePacket *find_queue(Packet *, WritablePacket ***);
-    void make_queue(Packet *, WritablePacket **);
+    Datagram *make_queue(Shard &, Table::iterator &, Packet *, int now);
     static ChunkLink *next_chunk(WritablePacket *, ChunkLink *);
-    Packet *emit_whole_packet(WritablePacket *, WritablePacket **, Packet *);
-    void reap_overfull(int);
-    void reap(int);
+    Packet *emit_whole_packet(Shard &, Table::iterator &, Packet *);
+    void unlink(Shard &, Datagram *);
+    void fail(Shard &, Datagram *, Packet *&dead);
+    void reap_overfull(Shard &, Datagram *keep, Packet *&dead);
+    void reap_all(int now, Packet *&dead);
+    void reap(Shard &, int now, Packet *&dead);
+    void push_failed(Packet *dead);
     static void check_error(ErrorHandler *, int, const Packet *, const char *, ...);
 
 };
 
 
-inline int
-IPReassembler::bucketno(const click_ip *h)
+inline hashcode_t
+IPReassembler::Key::hashcode() const
 {
-    return (h->ip_id % NMAP);
+    uint32_t h = (src ^ seed) * 0x9E3779B1U;
+    h = (h ^ (h >> 15) ^ dst) * 0x85EBCA6BU;
+    h = (h ^ (h >> 13) ^ id ^ (proto << 16)) * 0xC2B2AE35U;
+    return h ^ (h >> 16);
 }
 
-inline bool
-IPReassembler::same_segment(const click_ip *h, const click_ip *h2)
+inline IPReassembler::Shard &
+IPReassembler::shard_for(const Key &key) const
 {
-    return h->ip_id == h2->ip_id && h->ip_p == h2->ip_p
-	&& h->ip_src.s_addr == h2->ip_src.s_addr
-	&& h->ip_dst.s_addr == h2->ip_dst.s_addr;
+    return _shards[(key.hashcode() >> 24) & (_nshards - 1)];
 }
 
 CLICK_ENDDECLS
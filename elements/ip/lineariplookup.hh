@@ -87,6 +87,7 @@ class LinearIPLookup : public IPRouteTable { public:
     const char *class_name() const	{ return "LinearIPLookup"; }
     const char *port_count() const	{ return "1/-"; }
     const char *processing() const	{ return PUSH; }
+    const char *flags() const	{ return "C"; }
 
     int initialize(ErrorHandler *);
 
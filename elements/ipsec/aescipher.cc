@@ -0,0 +1,741 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * aescipher.{cc,hh} -- multi-buffer AES and GHASH
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "aescipher.hh"
+#include <click/glue.hh>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# define AESCIPHER_X86 1
+# include <immintrin.h>
+#endif
+CLICK_DECLS
+
+static const uint8_t sbox[256] = {
+    0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b,
+    0xfe, 0xd7, 0xab, 0x76, 0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0,
+    0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0, 0xb7, 0xfd, 0x93, 0x26,
+    0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+    0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2,
+    0xeb, 0x27, 0xb2, 0x75, 0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0,
+    0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84, 0x53, 0xd1, 0x00, 0xed,
+    0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+    0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f,
+    0x50, 0x3c, 0x9f, 0xa8, 0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5,
+    0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2, 0xcd, 0x0c, 0x13, 0xec,
+    0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+    0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14,
+    0xde, 0x5e, 0x0b, 0xdb, 0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c,
+    0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79, 0xe7, 0xc8, 0x37, 0x6d,
+    0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+    0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f,
+    0x4b, 0xbd, 0x8b, 0x8a, 0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e,
+    0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e, 0xe1, 0xf8, 0x98, 0x11,
+    0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+    0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f,
+    0xb0, 0x54, 0xbb, 0x16,
+};
+
+static const uint8_t inv_sbox[256] = {
+    0x52, 0x09, 0x6a, 0xd5, 0x30, 0x36, 0xa5, 0x38, 0xbf, 0x40, 0xa3, 0x9e,
+    0x81, 0xf3, 0xd7, 0xfb, 0x7c, 0xe3, 0x39, 0x82, 0x9b, 0x2f, 0xff, 0x87,
+    0x34, 0x8e, 0x43, 0x44, 0xc4, 0xde, 0xe9, 0xcb, 0x54, 0x7b, 0x94, 0x32,
+    0xa6, 0xc2, 0x23, 0x3d, 0xee, 0x4c, 0x95, 0x0b, 0x42, 0xfa, 0xc3, 0x4e,
+    0x08, 0x2e, 0xa1, 0x66, 0x28, 0xd9, 0x24, 0xb2, 0x76, 0x5b, 0xa2, 0x49,
+    0x6d, 0x8b, 0xd1, 0x25, 0x72, 0xf8, 0xf6, 0x64, 0x86, 0x68, 0x98, 0x16,
+    0xd4, 0xa4, 0x5c, 0xcc, 0x5d, 0x65, 0xb6, 0x92, 0x6c, 0x70, 0x48, 0x50,
+    0xfd, 0xed, 0xb9, 0xda, 0x5e, 0x15, 0x46, 0x57, 0xa7, 0x8d, 0x9d, 0x84,
+    0x90, 0xd8, 0xab, 0x00, 0x8c, 0xbc, 0xd3, 0x0a, 0xf7, 0xe4, 0x58, 0x05,
+    0xb8, 0xb3, 0x45, 0x06, 0xd0, 0x2c, 0x1e, 0x8f, 0xca, 0x3f, 0x0f, 0x02,
+    0xc1, 0xaf, 0xbd, 0x03, 0x01, 0x13, 0x8a, 0x6b, 0x3a, 0x91, 0x11, 0x41,
+    0x4f, 0x67, 0xdc, 0xea, 0x97, 0xf2, 0xcf, 0xce, 0xf0, 0xb4, 0xe6, 0x73,
+    0x96, 0xac, 0x74, 0x22, 0xe7, 0xad, 0x35, 0x85, 0xe2, 0xf9, 0x37, 0xe8,
+    0x1c, 0x75, 0xdf, 0x6e, 0x47, 0xf1, 0x1a, 0x71, 0x1d, 0x29, 0xc5, 0x89,
+    0x6f, 0xb7, 0x62, 0x0e, 0xaa, 0x18, 0xbe, 0x1b, 0xfc, 0x56, 0x3e, 0x4b,
+    0xc6, 0xd2, 0x79, 0x20, 0x9a, 0xdb, 0xc0, 0xfe, 0x78, 0xcd, 0x5a, 0xf4,
+    0x1f, 0xdd, 0xa8, 0x33, 0x88, 0x07, 0xc7, 0x31, 0xb1, 0x12, 0x10, 0x59,
+    0x27, 0x80, 0xec, 0x5f, 0x60, 0x51, 0x7f, 0xa9, 0x19, 0xb5, 0x4a, 0x0d,
+    0x2d, 0xe5, 0x7a, 0x9f, 0x93, 0xc9, 0x9c, 0xef, 0xa0, 0xe0, 0x3b, 0x4d,
+    0xae, 0x2a, 0xf5, 0xb0, 0xc8, 0xeb, 0xbb, 0x3c, 0x83, 0x53, 0x99, 0x61,
+    0x17, 0x2b, 0x04, 0x7e, 0xba, 0x77, 0xd6, 0x26, 0xe1, 0x69, 0x14, 0x63,
+    0x55, 0x21, 0x0c, 0x7d,
+};
+
+static inline uint8_t
+xtime(uint8_t x)
+{
+    return (x << 1) ^ ((x & 0x80) ? 0x1B : 0);
+}
+
+static inline uint8_t
+gmul(uint8_t a, uint8_t b)
+{
+    uint8_t r = 0;
+    for (; b; b >>= 1, a = xtime(a))
+	if (b & 1)
+	    r ^= a;
+    return r;
+}
+
+static inline void
+mix_column(uint8_t *c)
+{
+    uint8_t a0 = c[0], a1 = c[1], a2 = c[2], a3 = c[3];
+    c[0] = xtime(a0) ^ xtime(a1) ^ a1 ^ a2 ^ a3;
+    c[1] = a0 ^ xtime(a1) ^ xtime(a2) ^ a2 ^ a3;
+    c[2] = a0 ^ a1 ^ xtime(a2) ^ xtime(a3) ^ a3;
+    c[3] = xtime(a0) ^ a0 ^ a1 ^ a2 ^ xtime(a3);
+}
+
+static inline void
+inv_mix_column(uint8_t *c)
+{
+    uint8_t a0 = c[0], a1 = c[1], a2 = c[2], a3 = c[3];
+    c[0] = gmul(a0, 14) ^ gmul(a1, 11) ^ gmul(a2, 13) ^ gmul(a3, 9);
+    c[1] = gmul(a0, 9) ^ gmul(a1, 14) ^ gmul(a2, 11) ^ gmul(a3, 13);
+    c[2] = gmul(a0, 13) ^ gmul(a1, 9) ^ gmul(a2, 14) ^ gmul(a3, 11);
+    c[3] = gmul(a0, 11) ^ gmul(a1, 13) ^ gmul(a2, 9) ^ gmul(a3, 14);
+}
+
+int
+AESKey::set(const unsigned char *key, int len)
+{
+    if (len != 16 && len != 24 && len != 32)
+	return -EINVAL;
+    int nk = len / 4;
+    _rounds = nk + 6;
+    memcpy(_ek, key, len);
+    uint8_t rcon = 1;
+    for (int i = nk; i < 4 * (_rounds + 1); ++i) {
+	uint8_t t[4];
+	memcpy(t, _ek + 4 * (i - 1), 4);
+	if (i % nk == 0) {
+	    uint8_t t0 = t[0];
+	    t[0] = sbox[t[1]] ^ rcon;
+	    t[1] = sbox[t[2]];
+	    t[2] = sbox[t[3]];
+	    t[3] = sbox[t0];
+	    rcon = xtime(rcon);
+	} else if (nk > 6 && i % nk == 4)
+	    for (int k = 0; k < 4; ++k)
+		t[k] = sbox[t[k]];
+	for (int k = 0; k < 4; ++k)
+	    _ek[4 * i + k] = _ek[4 * (i - nk) + k] ^ t[k];
+    }
+
+    // The equivalent inverse cipher (FIPS-197 5.3.5) runs the round keys
+    // backwards, with InvMixColumns applied to the middle ones.  AESDEC
+    // expects the same.
+    memcpy(_dk, _ek + 16 * _rounds, 16);
+    for (int r = 1; r < _rounds; ++r) {
+	memcpy(_dk + 16 * r, _ek + 16 * (_rounds - r), 16);
+	for (int c = 0; c < 4; ++c)
+	    inv_mix_column(_dk + 16 * r + 4 * c);
+    }
+    memcpy(_dk + 16 * _rounds, _ek, 16);
+    return 0;
+}
+
+void
+AESKey::encrypt_block(const unsigned char *in, unsigned char *out) const
+{
+    uint8_t s[16], t[16];
+    for (int i = 0; i < 16; ++i)
+	s[i] = in[i] ^ _ek[i];
+    for (int r = 1; r <= _rounds; ++r) {
+	// SubBytes and ShiftRows; the state is column-major
+	for (int c = 0; c < 4; ++c)
+	    for (int row = 0; row < 4; ++row)
+		t[4 * c + row] = sbox[s[4 * ((c + row) & 3) + row]];
+	if (r < _rounds)
+	    for (int c = 0; c < 4; ++c)
+		mix_column(t + 4 * c);
+	for (int i = 0; i < 16; ++i)
+	    s[i] = t[i] ^ _ek[16 * r + i];
+    }
+    memcpy(out, s, 16);
+}
+
+void
+AESKey::decrypt_block(const unsigned char *in, unsigned char *out) const
+{
+    uint8_t s[16], t[16];
+    for (int i = 0; i < 16; ++i)
+	s[i] = in[i] ^ _dk[i];
+    for (int r = 1; r <= _rounds; ++r) {
+	// InvSubBytes and InvShiftRows
+	for (int c = 0; c < 4; ++c)
+	    for (int row = 0; row < 4; ++row)
+		t[4 * c + row] = inv_sbox[s[4 * ((c - row) & 3) + row]];
+	if (r < _rounds)
+	    for (int c = 0; c < 4; ++c)
+		inv_mix_column(t + 4 * c);
+	for (int i = 0; i < 16; ++i)
+	    s[i] = t[i] ^ _dk[16 * r + i];
+    }
+    memcpy(out, s, 16);
+}
+
+
+// GHASH
+
+static inline uint64_t
+load_be64(const unsigned char *p)
+{
+    uint64_t x = 0;
+    for (int i = 0; i < 8; ++i)
+	x = (x << 8) | p[i];
+    return x;
+}
+
+static inline void
+store_be64(unsigned char *p, uint64_t x)
+{
+    for (int i = 7; i >= 0; --i, x >>= 8)
+	p[i] = x;
+}
+
+// Multiplies y by h in GF(2^128) with GCM's bit order (SP 800-38D
+// algorithm 1).
+static void
+gf_mul_portable(uint64_t &yhi, uint64_t &ylo, uint64_t hhi, uint64_t hlo)
+{
+    uint64_t zhi = 0, zlo = 0, vhi = hhi, vlo = hlo;
+    for (int i = 0; i < 128; ++i) {
+	uint64_t bit = (i < 64 ? yhi >> (63 - i) : ylo >> (127 - i)) & 1;
+	uint64_t mask = -bit;
+	zhi ^= vhi & mask;
+	zlo ^= vlo & mask;
+	uint64_t lsb = vlo & 1;
+	vlo = (vlo >> 1) | (vhi << 63);
+	vhi = (vhi >> 1) ^ (-lsb & 0xE100000000000000ULL);
+    }
+    yhi = zhi;
+    ylo = zlo;
+}
+
+#if AESCIPHER_X86
+# define GHASH_TARGET __attribute__((target("pclmul,ssse3")))
+
+// Multiplies byte-reversed field elements, following Intel's "Carry-Less
+// Multiplication and Its Usage for Computing the GCM Mode": the 256-bit
+// product is shifted left one bit to undo GCM's reflected bit order and
+// then reduced modulo x^128 + x^7 + x^2 + x + 1.
+GHASH_TARGET static inline __m128i
+gf_mul_clmul(__m128i a, __m128i b)
+{
+    __m128i lo = _mm_clmulepi64_si128(a, b, 0x00);
+    __m128i mid = _mm_xor_si128(_mm_clmulepi64_si128(a, b, 0x10),
+				_mm_clmulepi64_si128(a, b, 0x01));
+    __m128i hi = _mm_clmulepi64_si128(a, b, 0x11);
+    lo = _mm_xor_si128(lo, _mm_slli_si128(mid, 8));
+    hi = _mm_xor_si128(hi, _mm_srli_si128(mid, 8));
+
+    __m128i lo_carry = _mm_srli_epi32(lo, 31);
+    __m128i hi_carry = _mm_srli_epi32(hi, 31);
+    lo = _mm_slli_epi32(lo, 1);
+    hi = _mm_slli_epi32(hi, 1);
+    __m128i cross = _mm_srli_si128(lo_carry, 12);
+    hi_carry = _mm_slli_si128(hi_carry, 4);
+    lo_carry = _mm_slli_si128(lo_carry, 4);
+    lo = _mm_or_si128(lo, lo_carry);
+    hi = _mm_or_si128(_mm_or_si128(hi, hi_carry), cross);
+
+    __m128i t = _mm_xor_si128(_mm_xor_si128(_mm_slli_epi32(lo, 31),
+					    _mm_slli_epi32(lo, 30)),
+			      _mm_slli_epi32(lo, 25));
+    __m128i t_hi = _mm_srli_si128(t, 4);
+    lo = _mm_xor_si128(lo, _mm_slli_si128(t, 12));
+    __m128i u = _mm_xor_si128(_mm_xor_si128(_mm_srli_epi32(lo, 1),
+					    _mm_srli_epi32(lo, 2)),
+			      _mm_xor_si128(_mm_srli_epi32(lo, 7), t_hi));
+    return _mm_xor_si128(hi, _mm_xor_si128(lo, u));
+}
+
+GHASH_TARGET static inline __m128i
+byte_reverse(__m128i x)
+{
+    return _mm_shuffle_epi8(x, _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7,
+					    8, 9, 10, 11, 12, 13, 14, 15));
+}
+
+GHASH_TARGET static void
+ghash_powers_clmul(const unsigned char *h, unsigned char (*hp)[16])
+{
+    __m128i h1 = byte_reverse(_mm_loadu_si128(reinterpret_cast<const __m128i *>(h)));
+    __m128i x = h1;
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(hp[0]), x);
+    for (int i = 1; i < 4; ++i) {
+	x = gf_mul_clmul(x, h1);
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(hp[i]), x);
+    }
+}
+
+// Four blocks are folded per step as (Y + X1)H^4 + X2 H^3 + X3 H^2 + X4 H,
+// so the four multiplications are independent.
+GHASH_TARGET static void
+ghash_clmul(const unsigned char (*hp)[16], unsigned char *yb,
+	    const unsigned char *data, uint32_t len)
+{
+    __m128i h1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(hp[0]));
+    __m128i h2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(hp[1]));
+    __m128i h3 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(hp[2]));
+    __m128i h4 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(hp[3]));
+    __m128i y = byte_reverse(_mm_loadu_si128(reinterpret_cast<const __m128i *>(yb)));
+    const __m128i *d = reinterpret_cast<const __m128i *>(data);
+    for (; len >= 64; len -= 64, d += 4) {
+	__m128i x0 = _mm_xor_si128(y, byte_reverse(_mm_loadu_si128(d)));
+	__m128i x1 = byte_reverse(_mm_loadu_si128(d + 1));
+	__m128i x2 = byte_reverse(_mm_loadu_si128(d + 2));
+	__m128i x3 = byte_reverse(_mm_loadu_si128(d + 3));
+	y = _mm_xor_si128(_mm_xor_si128(gf_mul_clmul(x0, h4), gf_mul_clmul(x1, h3)),
+			  _mm_xor_si128(gf_mul_clmul(x2, h2), gf_mul_clmul(x3, h1)));
+    }
+    for (; len >= 16; len -= 16, ++d)
+	y = gf_mul_clmul(_mm_xor_si128(y, byte_reverse(_mm_loadu_si128(d))), h1);
+    if (len) {
+	unsigned char buf[16];
+	memset(buf, 0, sizeof(buf));
+	memcpy(buf, d, len);
+	__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(buf));
+	y = gf_mul_clmul(_mm_xor_si128(y, byte_reverse(x)), h1);
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(yb), byte_reverse(y));
+}
+#endif
+
+void
+GHashKey::set(const unsigned char h[16], int impl)
+{
+    _hi = load_be64(h);
+    _lo = load_be64(h + 8);
+#if AESCIPHER_X86
+    if (impl != AESCipher::IMPL_PORTABLE)
+	ghash_powers_clmul(h, _h);
+#endif
+    _impl = impl;
+}
+
+void
+GHashKey::update(unsigned char y[16], const unsigned char *data, uint32_t len) const
+{
+#if AESCIPHER_X86
+    if (_impl != AESCipher::IMPL_PORTABLE) {
+	ghash_clmul(_h, y, data, len);
+	return;
+    }
+#endif
+    uint64_t yhi = load_be64(y), ylo = load_be64(y + 8);
+    for (; len; data += 16) {
+	unsigned char buf[16];
+	const unsigned char *x = data;
+	if (len >= 16)
+	    len -= 16;
+	else {
+	    memset(buf, 0, sizeof(buf));
+	    memcpy(buf, data, len);
+	    x = buf;
+	    len = 0;
+	}
+	yhi ^= load_be64(x);
+	ylo ^= load_be64(x + 8);
+	gf_mul_portable(yhi, ylo, _hi, _lo);
+    }
+    store_be64(y, yhi);
+    store_be64(y + 8, ylo);
+}
+
+void
+GHashKey::finish(unsigned char y[16], uint64_t aad_len, uint64_t text_len) const
+{
+    unsigned char block[16];
+    store_be64(block, aad_len * 8);
+    store_be64(block + 8, text_len * 8);
+    update(y, block, 16);
+}
+
+
+// Multi-buffer AES
+
+static inline void
+inc32(unsigned char *ctr)
+{
+    for (int i = 15; i >= 12 && ++ctr[i] == 0; --i)
+	/* nothing */;
+}
+
+int
+AESCipher::best_impl()
+{
+#if AESCIPHER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("aes") && __builtin_cpu_supports("pclmul")
+	&& __builtin_cpu_supports("ssse3")) {
+	if (__builtin_cpu_supports("vaes") && __builtin_cpu_supports("avx2"))
+	    return IMPL_VAES;
+	return IMPL_AESNI;
+    }
+#endif
+    return IMPL_PORTABLE;
+}
+
+const char *
+AESCipher::impl_name(int impl)
+{
+    switch (impl) {
+    case IMPL_AESNI:
+	return "aesni";
+    case IMPL_VAES:
+	return "vaes";
+    default:
+	return "portable";
+    }
+}
+
+bool
+AESCipher::equal(const unsigned char *a, const unsigned char *b, int len)
+{
+    unsigned char x = 0;
+    for (int i = 0; i < len; ++i)
+	x |= a[i] ^ b[i];
+    return x == 0;
+}
+
+unsigned
+AESCipher::rounds_present(const AESJob *jobs, int njobs)
+{
+    unsigned mask = 0;
+    for (int j = 0; j < njobs; ++j)
+	mask |= 1U << jobs[j].key->rounds();
+    return mask;
+}
+
+void
+AESCipher::ctr_portable(AESJob *jobs, int njobs)
+{
+    for (AESJob *jb = jobs; jb != jobs + njobs; ++jb)
+	for (uint32_t off = 0; off < jb->len; off += 16) {
+	    unsigned char ks[16];
+	    jb->key->encrypt_block(jb->iv, ks);
+	    inc32(jb->iv);
+	    uint32_t n = (jb->len - off < 16 ? jb->len - off : 16);
+	    for (uint32_t i = 0; i < n; ++i)
+		jb->out[off + i] = jb->in[off + i] ^ ks[i];
+	}
+}
+
+void
+AESCipher::cbc_encrypt_portable(AESJob *jobs, int njobs)
+{
+    for (AESJob *jb = jobs; jb != jobs + njobs; ++jb)
+	for (uint32_t off = 0; off < jb->len; off += 16) {
+	    for (int i = 0; i < 16; ++i)
+		jb->iv[i] ^= jb->in[off + i];
+	    jb->key->encrypt_block(jb->iv, jb->iv);
+	    memcpy(jb->out + off, jb->iv, 16);
+	}
+}
+
+void
+AESCipher::cbc_decrypt_portable(AESJob *jobs, int njobs)
+{
+    for (AESJob *jb = jobs; jb != jobs + njobs; ++jb)
+	for (uint32_t off = 0; off < jb->len; off += 16) {
+	    unsigned char c[16], p[16];
+	    memcpy(c, jb->in + off, 16);
+	    jb->key->decrypt_block(c, p);
+	    for (int i = 0; i < 16; ++i)
+		jb->out[off + i] = p[i] ^ jb->iv[i];
+	    memcpy(jb->iv, c, 16);
+	}
+}
+
+#if AESCIPHER_X86
+# define AESNI_TARGET __attribute__((target("aes,sse2")))
+# define VAES_TARGET __attribute__((target("vaes,avx2,aes")))
+
+namespace {
+// The next LANES counter blocks of a CTR call, possibly from different
+// jobs.  Unused lanes repeat lane 0 so the round loops have a fixed count.
+struct CtrLanes {
+    const unsigned char *rk[8];
+    const unsigned char *in[8];
+    unsigned char *out[8];
+    uint32_t len[8];
+    unsigned char ctr[8][16];
+};
+}
+
+static int
+gather_ctr(AESJob *jobs, int njobs, int rounds, int &j, uint32_t &off, CtrLanes &l)
+{
+    int n = 0;
+    while (n < 8 && j < njobs) {
+	AESJob &jb = jobs[j];
+	if (jb.key->rounds() != rounds || off >= jb.len) {
+	    ++j;
+	    off = 0;
+	    continue;
+	}
+	l.rk[n] = jb.key->encrypt_schedule();
+	l.in[n] = jb.in + off;
+	l.out[n] = jb.out + off;
+	l.len[n] = (jb.len - off < 16 ? jb.len - off : 16);
+	memcpy(l.ctr[n], jb.iv, 16);
+	inc32(jb.iv);
+	off += 16;
+	++n;
+    }
+    for (int i = n; n && i < 8; ++i) {
+	l.rk[i] = l.rk[0];
+	memcpy(l.ctr[i], l.ctr[0], 16);
+    }
+    return n;
+}
+
+static inline void
+xor_partial(unsigned char *out, const unsigned char *in, const unsigned char *ks, uint32_t len)
+{
+    for (uint32_t i = 0; i < len; ++i)
+	out[i] = in[i] ^ ks[i];
+}
+
+AESNI_TARGET static inline __m128i
+load128(const unsigned char *p)
+{
+    return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+}
+
+AESNI_TARGET static inline void
+store128(unsigned char *p, __m128i x)
+{
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(p), x);
+}
+
+AESNI_TARGET static void
+ctr_lanes_aesni(const CtrLanes &l, int n, int rounds)
+{
+    __m128i b[8];
+    for (int i = 0; i < 8; ++i)
+	b[i] = _mm_xor_si128(load128(l.ctr[i]), load128(l.rk[i]));
+    for (int r = 1; r < rounds; ++r)
+	for (int i = 0; i < 8; ++i)
+	    b[i] = _mm_aesenc_si128(b[i], load128(l.rk[i] + 16 * r));
+    for (int i = 0; i < 8; ++i)
+	b[i] = _mm_aesenclast_si128(b[i], load128(l.rk[i] + 16 * rounds));
+    for (int i = 0; i < n; ++i)
+	if (l.len[i] == 16)
+	    store128(l.out[i], _mm_xor_si128(load128(l.in[i]), b[i]));
+	else {
+	    unsigned char ks[16];
+	    store128(ks, b[i]);
+	    xor_partial(l.out[i], l.in[i], ks, l.len[i]);
+	}
+}
+
+VAES_TARGET static inline __m256i
+load2x128(const unsigned char *lo, const unsigned char *hi)
+{
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(lo));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(hi));
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(a), b, 1);
+}
+
+// Two blocks per instruction; each 128-bit half may use a different key.
+VAES_TARGET static void
+ctr_lanes_vaes(const CtrLanes &l, int n, int rounds)
+{
+    __m256i b[4];
+    for (int i = 0; i < 4; ++i)
+	b[i] = _mm256_xor_si256(load2x128(l.ctr[2*i], l.ctr[2*i + 1]),
+				load2x128(l.rk[2*i], l.rk[2*i + 1]));
+    for (int r = 1; r < rounds; ++r)
+	for (int i = 0; i < 4; ++i)
+	    b[i] = _mm256_aesenc_epi128(b[i], load2x128(l.rk[2*i] + 16 * r,
+							l.rk[2*i + 1] + 16 * r));
+    unsigned char ks[8][16];
+    for (int i = 0; i < 4; ++i) {
+	b[i] = _mm256_aesenclast_epi128(b[i], load2x128(l.rk[2*i] + 16 * rounds,
+							l.rk[2*i + 1] + 16 * rounds));
+	_mm256_storeu_si256(reinterpret_cast<__m256i *>(ks[2*i]), b[i]);
+    }
+    for (int i = 0; i < n; ++i)
+	if (l.len[i] == 16) {
+	    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(l.in[i]));
+	    __m128i k = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ks[i]));
+	    _mm_storeu_si128(reinterpret_cast<__m128i *>(l.out[i]), _mm_xor_si128(x, k));
+	} else
+	    xor_partial(l.out[i], l.in[i], ks[i], l.len[i]);
+}
+
+void
+AESCipher::ctr_simd(AESJob *jobs, int njobs, int rounds, bool vaes)
+{
+    CtrLanes l;
+    int j = 0, n;
+    uint32_t off = 0;
+    while ((n = gather_ctr(jobs, njobs, rounds, j, off, l)))
+	if (vaes)
+	    ctr_lanes_vaes(l, n, rounds);
+	else
+	    ctr_lanes_aesni(l, n, rounds);
+}
+
+// Each lane carries one job's CBC chain; a lane whose job finishes takes
+// the next job, so the chains of up to LANES packets advance together.
+AESNI_TARGET void
+AESCipher::cbc_encrypt_aesni(AESJob *jobs, int njobs, int rounds)
+{
+    AESJob *lane[8];
+    const unsigned char *rk[8];
+    uint32_t off[8];
+    __m128i c[8];
+    int next = 0, active = 0;
+    while (1) {
+	for (; active < 8 && next < njobs; ++next)
+	    if (jobs[next].key->rounds() == rounds && jobs[next].len) {
+		lane[active] = &jobs[next];
+		rk[active] = jobs[next].key->encrypt_schedule();
+		off[active] = 0;
+		c[active] = load128(jobs[next].iv);
+		++active;
+	    }
+	if (!active)
+	    break;
+
+	__m128i b[8];
+	for (int i = 0; i < 8; ++i) {
+	    int k = (i < active ? i : 0);
+	    b[i] = _mm_xor_si128(_mm_xor_si128(load128(lane[k]->in + off[k]), c[k]),
+				 load128(rk[k]));
+	}
+	for (int r = 1; r < rounds; ++r)
+	    for (int i = 0; i < 8; ++i)
+		b[i] = _mm_aesenc_si128(b[i], load128(rk[i < active ? i : 0] + 16 * r));
+	for (int i = 0; i < 8; ++i)
+	    b[i] = _mm_aesenclast_si128(b[i], load128(rk[i < active ? i : 0] + 16 * rounds));
+
+	for (int i = 0; i < active; ++i) {
+	    store128(lane[i]->out + off[i], b[i]);
+	    c[i] = b[i];
+	    off[i] += 16;
+	}
+	for (int i = active - 1; i >= 0; --i)
+	    if (off[i] >= lane[i]->len) {
+		store128(lane[i]->iv, c[i]);
+		--active;
+		lane[i] = lane[active];
+		rk[i] = rk[active];
+		off[i] = off[active];
+		c[i] = c[active];
+	    }
+    }
+}
+
+// Decryption blocks are independent, so they are gathered across jobs as
+// in CTR mode.  Each ciphertext block is saved as the next block's
+// chaining value before any output is written, which allows in == out.
+AESNI_TARGET void
+AESCipher::cbc_decrypt_aesni(AESJob *jobs, int njobs, int rounds)
+{
+    int j = 0;
+    uint32_t o = 0;
+    while (1) {
+	const unsigned char *rk[8];
+	unsigned char *out[8];
+	__m128i b[8], prev[8];
+	int n = 0;
+	while (n < 8 && j < njobs) {
+	    AESJob &jb = jobs[j];
+	    if (jb.key->rounds() != rounds || o >= jb.len) {
+		++j;
+		o = 0;
+		continue;
+	    }
+	    rk[n] = jb.key->decrypt_schedule();
+	    out[n] = jb.out + o;
+	    b[n] = load128(jb.in + o);
+	    prev[n] = load128(jb.iv);
+	    store128(jb.iv, b[n]);
+	    o += 16;
+	    ++n;
+	}
+	if (!n)
+	    break;
+	for (int i = n; i < 8; ++i) {
+	    rk[i] = rk[0];
+	    b[i] = b[0];
+	}
+
+	for (int i = 0; i < 8; ++i)
+	    b[i] = _mm_xor_si128(b[i], load128(rk[i]));
+	for (int r = 1; r < rounds; ++r)
+	    for (int i = 0; i < 8; ++i)
+		b[i] = _mm_aesdec_si128(b[i], load128(rk[i] + 16 * r));
+	for (int i = 0; i < 8; ++i)
+	    b[i] = _mm_aesdeclast_si128(b[i], load128(rk[i] + 16 * rounds));
+	for (int i = 0; i < n; ++i)
+	    store128(out[i], _mm_xor_si128(b[i], prev[i]));
+    }
+}
+#endif
+
+void
+AESCipher::ctr(AESJob *jobs, int njobs, int impl)
+{
+#if AESCIPHER_X86
+    if (impl != IMPL_PORTABLE) {
+	unsigned mask = rounds_present(jobs, njobs);
+	for (int rounds = 10; rounds <= 14; rounds += 2)
+	    if (mask & (1U << rounds))
+		ctr_simd(jobs, njobs, rounds, impl == IMPL_VAES);
+	return;
+    }
+#endif
+    ctr_portable(jobs, njobs);
+}
+
+void
+AESCipher::cbc_encrypt(AESJob *jobs, int njobs, int impl)
+{
+#if AESCIPHER_X86
+    if (impl != IMPL_PORTABLE) {
+	unsigned mask = rounds_present(jobs, njobs);
+	for (int rounds = 10; rounds <= 14; rounds += 2)
+	    if (mask & (1U << rounds))
+		cbc_encrypt_aesni(jobs, njobs, rounds);
+	return;
+    }
+#endif
+    cbc_encrypt_portable(jobs, njobs);
+}
+
+void
+AESCipher::cbc_decrypt(AESJob *jobs, int njobs, int impl)
+{
+#if AESCIPHER_X86
+    if (impl != IMPL_PORTABLE) {
+	unsigned mask = rounds_present(jobs, njobs);
+	for (int rounds = 10; rounds <= 14; rounds += 2)
+	    if (mask & (1U << rounds))
+		cbc_decrypt_aesni(jobs, njobs, rounds);
+	return;
+    }
+#endif
+    cbc_decrypt_portable(jobs, njobs);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel)
+ELEMENT_PROVIDES(AESCipher)
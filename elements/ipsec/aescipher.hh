@@ -0,0 +1,129 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_AESCIPHER_HH
+#define CLICK_AESCIPHER_HH
+#include <click/glue.hh>
+CLICK_DECLS
+
+/*
+ * =c
+ * AESCipher
+ * =s ipsec
+ * multi-buffer AES and GHASH for IPsec
+ * =d
+ *
+ * Not an element.  AESCipher runs AES in CTR and CBC mode over many
+ * buffers at once, as IPsecESPCrypt does for a burst of packets.  Blocks
+ * from different buffers are independent, so each call encrypts eight of
+ * them together, interleaving their rounds so that AES-NI's instruction
+ * latency is hidden even though each packet's own CBC chain is serial.
+ * With VAES, the eight blocks are processed two per instruction.  A
+ * portable byte-oriented implementation is used on CPUs without AES-NI.
+ *
+ * GHashKey computes GCM's GHASH with PCLMULQDQ, four blocks at a time, or
+ * with a portable bitwise multiply.
+ *
+ * =a IPsecESPCrypt, IPsecAES
+ */
+
+class AESKey { public:
+
+    AESKey()
+	: _rounds(0) {
+    }
+
+    // Expands a 16-, 24- or 32-byte key.  Returns 0, or -EINVAL for other
+    // key lengths.
+    int set(const unsigned char *key, int len);
+
+    int rounds() const {
+	return _rounds;
+    }
+
+    void encrypt_block(const unsigned char *in, unsigned char *out) const;
+    void decrypt_block(const unsigned char *in, unsigned char *out) const;
+
+    // Round keys for AESENC and AESDEC, 16 bytes per round.
+    const unsigned char *encrypt_schedule() const {
+	return _ek;
+    }
+    const unsigned char *decrypt_schedule() const {
+	return _dk;
+    }
+
+  private:
+
+    enum { MAX_ROUNDS = 14 };
+
+    unsigned char _ek[(MAX_ROUNDS + 1) * 16];	// FIPS-197 round keys
+    unsigned char _dk[(MAX_ROUNDS + 1) * 16];	// AESDEC round keys
+    int _rounds;
+
+};
+
+// One buffer of a multi-buffer call.  For CTR, iv is the first counter
+// block; the low 32 bits are incremented big-endian, as in GCM.  For CBC,
+// iv is the chaining value and len must be a multiple of 16.  Either way,
+// iv is left at the value that would continue the stream.  in and out may
+// be equal.
+struct AESJob {
+    const AESKey *key;
+    const unsigned char *in;
+    unsigned char *out;
+    uint32_t len;
+    unsigned char iv[16];
+};
+
+class GHashKey { public:
+
+    GHashKey() {
+    }
+
+    // Sets the hash key, E_K(0^128), for implementation impl.
+    void set(const unsigned char h[16], int impl);
+
+    // Absorbs len bytes of data into y, zero-padding the last block.
+    void update(unsigned char y[16], const unsigned char *data, uint32_t len) const;
+
+    // Absorbs GCM's final length block.
+    void finish(unsigned char y[16], uint64_t aad_len, uint64_t text_len) const;
+
+  private:
+
+    unsigned char _h[4][16];	// H, H^2, H^3, H^4 byte-reversed
+    uint64_t _hi;		// H for the portable multiply
+    uint64_t _lo;
+    int _impl;
+
+};
+
+class AESCipher { public:
+
+    enum { IMPL_PORTABLE, IMPL_AESNI, IMPL_VAES };
+
+    // Returns the fastest implementation this CPU supports.
+    static int best_impl();
+    static const char *impl_name(int impl);
+
+    static void ctr(AESJob *jobs, int njobs, int impl);
+    static void cbc_encrypt(AESJob *jobs, int njobs, int impl);
+    static void cbc_decrypt(AESJob *jobs, int njobs, int impl);
+
+    // Constant-time comparison of authentication tags.
+    static bool equal(const unsigned char *a, const unsigned char *b, int len);
+
+  private:
+
+    enum { LANES = 8 };
+
+    static unsigned rounds_present(const AESJob *jobs, int njobs);
+    static void ctr_portable(AESJob *jobs, int njobs);
+    static void cbc_encrypt_portable(AESJob *jobs, int njobs);
+    static void cbc_decrypt_portable(AESJob *jobs, int njobs);
+    static void ctr_simd(AESJob *jobs, int njobs, int rounds, bool vaes);
+    static void cbc_encrypt_aesni(AESJob *jobs, int njobs, int rounds);
+    static void cbc_decrypt_aesni(AESJob *jobs, int njobs, int rounds);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -41,41 +41,6 @@ IPsecESPUnencap::~IPsecESPUnencap()
 {
 }
 
-int
-IPsecESPUnencap::checkreplaywindow(SADataTuple * sa_data,unsigned long seq)
-  {
-	unsigned long diff;
-
-	if (seq == 0)
-		return 0;		/* first == 0 or wrapped */
-	/*This logic has been added for the time being to deal with replay rollover*/
-	if((seq == sa_data->replay_start_counter) && (sa_data->lastseq!=sa_data->replay_start_counter)) { sa_data->bitmap=0;sa_data->lastseq=seq;return 1;}
-
-	if (seq > sa_data->lastseq)	/* new larger sequence number */
-	{
-		diff = seq - sa_data->lastseq;
-		if (diff < sa_data->ooowin) /* In win, set bit for this pkt */
-			sa_data->bitmap = (sa_data->bitmap << diff) | 1;
-		else
-			sa_data->bitmap = 1; /* This packet has way larger */
-
-		sa_data->lastseq = seq;
-		return 1;		/* larger is good */
-	}
-	diff = sa_data->lastseq - seq;
-	if (diff >= sa_data->ooowin) {	/* too old or wrapped */
-		click_chatter("Replay protection: This packet is too old to be accepted\n");
-		return 0;
-
-        }
-	if (sa_data->bitmap & (1 << diff)) { /* this packet already seen */
-		click_chatter("Replay protection: This packet is already seen...\n");
-		return 0;
-        }
-	sa_data->bitmap |= (1 << diff);	/* mark as seen */
-	return 1;			/* out of order but good */
-}
-
 Packet *
 IPsecESPUnencap::simple_action(Packet *p)
 {
@@ -90,7 +55,9 @@ IPsecESPUnencap::simple_action(Packet *p)
 
   if(sa==NULL) {click_chatter("Null reference to Security Association Table");}
 
-  if(!checkreplaywindow(sa,(unsigned long)ntohl(esp->esp_rpl))) {
+  if(!sa->accept(ntohl(esp->esp_rpl), p->length())) {
+      if (sa->replay_drops == 1)
+	click_chatter("Replay protection: packet outside the window or already seen");
       p->kill(); //The packet failed replay check and it is therefore dropped
       return (0);
   }
@@ -13,10 +13,12 @@ CLICK_DECLS
  * removes IPSec encapsulation
  * =d
  *
- * Removes ESP header added by IPsecESPEncap. see RFC 2406. Does not perform
- * the optional anti-replay attack checks.
+ * Removes ESP header added by IPsecESPEncap. see RFC 2406. Drops packets
+ * whose sequence numbers fall outside, or repeat within, the security
+ * association's anti-replay window.  Place it after authentication, so
+ * that only authenticated packets advance the window.
  *
- * =a IPsecESPUnencap, IPsecDES, IPsecAuthSHA1
+ * =a IPsecESPUnencap, IPsecDES, IPsecAuthSHA1, IPsecSAD
  */
 
 class IPsecESPUnencap : public Element {
@@ -27,8 +29,6 @@ public:
   const char *class_name() const	{ return "IPsecESPUnencap"; }
   const char *port_count() const	{ return PORTS_1_1; }
 
-  int checkreplaywindow(SADataTuple * sa_data,unsigned long seq);
-
   Packet *simple_action(Packet *);
 };
 
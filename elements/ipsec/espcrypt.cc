@@ -0,0 +1,446 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * espcrypt.{cc,hh} -- batched ESP with AES-GCM or AES-CBC and HMAC-SHA-256
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#ifndef HAVE_IPSEC
+# error "Must #define HAVE_IPSEC in config.h"
+#endif
+#include "espcrypt.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/packet_anno.hh>
+#include <click/master.hh>
+#include <clicknet/ip.h>
+CLICK_DECLS
+
+static const unsigned char zero_block[16] = { 0 };
+
+static inline void
+store_be32(unsigned char *p, uint32_t x)
+{
+    p[0] = x >> 24;
+    p[1] = x >> 16;
+    p[2] = x >> 8;
+    p[3] = x;
+}
+
+// GCM counter block: salt, explicit IV, block number (RFC 4106 section 3)
+static inline void
+gcm_counter(unsigned char *ctr, const uint8_t *salt, const unsigned char *iv,
+	    uint32_t block)
+{
+    memcpy(ctr, salt, 4);
+    memcpy(ctr + 4, iv, 8);
+    store_be32(ctr + 12, block);
+}
+
+IPsecESPCrypt::IPsecESPCrypt()
+    : _encrypt(true), _mode(MODE_GCM), _impl(AESCipher::IMPL_PORTABLE),
+      _hash_impl(MBHash::IMPL_PORTABLE)
+{
+}
+
+IPsecESPCrypt::~IPsecESPCrypt()
+{
+}
+
+int
+IPsecESPCrypt::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    String mode = "gcm";
+    bool simd = true;
+    if (Args(conf, this, errh)
+	.read_mp("ENCRYPT", _encrypt)
+	.read_p("MODE", WordArg(), mode)
+	.read("SIMD", simd)
+	.complete() < 0)
+	return -1;
+    mode = mode.lower();
+    if (mode == "gcm")
+	_mode = MODE_GCM;
+    else if (mode == "cbc")
+	_mode = MODE_CBC;
+    else
+	return errh->error("MODE must be gcm or cbc");
+    _impl = (simd ? AESCipher::best_impl() : (int) AESCipher::IMPL_PORTABLE);
+    _hash_impl = (simd ? MBHash::best_impl() : (int) MBHash::IMPL_PORTABLE);
+    return 0;
+}
+
+int
+IPsecESPCrypt::initialize(ErrorHandler *)
+{
+    int nthreads = master()->nthreads();
+    _cache.resize((nthreads < 1 ? 1 : nthreads) * CACHE_SIZE);
+    for (Keys *k = _cache.begin(); k != _cache.end(); ++k)
+	k->sa = 0;
+    _drops = 0;
+    return 0;
+}
+
+IPsecESPCrypt::Keys *
+IPsecESPCrypt::lookup_keys(const SADataTuple *sa)
+{
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD && HAVE___THREAD_STORAGE_CLASS
+    int id = click_current_thread_id;
+#else
+    int id = 0;
+#endif
+    unsigned nthreads = _cache.size() / CACHE_SIZE;
+    uint32_t h = (uint32_t) ((uintptr_t) sa >> 4) * 0x9E3779B1U;
+    Keys &k = _cache[((unsigned) id % nthreads) * CACHE_SIZE + (h >> 24) % CACHE_SIZE];
+
+    // Compare the key bytes too, so a rekeyed SA is noticed.
+    if (k.sa != sa || memcmp(k.enc_key, sa->Encryption_key, KEY_SIZE) != 0
+	|| memcmp(k.auth_key, sa->Authentication_key, KEY_SIZE) != 0) {
+	k.sa = sa;
+	memcpy(k.enc_key, sa->Encryption_key, KEY_SIZE);
+	memcpy(k.auth_key, sa->Authentication_key, KEY_SIZE);
+	k.aes.set(k.enc_key, KEY_SIZE);
+	if (_mode == MODE_GCM) {
+	    unsigned char h[16];
+	    k.aes.encrypt_block(zero_block, h);
+	    k.ghash.set(h, _impl);
+	} else
+	    k.hmac.set(MBHash::SHA256, k.auth_key, KEY_SIZE);
+    }
+    return &k;
+}
+
+void
+IPsecESPCrypt::fail(Packet *p, const char *why)
+{
+    if (_drops == 0)
+	click_chatter("%p{element}: %s", this, why);
+    _drops++;
+    checked_output_push(1, p);
+}
+
+bool
+IPsecESPCrypt::prepare_encrypt(Work &w, SADataTuple *sa, Packet *p, AESJob &job)
+{
+    uint32_t ivlen = (_mode == MODE_GCM ? 8 : 16);
+    uint32_t block = (_mode == MODE_GCM ? 4 : 16);
+    uint8_t ip_p = (p->has_network_header() ? p->ip_header()->ip_p : 0);
+    uint32_t spi = IPSEC_SPI_ANNO(p);
+    uint32_t len = p->length();
+    uint32_t padding = (block - (len + 2) % block) % block;
+
+    // Sequence numbers must not cycle (RFC 4303 section 3.3.3): the packet
+    // numbered 0xFFFFFFFF leaves the counter at 0, and the SA sends nothing
+    // more until it is rekeyed.  A fetch-and-add would keep counting past 0,
+    // so the counter is advanced with compare-and-swap.
+    uint32_t seq;
+    do {
+	seq = sa->cur_rpl;
+	if (unlikely(seq == 0)) {
+	    fail(p, "ESP sequence numbers exhausted");
+	    return false;
+	}
+    } while (!__sync_bool_compare_and_swap(&sa->cur_rpl, seq, seq + 1));
+    if (unlikely(seq == 0xFFFFFFFFU))
+	click_chatter("%p{element}: SPI %u used its last sequence number, rekey it", this, spi);
+
+    WritablePacket *q = p->push(8 + ivlen);
+    if (q)
+	q = q->put(padding + 2 + ICV_SIZE);
+    if (!q) {
+	_drops++;
+	return false;
+    }
+
+    uint64_t ivc = __sync_add_and_fetch(&sa->iv_counter, 1);
+
+    unsigned char *esp = q->data();
+    store_be32(esp, spi);
+    store_be32(esp + 4, seq);
+    w.p = q;
+    w.text = esp + 8 + ivlen;
+    w.text_len = len + padding + 2;
+
+    // default padding specified by RFC 2406, then pad length and next header
+    unsigned char *pad = w.text + len;
+    for (uint32_t i = 0; i < padding; ++i)
+	pad[i] = i + 1;
+    pad[padding] = padding;
+    pad[padding + 1] = ip_p;
+
+    job.key = &w.keys->aes;
+    job.in = zero_block;
+    job.len = 16;
+    if (_mode == MODE_GCM) {
+	// The IV is a counter, which GCM requires to be unique per key.
+	store_be32(esp + 8, ivc >> 32);
+	store_be32(esp + 12, ivc);
+	job.out = w.tag;
+	gcm_counter(job.iv, w.keys->auth_key, esp + 8, 1);
+    } else {
+	// The IV is the encryption of a unique block, so it is unpredictable
+	// as CBC requires.
+	job.out = esp + 8;
+	memcpy(job.iv, esp, 8);
+	store_be32(job.iv + 8, ivc >> 32);
+	store_be32(job.iv + 12, ivc);
+    }
+    return true;
+}
+
+bool
+IPsecESPCrypt::prepare_decrypt(Work &w, Packet *p, AESJob &job)
+{
+    uint32_t ivlen = (_mode == MODE_GCM ? 8 : 16);
+    uint32_t len = p->length();
+    if (len < 8 + ivlen + 2 + ICV_SIZE
+	|| (_mode == MODE_CBC && (len - 8 - ivlen - ICV_SIZE) % 16 != 0)) {
+	fail(p, "bad ESP packet length");
+	return false;
+    }
+    WritablePacket *q = p->uniqueify();
+    if (!q) {
+	_drops++;
+	return false;
+    }
+    w.p = q;
+    w.text = q->data() + 8 + ivlen;
+    w.text_len = len - 8 - ivlen - ICV_SIZE;
+
+    // GCM: E(J0) masks the tag.  CBC needs no keystream.
+    job.key = &w.keys->aes;
+    job.in = zero_block;
+    job.out = w.tag;
+    job.len = (_mode == MODE_GCM ? 16 : 0);
+    gcm_counter(job.iv, w.keys->auth_key, q->data() + 8, 1);
+    return true;
+}
+
+bool
+IPsecESPCrypt::finish_decrypt(Work &w)
+{
+    const unsigned char *t = w.text;
+    uint32_t padding = t[w.text_len - 2];
+    if (padding + 2 > w.text_len) {
+	fail(w.p, "invalid ESP padding length");
+	return false;
+    }
+    const unsigned char *pad = t + w.text_len - 2 - padding;
+    for (uint32_t i = 0; i < padding; ++i)
+	if (pad[i] != i + 1) {
+	    fail(w.p, "corrupt ESP padding");
+	    return false;
+	}
+    w.p->pull(w.text - w.p->data());
+    w.p->take(padding + 2 + ICV_SIZE);
+    return true;
+}
+
+// Advances the SA's replay window with an authenticated packet.
+inline bool
+IPsecESPCrypt::accept(const Work &w)
+{
+    SADataTuple *sa = (SADataTuple *) IPSEC_SA_DATA_REFERENCE_ANNO(w.p);
+    uint32_t seq;
+    memcpy(&seq, w.p->data() + 4, 4);
+    return sa->accept(ntohl(seq), w.p->length());
+}
+
+// Computes the HMACs of a burst's packets, from the ESP header through the
+// ciphertext, in one multi-buffer pass.  The MACs go to mac, or into the
+// packets' ICV fields if mac is null.
+void
+IPsecESPCrypt::hmac_burst(Work *w, int n, unsigned char (*mac)[ICV_SIZE])
+{
+    HMACJob jobs[BURST];
+    for (int i = 0; i < n; ++i) {
+	unsigned char *icv = w[i].text + w[i].text_len;
+	jobs[i].key = &w[i].keys->hmac;
+	jobs[i].data = w[i].p->data();
+	jobs[i].len = icv - w[i].p->data();
+	jobs[i].mac = (mac ? mac[i] : icv);
+	jobs[i].mac_len = ICV_SIZE;
+    }
+    MBHash::hmac(jobs, n, _hash_impl);
+}
+
+// Processes up to BURST packets, leaving the survivors at the start of
+// pkts and, if index is nonnull, their original positions in index.  Each
+// step runs over the whole burst so that AESCipher can interleave the
+// packets' blocks.
+int
+IPsecESPCrypt::process_burst(Packet **pkts, int n, int *index)
+{
+    Work w[BURST];
+    AESJob jobs[BURST];
+    int m = 0;
+    for (int i = 0; i < n; ++i) {
+	Packet *p = pkts[i];
+	SADataTuple *sa = (SADataTuple *) IPSEC_SA_DATA_REFERENCE_ANNO(p);
+	if (!sa) {
+	    fail(p, "no security association");
+	    continue;
+	}
+	w[m].keys = lookup_keys(sa);
+	w[m].index = i;
+	if (_encrypt ? prepare_encrypt(w[m], sa, p, jobs[m])
+	    : prepare_decrypt(w[m], p, jobs[m]))
+	    ++m;
+    }
+
+    // GCM tag masks, or CBC IVs when encrypting
+    AESCipher::ctr(jobs, m, _impl);
+
+    if (!_encrypt) {
+	// verify before decrypting
+	unsigned char mac[BURST][ICV_SIZE];
+	if (_mode == MODE_CBC)
+	    hmac_burst(w, m, mac);
+	int k = 0;
+	for (int i = 0; i < m; ++i) {
+	    unsigned char *icv = w[i].text + w[i].text_len;
+	    if (_mode == MODE_GCM) {
+		memset(mac[i], 0, ICV_SIZE);
+		w[i].keys->ghash.update(mac[i], w[i].p->data(), 8);
+		w[i].keys->ghash.update(mac[i], w[i].text, w[i].text_len);
+		w[i].keys->ghash.finish(mac[i], 8, w[i].text_len);
+		for (int j = 0; j < ICV_SIZE; ++j)
+		    mac[i][j] ^= w[i].tag[j];
+	    }
+	    if (!AESCipher::equal(mac[i], icv, ICV_SIZE))
+		fail(w[i].p, "ESP integrity check failed");
+	    else if (!accept(w[i]))
+		fail(w[i].p, "ESP replayed packet");
+	    else
+		w[k++] = w[i];
+	}
+	m = k;
+    }
+
+    for (int i = 0; i < m; ++i) {
+	AESJob &job = jobs[i];
+	job.key = &w[i].keys->aes;
+	job.in = job.out = w[i].text;
+	job.len = w[i].text_len;
+	if (_mode == MODE_GCM)
+	    gcm_counter(job.iv, w[i].keys->auth_key, w[i].p->data() + 8, 2);
+	else
+	    memcpy(job.iv, w[i].text - 16, 16);
+    }
+    if (_mode == MODE_GCM)
+	AESCipher::ctr(jobs, m, _impl);
+    else if (_encrypt)
+	AESCipher::cbc_encrypt(jobs, m, _impl);
+    else
+	AESCipher::cbc_decrypt(jobs, m, _impl);
+
+    if (_encrypt && _mode == MODE_CBC)
+	hmac_burst(w, m, 0);
+
+    int k = 0;
+    for (int i = 0; i < m; ++i) {
+	if (_encrypt) {
+	    if (_mode == MODE_GCM) {
+		unsigned char y[16];
+		unsigned char *icv = w[i].text + w[i].text_len;
+		memset(y, 0, sizeof(y));
+		w[i].keys->ghash.update(y, w[i].p->data(), 8);
+		w[i].keys->ghash.update(y, w[i].text, w[i].text_len);
+		w[i].keys->ghash.finish(y, 8, w[i].text_len);
+		for (int j = 0; j < ICV_SIZE; ++j)
+		    icv[j] = y[j] ^ w[i].tag[j];
+	    }
+	} else if (!finish_decrypt(w[i]))
+	    continue;
+	if (index)
+	    index[k] = w[i].index;
+	pkts[k++] = w[i].p;
+    }
+    return k;
+}
+
+int
+IPsecESPCrypt::process(Packet **p, int n)
+{
+    int k = 0;
+    for (int i = 0; i < n; i += BURST) {
+	int x = process_burst(p + i, n - i < BURST ? n - i : BURST);
+	memmove(p + k, p + i, x * sizeof(Packet *));
+	k += x;
+    }
+    return k;
+}
+
+void
+IPsecESPCrypt::push(int, Packet *p)
+{
+    if (process(&p, 1))
+	output(0).push(p);
+}
+
+Packet *
+IPsecESPCrypt::pull(int)
+{
+    Packet *p = input(0).pull();
+    if (p && process(&p, 1))
+	return p;
+    return 0;
+}
+
+int
+IPsecESPCrypt::pull_burst(int, Packet **p, int max)
+{
+    return process(p, input(0).pull_burst(p, max));
+}
+
+void
+IPsecESPCrypt::bpush(int, PBatch *p)
+{
+    int k = 0;
+    for (int i = 0; i < p->npkts; i += BURST) {
+	int index[BURST];
+	int x = process_burst(p->pptrs + i, p->npkts - i < BURST ? p->npkts - i : BURST, index);
+	for (int j = 0; j < x; ++j)
+	    p->move_packet(i + index[j], k++, p->pptrs[i + j]);
+    }
+    p->npkts = k;
+    output(0).bpush(p);
+}
+
+enum { h_drops, h_implementation, h_hash_implementation };
+
+String
+IPsecESPCrypt::read_handler(Element *e, void *thunk)
+{
+    IPsecESPCrypt *ec = static_cast<IPsecESPCrypt *>(e);
+    switch ((intptr_t) thunk) {
+    case h_drops:
+	return String(ec->_drops.value());
+    case h_implementation:
+	return String(AESCipher::impl_name(ec->_impl));
+    default:
+	return String(MBHash::impl_name(ec->_hash_impl));
+    }
+}
+
+void
+IPsecESPCrypt::add_handlers()
+{
+    add_read_handler("drops", read_handler, h_drops);
+    add_read_handler("implementation", read_handler, h_implementation);
+    add_read_handler("hash_implementation", read_handler, h_hash_implementation);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel AESCipher MBHash)
+EXPORT_ELEMENT(IPsecESPCrypt)
+ELEMENT_MT_SAFE(IPsecESPCrypt)
@@ -0,0 +1,160 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_IPSECESPCRYPT_HH
+#define CLICK_IPSECESPCRYPT_HH
+#include <click/element.hh>
+#include <click/atomic.hh>
+#include <click/pbatch.hh>
+#include "aescipher.hh"
+#include "mbhash.hh"
+#include "sadatatuple.hh"
+CLICK_DECLS
+
+/*
+=c
+
+IPsecESPCrypt(ENCRYPT [, MODE, I<keywords> SIMD])
+
+=s ipsec
+
+ESP encapsulation with AES-GCM or AES-CBC and HMAC-SHA-256
+
+=d
+
+Applies or removes ESP in one step, replacing the IPsecESPEncap, cipher and
+IPsecAuthHMACSHA1 chain.  If ENCRYPT is true, IPsecESPCrypt adds an ESP
+header, padding and trailer to the packet, encrypts it and appends the
+integrity check value.  If ENCRYPT is false, it expects a packet that starts
+with an ESP header, verifies and decrypts it, and strips the ESP header,
+padding, trailer and ICV.  Authenticated packets must also pass the SA's
+anti-replay window.  Packets that fail verification are emitted on output 1
+if it exists, and dropped otherwise.
+
+Keys come from the security association referenced by the packet's SA
+annotation, as set by RadixIPsecLookup or IPsecSAD; outgoing packets take their SPI from
+the SPI annotation and their sequence number from the SA.  Concurrent
+encryptors take distinct sequence numbers.  Sequence numbers do not cycle:
+after an SA sends number 0xFFFFFFFF, IPsecESPCrypt reports that it needs
+rekeying and drops its packets until it is rekeyed.  MODE is one of:
+
+=over 8
+
+=item C<gcm>
+
+AES-GCM with a 16-byte ICV and an 8-byte explicit IV (RFC 4106).  The IV
+is a per-SA counter that starts at a random value when the SA is created.  The
+encryption key is the SA's ENCRYPT_KEY; the first 4 bytes of its AUTH_KEY
+are the salt.  The ESP header is authenticated as associated data.
+
+=item C<cbc>
+
+AES-CBC (RFC 3602) with a 16-byte IV, authenticated with
+HMAC-SHA-256-128 (RFC 4868) keyed by the SA's AUTH_KEY.
+
+=back
+
+Default MODE is C<gcm>.  Keys are 128 bits, the key size SATable stores.
+
+IPsecESPCrypt works on many packets at once.  It accepts batches with
+bpush(), and when pulled through pull_burst() it processes the whole burst.
+The AES blocks of different packets are encrypted together, eight at a time
+with AES-NI or VAES, so the latency of each AES round is hidden even though
+each packet's CBC chain is serial; GCM's GHASH uses PCLMULQDQ, and the
+burst's HMACs are computed together by MBHash.  Expanded
+keys are cached per thread and recomputed when an SA is rekeyed.  Batch
+slices and annotations are not updated; packets that fail verification are
+removed from the batch, and the others keep their slices and annotations.
+
+Keyword arguments are:
+
+=over 8
+
+=item SIMD
+
+Boolean.  Whether to use AES-NI, VAES, PCLMULQDQ and MBHash's SIMD code
+when the CPU supports them.  Default is true.
+
+=back
+
+=h drops read-only
+
+Number of packets dropped because they were malformed, failed
+verification, were replayed, or found their SA's sequence numbers used up.
+
+=h implementation read-only
+
+Returns C<portable>, C<aesni> or C<vaes>.
+
+=h hash_implementation read-only
+
+Returns the MBHash implementation used for HMAC-SHA-256: C<portable>,
+C<sse2>, C<avx2>, C<avx512> or C<shani>.
+
+=a IPsecESPEncap, IPsecESPUnencap, IPsecAuthHMACSHA1, IPsecAES,
+RadixIPsecLookup, IPsecSAD, AESCipher, MBHash */
+
+class IPsecESPCrypt : public Element { public:
+
+    IPsecESPCrypt();
+    ~IPsecESPCrypt();
+
+    const char *class_name() const	{ return "IPsecESPCrypt"; }
+    const char *port_count() const	{ return "1/1-2"; }
+    const char *processing() const	{ return "a/ah"; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    int initialize(ErrorHandler *errh);
+    void add_handlers();
+
+    void push(int port, Packet *p);
+    Packet *pull(int port);
+    int pull_burst(int port, Packet **p, int max);
+    void bpush(int port, PBatch *p);
+
+  private:
+
+    enum { MODE_GCM, MODE_CBC };
+    enum { BURST = PULL_BURST, ICV_SIZE = 16, CACHE_SIZE = 256 };
+
+    // Expanded keys of one SA.
+    struct Keys {
+	const SADataTuple *sa;
+	uint8_t enc_key[KEY_SIZE];
+	uint8_t auth_key[KEY_SIZE];
+	AESKey aes;
+	GHashKey ghash;
+	HMACKey hmac;
+    };
+
+    // Per-packet state of one burst.
+    struct Work {
+	WritablePacket *p;
+	Keys *keys;
+	unsigned char *text;
+	uint32_t text_len;
+	unsigned char tag[16];
+	int index;		// position in the burst
+    };
+
+    bool _encrypt;
+    int _mode;
+    int _impl;
+    int _hash_impl;
+    Vector<Keys> _cache;	// CACHE_SIZE entries per thread
+    atomic_uint32_t _drops;
+
+    Keys *lookup_keys(const SADataTuple *sa);
+    void fail(Packet *p, const char *why);
+    int process(Packet **p, int n);
+    int process_burst(Packet **p, int n, int *index = 0);
+    void hmac_burst(Work *w, int n, unsigned char (*mac)[ICV_SIZE]);
+    bool prepare_encrypt(Work &w, SADataTuple *sa, Packet *p, AESJob &job);
+    bool prepare_decrypt(Work &w, Packet *p, AESJob &job);
+    bool finish_decrypt(Work &w);
+    inline bool accept(const Work &w);
+
+    static String read_handler(Element *e, void *thunk);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -37,6 +37,7 @@ CLICK_DECLS
 #define KEY_SIZE 16
 
 IPsecAuthHMACSHA1::IPsecAuthHMACSHA1()
+  : _impl(MBHash::IMPL_PORTABLE)
 {
 }
 
@@ -47,7 +48,14 @@ IPsecAuthHMACSHA1::~IPsecAuthHMACSHA1()
 int
 IPsecAuthHMACSHA1::configure(Vector<String> &conf, ErrorHandler *errh)
 {
-    return Args(conf, this, errh).read_mp("VERIFY", _op).complete();
+    bool simd = true;
+    if (Args(conf, this, errh)
+	.read_mp("VERIFY", _op)
+	.read("SIMD", simd)
+	.complete() < 0)
+	return -1;
+    _impl = (simd ? MBHash::best_impl() : (int) MBHash::IMPL_PORTABLE);
+    return 0;
 }
 
 int
@@ -80,13 +88,7 @@ IPsecAuthHMACSHA1::simple_action(Packet *p)
 
     HMAC(sa_data->Authentication_key,KEY_SIZE,(u_char*) p->data(),p->length()-12,digest,&len);
     if (memcmp(ah, digest, 12)) {
-      if (_drops == 0)
-	click_chatter("Invalid SHA1 authentication digest");
-      _drops++;
-      if (noutputs() > 1)
-	output(1).push(p);
-      else
-	p->kill();
+      fail(p);
       return 0;
     }
     //remove digest
@@ -95,6 +97,116 @@ IPsecAuthHMACSHA1::simple_action(Packet *p)
   }
 }
 
+void
+IPsecAuthHMACSHA1::fail(Packet *p)
+{
+  if (_drops == 0)
+    click_chatter("Invalid SHA1 authentication digest");
+  _drops++;
+  if (noutputs() > 1)
+    output(1).push(p);
+  else
+    p->kill();
+}
+
+// Authenticates up to BURST packets in one MBHash call, leaving the
+// survivors at the start of pkts and, if index is nonnull, their original
+// positions in index.  A burst usually belongs to few SAs, so each SA's
+// HMAC key is set up once per burst.
+int
+IPsecAuthHMACSHA1::process_burst(Packet **pkts, int n, int *index)
+{
+  HMACJob jobs[BURST];
+  HMACKey keys[BURST];
+  const SADataTuple *key_sa[BURST];
+  unsigned char digest[BURST][AUTH_LEN];
+  int from[BURST];
+  int nkeys = 0, m = 0;
+
+  for (int i = 0; i < n; i++) {
+    SADataTuple *sa_data = (SADataTuple *)IPSEC_SA_DATA_REFERENCE_ANNO(pkts[i]);
+    int k = nkeys - 1;
+    while (k >= 0 && key_sa[k] != sa_data)
+      k--;
+    if (k < 0) {
+      k = nkeys++;
+      key_sa[k] = sa_data;
+      keys[k].set(MBHash::SHA1, sa_data->Authentication_key, KEY_SIZE);
+    }
+
+    Packet *p = pkts[i];
+    if (_op == COMPUTE_AUTH) {
+      WritablePacket *q = p->put(AUTH_LEN);
+      if (!q) {
+	_drops++;
+	continue;
+      }
+      p = q;
+      jobs[m].mac = q->data() + q->length() - AUTH_LEN;
+    } else if (p->length() < AUTH_LEN) {
+      fail(p);
+      continue;
+    } else
+      jobs[m].mac = digest[m];
+    jobs[m].key = &keys[k];
+    jobs[m].data = p->data();
+    jobs[m].len = p->length() - AUTH_LEN;
+    jobs[m].mac_len = AUTH_LEN;
+    from[m] = i;
+    pkts[m++] = p;
+  }
+
+  MBHash::hmac(jobs, m, _impl);
+
+  int k = 0;
+  for (int i = 0; i < m; i++) {
+    Packet *p = pkts[i];
+    if (_op != COMPUTE_AUTH) {
+      if (memcmp(p->data() + p->length() - AUTH_LEN, digest[i], AUTH_LEN)) {
+	fail(p);
+	continue;
+      }
+      p->take(AUTH_LEN);
+    }
+    if (index)
+      index[k] = from[i];
+    pkts[k++] = p;
+  }
+  return k;
+}
+
+int
+IPsecAuthHMACSHA1::process(Packet **p, int n)
+{
+  int k = 0;
+  for (int i = 0; i < n; i += BURST) {
+    int x = process_burst(p + i, n - i < BURST ? n - i : BURST);
+    memmove(p + k, p + i, x * sizeof(Packet *));
+    k += x;
+  }
+  return k;
+}
+
+int
+IPsecAuthHMACSHA1::pull_burst(int, Packet **p, int max)
+{
+  return process(p, input(0).pull_burst(p, max));
+}
+
+void
+IPsecAuthHMACSHA1::bpush(int, PBatch *p)
+{
+  int k = 0;
+  for (int i = 0; i < p->npkts; i += BURST) {
+    int index[BURST];
+    int x = process_burst(p->pptrs + i, p->npkts - i < BURST ? p->npkts - i : BURST, index);
+    for (int j = 0; j < x; j++)
+      p->move_packet(i + index[j], k++, p->pptrs[i + j]);
+  }
+  p->npkts = k;
+  output(0).bpush(p);
+}
+
 String
 IPsecAuthHMACSHA1::drop_handler(Element *e, void *)
 {
@@ -102,15 +214,24 @@ IPsecAuthHMACSHA1::drop_handler(Element *e, void *)
   return String(a->_drops);
 }
 
+String
+IPsecAuthHMACSHA1::impl_handler(Element *e, void *)
+{
+  IPsecAuthHMACSHA1 *a = (IPsecAuthHMACSHA1 *)e;
+  return String(MBHash::impl_name(a->_impl));
+}
+
 void
 IPsecAuthHMACSHA1::add_handlers()
 {
   add_read_handler("drops", drop_handler, 0);
+  add_read_handler("implementation", impl_handler, 0);
 }
 
 #include "sha1_impl.cc"
 #include "hmac.cc"
 
 CLICK_ENDDECLS
+ELEMENT_REQUIRES(MBHash)
 EXPORT_ELEMENT(IPsecAuthHMACSHA1)
 ELEMENT_MT_SAFE(IPsecAuthHMACSHA1)
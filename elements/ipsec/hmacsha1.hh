@@ -3,20 +3,39 @@
 #include <click/element.hh>
 #include <click/atomic.hh>
 #include <click/glue.hh>
+#include <click/pbatch.hh>
+#include "mbhash.hh"
 CLICK_DECLS
 
 /*
  * =c
- * IPsecAuthHMACSHA1(VERIFY)
+ * IPsecAuthHMACSHA1(VERIFY [, SIMD])
  * =s ipsec
  * verify SHA1 authentication digest.
  * =d
  *
  * If first argument is 0, computes SHA1 authentication digest for ESP packet
  * per RFC 2404, 2406. If first argument is 1, verify SHA1 digest and remove
- * authentication bits.
+ * authentication bits.  Packets that fail verification are sent to output 1,
+ * if present, and dropped otherwise.
  *
- * =a IPsecESPEncap, IPsecDES
+ * Bursts pulled through pull_burst() and batches received by bpush() are
+ * authenticated together with MBHash, which hashes several packets at once
+ * in SIMD lanes or with the SHA extensions; packets that fail or are
+ * dropped are removed from the batch, and the others keep their slices and
+ * annotations.  If the SIMD keyword is false, the portable code is used.
+ * Default is true.
+ *
+ * =h drops read-only
+ *
+ * Number of packets that failed verification, or that were dropped in
+ * compute mode because no room could be made for the digest.
+ *
+ * =h implementation read-only
+ *
+ * Returns the MBHash implementation used for bursts and batches.
+ *
+ * =a IPsecESPEncap, IPsecDES, MBHash
  */
 
 class IPsecAuthHMACSHA1 : public Element {
@@ -32,15 +51,25 @@ public:
   int initialize(ErrorHandler *);
 
   Packet *simple_action(Packet *);
+  int pull_burst(int port, Packet **p, int max);
+  void bpush(int port, PBatch *p);
   void add_handlers();
 
   static String drop_handler(Element *e, void *thunk);
+  static String impl_handler(Element *e, void *thunk);
 
 private:
 
   int _op;
+  int _impl;
   atomic_uint32_t _drops;
 
+  enum { BURST = PULL_BURST, AUTH_LEN = 12 };
+
+  void fail(Packet *p);
+  int process(Packet **p, int n);
+  int process_burst(Packet **p, int n, int *index = 0);
+
   enum { COMPUTE_AUTH = 0, VERIFY_AUTH = 1 };
 };
 
@@ -0,0 +1,279 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * ipsecciphertest.{cc,hh} -- known-answer tests for AESCipher and MBHash
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "ipsecciphertest.hh"
+#include "aescipher.hh"
+#include "mbhash.hh"
+#include <click/error.hh>
+#include <click/straccum.hh>
+CLICK_DECLS
+
+IPsecCipherTest::IPsecCipherTest()
+{
+}
+
+namespace {
+
+// GCM specification test cases 2, 3 and 4 (AES-128)
+const char * const gcm_p3 =
+    "d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a72"
+    "1c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b391aafd255";
+const char * const gcm_c3 =
+    "42831ec2217774244b7221b784d0d49ce3aa212f2c02a4e035c17e2329aca12e"
+    "21d514b25466931c7d8f6a5aac84aa051ba30b396a0aac973d58e091473f5985";
+
+struct GCMVector {
+    const char *key;
+    const char *iv;
+    const char *plain;
+    int plain_len;
+    const char *aad;
+    const char *tag;
+};
+
+const GCMVector gcm_vectors[] = {
+    { "00000000000000000000000000000000", "000000000000000000000000",
+      "00000000000000000000000000000000", 16, "",
+      "ab6e47d42cec13bdf53a67b21257bddf" },
+    { "feffe9928665731c6d6a8f9467308308", "cafebabefacedbaddecaf888",
+      gcm_p3, 64, "",
+      "4d5c2af327cd64a62cf35abd2ba6fab4" },
+    { "feffe9928665731c6d6a8f9467308308", "cafebabefacedbaddecaf888",
+      gcm_p3, 60, "feedfacedeadbeeffeedfacedeadbeefabaddad2",
+      "5bc94fbc3221a5db94fae95ae7121a47" }
+};
+
+const char * const gcm_ciphers[] = {
+    "0388dace60b6a392f328c2b971b2fe78", gcm_c3, gcm_c3
+};
+
+// RFC 3602 test cases 1 and 2
+struct CBCVector {
+    const char *key;
+    const char *iv;
+    const char *plain;
+    const char *cipher;
+};
+
+const CBCVector cbc_vectors[] = {
+    { "06a9214036b8a15b512e03d534120006", "3dafba429d9eb430b422da802c9fac41",
+      "53696e676c6520626c6f636b206d7367",
+      "e353779c1079aeb82708942dbe77181a" },
+    { "c286696d887c9aa0611bbb3e2025a45a", "562e17996d093d28ddb3ba695a2e6f58",
+      "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f",
+      "d296cd94c2cccf8a3a863028b5e1dc0a7586602d253cfff91b8266bea6d61ab1" }
+};
+
+// RFC 4231 test cases 1 to 7; case 5 is truncated to 128 bits
+struct HMACVector {
+    String key;
+    String data;
+    const char *mac;
+};
+
+String
+unhex(const char *s, int len = -1)
+{
+    StringAccum sa;
+    for (; s[0] && s[1] && len != 0; s += 2, --len) {
+	int hi = (s[0] <= '9' ? s[0] - '0' : s[0] - 'a' + 10);
+	int lo = (s[1] <= '9' ? s[1] - '0' : s[1] - 'a' + 10);
+	sa << (char) (hi * 16 + lo);
+    }
+    return sa.take_string();
+}
+
+String
+fill(char c, int len)
+{
+    StringAccum sa;
+    while (len-- > 0)
+	sa << c;
+    return sa.take_string();
+}
+
+const unsigned char *
+udata(const String &s)
+{
+    return reinterpret_cast<const unsigned char *>(s.data());
+}
+
+String
+hex(const unsigned char *data, int len)
+{
+    return String(data, len).quoted_hex().lower().substring(2, -1);
+}
+
+int
+check_gcm(int impl, ErrorHandler *errh)
+{
+    enum { N = sizeof(gcm_vectors) / sizeof(gcm_vectors[0]) };
+    static const unsigned char zero_block[16] = { 0 };
+    AESKey keys[N];
+    GHashKey ghash[N];
+    String plain[N], iv[N];
+    unsigned char cipher[N][64], mask[N][16];
+    AESJob jobs[N];
+
+    // tag masks E(K, IV || 1), then the text from counter 2
+    for (int i = 0; i < N; ++i) {
+	const GCMVector &v = gcm_vectors[i];
+	String key = unhex(v.key);
+	keys[i].set(udata(key), key.length());
+	unsigned char h[16];
+	keys[i].encrypt_block(zero_block, h);
+	ghash[i].set(h, impl);
+	plain[i] = unhex(v.plain, v.plain_len);
+	iv[i] = unhex(v.iv);
+	jobs[i].key = &keys[i];
+	jobs[i].in = zero_block;
+	jobs[i].out = mask[i];
+	jobs[i].len = 16;
+	memcpy(jobs[i].iv, iv[i].data(), 12);
+	memcpy(jobs[i].iv + 12, "\0\0\0\1", 4);
+    }
+    AESCipher::ctr(jobs, N, impl);
+    for (int i = 0; i < N; ++i) {
+	jobs[i].in = udata(plain[i]);
+	jobs[i].out = cipher[i];
+	jobs[i].len = plain[i].length();
+	memcpy(jobs[i].iv, iv[i].data(), 12);
+	memcpy(jobs[i].iv + 12, "\0\0\0\2", 4);
+    }
+    AESCipher::ctr(jobs, N, impl);
+
+    for (int i = 0; i < N; ++i) {
+	const GCMVector &v = gcm_vectors[i];
+	int len = plain[i].length();
+	String expect = unhex(gcm_ciphers[i], len);
+	if (memcmp(cipher[i], expect.data(), len) != 0)
+	    return errh->error("%s: GCM test %d: bad ciphertext %s", AESCipher::impl_name(impl), i + 2, hex(cipher[i], len).c_str());
+	String aad = unhex(v.aad);
+	unsigned char y[16];
+	memset(y, 0, sizeof(y));
+	ghash[i].update(y, udata(aad), aad.length());
+	ghash[i].update(y, cipher[i], len);
+	ghash[i].finish(y, aad.length(), len);
+	for (int j = 0; j < 16; ++j)
+	    y[j] ^= mask[i][j];
+	if (memcmp(y, unhex(v.tag).data(), 16) != 0)
+	    return errh->error("%s: GCM test %d: bad tag %s", AESCipher::impl_name(impl), i + 2, hex(y, 16).c_str());
+    }
+    return 0;
+}
+
+int
+check_cbc(int impl, ErrorHandler *errh)
+{
+    enum { N = sizeof(cbc_vectors) / sizeof(cbc_vectors[0]) };
+    AESKey keys[N];
+    String plain[N], cipher[N];
+    unsigned char out[N][32], back[N][32];
+    AESJob jobs[N];
+
+    for (int i = 0; i < N; ++i) {
+	String key = unhex(cbc_vectors[i].key);
+	keys[i].set(udata(key), key.length());
+	plain[i] = unhex(cbc_vectors[i].plain);
+	cipher[i] = unhex(cbc_vectors[i].cipher);
+	jobs[i].key = &keys[i];
+	jobs[i].in = udata(plain[i]);
+	jobs[i].out = out[i];
+	jobs[i].len = plain[i].length();
+	memcpy(jobs[i].iv, unhex(cbc_vectors[i].iv).data(), 16);
+    }
+    AESCipher::cbc_encrypt(jobs, N, impl);
+    for (int i = 0; i < N; ++i)
+	if (memcmp(out[i], cipher[i].data(), cipher[i].length()) != 0)
+	    return errh->error("%s: CBC test %d: bad ciphertext %s", AESCipher::impl_name(impl), i + 1, hex(out[i], cipher[i].length()).c_str());
+
+    for (int i = 0; i < N; ++i) {
+	jobs[i].in = udata(cipher[i]);
+	jobs[i].out = back[i];
+	memcpy(jobs[i].iv, unhex(cbc_vectors[i].iv).data(), 16);
+    }
+    AESCipher::cbc_decrypt(jobs, N, impl);
+    for (int i = 0; i < N; ++i)
+	if (memcmp(back[i], plain[i].data(), plain[i].length()) != 0)
+	    return errh->error("%s: CBC test %d: bad plaintext %s", AESCipher::impl_name(impl), i + 1, hex(back[i], plain[i].length()).c_str());
+    return 0;
+}
+
+int
+check_hmac(int impl, ErrorHandler *errh)
+{
+    const HMACVector v[] = {
+	{ fill('\x0b', 20), "Hi There",
+	  "b0344c61d8db38535ca8afceaf0bf12b881dc200c9833da726e9376c2e32cff7" },
+	{ "Jefe", "what do ya want for nothing?",
+	  "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843" },
+	{ fill('\xaa', 20), fill('\xdd', 50),
+	  "773ea91e36800e46854db8ebd09181a72959098b3ef8c122d9635514ced565fe" },
+	{ unhex("0102030405060708090a0b0c0d0e0f10111213141516171819"),
+	  fill('\xcd', 50),
+	  "82558a389a443c0ea4cc819899f2083a85f0faa3e578f8077a2e3ff46729665b" },
+	{ fill('\x0c', 20), "Test With Truncation",
+	  "a3b6167473100ee06e0c796c2955552b" },
+	{ fill('\xaa', 131),
+	  "Test Using Larger Than Block-Size Key - Hash Key First",
+	  "60e431591ee0b67f0d8a26aacbf5b77f8e0bc6213728c5140546040f0ee37f54" },
+	{ fill('\xaa', 131),
+	  "This is a test using a larger than block-size key and a larger "
+	  "than block-size data. The key needs to be hashed before being used "
+	  "by the HMAC algorithm.",
+	  "9b09ffa71b942fcb27635fbcd5b0e944bfdc63644f0713938a7f51535c3a35e2" }
+    };
+    // each vector three times, so that every SIMD lane is used
+    enum { NV = sizeof(v) / sizeof(v[0]), N = 3 * NV };
+    HMACKey keys[NV];
+    HMACJob jobs[N];
+    unsigned char mac[N][MBHash::SHA256_SIZE];
+    for (int i = 0; i < NV; ++i)
+	keys[i].set(MBHash::SHA256, udata(v[i].key), v[i].key.length());
+    for (int i = 0; i < N; ++i) {
+	const HMACVector &x = v[i % NV];
+	jobs[i].key = &keys[i % NV];
+	jobs[i].data = udata(x.data);
+	jobs[i].len = x.data.length();
+	jobs[i].mac = mac[i];
+	jobs[i].mac_len = strlen(x.mac) / 2;
+    }
+    MBHash::hmac(jobs, N, impl);
+    for (int i = 0; i < N; ++i)
+	if (memcmp(mac[i], unhex(v[i % NV].mac).data(), jobs[i].mac_len) != 0)
+	    return errh->error("%s: HMAC-SHA-256 test %d: bad MAC %s", MBHash::impl_name(impl), i % NV + 1, hex(mac[i], jobs[i].mac_len).c_str());
+    return 0;
+}
+
+}
+
+int
+IPsecCipherTest::initialize(ErrorHandler *errh)
+{
+    for (int impl = AESCipher::IMPL_PORTABLE; impl <= AESCipher::best_impl(); ++impl)
+	if (check_gcm(impl, errh) < 0 || check_cbc(impl, errh) < 0)
+	    return -1;
+    if (check_hmac(MBHash::IMPL_PORTABLE, errh) < 0
+	|| check_hmac(MBHash::best_impl(), errh) < 0)
+	return -1;
+
+    errh->message("All tests pass!");
+    return 0;
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel AESCipher MBHash)
+EXPORT_ELEMENT(IPsecCipherTest)
@@ -0,0 +1,42 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_IPSECCIPHERTEST_HH
+#define CLICK_IPSECCIPHERTEST_HH
+#include <click/element.hh>
+CLICK_DECLS
+
+/*
+=c
+
+IPsecCipherTest()
+
+=s test
+
+runs known-answer tests for IPsecESPCrypt's ciphers
+
+=d
+
+IPsecCipherTest checks AESCipher and MBHash against published test vectors
+at initialization time.  It does not route packets.
+
+AES-GCM is checked with the AES-128 test cases 2 to 4 of the GCM
+specification (also used by NIST), AES-CBC with test cases 1 and 2 of RFC
+3602, and HMAC-SHA-256 with test cases 1 to 7 of RFC 4231, including the
+truncated output of case 5.  Every implementation the CPU supports is
+checked, with all of a cipher's vectors in one multi-buffer call.
+
+=a IPsecESPCrypt, CryptoTest
+
+*/
+
+class IPsecCipherTest : public Element { public:
+
+    IPsecCipherTest();
+
+    const char *class_name() const		{ return "IPsecCipherTest"; }
+
+    int initialize(ErrorHandler *errh);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,286 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * ipsecsad.{cc,hh} -- security association database for incoming ESP
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#ifndef HAVE_IPSEC
+# error "Must #define HAVE_IPSEC in config.h"
+#endif
+#include "ipsecsad.hh"
+#include "esp.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/straccum.hh>
+#include <click/handler.hh>
+#include <click/packet_anno.hh>
+CLICK_DECLS
+
+IPsecSAD::IPsecSAD()
+    : _buckets(0), _shift(32), _count(0), _window(ReplayWindow::MIN_SIZE),
+      _retired_head(0), _retired_tail(0)
+{
+    _drops = 0;
+}
+
+IPsecSAD::~IPsecSAD()
+{
+}
+
+void *
+IPsecSAD::cast(const char *name)
+{
+    if (strcmp(name, "IPsecSAD") == 0)
+	return this;
+    else
+	return Element::cast(name);
+}
+
+int
+IPsecSAD::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    uint32_t capacity = 4096;
+    if (Args(this, errh).bind(conf)
+	.read("CAPACITY", capacity)
+	.read("WINDOW", _window)
+	.consume() < 0)
+	return -1;
+    if (_window < ReplayWindow::MIN_SIZE || _window > ReplayWindow::MAX_SIZE)
+	return errh->error("WINDOW must be between %d and %d", ReplayWindow::MIN_SIZE, ReplayWindow::MAX_SIZE);
+
+    int nbits = 1;
+    while (nbits < 30 && (1U << nbits) < capacity)
+	++nbits;
+    _shift = 32 - nbits;
+    _buckets = new Entry * volatile[1U << nbits];
+    for (uint32_t i = 0; i < (1U << nbits); ++i)
+	_buckets[i] = 0;
+
+    for (int i = 0; i < conf.size(); ++i)
+	if (change(CMD_ADD, conf[i], errh) < 0)
+	    return -1;
+    return 0;
+}
+
+void
+IPsecSAD::cleanup(CleanupStage)
+{
+    if (_buckets)
+	for (uint32_t i = 0; i < (1U << (32 - _shift)); ++i)
+	    while (Entry *e = _buckets[i]) {
+		_buckets[i] = e->next;
+		delete e;
+	    }
+    delete[] _buckets;
+    _buckets = 0;
+    while (Entry *e = _retired_head) {
+	_retired_head = e->retired_next;
+	delete e;
+    }
+}
+
+// Returns an entry that no reader can still be using: a new one, or one
+// retired more than GRACE_SEC seconds ago.
+IPsecSAD::Entry *
+IPsecSAD::alloc_entry()
+{
+    Entry *e = _retired_head;
+    if (e && e->retired + Timestamp(GRACE_SEC, 0) <= Timestamp::recent_steady()) {
+	if (!(_retired_head = e->retired_next))
+	    _retired_tail = 0;
+	return e;
+    } else
+	return new Entry;
+}
+
+void
+IPsecSAD::retire(Entry *e)
+{
+    e->retired = Timestamp::recent_steady();
+    e->retired_next = 0;
+    if (_retired_tail)
+	_retired_tail->retired_next = e;
+    else
+	_retired_head = e;
+    _retired_tail = e;
+}
+
+int
+IPsecSAD::parse_sa(const String &str, uint32_t &spi, SADataTuple &sa, ErrorHandler *errh)
+{
+    Vector<String> words;
+    cp_spacevec(str, words);
+    String enc_key, auth_key;
+    uint32_t replay = 1, window = _window;
+    if (Args(words, this, errh)
+	.read_mp("SPI", spi)
+	.read_mp("ENCRYPT_KEY", enc_key)
+	.read_mp("AUTH_KEY", auth_key)
+	.read_p("REPLAY", replay)
+	.read_p("WINDOW", window)
+	.complete() < 0)
+	return -1;
+    if (spi == 0)
+	return errh->error("SPI must be nonzero");
+    if (enc_key.length() != KEY_SIZE || auth_key.length() != KEY_SIZE)
+	return errh->error("keys must be %d bytes long", KEY_SIZE);
+    if (window < ReplayWindow::MIN_SIZE || window > ReplayWindow::MAX_SIZE)
+	return errh->error("WINDOW must be between %d and %d", ReplayWindow::MIN_SIZE, ReplayWindow::MAX_SIZE);
+    sa = SADataTuple(enc_key.data(), auth_key.data(), replay, 0);
+    sa.window.init(window, replay);
+    return 0;
+}
+
+// Applies one add, rekey or remove command.  Readers traverse the chains
+// without locks, so an entry is filled in before it is linked, and an
+// unlinked entry keeps its next pointer for readers still standing on it.
+int
+IPsecSAD::change(int command, const String &str, ErrorHandler *errh)
+{
+    uint32_t spi;
+    SADataTuple sa;
+    if (command == CMD_REMOVE) {
+	if (!IntArg().parse(cp_uncomment(str), spi))
+	    return errh->error("expected SPI");
+    } else if (parse_sa(str, spi, sa, errh) < 0)
+	return -1;
+
+    _lock.acquire();
+    Entry * volatile *pprev = &_buckets[bucket(spi)];
+    while (*pprev && (*pprev)->spi != spi)
+	pprev = &(*pprev)->next;
+    Entry *old = *pprev;
+
+    int r = 0;
+    if (command == CMD_ADD && old)
+	r = errh->error("SPI %u already exists", spi);
+    else if (command != CMD_ADD && !old)
+	r = errh->error("SPI %u not found", spi);
+    else if (command == CMD_REMOVE) {
+	*pprev = old->next;
+	retire(old);
+	--_count;
+    } else {
+	Entry *e = alloc_entry();
+	e->spi = spi;
+	e->sa = sa;
+	e->next = (old ? old->next : 0);
+	click_fence();
+	*pprev = e;
+	if (old)
+	    retire(old);
+	else
+	    ++_count;
+    }
+    _lock.release();
+    return r;
+}
+
+bool
+IPsecSAD::process(Packet *p)
+{
+    const esp_new *esp = reinterpret_cast<const esp_new *>(p->data());
+    SADataTuple *sa;
+    if (p->length() < sizeof(esp_new)
+	|| !(sa = lookup(ntohl(esp->esp_spi)))
+	|| !sa->window.check(ntohl(esp->esp_rpl))) {
+	_drops++;
+	checked_output_push(1, p);
+	return false;
+    }
+    SET_IPSEC_SPI_ANNO(p, ntohl(esp->esp_spi));
+    SET_IPSEC_SA_DATA_REFERENCE_ANNO(p, (uintptr_t) sa);
+    return true;
+}
+
+void
+IPsecSAD::push(int, Packet *p)
+{
+    if (process(p))
+	output(0).push(p);
+}
+
+void
+IPsecSAD::bpush(int, PBatch *p)
+{
+    int k = 0;
+    for (int i = 0; i < p->npkts; ++i)
+	if (process(p->pptrs[i]))
+	    p->move_packet(i, k++, p->pptrs[i]);
+    p->npkts = k;
+    output(0).bpush(p);
+}
+
+enum { h_count, h_table, h_drops };
+
+int
+IPsecSAD::write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh)
+{
+    IPsecSAD *sad = static_cast<IPsecSAD *>(e);
+    return sad->change((intptr_t) thunk, str, errh);
+}
+
+String
+IPsecSAD::read_handler(Element *e, void *thunk)
+{
+    IPsecSAD *sad = static_cast<IPsecSAD *>(e);
+    switch ((intptr_t) thunk) {
+    case h_count:
+	return String(sad->_count);
+    case h_drops:
+	return String(sad->_drops.value());
+    default: {
+	StringAccum sa;
+	sad->_lock.acquire();
+	for (uint32_t i = 0; i < (1U << (32 - sad->_shift)); ++i)
+	    for (Entry *x = sad->_buckets[i]; x; x = x->next)
+		sa << x->spi << ' ' << x->sa.window.size() << ' '
+		   << x->sa.window.top() << ' ' << x->sa.packets << ' '
+		   << x->sa.bytes << ' ' << x->sa.replay_drops << '\n';
+	sad->_lock.release();
+	return sa.take_string();
+    }
+    }
+}
+
+int
+IPsecSAD::stats_handler(int, String &str, Element *e, const Handler *, ErrorHandler *errh)
+{
+    IPsecSAD *sad = static_cast<IPsecSAD *>(e);
+    uint32_t spi;
+    if (!IntArg().parse(cp_uncomment(str), spi))
+	return errh->error("expected SPI");
+    SADataTuple *sa = sad->lookup(spi);
+    if (!sa)
+	return errh->error("SPI %u not found", spi);
+    StringAccum sa_str;
+    sa_str << sa->packets << ' ' << sa->bytes << ' ' << sa->replay_drops;
+    str = sa_str.take_string();
+    return 0;
+}
+
+void
+IPsecSAD::add_handlers()
+{
+    add_write_handler("add", write_handler, CMD_ADD);
+    add_write_handler("rekey", write_handler, CMD_REKEY);
+    add_write_handler("remove", write_handler, CMD_REMOVE);
+    add_read_handler("count", read_handler, h_count);
+    add_read_handler("table", read_handler, h_table);
+    add_read_handler("drops", read_handler, h_drops);
+    set_handler("stats", Handler::OP_READ | Handler::READ_PARAM, stats_handler);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(IPsecSAD)
+ELEMENT_MT_SAFE(IPsecSAD)
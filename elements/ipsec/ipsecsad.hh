@@ -0,0 +1,175 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_IPSECSAD_HH
+#define CLICK_IPSECSAD_HH
+#include <click/element.hh>
+#include <click/atomic.hh>
+#include <click/sync.hh>
+#include <click/timestamp.hh>
+#include <click/pbatch.hh>
+#include "sadatatuple.hh"
+CLICK_DECLS
+
+/*
+=c
+
+IPsecSAD(SA1, SA2, ..., I<keywords> CAPACITY, WINDOW)
+
+=s ipsec
+
+security association database for incoming ESP
+
+=d
+
+IPsecSAD holds the security associations of incoming ESP tunnels, indexed
+by SPI, and attaches them to ESP packets.  Each input packet must start
+with an ESP header, as after Strip(20).  IPsecSAD looks up the packet's SPI,
+sets the SPI and SA annotations that IPsecESPCrypt, IPsecAuthHMACSHA1 and
+IPsecESPUnencap use, and emits the packet on output 0.  Packets with
+unknown SPIs, and packets whose sequence numbers the SA's anti-replay
+window already rejects, are emitted on output 1 if it exists and dropped
+otherwise.  This early check only saves the cost of authenticating obvious
+replays; the window itself advances when IPsecESPCrypt or IPsecESPUnencap
+accept an authenticated packet.  As RFC 4303 requires without extended
+sequence numbers, the window does not wrap: an SA nearing 2^32 packets must
+be rekeyed, and packets whose sequence numbers start over are rejected.
+
+Each SA argument is a space-separated list `C<SPI ENCRYPT_KEY AUTH_KEY
+[REPLAY [WINDOW]]>'.  The keys are 16 bytes, written for instance as
+C<\E<lt>0183A947 1ABE01FF FA04103B B1024A91<gt>>.  REPLAY is the first
+sequence number the sender uses, and defaults to 1.  WINDOW is the size of
+the SA's anti-replay window, from 64 to 1024 packets, and defaults to the
+WINDOW keyword.
+
+The table is a hash table with a fixed number of buckets, so lookups from
+any number of threads need no locks.  Handlers add, rekey and remove SAs
+while traffic flows: a new or rekeyed SA is fully built before it is linked
+into its bucket, and a replaced SA's memory is reused for other SAs only
+after a grace period, never freed while the router runs, so a packet whose
+annotation still refers to it at worst fails authentication.
+
+Keyword arguments are:
+
+=over 8
+
+=item CAPACITY
+
+Expected number of SAs.  The table has at least this many buckets; more SAs
+can be added, at the cost of longer chains.  Default is 4096.
+
+=item WINDOW
+
+Default anti-replay window size.  Default is 64.
+
+=back
+
+=h add write-only
+
+Adds an SA, written like a configuration argument.  Fails if the SPI is
+already in use.
+
+=h rekey write-only
+
+Replaces the keys of an existing SA, written like a configuration argument.
+The replacement starts a new sequence number space from REPLAY, with an
+empty window and zeroed counters.
+
+=h remove write-only
+
+Removes the SA with the given SPI.
+
+=h count read-only
+
+Number of SAs.
+
+=h stats read-only
+
+Takes an SPI and returns the SA's counters: accepted packets, accepted
+bytes, and packets rejected by the anti-replay window.
+
+=h table read-only
+
+One line per SA: SPI, window size, highest sequence number accepted, and
+the counters of the C<stats> handler.
+
+=h drops read-only
+
+Number of packets dropped for unknown SPIs or by the early replay check.
+
+=e
+
+  FromDevice(eth0) -> Classifier(12/0800 23/32) -> Strip(14)
+      -> CheckIPHeader -> StripIPHeader
+      -> sad :: IPsecSAD(234 ABCDEFFF001DEFD2 1122334455667788 1 256,
+                         CAPACITY 65536)
+      -> IPsecESPCrypt(false, cbc) -> ...
+
+=a IPsecESPCrypt, IPsecESPUnencap, IPsecAuthHMACSHA1, RadixIPsecLookup */
+
+class IPsecSAD : public Element { public:
+
+    IPsecSAD();
+    ~IPsecSAD();
+
+    const char *class_name() const	{ return "IPsecSAD"; }
+    const char *port_count() const	{ return "1/1-2"; }
+    const char *processing() const	{ return PUSH; }
+    void *cast(const char *name);
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    void cleanup(CleanupStage stage);
+    void add_handlers();
+
+    void push(int port, Packet *p);
+    void bpush(int port, PBatch *p);
+
+    // Returns the SA for spi, or null.  Safe to call from any thread.
+    inline SADataTuple *lookup(uint32_t spi) const;
+
+  private:
+
+    struct Entry {
+	Entry * volatile next;
+	uint32_t spi;
+	SADataTuple sa;
+	Entry *retired_next;
+	Timestamp retired;
+    };
+
+    enum { GRACE_SEC = 1 };
+    enum { CMD_ADD, CMD_REKEY, CMD_REMOVE };
+
+    Entry * volatile *_buckets;
+    int _shift;
+    uint32_t _count;
+    uint32_t _window;
+    Spinlock _lock;		// serializes writers
+    Entry *_retired_head;	// retired entries, oldest first
+    Entry *_retired_tail;
+    atomic_uint32_t _drops;
+
+    uint32_t bucket(uint32_t spi) const {
+	return (spi * 0x9E3779B1U) >> _shift;
+    }
+    Entry *alloc_entry();
+    void retire(Entry *e);
+    int parse_sa(const String &str, uint32_t &spi, SADataTuple &sa, ErrorHandler *errh);
+    int change(int command, const String &str, ErrorHandler *errh);
+    bool process(Packet *p);
+
+    static int write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh);
+    static String read_handler(Element *e, void *thunk);
+    static int stats_handler(int op, String &str, Element *e, const Handler *h, ErrorHandler *errh);
+
+};
+
+inline SADataTuple *
+IPsecSAD::lookup(uint32_t spi) const
+{
+    for (Entry *e = _buckets[bucket(spi)]; e; e = e->next)
+	if (e->spi == spi)
+	    return &e->sa;
+    return 0;
+}
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,621 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * mbhash.{cc,hh} -- multi-buffer SHA-1, SHA-256 and HMAC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "mbhash.hh"
+#include "sha256.hh"
+#include <click/glue.hh>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# define MBHASH_X86 1
+# include <immintrin.h>
+#endif
+CLICK_DECLS
+
+static const uint32_t sha1_initial[5] = {
+    0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0
+};
+
+static const uint32_t sha1_k[4] = {
+    0x5A827999, 0x6ED9EBA1, 0x8F1BBCDC, 0xCA62C1D6
+};
+
+static inline uint32_t
+load_be32(const unsigned char *p)
+{
+    return ((uint32_t) p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static inline uint32_t
+rol(uint32_t x, int n)
+{
+    return (x << n) | (x >> (32 - n));
+}
+
+static void
+sha1_compress(uint32_t state[5], const unsigned char *data, uint32_t nblocks)
+{
+    for (; nblocks; --nblocks, data += 64) {
+	uint32_t w[80];
+	for (int i = 0; i < 16; ++i)
+	    w[i] = load_be32(data + 4 * i);
+	for (int i = 16; i < 80; ++i)
+	    w[i] = rol(w[i-3] ^ w[i-8] ^ w[i-14] ^ w[i-16], 1);
+	uint32_t a = state[0], b = state[1], c = state[2], d = state[3],
+	    e = state[4];
+	for (int i = 0; i < 80; ++i) {
+	    uint32_t f;
+	    if (i < 20)
+		f = (b & c) | (~b & d);
+	    else if (i < 40 || i >= 60)
+		f = b ^ c ^ d;
+	    else
+		f = (b & c) | (b & d) | (c & d);
+	    uint32_t t = rol(a, 5) + f + e + sha1_k[i / 20] + w[i];
+	    e = d;
+	    d = c;
+	    c = rol(b, 30);
+	    b = a;
+	    a = t;
+	}
+	state[0] += a;
+	state[1] += b;
+	state[2] += c;
+	state[3] += d;
+	state[4] += e;
+    }
+}
+
+static inline void
+compress(int alg, uint32_t *state, const unsigned char *data, uint32_t nblocks)
+{
+    if (alg == MBHash::SHA1)
+	sha1_compress(state, data, nblocks);
+    else
+	SHA256::compress(state, data, nblocks);
+}
+
+namespace {
+// The blocks of one message: its full data blocks, then one or two blocks
+// that hold the rest of the data and the padding.
+struct Stream {
+    const unsigned char *data;
+    uint32_t nfull;
+    uint32_t ntail;
+    uint32_t tail_pos;
+    unsigned char tail[128];
+
+    void start(const HashJob &j) {
+	data = j.data;
+	nfull = j.len / 64;
+	uint32_t rem = j.len % 64;
+	memset(tail, 0, sizeof(tail));
+	memcpy(tail, j.data + nfull * 64, rem);
+	tail[rem] = 0x80;
+	ntail = (rem < 56 ? 1 : 2);
+	uint64_t bits = ((uint64_t) j.prefix + j.len) * 8;
+	for (int i = 0; i < 8; ++i)
+	    tail[ntail * 64 - 1 - i] = bits >> (8 * i);
+	tail_pos = 0;
+    }
+    bool done() const {
+	return !nfull && tail_pos == ntail;
+    }
+    const unsigned char *next() {
+	if (nfull) {
+	    --nfull;
+	    data += 64;
+	    return data - 64;
+	} else
+	    return tail + 64 * tail_pos++;
+    }
+};
+}
+
+void
+MBHash::init(int alg, uint32_t state[8])
+{
+    if (alg == SHA1)
+	memcpy(state, sha1_initial, sizeof(sha1_initial));
+    else
+	memcpy(state, SHA256::initial, 8 * sizeof(uint32_t));
+}
+
+void
+MBHash::digest(int alg, const uint32_t state[8], unsigned char *out)
+{
+    for (int i = 0; i < digest_size(alg) / 4; ++i) {
+	out[4*i] = state[i] >> 24;
+	out[4*i + 1] = state[i] >> 16;
+	out[4*i + 2] = state[i] >> 8;
+	out[4*i + 3] = state[i];
+    }
+}
+
+static void
+hash_portable(int alg, HashJob *jobs, int njobs)
+{
+    for (HashJob *j = jobs; j != jobs + njobs; ++j) {
+	Stream s;
+	s.start(*j);
+	compress(alg, j->state, j->data, s.nfull);
+	compress(alg, j->state, s.tail, s.ntail);
+    }
+}
+
+#if MBHASH_X86
+typedef uint32_t mbhash_v4 __attribute__((vector_size(16)));
+typedef uint32_t mbhash_v8 __attribute__((vector_size(32)));
+typedef uint32_t mbhash_v16 __attribute__((vector_size(64)));
+
+# define VROR(x, n)	(((x) >> (n)) | ((x) << (32 - (n))))
+# define VROL(x, n)	(((x) << (n)) | ((x) >> (32 - (n))))
+
+static const unsigned char zero_block[64] = { 0 };
+
+// Compresses one block per lane; st holds the lanes' states transposed,
+// so st[k][l] is word k of lane l.
+template <typename V, int L>
+static inline __attribute__((always_inline)) void
+sha1_lanes(V *st, const unsigned char *const *blk)
+{
+    V w[16];
+    for (int t = 0; t < 16; ++t)
+	for (int l = 0; l < L; ++l)
+	    w[t][l] = load_be32(blk[l] + 4 * t);
+    V a = st[0], b = st[1], c = st[2], d = st[3], e = st[4];
+    for (int t = 0; t < 80; ++t) {
+	if (t >= 16) {
+	    V x = w[(t + 13) & 15] ^ w[(t + 8) & 15] ^ w[(t + 2) & 15] ^ w[t & 15];
+	    w[t & 15] = VROL(x, 1);
+	}
+	V f;
+	if (t < 20)
+	    f = (b & c) | (~b & d);
+	else if (t < 40 || t >= 60)
+	    f = b ^ c ^ d;
+	else
+	    f = (b & c) | (b & d) | (c & d);
+	V x = VROL(a, 5) + f + e + sha1_k[t / 20] + w[t & 15];
+	e = d;
+	d = c;
+	c = VROL(b, 30);
+	b = a;
+	a = x;
+    }
+    st[0] += a;
+    st[1] += b;
+    st[2] += c;
+    st[3] += d;
+    st[4] += e;
+}
+
+template <typename V, int L>
+static inline __attribute__((always_inline)) void
+sha256_lanes(V *st, const unsigned char *const *blk)
+{
+    V w[16];
+    for (int t = 0; t < 16; ++t)
+	for (int l = 0; l < L; ++l)
+	    w[t][l] = load_be32(blk[l] + 4 * t);
+    V a = st[0], b = st[1], c = st[2], d = st[3],
+	e = st[4], f = st[5], g = st[6], h = st[7];
+    for (int t = 0; t < 64; ++t) {
+	if (t >= 16) {
+	    V w15 = w[(t + 1) & 15], w2 = w[(t + 14) & 15];
+	    w[t & 15] += (VROR(w15, 7) ^ VROR(w15, 18) ^ (w15 >> 3))
+		+ w[(t + 9) & 15] + (VROR(w2, 17) ^ VROR(w2, 19) ^ (w2 >> 10));
+	}
+	V t1 = h + (VROR(e, 6) ^ VROR(e, 11) ^ VROR(e, 25))
+	    + ((e & f) ^ (~e & g)) + SHA256::k[t] + w[t & 15];
+	V t2 = (VROR(a, 2) ^ VROR(a, 13) ^ VROR(a, 22))
+	    + ((a & b) ^ (a & c) ^ (b & c));
+	h = g;
+	g = f;
+	f = e;
+	e = d + t1;
+	d = c;
+	c = b;
+	b = a;
+	a = t1 + t2;
+    }
+    st[0] += a;
+    st[1] += b;
+    st[2] += c;
+    st[3] += d;
+    st[4] += e;
+    st[5] += f;
+    st[6] += g;
+    st[7] += h;
+}
+
+// Each lane hashes one message; when it finishes, the lane takes the next
+// message, and lanes with nothing left hash a dummy block.
+template <typename V, int L, int ALG>
+static inline __attribute__((always_inline)) void
+hash_lanes(HashJob *jobs, int njobs)
+{
+    enum { NW = (ALG == MBHash::SHA1 ? 5 : 8) };
+    Stream stream[L];
+    HashJob *job[L];
+    V st[NW];
+    int next = 0, active = 0;
+    for (int l = 0; l < L; ++l) {
+	job[l] = (next < njobs ? &jobs[next++] : 0);
+	if (job[l]) {
+	    stream[l].start(*job[l]);
+	    ++active;
+	}
+	for (int k = 0; k < NW; ++k)
+	    st[k][l] = (job[l] ? job[l]->state[k] : 0);
+    }
+
+    while (active) {
+	const unsigned char *blk[L];
+	for (int l = 0; l < L; ++l)
+	    blk[l] = (job[l] ? stream[l].next() : zero_block);
+	if (ALG == MBHash::SHA1)
+	    sha1_lanes<V, L>(st, blk);
+	else
+	    sha256_lanes<V, L>(st, blk);
+	for (int l = 0; l < L; ++l)
+	    if (job[l] && stream[l].done()) {
+		for (int k = 0; k < NW; ++k)
+		    job[l]->state[k] = st[k][l];
+		job[l] = 0;
+		--active;
+		if (next < njobs) {
+		    job[l] = &jobs[next++];
+		    stream[l].start(*job[l]);
+		    ++active;
+		    for (int k = 0; k < NW; ++k)
+			st[k][l] = job[l]->state[k];
+		}
+	    }
+    }
+}
+
+__attribute__((target("sse2"))) static void
+sha1_x4(HashJob *jobs, int njobs)
+{
+    hash_lanes<mbhash_v4, 4, MBHash::SHA1>(jobs, njobs);
+}
+
+__attribute__((target("sse2"))) static void
+sha256_x4(HashJob *jobs, int njobs)
+{
+    hash_lanes<mbhash_v4, 4, MBHash::SHA256>(jobs, njobs);
+}
+
+__attribute__((target("avx2"))) static void
+sha1_x8(HashJob *jobs, int njobs)
+{
+    hash_lanes<mbhash_v8, 8, MBHash::SHA1>(jobs, njobs);
+}
+
+__attribute__((target("avx2"))) static void
+sha256_x8(HashJob *jobs, int njobs)
+{
+    hash_lanes<mbhash_v8, 8, MBHash::SHA256>(jobs, njobs);
+}
+
+__attribute__((target("avx512f"))) static void
+sha1_x16(HashJob *jobs, int njobs)
+{
+    hash_lanes<mbhash_v16, 16, MBHash::SHA1>(jobs, njobs);
+}
+
+__attribute__((target("avx512f"))) static void
+sha256_x16(HashJob *jobs, int njobs)
+{
+    hash_lanes<mbhash_v16, 16, MBHash::SHA256>(jobs, njobs);
+}
+
+# define SHANI_TARGET __attribute__((target("sha,sse4.1")))
+
+// Rounds 4g to 4g+3 of SHA-1 for 4 <= g <= 16, following Intel's SHA
+// extensions reference code: ea receives E plus W[g], held in m, and the
+// schedule of the next three groups advances.
+# define SHA1NI_ROUNDS(ea, eb, m, mn, mp, mpp, f) do {	\
+	ea = _mm_sha1nexte_epu32(ea, m);		\
+	eb = abcd;					\
+	mn = _mm_sha1msg2_epu32(mn, m);			\
+	abcd = _mm_sha1rnds4_epu32(abcd, ea, f);	\
+	mp = _mm_sha1msg1_epu32(mp, m);			\
+	mpp = _mm_xor_si128(mpp, m);			\
+    } while (0)
+
+SHANI_TARGET static void
+sha1_shani(uint32_t *state, const unsigned char *data, uint32_t nblocks)
+{
+    const __m128i mask = _mm_set_epi64x(0x0001020304050607ULL, 0x08090A0B0C0D0E0FULL);
+    __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(state)), 0x1B);
+    __m128i e0 = _mm_set_epi32(state[4], 0, 0, 0), e1;
+    for (; nblocks; --nblocks, data += 64) {
+	__m128i abcd_save = abcd, e_save = e0;
+	const __m128i *d = reinterpret_cast<const __m128i *>(data);
+	__m128i m0 = _mm_shuffle_epi8(_mm_loadu_si128(d), mask);
+	__m128i m1 = _mm_shuffle_epi8(_mm_loadu_si128(d + 1), mask);
+	__m128i m2 = _mm_shuffle_epi8(_mm_loadu_si128(d + 2), mask);
+	__m128i m3 = _mm_shuffle_epi8(_mm_loadu_si128(d + 3), mask);
+
+	e0 = _mm_add_epi32(e0, m0);
+	e1 = abcd;
+	abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+
+	e1 = _mm_sha1nexte_epu32(e1, m1);
+	e0 = abcd;
+	abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+	m0 = _mm_sha1msg1_epu32(m0, m1);
+
+	e0 = _mm_sha1nexte_epu32(e0, m2);
+	e1 = abcd;
+	abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+	m1 = _mm_sha1msg1_epu32(m1, m2);
+	m0 = _mm_xor_si128(m0, m2);
+
+	SHA1NI_ROUNDS(e1, e0, m3, m0, m2, m1, 0);
+	SHA1NI_ROUNDS(e0, e1, m0, m1, m3, m2, 0);
+	SHA1NI_ROUNDS(e1, e0, m1, m2, m0, m3, 1);
+	SHA1NI_ROUNDS(e0, e1, m2, m3, m1, m0, 1);
+	SHA1NI_ROUNDS(e1, e0, m3, m0, m2, m1, 1);
+	SHA1NI_ROUNDS(e0, e1, m0, m1, m3, m2, 1);
+	SHA1NI_ROUNDS(e1, e0, m1, m2, m0, m3, 1);
+	SHA1NI_ROUNDS(e0, e1, m2, m3, m1, m0, 2);
+	SHA1NI_ROUNDS(e1, e0, m3, m0, m2, m1, 2);
+	SHA1NI_ROUNDS(e0, e1, m0, m1, m3, m2, 2);
+	SHA1NI_ROUNDS(e1, e0, m1, m2, m0, m3, 2);
+	SHA1NI_ROUNDS(e0, e1, m2, m3, m1, m0, 2);
+	SHA1NI_ROUNDS(e1, e0, m3, m0, m2, m1, 3);
+	SHA1NI_ROUNDS(e0, e1, m0, m1, m3, m2, 3);
+
+	e1 = _mm_sha1nexte_epu32(e1, m1);
+	e0 = abcd;
+	m2 = _mm_sha1msg2_epu32(m2, m1);
+	abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+	m3 = _mm_xor_si128(m3, m1);
+
+	e0 = _mm_sha1nexte_epu32(e0, m2);
+	e1 = abcd;
+	m3 = _mm_sha1msg2_epu32(m3, m2);
+	abcd = _mm_sha1rnds4_epu32(abcd, e0, 3);
+
+	e1 = _mm_sha1nexte_epu32(e1, m3);
+	e0 = abcd;
+	abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+
+	e0 = _mm_sha1nexte_epu32(e0, e_save);
+	abcd = _mm_add_epi32(abcd, abcd_save);
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(state), _mm_shuffle_epi32(abcd, 0x1B));
+    state[4] = _mm_extract_epi32(e0, 3);
+}
+
+// Four rounds of SHA-256; the state is kept as ABEF and CDGH.
+# define SHA256NI_ROUNDS(m, i) do {					\
+	__m128i x_ = _mm_add_epi32(m, _mm_loadu_si128(reinterpret_cast<const __m128i *>(SHA256::k + (i)))); \
+	s1 = _mm_sha256rnds2_epu32(s1, s0, x_);				\
+	s0 = _mm_sha256rnds2_epu32(s0, s1, _mm_shuffle_epi32(x_, 0x0E)); \
+    } while (0)
+// Computes the next four schedule words into m0 from the previous sixteen,
+// held in m0 to m3.
+# define SHA256NI_SCHEDULE(m0, m1, m2, m3)				\
+    m0 = _mm_sha256msg2_epu32(_mm_add_epi32(_mm_sha256msg1_epu32(m0, m1), \
+					    _mm_alignr_epi8(m3, m2, 4)), m3)
+
+SHANI_TARGET static void
+sha256_shani(uint32_t *state, const unsigned char *data, uint32_t nblocks)
+{
+    const __m128i mask = _mm_set_epi64x(0x0C0D0E0F08090A0BULL, 0x0405060700010203ULL);
+    __m128i t = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(state)), 0xB1);
+    __m128i s1 = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(state + 4)), 0x1B);
+    __m128i s0 = _mm_alignr_epi8(t, s1, 8);
+    s1 = _mm_blend_epi16(s1, t, 0xF0);
+    for (; nblocks; --nblocks, data += 64) {
+	__m128i s0_save = s0, s1_save = s1;
+	const __m128i *d = reinterpret_cast<const __m128i *>(data);
+	__m128i m0 = _mm_shuffle_epi8(_mm_loadu_si128(d), mask);
+	__m128i m1 = _mm_shuffle_epi8(_mm_loadu_si128(d + 1), mask);
+	__m128i m2 = _mm_shuffle_epi8(_mm_loadu_si128(d + 2), mask);
+	__m128i m3 = _mm_shuffle_epi8(_mm_loadu_si128(d + 3), mask);
+	SHA256NI_ROUNDS(m0, 0);
+	SHA256NI_ROUNDS(m1, 4);
+	SHA256NI_ROUNDS(m2, 8);
+	SHA256NI_ROUNDS(m3, 12);
+	for (int i = 16; i < 64; i += 16) {
+	    SHA256NI_SCHEDULE(m0, m1, m2, m3);
+	    SHA256NI_ROUNDS(m0, i);
+	    SHA256NI_SCHEDULE(m1, m2, m3, m0);
+	    SHA256NI_ROUNDS(m1, i + 4);
+	    SHA256NI_SCHEDULE(m2, m3, m0, m1);
+	    SHA256NI_ROUNDS(m2, i + 8);
+	    SHA256NI_SCHEDULE(m3, m0, m1, m2);
+	    SHA256NI_ROUNDS(m3, i + 12);
+	}
+	s0 = _mm_add_epi32(s0, s0_save);
+	s1 = _mm_add_epi32(s1, s1_save);
+    }
+    t = _mm_shuffle_epi32(s0, 0x1B);
+    s1 = _mm_shuffle_epi32(s1, 0xB1);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(state), _mm_blend_epi16(t, s1, 0xF0));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(state + 4), _mm_alignr_epi8(s1, t, 8));
+}
+
+static void
+hash_shani(int alg, HashJob *jobs, int njobs)
+{
+    for (HashJob *j = jobs; j != jobs + njobs; ++j) {
+	Stream s;
+	s.start(*j);
+	if (alg == MBHash::SHA1) {
+	    sha1_shani(j->state, j->data, s.nfull);
+	    sha1_shani(j->state, s.tail, s.ntail);
+	} else {
+	    sha256_shani(j->state, j->data, s.nfull);
+	    sha256_shani(j->state, s.tail, s.ntail);
+	}
+    }
+}
+#endif
+
+#if MBHASH_X86
+static bool
+have_shani()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sha") && __builtin_cpu_supports("sse4.1");
+}
+#endif
+
+int
+MBHash::best_impl()
+{
+#if MBHASH_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+	return IMPL_AVX512;
+    else if (have_shani())
+	return IMPL_SHANI;
+    else if (__builtin_cpu_supports("avx2"))
+	return IMPL_AVX2;
+    else if (__builtin_cpu_supports("sse2"))
+	return IMPL_SSE2;
+#endif
+    return IMPL_PORTABLE;
+}
+
+const char *
+MBHash::impl_name(int impl)
+{
+    switch (impl) {
+    case IMPL_SSE2:
+	return "sse2";
+    case IMPL_AVX2:
+	return "avx2";
+    case IMPL_AVX512:
+	return "avx512";
+    case IMPL_SHANI:
+	return "shani";
+    default:
+	return "portable";
+    }
+}
+
+void
+MBHash::hash(int alg, HashJob *jobs, int njobs, int impl)
+{
+#if MBHASH_X86
+    // A few messages would leave most lanes of a wide vector idle; SHA-NI
+    // hashes them faster, one at a time.
+    if (impl == IMPL_AVX512 && njobs < 12)
+	impl = (have_shani() ? IMPL_SHANI : IMPL_AVX2);
+    if (impl == IMPL_AVX2 && njobs < 6)
+	impl = IMPL_SSE2;
+    if (impl == IMPL_SSE2 && njobs < 2)
+	impl = IMPL_PORTABLE;
+    switch (impl) {
+    case IMPL_SHANI:
+	hash_shani(alg, jobs, njobs);
+	return;
+    case IMPL_AVX512:
+	(alg == SHA1 ? sha1_x16 : sha256_x16)(jobs, njobs);
+	return;
+    case IMPL_AVX2:
+	(alg == SHA1 ? sha1_x8 : sha256_x8)(jobs, njobs);
+	return;
+    case IMPL_SSE2:
+	(alg == SHA1 ? sha1_x4 : sha256_x4)(jobs, njobs);
+	return;
+    }
+#endif
+    hash_portable(alg, jobs, njobs);
+}
+
+void
+HMACKey::set(int alg, const unsigned char *key, uint32_t len)
+{
+    unsigned char k[MBHash::BLOCK_SIZE], pad[MBHash::BLOCK_SIZE];
+    memset(k, 0, sizeof(k));
+    if (len > MBHash::BLOCK_SIZE) {
+	HashJob j;
+	MBHash::init(alg, j.state);
+	j.data = key;
+	j.len = len;
+	j.prefix = 0;
+	MBHash::hash(alg, &j, 1, MBHash::IMPL_PORTABLE);
+	MBHash::digest(alg, j.state, k);
+    } else
+	memcpy(k, key, len);
+
+    _alg = alg;
+    for (int i = 0; i < MBHash::BLOCK_SIZE; ++i)
+	pad[i] = k[i] ^ 0x36;
+    MBHash::init(alg, _inner);
+    compress(alg, _inner, pad, 1);
+    for (int i = 0; i < MBHash::BLOCK_SIZE; ++i)
+	pad[i] = k[i] ^ 0x5C;
+    MBHash::init(alg, _outer);
+    compress(alg, _outer, pad, 1);
+}
+
+// Hashes the messages, then the inner digests, each in one multi-buffer
+// pass.  The key pads were absorbed by HMACKey::set.
+void
+MBHash::hmac_alg(int alg, HMACJob *jobs, int njobs, int impl)
+{
+    int dsize = digest_size(alg);
+    for (int i = 0; i < njobs; ) {
+	HashJob hj[HMAC_BURST];
+	HMACJob *hmj[HMAC_BURST];
+	unsigned char inner[HMAC_BURST][SHA256_SIZE];
+	int n = 0;
+	for (; i < njobs && n < HMAC_BURST; ++i)
+	    if (jobs[i].key->alg() == alg) {
+		hmj[n] = &jobs[i];
+		memcpy(hj[n].state, jobs[i].key->_inner, sizeof(hj[n].state));
+		hj[n].data = jobs[i].data;
+		hj[n].len = jobs[i].len;
+		hj[n].prefix = BLOCK_SIZE;
+		++n;
+	    }
+	hash(alg, hj, n, impl);
+	for (int j = 0; j < n; ++j) {
+	    digest(alg, hj[j].state, inner[j]);
+	    memcpy(hj[j].state, hmj[j]->key->_outer, sizeof(hj[j].state));
+	    hj[j].data = inner[j];
+	    hj[j].len = dsize;
+	}
+	hash(alg, hj, n, impl);
+	for (int j = 0; j < n; ++j) {
+	    unsigned char mac[SHA256_SIZE];
+	    digest(alg, hj[j].state, mac);
+	    memcpy(hmj[j]->mac, mac, hmj[j]->mac_len);
+	}
+    }
+}
+
+void
+MBHash::hmac(HMACJob *jobs, int njobs, int impl)
+{
+    bool alg[2] = { false, false };
+    for (int i = 0; i < njobs; ++i)
+	alg[jobs[i].key->alg()] = true;
+    for (int a = SHA1; a <= SHA256; ++a)
+	if (alg[a])
+	    hmac_alg(a, jobs, njobs, impl);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel SHA256)
+ELEMENT_PROVIDES(MBHash)
@@ -0,0 +1,98 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_MBHASH_HH
+#define CLICK_MBHASH_HH
+#include <click/glue.hh>
+CLICK_DECLS
+
+/*
+ * =c
+ * MBHash
+ * =s ipsec
+ * multi-buffer SHA-1, SHA-256 and HMAC for IPsec
+ * =d
+ *
+ * Not an element.  MBHash hashes many independent messages at once, as
+ * IPsecAuthHMACSHA1 and IPsecESPCrypt do for the packets of a burst or
+ * batch.  With SSE2, AVX2 or AVX-512, each SIMD lane hashes a different
+ * message, so 4, 8 or 16 packets advance one block per step.  A lane whose
+ * message ends takes the next message at once, so packets of different
+ * lengths share the lanes well.  On CPUs with the SHA extensions, messages
+ * are hashed one at a time with SHA-NI unless AVX-512 is also available;
+ * then SHA-NI takes only batches too short to fill the 16 lanes.
+ *
+ * HMACKey holds an HMAC key's precomputed inner and outer states (RFC
+ * 2104), and MBHash::hmac authenticates many messages in two multi-buffer
+ * passes.
+ *
+ * =a IPsecAuthHMACSHA1, IPsecESPCrypt, SHA256
+ */
+
+// One message of a multi-buffer call.  state is the initial chaining value
+// on input and the final one on output; prefix is the number of bytes, a
+// multiple of 64, already absorbed into state, for the length padding.
+struct HashJob {
+    uint32_t state[8];
+    const unsigned char *data;
+    uint32_t len;
+    uint32_t prefix;
+};
+
+class HMACKey { public:
+
+    HMACKey()
+	: _alg(-1) {
+    }
+
+    void set(int alg, const unsigned char *key, uint32_t len);
+
+    int alg() const {
+	return _alg;
+    }
+
+  private:
+
+    int _alg;
+    uint32_t _inner[8];
+    uint32_t _outer[8];
+
+    friend class MBHash;
+
+};
+
+struct HMACJob {
+    const HMACKey *key;
+    const unsigned char *data;
+    uint32_t len;
+    unsigned char *mac;		// receives the first mac_len bytes
+    int mac_len;
+};
+
+class MBHash { public:
+
+    enum { SHA1, SHA256 };
+    enum { SHA1_SIZE = 20, SHA256_SIZE = 32, BLOCK_SIZE = 64 };
+    enum { IMPL_PORTABLE, IMPL_SSE2, IMPL_AVX2, IMPL_AVX512, IMPL_SHANI };
+
+    // Returns the fastest implementation this CPU supports.
+    static int best_impl();
+    static const char *impl_name(int impl);
+
+    static int digest_size(int alg) {
+	return alg == SHA1 ? SHA1_SIZE : SHA256_SIZE;
+    }
+    static void init(int alg, uint32_t state[8]);
+    static void digest(int alg, const uint32_t state[8], unsigned char *out);
+
+    static void hash(int alg, HashJob *jobs, int njobs, int impl);
+    static void hmac(HMACJob *jobs, int njobs, int impl);
+
+  private:
+
+    enum { HMAC_BURST = 32 };
+
+    static void hmac_alg(int alg, HMACJob *jobs, int njobs, int impl);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,107 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_REPLAYWINDOW_HH
+#define CLICK_REPLAYWINDOW_HH
+#include <click/glue.hh>
+CLICK_DECLS
+
+/*
+ * replaywindow.hh -- ESP anti-replay sliding window
+ *
+ * ReplayWindow remembers which of the last size() sequence numbers have
+ * been received (RFC 4303 section 3.4.3), for windows of 64 to 1024
+ * packets.  The bitmap is a ring of 64-bit words (RFC 6479): sliding the
+ * window forward clears the words it passes over instead of shifting the
+ * whole bitmap, so each packet costs O(1) whatever the window size.
+ *
+ * Sequence numbers never wrap.  Without extended sequence numbers, RFC 4303
+ * requires the SA to be rekeyed before the 32-bit counter cycles, so once
+ * the top nears 2^32, numbers from the start of the sequence are rejected
+ * like any other packet below the window; rekeying calls init() again.
+ *
+ * ReplayWindow is not synchronized; SADataTuple::accept() locks it.
+ */
+
+class ReplayWindow { public:
+
+    enum { MIN_SIZE = 64, MAX_SIZE = 1024 };
+
+    // Rounds size up to a multiple of 64 within [MIN_SIZE, MAX_SIZE].
+    inline void init(uint32_t size, uint32_t start);
+
+    uint32_t size() const	{ return _size; }
+    uint32_t top() const	{ return _top; }
+
+    // Returns true if seq would be accepted, without recording it.
+    inline bool check(uint32_t seq) const;
+    // Returns true and records seq if it is new and inside the window.
+    inline bool update(uint32_t seq);
+
+  private:
+
+    enum { WORDS = MAX_SIZE / 64 + 1 };
+
+    uint32_t _size;
+    uint32_t _nwords;
+    uint32_t _top;
+    uint64_t _bits[WORDS];
+
+    uint64_t &word(uint32_t seq) {
+	return _bits[(seq / 64) % _nwords];
+    }
+    uint64_t word(uint32_t seq) const {
+	return _bits[(seq / 64) % _nwords];
+    }
+
+};
+
+inline void
+ReplayWindow::init(uint32_t size, uint32_t start)
+{
+    if (size < MIN_SIZE)
+	size = MIN_SIZE;
+    else if (size > MAX_SIZE)
+	size = MAX_SIZE;
+    _size = (size + 63) & ~63U;
+    _nwords = _size / 64 + 1;
+    _top = start;
+    memset(_bits, 0, sizeof(_bits));
+}
+
+inline bool
+ReplayWindow::check(uint32_t seq) const
+{
+    if (seq == 0)
+	return false;
+    else if (seq > _top)
+	return true;
+    else if (_top - seq >= _size)
+	return false;
+    else
+	return !(word(seq) & (1ULL << (seq % 64)));
+}
+
+inline bool
+ReplayWindow::update(uint32_t seq)
+{
+    if (seq == 0)
+	return false;
+    else if (seq > _top) {
+	uint32_t from = _top / 64 + 1, to = seq / 64;
+	if (to - from + 1 >= _nwords)
+	    memset(_bits, 0, sizeof(_bits));
+	else
+	    for (uint32_t w = from; w <= to; ++w)
+		_bits[w % _nwords] = 0;
+	_top = seq;
+    } else if (_top - seq >= _size)
+	return false;
+    uint64_t &w = word(seq);
+    uint64_t bit = 1ULL << (seq % 64);
+    if (w & bit)
+	return false;
+    w |= bit;
+    return true;
+}
+
+CLICK_ENDDECLS
+#endif
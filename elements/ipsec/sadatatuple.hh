@@ -5,6 +5,8 @@
 #include <click/etheraddress.hh>
 #include <click/bighashmap.hh>
 #include <click/glue.hh>
+#include <click/sync.hh>
+#include "replaywindow.hh"
 CLICK_DECLS
 
 /*
@@ -78,22 +80,46 @@ class SADataTuple {
     uint32_t replay_start_counter;
     uint32_t cur_rpl;
     uint8_t  ooowin;	/* out-of-order window size */
-    uint32_t bitmap;	/* Support out-of-order receive support */
-    uint32_t lastseq;	/* in host order */
-
+    ReplayWindow window;	/* anti-replay window, in host order */
+    SimpleSpinlock lock;	/* protects window and the counters below */
+    uint64_t packets;	/* packets accepted by the window */
+    uint64_t bytes;
+    uint32_t replay_drops;
+    uint64_t iv_counter;	/* last IV used by IPsecESPCrypt, atomic */
+
+    // The zeroed lock is released.
     SADataTuple() {
-	memset(this, 0, sizeof(*this));
+	memset((void *) this, 0, sizeof(*this));
+	window.init(0, 0);
     }
 
     SADataTuple(const void * enc_key , const void * Auth_key, uint32_t counter, uint8_t o_oowin)
      {
-		memset(this, 0, sizeof(*this));
+		memset((void *) this, 0, sizeof(*this));
 		memcpy(Encryption_key, enc_key, KEY_SIZE);
 		memcpy(Authentication_key, Auth_key, KEY_SIZE);
 		replay_start_counter = counter;
 		ooowin = o_oowin;
-	        bitmap=0;
-		lastseq=cur_rpl=counter;
+		window.init(o_oowin, counter);
+		cur_rpl=counter;
+		// Statically configured keys survive restarts, so a counter
+		// starting at 0 would repeat GCM nonces.
+		iv_counter = ((uint64_t) click_random() << 32) | click_random();
+     }
+
+     /* Checks an authenticated packet's sequence number against the replay
+        window and counts it; returns false if it is a replay. */
+     bool accept(uint32_t seq, uint32_t len)
+     {
+	lock.acquire();
+	bool ok = window.update(seq);
+	if (ok) {
+	    packets++;
+	    bytes += len;
+	} else
+	    replay_drops++;
+	lock.release();
+	return ok;
      }
 
      operator bool() const
@@ -0,0 +1,137 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * sha256.{cc,hh} -- SHA-256
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "sha256.hh"
+#include <click/glue.hh>
+CLICK_DECLS
+
+const uint32_t SHA256::k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+const uint32_t SHA256::initial[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+static inline uint32_t
+ror(uint32_t x, int n)
+{
+    return (x >> n) | (x << (32 - n));
+}
+
+void
+SHA256::compress(uint32_t state[8], const unsigned char *data, uint32_t nblocks)
+{
+    for (; nblocks; --nblocks, data += BLOCK_SIZE) {
+	uint32_t w[64];
+	for (int i = 0; i < 16; ++i)
+	    w[i] = ((uint32_t) data[4*i] << 24) | (data[4*i + 1] << 16)
+		| (data[4*i + 2] << 8) | data[4*i + 3];
+	for (int i = 16; i < 64; ++i) {
+	    uint32_t s0 = ror(w[i-15], 7) ^ ror(w[i-15], 18) ^ (w[i-15] >> 3);
+	    uint32_t s1 = ror(w[i-2], 17) ^ ror(w[i-2], 19) ^ (w[i-2] >> 10);
+	    w[i] = w[i-16] + s0 + w[i-7] + s1;
+	}
+	uint32_t a = state[0], b = state[1], c = state[2], d = state[3],
+	    e = state[4], f = state[5], g = state[6], h = state[7];
+	for (int i = 0; i < 64; ++i) {
+	    uint32_t t1 = h + (ror(e, 6) ^ ror(e, 11) ^ ror(e, 25))
+		+ ((e & f) ^ (~e & g)) + k[i] + w[i];
+	    uint32_t t2 = (ror(a, 2) ^ ror(a, 13) ^ ror(a, 22))
+		+ ((a & b) ^ (a & c) ^ (b & c));
+	    h = g;
+	    g = f;
+	    f = e;
+	    e = d + t1;
+	    d = c;
+	    c = b;
+	    b = a;
+	    a = t1 + t2;
+	}
+	state[0] += a;
+	state[1] += b;
+	state[2] += c;
+	state[3] += d;
+	state[4] += e;
+	state[5] += f;
+	state[6] += g;
+	state[7] += h;
+    }
+}
+
+void
+SHA256::reset()
+{
+    memcpy(_state, initial, sizeof(_state));
+    _len = 0;
+}
+
+void
+SHA256::update(const unsigned char *data, uint32_t len)
+{
+    uint32_t used = _len % BLOCK_SIZE;
+    _len += len;
+    if (used) {
+	uint32_t n = BLOCK_SIZE - used;
+	if (len < n) {
+	    memcpy(_buf + used, data, len);
+	    return;
+	}
+	memcpy(_buf + used, data, n);
+	compress(_state, _buf, 1);
+	data += n;
+	len -= n;
+    }
+    compress(_state, data, len / BLOCK_SIZE);
+    memcpy(_buf, data + len - len % BLOCK_SIZE, len % BLOCK_SIZE);
+}
+
+void
+SHA256::final(unsigned char digest[DIGEST_SIZE])
+{
+    uint64_t bits = _len * 8;
+    uint32_t used = _len % BLOCK_SIZE;
+    _buf[used++] = 0x80;
+    if (used > BLOCK_SIZE - 8) {
+	memset(_buf + used, 0, BLOCK_SIZE - used);
+	compress(_state, _buf, 1);
+	used = 0;
+    }
+    memset(_buf + used, 0, BLOCK_SIZE - 8 - used);
+    for (int i = 0; i < 8; ++i)
+	_buf[BLOCK_SIZE - 1 - i] = bits >> (8 * i);
+    compress(_state, _buf, 1);
+    for (int i = 0; i < 8; ++i) {
+	digest[4*i] = _state[i] >> 24;
+	digest[4*i + 1] = _state[i] >> 16;
+	digest[4*i + 2] = _state[i] >> 8;
+	digest[4*i + 3] = _state[i];
+    }
+}
+
+CLICK_ENDDECLS
+ELEMENT_PROVIDES(SHA256)
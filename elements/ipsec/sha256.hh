@@ -0,0 +1,47 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_IPSEC_SHA256_HH
+#define CLICK_IPSEC_SHA256_HH
+#include <click/glue.hh>
+CLICK_DECLS
+
+/*
+ * =c
+ * SHA256
+ * =s ipsec
+ * SHA-256 for IPsec
+ * =d
+ *
+ * Not an element.  SHA256 hashes a message incrementally (FIPS 180-4).
+ * MBHash uses its compression function on CPUs without SIMD support.
+ *
+ * =a MBHash
+ */
+
+class SHA256 { public:
+
+    enum { DIGEST_SIZE = 32, BLOCK_SIZE = 64 };
+
+    SHA256() {
+	reset();
+    }
+
+    void reset();
+    void update(const unsigned char *data, uint32_t len);
+    void final(unsigned char digest[DIGEST_SIZE]);
+
+    // Compresses nblocks 64-byte blocks into state.
+    static void compress(uint32_t state[8], const unsigned char *data, uint32_t nblocks);
+
+    static const uint32_t initial[8];
+    static const uint32_t k[64];
+
+  private:
+
+    uint32_t _state[8];
+    uint64_t _len;
+    unsigned char _buf[BLOCK_SIZE];
+
+};
+
+CLICK_ENDDECLS
+#endif
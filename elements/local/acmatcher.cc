@@ -0,0 +1,251 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * acmatcher.{cc,hh} -- Aho-Corasick multi-pattern matcher
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "acmatcher.hh"
+#include <click/glue.hh>
+CLICK_DECLS
+
+static inline unsigned char
+fold(unsigned char c)
+{
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+ACMatcher::ACMatcher()
+    : _nclasses(0), _nstates(0), _ndense(0), _wide(false), _dense(0)
+{
+    memset(_class, 0, sizeof(_class));
+}
+
+ACMatcher::~ACMatcher()
+{
+    clear();
+}
+
+void
+ACMatcher::clear()
+{
+    _patterns.clear();
+    delete[] static_cast<uint32_t *>(_dense);
+    _dense = 0;
+    _nclasses = _nstates = _ndense = 0;
+    _sparse_first.clear();
+    _sparse_class.clear();
+    _sparse_entry.clear();
+    _fail.clear();
+    _out_first.clear();
+    _out.clear();
+}
+
+int
+ACMatcher::add_pattern(const String &pattern, bool nocase)
+{
+    if (!pattern || compiled())
+	return -1;
+    Pattern p;
+    p.str = pattern;
+    p.nocase = nocase;
+    _patterns.push_back(p);
+    return _patterns.size() - 1;
+}
+
+size_t
+ACMatcher::dense_bytes() const
+{
+    return (size_t) _ndense * _nclasses * (_wide ? 4 : 2);
+}
+
+size_t
+ACMatcher::sparse_bytes() const
+{
+    return _sparse_first.size() * sizeof(uint32_t)
+	+ _sparse_class.size() * (sizeof(uint8_t) + sizeof(uint32_t))
+	+ _fail.size() * sizeof(uint32_t);
+}
+
+uint32_t
+ACMatcher::sparse_step(uint32_t state, int c) const
+{
+    while (state >= (uint32_t) _ndense) {
+	uint32_t s = state - _ndense;
+	for (uint32_t k = _sparse_first[s]; k != _sparse_first[s + 1]; ++k)
+	    if (_sparse_class[k] == c)
+		return _sparse_entry[k];
+	    else if (_sparse_class[k] > c)
+		break;
+	state = _fail[s];
+    }
+    return step(state, c);
+}
+
+namespace {
+struct TrieNode {
+    int first_child;
+    int next_sibling;
+    int fail;
+    int own_out;		// first pattern ending here, chained by next_out
+    uint8_t cls;
+    TrieNode(uint8_t c)
+	: first_child(-1), next_sibling(-1), fail(0), own_out(-1), cls(c) {
+    }
+};
+
+inline int
+trie_child(const Vector<TrieNode> &trie, int n, int c)
+{
+    for (int k = trie[n].first_child; k >= 0; k = trie[k].next_sibling)
+	if (trie[k].cls == c)
+	    return k;
+    return -1;
+}
+}
+
+int
+ACMatcher::compile(size_t dense_budget)
+{
+    if (compiled())
+	return 0;
+
+    // Compress the alphabet.  Folding leaves at most 230 distinct bytes, so
+    // the classes fit in a byte with class 0 left for unused bytes.
+    bool used[256];
+    memset(used, 0, sizeof(used));
+    for (Pattern *p = _patterns.begin(); p != _patterns.end(); ++p)
+	for (const char *s = p->str.begin(); s != p->str.end(); ++s)
+	    used[fold(*s)] = true;
+    uint8_t fclass[256];
+    _nclasses = 1;
+    for (int c = 0; c < 256; ++c)
+	fclass[c] = used[c] ? _nclasses++ : 0;
+    for (int c = 0; c < 256; ++c)
+	_class[c] = fclass[fold(c)];
+
+    // Build the trie.
+    Vector<TrieNode> trie;
+    Vector<int> next_out(_patterns.size(), -1);
+    trie.push_back(TrieNode(0));
+    for (int id = 0; id < _patterns.size(); ++id) {
+	const String &str = _patterns[id].str;
+	int n = 0;
+	for (const char *s = str.begin(); s != str.end(); ++s) {
+	    int c = _class[(unsigned char) *s];
+	    int k = trie_child(trie, n, c);
+	    if (k < 0) {
+		k = trie.size();
+		trie.push_back(TrieNode(c));
+		trie[k].next_sibling = trie[n].first_child;
+		trie[n].first_child = k;
+	    }
+	    n = k;
+	}
+	next_out[id] = trie[n].own_out;
+	trie[n].own_out = id;
+    }
+    if (trie.size() >= (int) (OUT_BIT >> 1))
+	return -ENOMEM;
+
+    // Number states breadth-first and compute failure links.
+    Vector<int> order, stateof(trie.size(), 0);
+    order.reserve(trie.size());
+    order.push_back(0);
+    for (int i = 0; i < order.size(); ++i) {
+	int n = order[i];
+	stateof[n] = i;
+	for (int k = trie[n].first_child; k >= 0; k = trie[k].next_sibling) {
+	    if (n != 0) {
+		int f = trie[n].fail, x;
+		while ((x = trie_child(trie, f, trie[k].cls)) < 0 && f != 0)
+		    f = trie[f].fail;
+		trie[k].fail = x >= 0 ? x : 0;
+	    }
+	    order.push_back(k);
+	}
+    }
+    _nstates = order.size();
+
+    // Collect outputs, inheriting those of the failure state.
+    _out_first.assign(_nstates + 1, 0);
+    for (int i = 0; i < _nstates; ++i) {
+	int n = order[i];
+	_out_first[i] = _out.size();
+	for (int id = trie[n].own_out; id >= 0; id = next_out[id])
+	    _out.push_back(id);
+	if (n != 0) {
+	    int f = stateof[trie[n].fail];
+	    for (uint32_t k = _out_first[f]; k != _out_first[f + 1]; ++k)
+		_out.push_back(_out[k]);
+	}
+    }
+    _out_first[_nstates] = _out.size();
+
+    // Lay out the shallow states as full rows.
+    _wide = _nstates > (int) OUT_BIT16;
+    size_t row_bytes = (size_t) _nclasses * (_wide ? 4 : 2);
+    size_t ndense = dense_budget / row_bytes;
+    _ndense = ndense < 1 ? 1 : (ndense > (size_t) _nstates ? _nstates : (int) ndense);
+    size_t nentries = (size_t) _ndense * _nclasses;
+    uint32_t *rows = new uint32_t[(nentries * (_wide ? 4 : 2) + 3) / 4];
+    if (!rows)
+	return -ENOMEM;
+    _dense = rows;
+    Vector<uint32_t> row(_nclasses, 0);
+    for (int i = 0; i < _ndense; ++i) {
+	int n = order[i];
+	if (n == 0)
+	    row.assign(_nclasses, 0);
+	else {
+	    int f = stateof[trie[n].fail];
+	    for (int c = 0; c < _nclasses; ++c)
+		row[c] = step(f, c);
+	}
+	for (int k = trie[n].first_child; k >= 0; k = trie[k].next_sibling) {
+	    uint32_t s = stateof[k];
+	    row[trie[k].cls] = s | (_out_first[s] != _out_first[s + 1] ? (uint32_t) OUT_BIT : 0);
+	}
+	for (int c = 0; c < _nclasses; ++c)
+	    if (_wide)
+		rows[i * _nclasses + c] = row[c];
+	    else
+		reinterpret_cast<uint16_t *>(rows)[i * _nclasses + c] =
+		    (row[c] & ~OUT_BIT) | ((row[c] & OUT_BIT) >> 16);
+    }
+
+    // Deeper states keep their trie edges, sorted by class.
+    _sparse_first.assign(_nstates - _ndense + 1, 0);
+    _fail.assign(_nstates - _ndense, 0);
+    for (int i = _ndense; i < _nstates; ++i) {
+	int n = order[i];
+	_sparse_first[i - _ndense] = _sparse_class.size();
+	_fail[i - _ndense] = stateof[trie[n].fail];
+	int first = _sparse_class.size();
+	for (int k = trie[n].first_child; k >= 0; k = trie[k].next_sibling) {
+	    uint32_t s = stateof[k];
+	    uint32_t e = s | (_out_first[s] != _out_first[s + 1] ? (uint32_t) OUT_BIT : 0);
+	    int j = _sparse_class.size();
+	    _sparse_class.push_back(trie[k].cls);
+	    _sparse_entry.push_back(e);
+	    for (; j > first && _sparse_class[j - 1] > _sparse_class[j]; --j) {
+		click_swap(_sparse_class[j - 1], _sparse_class[j]);
+		click_swap(_sparse_entry[j - 1], _sparse_entry[j]);
+	    }
+	}
+    }
+    _sparse_first[_nstates - _ndense] = _sparse_class.size();
+    return 0;
+}
+
+CLICK_ENDDECLS
+ELEMENT_PROVIDES(ACMatcher)
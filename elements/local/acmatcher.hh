@@ -0,0 +1,168 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_ACMATCHER_HH
+#define CLICK_ACMATCHER_HH
+#include <click/string.hh>
+#include <click/vector.hh>
+#include <string.h>
+CLICK_DECLS
+
+/** @class ACMatcher
+ * @brief Aho-Corasick multi-pattern matcher.
+ *
+ * An ACMatcher finds every occurrence of a set of byte-string patterns in a
+ * buffer in one pass.  Add patterns with add_pattern(), call compile(), then
+ * call scan() on each buffer.
+ *
+ * The compiled automaton is a DFA over a compressed alphabet: bytes that
+ * appear in no pattern share one input class, and upper- and lowercase
+ * letters share a class.  Case-sensitive patterns are checked against the
+ * original bytes when the DFA reports them.  States are numbered in
+ * breadth-first order, so the shallow states where scans spend most of their
+ * time come first.  Those states get full transition rows, as many as fit in
+ * the byte budget passed to compile(); deeper states store only their trie
+ * edges and fall back along failure links.  Transition entries are 16 bits
+ * wide when the automaton has fewer than 32768 states. */
+class ACMatcher { public:
+
+    ACMatcher();
+    ~ACMatcher();
+
+    /** @brief Add a pattern and return its ID.
+     * @param pattern non-empty pattern bytes
+     * @param nocase if true, match letters regardless of case
+     *
+     * IDs are assigned consecutively from 0.  Returns -1 if @a pattern is
+     * empty or the matcher is already compiled. */
+    int add_pattern(const String &pattern, bool nocase = false);
+
+    /** @brief Build the automaton.
+     * @param dense_budget bytes allowed for full transition rows
+     * @return 0 on success, -ENOMEM on failure */
+    int compile(size_t dense_budget = 256 * 1024);
+
+    /** @brief Remove all patterns and the automaton. */
+    void clear();
+
+    bool compiled() const		{ return _nstates > 0; }
+    int npatterns() const		{ return _patterns.size(); }
+    const String &pattern(int id) const	{ return _patterns[id].str; }
+    bool pattern_nocase(int id) const	{ return _patterns[id].nocase; }
+
+    int nstates() const			{ return _nstates; }
+    int nclasses() const		{ return _nclasses; }
+    int ndense() const			{ return _ndense; }
+    size_t dense_bytes() const;
+    size_t sparse_bytes() const;
+
+    /** @brief Report every pattern occurrence in @a data.
+     * @param data buffer
+     * @param len buffer length
+     * @param f callback
+     *
+     * Calls @a f(id, end) for each occurrence, where @a id is the pattern ID
+     * and @a end is the offset just past the occurrence.  Occurrences are
+     * reported in order of @a end. */
+    template <typename F> inline void scan(const unsigned char *data, int len, F &f) const;
+
+    /** @brief Report occurrences from @a pos until the automaton is idle.
+     * @param data buffer
+     * @param pos offset to start from, with no match in progress
+     * @param len buffer length
+     * @param f callback, as for scan()
+     * @return offset just past the first byte after which no match is in
+     * progress, or @a len
+     *
+     * Since no occurrence can start before the returned offset without
+     * having been reported, a caller can skip ahead from there, for instance
+     * with a LiteralPrefilter, and call scan_run() again. */
+    template <typename F> inline int scan_run(const unsigned char *data, int pos, int len, F &f) const;
+
+  private:
+
+    enum { OUT_BIT = 0x80000000U, OUT_BIT16 = 0x8000 };
+
+    struct Pattern {
+	String str;
+	bool nocase;
+    };
+
+    Vector<Pattern> _patterns;
+    uint8_t _class[256];
+    int _nclasses;
+    int _nstates;
+    int _ndense;
+    bool _wide;
+    void *_dense;
+
+    // states _ndense and up, indexed by state - _ndense
+    Vector<uint32_t> _sparse_first;
+    Vector<uint8_t> _sparse_class;
+    Vector<uint32_t> _sparse_entry;
+    Vector<uint32_t> _fail;
+
+    // all patterns ending at each state, including via failure links
+    Vector<uint32_t> _out_first;
+    Vector<int> _out;
+
+    inline uint32_t step(uint32_t state, int c) const;
+    uint32_t sparse_step(uint32_t state, int c) const;
+    template <typename F> void report(uint32_t state, const unsigned char *data, int end, F &f) const;
+
+    ACMatcher(const ACMatcher &);
+    ACMatcher &operator=(const ACMatcher &);
+
+};
+
+inline uint32_t
+ACMatcher::step(uint32_t state, int c) const
+{
+    if (state < (uint32_t) _ndense) {
+	if (_wide)
+	    return static_cast<const uint32_t *>(_dense)[state * _nclasses + c];
+	uint32_t e = static_cast<const uint16_t *>(_dense)[state * _nclasses + c];
+	return (e & ~OUT_BIT16) | ((e & OUT_BIT16) << 16);
+    } else
+	return sparse_step(state, c);
+}
+
+template <typename F> void
+ACMatcher::report(uint32_t state, const unsigned char *data, int end, F &f) const
+{
+    for (uint32_t k = _out_first[state]; k != _out_first[state + 1]; ++k) {
+	int id = _out[k];
+	const Pattern &p = _patterns[id];
+	if (p.nocase || memcmp(data + end - p.str.length(), p.str.data(), p.str.length()) == 0)
+	    f(id, end);
+    }
+}
+
+template <typename F> inline void
+ACMatcher::scan(const unsigned char *data, int len, F &f) const
+{
+    uint32_t state = 0;
+    for (int i = 0; i < len; ++i) {
+	uint32_t e = step(state, _class[data[i]]);
+	state = e & ~OUT_BIT;
+	if (e & OUT_BIT)
+	    report(state, data, i + 1, f);
+    }
+}
+
+template <typename F> inline int
+ACMatcher::scan_run(const unsigned char *data, int pos, int len, F &f) const
+{
+    uint32_t state = 0;
+    while (pos < len) {
+	uint32_t e = step(state, _class[data[pos]]);
+	state = e & ~OUT_BIT;
+	++pos;
+	if (e & OUT_BIT)
+	    report(state, data, pos, f);
+	if (state == 0)
+	    break;
+    }
+    return pos;
+}
+
+CLICK_ENDDECLS
+#endif
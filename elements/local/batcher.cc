@@ -432,6 +432,14 @@ Batcher::push(int i, Packet *p)
     }
 }
 
+void *
+Batcher::cast(const char *name)
+{
+    if (strcmp(name, "BatchProducer") == 0)
+	return static_cast<BatchProducer *>(this);
+    return Element::cast(name);
+}
+
 int
 Batcher::configure(Vector<String> &conf, ErrorHandler *errh)
 {
@@ -8,8 +8,8 @@
 #include <click/task.hh>
 #include <click/timer.hh>
 #include <click/sync.hh>
+#include <click/error.hh>
 #include <click/ring.hh>
-using namespace std;
 CLICK_DECLS
 
 #define CLICK_BATCH_TIMEOUT 2000
@@ -36,6 +36,7 @@ public:
     const char *port_count() const	{ return "1-/1"; }
     const char *processing() const  { return PUSH; }
     int configure_phase() const { return CONFIGURE_PHASE_LAST; }
+    void *cast(const char *name);
 
     void push(int i, Packet *p);
     int configure(Vector<String> &conf, ErrorHandler *errh);
@@ -0,0 +1,121 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * bcheckchecksum.{cc,hh} -- verifies IP and transport checksums of batches
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "bcheckchecksum.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <clicknet/ip.h>
+#include <clicknet/tcp.h>
+#include <clicknet/udp.h>
+#include <clicknet/icmp.h>
+CLICK_DECLS
+
+BCheckChecksum::BCheckChecksum()
+    : _ip(true), _transport(true)
+{
+    _drops = 0;
+}
+
+BCheckChecksum::~BCheckChecksum()
+{
+}
+
+int
+BCheckChecksum::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    return Args(conf, this, errh)
+	.read("IP", _ip)
+	.read("TRANSPORT", _transport)
+	.complete();
+}
+
+inline bool
+BCheckChecksum::check(Packet *p) const
+{
+    if (!p->has_network_header() || p->network_length() < (int) sizeof(click_ip))
+	return false;
+    const click_ip *iph = p->ip_header();
+    unsigned hlen = iph->ip_hl << 2;
+    unsigned len = ntohs(iph->ip_len);
+    if (hlen < sizeof(click_ip) || len < hlen
+	|| len > (unsigned) p->network_length())
+	return false;
+    if (_ip && click_in_cksum(p->network_header(), hlen) != 0)
+	return false;
+    if (!_transport || IP_ISFRAG(iph))
+	return true;
+
+    const unsigned char *th = p->network_header() + hlen;
+    unsigned tlen = len - hlen;
+    switch (iph->ip_p) {
+    case IP_PROTO_TCP:
+	if (tlen < sizeof(click_tcp))
+	    return false;
+	break;
+    case IP_PROTO_UDP:
+	if (tlen < sizeof(click_udp))
+	    return false;
+	if (reinterpret_cast<const click_udp *>(th)->uh_sum == 0)
+	    return true;
+	break;
+    case IP_PROTO_ICMP:
+	return tlen >= sizeof(click_icmp) && click_in_cksum(th, tlen) == 0;
+    default:
+	return true;
+    }
+    uint16_t csum = click_in_cksum(th, tlen);
+    return click_in_cksum_pseudohdr(csum, iph, tlen) == 0;
+}
+
+void
+BCheckChecksum::push(int, Packet *p)
+{
+    if (check(p))
+	output(0).push(p);
+    else {
+	_drops++;
+	checked_output_push(1, p);
+    }
+}
+
+void
+BCheckChecksum::bpush(int, PBatch *p)
+{
+    int k = 0;
+    for (int i = 0; i < p->npkts; ++i) {
+	if (i + PREFETCH < p->npkts)
+	    __builtin_prefetch(p->pptrs[i + PREFETCH]->data());
+	Packet *q = p->pptrs[i];
+	if (check(q))
+	    p->move_packet(i, k++, q);
+	else {
+	    _drops++;
+	    checked_output_push(1, q);
+	}
+    }
+    p->npkts = k;
+    output(0).bpush(p);
+}
+
+void
+BCheckChecksum::add_handlers()
+{
+    add_data_handlers("drops", Handler::OP_READ, &_drops);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(BCheckChecksum)
+ELEMENT_MT_SAFE(BCheckChecksum)
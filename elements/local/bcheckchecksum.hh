@@ -0,0 +1,85 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_BCHECKCHECKSUM_HH
+#define CLICK_BCHECKCHECKSUM_HH
+#include <click/element.hh>
+#include <click/atomic.hh>
+#include <click/pbatch.hh>
+CLICK_DECLS
+
+/*
+=c
+
+BCheckChecksum([I<keywords> IP, TRANSPORT])
+
+=s local
+
+verifies IP, TCP, UDP and ICMP checksums of packets and batches
+
+=d
+
+Verifies the checksums of IP packets, pushed one at a time or as batches.
+Packets must have their network header annotations set, for instance by
+MarkIPHeader or by CheckIPHeader with its own checksum check turned off.
+
+If IP is true, the IP header checksum is verified.  If TRANSPORT is true,
+the TCP, UDP or ICMP checksum of unfragmented packets is verified over the
+length given in the IP header; a UDP checksum of 0 means no checksum.
+Fragments and other protocols pass unchecked.  Packets with bad checksums,
+or too short for the lengths their headers claim, are emitted on output 1,
+or dropped if there is no output 1.  Batches keep their good packets in
+order, with their slices and annotations, and lose the bad ones.
+
+Checksums are computed with click_in_cksum, which sums long payloads with
+AVX2 where available.  For batches, the next packets' headers are
+prefetched while the current one is checked.
+
+Keyword arguments are:
+
+=over 8
+
+=item IP
+
+Boolean.  Verify IP header checksums.  Default is true.
+
+=item TRANSPORT
+
+Boolean.  Verify TCP, UDP and ICMP checksums.  Default is true.
+
+=back
+
+=h drops read-only
+
+Number of packets with bad checksums or lengths.
+
+=a CheckIPHeader, CheckTCPHeader, CheckUDPHeader, CheckICMPHeader,
+SetIPChecksum, SetTCPChecksum, SetUDPChecksum */
+
+class BCheckChecksum : public Element { public:
+
+    BCheckChecksum();
+    ~BCheckChecksum();
+
+    const char *class_name() const	{ return "BCheckChecksum"; }
+    const char *port_count() const	{ return "1/1-2"; }
+    const char *processing() const	{ return PUSH; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    void add_handlers();
+
+    void push(int port, Packet *p);
+    void bpush(int port, PBatch *p);
+
+  private:
+
+    enum { PREFETCH = 2 };
+
+    bool _ip;
+    bool _transport;
+    atomic_uint32_t _drops;
+
+    inline bool check(Packet *p) const;
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,361 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * bpatternmatch.{cc,hh} -- batched multi-pattern payload matching
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "bpatternmatch.hh"
+#include "snortrule.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/hvputils.hh>
+#include <click/straccum.hh>
+CLICK_DECLS
+
+enum { PROTO_TCP, PROTO_UDP };
+
+BPatternMatch::BPatternMatch()
+    : _batcher(0), _proto(PROTO_TCP), _length(256), _anno(0), _nthreads(1),
+      _l2(256 * 1024), _use_prefilter(true), _anno_offset(-1),
+      _slice_offset(-1), _batch(0), _batches(0), _packets(0), _last_rate(0)
+{
+}
+
+BPatternMatch::~BPatternMatch()
+{
+}
+
+void
+BPatternMatch::add_rule(uint32_t sid, const String &msg,
+			const Vector<String> &contents, const Vector<int> &nocase)
+{
+    Rule r;
+    r.sid = sid;
+    r.msg = msg;
+    r.ncontents = contents.size();
+    for (int i = 0; i < contents.size(); ++i) {
+	_matcher.add_pattern(contents[i], nocase[i]);
+	_content_rule.push_back(_rules.size());
+    }
+    _rules.push_back(r);
+}
+
+int
+BPatternMatch::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    String filename, proto = "tcp";
+    Vector<String> contents;
+    bool simd = true;
+    if (Args(conf, this, errh)
+	.read_mp("BATCHER", ElementCastArg("Batcher"), _batcher)
+	.read("FILE", FilenameArg(), filename)
+	.read_all("CONTENT", StringArg(), contents)
+	.read("PROTO", WordArg(), proto)
+	.read("LENGTH", _length)
+	.read("ANNO", _anno)
+	.read("THREADS", _nthreads)
+	.read("L2", _l2)
+	.read("PREFILTER", _use_prefilter)
+	.read("SIMD", simd)
+	.complete() < 0)
+	return -1;
+    proto = proto.lower();
+    if (proto == "tcp")
+	_proto = PROTO_TCP;
+    else if (proto == "udp")
+	_proto = PROTO_UDP;
+    else
+	return errh->error("PROTO must be tcp or udp");
+    if (_length <= 0 || _length > CLICK_PBATCH_PACKET_BUFFER_SIZE)
+	return errh->error("LENGTH out of range");
+    if (_anno < 0 || _anno + 4 > 255)
+	return errh->error("ANNO out of range");
+    if (_nthreads < 1)
+	return errh->error("THREADS must be positive");
+
+    Vector<SnortRule> rules;
+    if (filename && SnortRule::read_file(filename, rules, errh) < 0)
+	return -1;
+    for (SnortRule *r = rules.begin(); r != rules.end(); ++r)
+	if (r->contents.size() && (r->proto == "ip" || r->proto == proto))
+	    add_rule(r->sid, r->msg, r->contents, r->content_nocase);
+    for (int i = 0; i < contents.size(); ++i) {
+	Vector<String> c(1, String());
+	Vector<int> nocase(1, 0);
+	if (SnortRule::parse_content(contents[i], c[0], errh) < 0)
+	    return -1;
+	add_rule(i + 1, String(), c, nocase);
+    }
+    if (!_rules.size())
+	return errh->error("no rules with content");
+    if (_matcher.compile(_l2) < 0)
+	return errh->error("out of memory");
+    if (_use_prefilter) {
+	for (int id = 0; id < _matcher.npatterns(); ++id)
+	    _prefilter.add_literal(_matcher.pattern(id), _matcher.pattern_nocase(id));
+	_prefilter.compile(simd);
+    }
+
+    if (_batcher->req_anno(_anno, 4, BatchProducer::anno_write)) {
+	errh->error("Register annotation request in batcher failed");
+	return -1;
+    }
+
+    _psr.start = (_proto == PROTO_TCP ? EthernetBatchProducer::tcp4_payload
+		  : EthernetBatchProducer::udp4_payload);
+    _psr.start_offset = 0;
+    _psr.len = _length;
+    _psr.end = _psr.start + _psr.len;
+    if (_batcher->req_slice_range(_psr) < 0) {
+	errh->error("Request slice range failed: %d, %d, %d, %d",
+		    _psr.start, _psr.start_offset, _psr.len, _psr.end);
+	return -1;
+    }
+
+    return 0;
+}
+
+void
+BPatternMatch::init_scanner(Scanner &s) const
+{
+    s.bpm = this;
+    s.content_stamp.assign(_matcher.npatterns(), 0);
+    s.rule_stamp.assign(_rules.size(), 0);
+    s.rule_count.assign(_rules.size(), 0);
+    s.stamp = 0;
+    s.best = -1;
+    s.counts = Counts();
+}
+
+inline void
+BPatternMatch::Scanner::start()
+{
+    if (++stamp == 0) {
+	content_stamp.assign(content_stamp.size(), 0);
+	rule_stamp.assign(rule_stamp.size(), 0);
+	stamp = 1;
+    }
+    best = -1;
+}
+
+inline void
+BPatternMatch::Scanner::operator()(int id, int)
+{
+    if (content_stamp[id] == stamp)
+	return;
+    content_stamp[id] = stamp;
+    int r = bpm->_content_rule[id];
+    if (rule_stamp[r] != stamp) {
+	rule_stamp[r] = stamp;
+	rule_count[r] = 0;
+    }
+    if (++rule_count[r] == bpm->_rules[r].ncontents && (best < 0 || r < best))
+	best = r;
+}
+
+void
+BPatternMatch::scan(PBatch *p, int begin, int end, Scanner &s) const
+{
+    Counts &counts = s.counts;
+    for (int i = begin; i < end; ++i) {
+	int len = (int) p->pptrs[i]->length() - _psr.start;
+	if (len > _length)
+	    len = _length;
+	s.start();
+	if (len > 0) {
+	    const unsigned char *data = p->slice_hptr(i) + _slice_offset;
+	    if (_use_prefilter) {
+		// No occurrence starts before a candidate offset, and none
+		// is in progress where scan_run() stops.
+		bool candidate = false;
+		for (int pos = 0; pos < len; ) {
+		    int c = _prefilter.first_candidate(data + pos, len - pos);
+		    if (c < 0)
+			break;
+		    candidate = true;
+		    pos = _matcher.scan_run(data, pos + c, len, s);
+		}
+		counts.candidates += candidate;
+	    } else {
+		_matcher.scan(data, len, s);
+		++counts.candidates;
+	    }
+	    counts.bytes += len;
+	}
+	uint32_t sid = (s.best >= 0 ? _rules[s.best].sid : 0);
+	counts.matches += (sid != 0);
+	memcpy(p->anno_hptr(i) + _anno_offset, &sid, sizeof(sid));
+    }
+}
+
+void
+BPatternMatch::scan_job(void *arg, int index)
+{
+    BPatternMatch *bpm = static_cast<BPatternMatch *>(arg);
+    PBatch *p = bpm->_batch;
+    bpm->scan(p, bpm->_pool.range(p->npkts, index),
+	      bpm->_pool.range(p->npkts, index + 1), bpm->_scanners[index]);
+}
+
+int
+BPatternMatch::initialize(ErrorHandler *errh)
+{
+    _anno_offset = _batcher->get_anno_offset(_anno);
+    if (_anno_offset < 0) {
+	errh->error("Failed to get anno offset in batch");
+	return -1;
+    }
+    _slice_offset = _batcher->get_slice_offset(_psr);
+    if (_slice_offset < 0) {
+	errh->error("Failed to get slice offset in batch");
+	return -1;
+    }
+
+    _scanners.resize(_nthreads);
+    for (int i = 0; i < _nthreads; ++i)
+	init_scanner(_scanners[i]);
+    if (_pool.start(_nthreads) < 0)
+	return errh->error("cannot create scan threads");
+
+    errh->message("%s: %d rules, %d contents, %d states, %d classes, %d/%d states dense (%s bytes)",
+		  declaration().c_str(), _rules.size(), _matcher.npatterns(),
+		  _matcher.nstates(), _matcher.nclasses(), _matcher.ndense(),
+		  _matcher.nstates(), String(_matcher.dense_bytes()).c_str());
+    return 0;
+}
+
+void
+BPatternMatch::cleanup(CleanupStage)
+{
+    _pool.stop();
+}
+
+void
+BPatternMatch::bpush(int, PBatch *p)
+{
+    Timestamp start = Timestamp::now_steady();
+
+    for (Scanner *s = _scanners.begin(); s != _scanners.end(); ++s)
+	s->counts = Counts();
+    if (p->npkts >= _nthreads) {
+	_batch = p;
+	_pool.run(scan_job, this);
+    } else
+	scan(p, 0, p->npkts, _scanners[0]);
+    Counts counts;
+    for (Scanner *s = _scanners.begin(); s != _scanners.end(); ++s)
+	counts += s->counts;
+
+    Timestamp elapsed = Timestamp::now_steady() - start;
+    _scan_time += elapsed;
+    double sec = elapsed.doubleval();
+    _last_rate = (sec > 0 ? counts.bytes * 8 / sec / 1e9 : 0);
+    ++_batches;
+    _packets += p->npkts;
+    _counts += counts;
+
+    output(0).bpush(p);
+}
+
+void
+BPatternMatch::push(int i, Packet *p)
+{
+    hvp_chatter("Should never call this: %d, %p\n", i, p);
+}
+
+enum { h_rules, h_table, h_prefilter, h_batches, h_packets, h_matches,
+       h_candidates, h_match_rate, h_fp_rate, h_bytes, h_rate, h_avg_rate,
+       h_reset };
+
+String
+BPatternMatch::read_handler(Element *e, void *thunk)
+{
+    BPatternMatch *bpm = static_cast<BPatternMatch *>(e);
+    switch ((intptr_t) thunk) {
+    case h_rules: {
+	StringAccum sa;
+	for (Rule *r = bpm->_rules.begin(); r != bpm->_rules.end(); ++r)
+	    sa << r->sid << ' ' << r->ncontents << ' ' << r->msg << '\n';
+	return sa.take_string();
+    }
+    case h_table: {
+	const ACMatcher &m = bpm->_matcher;
+	StringAccum sa;
+	sa << "states " << m.nstates() << "\nclasses " << m.nclasses()
+	   << "\ndense " << m.ndense() << "\ndense_bytes " << m.dense_bytes()
+	   << "\nsparse_bytes " << m.sparse_bytes() << '\n';
+	return sa.take_string();
+    }
+    case h_prefilter:
+	if (!bpm->_use_prefilter)
+	    return String("off");
+	return String(bpm->_prefilter.isa()) + " " + String(bpm->_prefilter.width());
+    case h_batches:
+	return String(bpm->_batches);
+    case h_packets:
+	return String(bpm->_packets);
+    case h_matches:
+	return String(bpm->_counts.matches);
+    case h_candidates:
+	return String(bpm->_counts.candidates);
+    case h_match_rate:
+	return String(bpm->_packets ? (double) bpm->_counts.matches / bpm->_packets : 0.);
+    case h_fp_rate: {
+	const Counts &c = bpm->_counts;
+	return String(c.candidates ? (double) (c.candidates - c.matches) / c.candidates : 0.);
+    }
+    case h_bytes:
+	return String(bpm->_counts.bytes);
+    case h_rate:
+	return String(bpm->_last_rate);
+    case h_avg_rate: {
+	double sec = bpm->_scan_time.doubleval();
+	return String(sec > 0 ? bpm->_counts.bytes * 8 / sec / 1e9 : 0.);
+    }
+    default:
+	return String();
+    }
+}
+
+int
+BPatternMatch::write_handler(const String &, Element *e, void *, ErrorHandler *)
+{
+    BPatternMatch *bpm = static_cast<BPatternMatch *>(e);
+    bpm->_batches = bpm->_packets = 0;
+    bpm->_counts = Counts();
+    bpm->_scan_time = Timestamp();
+    bpm->_last_rate = 0;
+    return 0;
+}
+
+void
+BPatternMatch::add_handlers()
+{
+    add_read_handler("rules", read_handler, h_rules);
+    add_read_handler("table", read_handler, h_table);
+    add_read_handler("prefilter", read_handler, h_prefilter);
+    add_read_handler("batches", read_handler, h_batches);
+    add_read_handler("packets", read_handler, h_packets);
+    add_read_handler("matches", read_handler, h_matches);
+    add_read_handler("candidates", read_handler, h_candidates);
+    add_read_handler("match_rate", read_handler, h_match_rate);
+    add_read_handler("fp_rate", read_handler, h_fp_rate);
+    add_read_handler("bytes", read_handler, h_bytes);
+    add_read_handler("rate", read_handler, h_rate);
+    add_read_handler("avg_rate", read_handler, h_avg_rate);
+    add_write_handler("reset", write_handler, h_reset, Handler::BUTTON);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel Batcher ACMatcher LiteralPrefilter SnortRule WorkerPool)
+EXPORT_ELEMENT(BPatternMatch)
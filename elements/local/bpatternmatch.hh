@@ -0,0 +1,248 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_BPATTERNMATCH_HH
+#define CLICK_BPATTERNMATCH_HH
+#include <click/element.hh>
+#include <click/pbatch.hh>
+#include <click/timestamp.hh>
+#include "batcher.hh"
+#include "acmatcher.hh"
+#include "literalprefilter.hh"
+#include "workerpool.hh"
+CLICK_DECLS
+
+/*
+=c
+
+BPatternMatch(BATCHER, I<keywords> FILE, CONTENT, PROTO, LENGTH, ANNO,
+  THREADS, L2, PREFILTER, SIMD)
+
+=s local
+
+matches batched packet payloads against content signatures
+
+=d
+
+Scans the payload of every packet in each batch it receives for a set of
+content signatures, and writes the result to a 4-byte batch annotation:
+the SID of the lowest-numbered matching rule in host byte order, or 0 if no
+rule matches.  The batch is then pushed to output 0.
+
+Signatures come from FILE, a Snort-style rule file, and from CONTENT
+arguments.  Of each rule, only the protocol and the C<content>, C<nocase>,
+C<sid> and C<msg> options are used; other options are ignored, as are
+negated contents and rules without content.  A rule matches when all of its
+contents appear anywhere in the scanned payload.  Each CONTENT argument adds
+a rule with a single content and SID equal to its position, starting at 1.
+Contents may contain hex bytes between pipes, as in C<"GET|20|/">.
+
+All contents are compiled into one Aho-Corasick automaton (see ACMatcher).
+Its alphabet is compressed to the bytes the contents use, and the shallowest
+states get full transition rows as long as they fit in L2 bytes, so the hot
+part of the table stays in cache; deeper states fall back to sparse edges.
+
+Most packets match nothing, so by default a LiteralPrefilter built from the
+first bytes of every content skips ahead to offsets where some content might
+start.  The automaton runs from there until no match is in progress, and the
+prefilter takes over again.  Packets with no candidate offset never reach
+the automaton.  The prefilter uses AVX-512BW, AVX2 or SSSE3 byte shuffles
+when the CPU supports them.
+
+BPatternMatch asks BATCHER for a slice of LENGTH bytes starting at the TCP or
+UDP payload of an untagged Ethernet/IPv4 packet without IP options.  Shorter
+payloads are scanned up to the end of the packet.
+
+Keyword arguments are:
+
+=over 8
+
+=item BATCHER
+
+Element name.  The Batcher that produces the batches.  Required.
+
+=item FILE
+
+Filename.  Snort-style rule file.
+
+=item CONTENT
+
+String.  A content to match.  May be given more than once.
+
+=item PROTO
+
+Either C<tcp> or C<udp>.  Selects the payload offset and the rules to load;
+rules for C<ip> are always loaded.  Default is C<tcp>.
+
+=item LENGTH
+
+Integer.  Number of payload bytes to scan per packet.  Default is 256.
+
+=item ANNO
+
+Integer.  Start of the batch annotation that receives the result.  Default
+is 0.
+
+=item THREADS
+
+Integer.  Number of threads that scan each batch, including the one that
+pushed it.  Each thread scans a contiguous run of packets.  Default is 1.
+
+=item L2
+
+Integer.  Bytes of full transition rows.  Default is 262144.
+
+=item PREFILTER
+
+Boolean.  Whether to use the prefilter.  Default is true.
+
+=item SIMD
+
+Boolean.  Whether the prefilter may use SIMD instructions.  Default is true.
+
+=back
+
+=h rules read-only
+
+Returns the loaded rules, one per line: SID, number of contents, message.
+
+=h table read-only
+
+Returns the automaton's size: states, input classes, full rows and bytes
+used.
+
+=h prefilter read-only
+
+Returns the prefilter's implementation and the number of leading content
+bytes it checks, or C<off>.
+
+=h batches read-only
+
+=h packets read-only
+
+=h matches read-only
+
+Number of packets that matched a rule.
+
+=h candidates read-only
+
+Number of packets the automaton scanned, that is, packets with a candidate
+offset when the prefilter is on.
+
+=h match_rate read-only
+
+Fraction of packets that matched a rule.
+
+=h fp_rate read-only
+
+Fraction of candidate packets that matched no rule.
+
+=h bytes read-only
+
+Number of payload bytes scanned.
+
+=h rate read-only
+
+Scan throughput of the last batch, in Gbps.
+
+=h avg_rate read-only
+
+Scan throughput over all batches, in Gbps.
+
+=h reset write-only
+
+Resets the counters.
+
+=a Batcher, ACMatcher, BIPLookup */
+
+class BPatternMatch : public Element { public:
+
+    BPatternMatch();
+    ~BPatternMatch();
+
+    const char *class_name() const	{ return "BPatternMatch"; }
+    const char *port_count() const	{ return PORTS_1_1; }
+    const char *processing() const	{ return PUSH; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    int initialize(ErrorHandler *errh);
+    void cleanup(CleanupStage stage);
+    void add_handlers();
+
+    void bpush(int i, PBatch *p);
+    void push(int i, Packet *p);
+
+  private:
+
+    struct Rule {
+	uint32_t sid;
+	String msg;
+	int ncontents;
+    };
+
+    struct Counts {
+	uint64_t bytes;
+	uint64_t candidates;
+	uint64_t matches;
+	Counts()
+	    : bytes(0), candidates(0), matches(0) {
+	}
+	void operator+=(const Counts &x) {
+	    bytes += x.bytes;
+	    candidates += x.candidates;
+	    matches += x.matches;
+	}
+    };
+
+    // Per-thread match state.  A rule matches a packet when the number of
+    // its distinct contents seen reaches ncontents; the stamps avoid
+    // clearing the counts between packets.
+    struct Scanner {
+	const BPatternMatch *bpm;
+	Vector<uint32_t> content_stamp;
+	Vector<uint32_t> rule_stamp;
+	Vector<int> rule_count;
+	uint32_t stamp;
+	int best;
+	Counts counts;
+	void start();
+	void operator()(int id, int end);
+    };
+
+    Batcher *_batcher;
+    ACMatcher _matcher;
+    LiteralPrefilter _prefilter;
+    Vector<Rule> _rules;
+    Vector<int> _content_rule;
+    int _proto;
+    int _length;
+    int _anno;
+    int _nthreads;
+    uint32_t _l2;
+    bool _use_prefilter;
+
+    PSliceRange _psr;
+    int16_t _anno_offset;
+    int16_t _slice_offset;
+
+    WorkerPool _pool;
+    Vector<Scanner> _scanners;
+    PBatch *_batch;
+
+    uint64_t _batches;
+    uint64_t _packets;
+    Counts _counts;
+    Timestamp _scan_time;
+    double _last_rate;
+
+    void add_rule(uint32_t sid, const String &msg, const Vector<String> &contents,
+		  const Vector<int> &nocase);
+    void init_scanner(Scanner &s) const;
+    void scan(PBatch *p, int begin, int end, Scanner &s) const;
+    static void scan_job(void *arg, int index);
+
+    static String read_handler(Element *e, void *thunk);
+    static int write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh);
+
+};
+
+CLICK_ENDDECLS
+#endif
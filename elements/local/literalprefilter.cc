@@ -0,0 +1,293 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * literalprefilter.{cc,hh} -- SIMD multi-literal prefilter
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "literalprefilter.hh"
+#include <click/glue.hh>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# define LITERALPREFILTER_X86 1
+# include <immintrin.h>
+#endif
+CLICK_DECLS
+
+static inline unsigned char
+fold(unsigned char c)
+{
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+static int
+prefix_compare(const void *a, const void *b, void *user_data)
+{
+    const Vector<String> &prefix = *static_cast<const Vector<String> *>(user_data);
+    return String::compare(prefix[*static_cast<const int *>(a)],
+			   prefix[*static_cast<const int *>(b)]);
+}
+
+LiteralPrefilter::LiteralPrefilter()
+    : _width(0), _impl(IMPL_SCALAR)
+{
+}
+
+void
+LiteralPrefilter::add_literal(const String &literal, bool nocase)
+{
+    if (literal && !compiled()) {
+	Literal l;
+	l.str = literal;
+	l.nocase = nocase;
+	_literals.push_back(l);
+    }
+}
+
+void
+LiteralPrefilter::clear()
+{
+    _literals.clear();
+    _width = 0;
+    _impl = IMPL_SCALAR;
+}
+
+void
+LiteralPrefilter::compile(bool simd)
+{
+    if (compiled() || !_literals.size())
+	return;
+
+    _width = MAX_WIDTH;
+    for (Literal *l = _literals.begin(); l != _literals.end(); ++l)
+	if (l->str.length() < _width)
+	    _width = l->str.length();
+
+    // Sorting puts literals with similar prefixes in the same bucket, which
+    // keeps false positives down.
+    Vector<String> prefix;
+    Vector<int> order;
+    for (int i = 0; i < _literals.size(); ++i) {
+	String p = _literals[i].str.substring(0, _width);
+	char *x = p.mutable_data();
+	for (int j = 0; j < p.length(); ++j)
+	    x[j] = fold(x[j]);
+	prefix.push_back(p);
+	order.push_back(i);
+    }
+    click_qsort(order.begin(), order.size(), sizeof(int), prefix_compare, &prefix);
+
+    memset(_nibble_lo, 0, sizeof(_nibble_lo));
+    memset(_nibble_hi, 0, sizeof(_nibble_hi));
+    memset(_byte, 0, sizeof(_byte));
+    for (int i = 0; i < order.size(); ++i) {
+	const Literal &l = _literals[order[i]];
+	uint8_t bucket = 1 << (i * NBUCKETS / _literals.size());
+	for (int j = 0; j < _width; ++j) {
+	    unsigned char c[2];
+	    int nc = 1;
+	    c[0] = l.str[j];
+	    if (l.nocase && fold(c[0]) != c[0])
+		c[nc++] = fold(c[0]);
+	    else if (l.nocase && c[0] >= 'a' && c[0] <= 'z')
+		c[nc++] = c[0] - ('a' - 'A');
+	    for (int k = 0; k < nc; ++k) {
+		_nibble_lo[j][c[k] & 15] |= bucket;
+		_nibble_hi[j][c[k] >> 4] |= bucket;
+		_byte[j][c[k]] |= bucket;
+	    }
+	}
+    }
+
+    _impl = IMPL_SCALAR;
+#if LITERALPREFILTER_X86
+    if (simd) {
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512bw"))
+	    _impl = IMPL_AVX512;
+	else if (__builtin_cpu_supports("avx2"))
+	    _impl = IMPL_AVX2;
+	else if (__builtin_cpu_supports("ssse3"))
+	    _impl = IMPL_SSSE3;
+    }
+#else
+    (void) simd;
+#endif
+}
+
+const char *
+LiteralPrefilter::isa() const
+{
+    switch (_impl) {
+    case IMPL_SSSE3:
+	return "ssse3";
+    case IMPL_AVX2:
+	return "avx2";
+    case IMPL_AVX512:
+	return "avx512bw";
+    default:
+	return "scalar";
+    }
+}
+
+int
+LiteralPrefilter::scan_scalar(const unsigned char *data, int begin, int len) const
+{
+    int last = len - _width;
+    switch (_width) {
+    case 1:
+	for (int i = begin; i <= last; ++i)
+	    if (_byte[0][data[i]])
+		return i;
+	break;
+    case 2:
+	for (int i = begin; i <= last; ++i)
+	    if (_byte[0][data[i]] & _byte[1][data[i + 1]])
+		return i;
+	break;
+    default:
+	for (int i = begin; i <= last; ++i)
+	    if (_byte[0][data[i]] & _byte[1][data[i + 1]] & _byte[2][data[i + 2]])
+		return i;
+	break;
+    }
+    return -1;
+}
+
+#if LITERALPREFILTER_X86
+// Each function checks blocks of positions while the loads stay inside the
+// buffer.  Positions that pass the nibble tables are rechecked against the
+// exact byte tables, since nibbles let through many more false candidates
+// when buckets hold several literals.  Returns the first candidate, or -1
+// with @a pos set to the first position left for the scalar loop.
+
+static inline bool
+exact_candidate(const uint8_t (*tbyte)[256], int width, const unsigned char *s)
+{
+    uint8_t r = tbyte[0][s[0]];
+    for (int j = 1; j < width; ++j)
+	r &= tbyte[j][s[j]];
+    return r != 0;
+}
+
+__attribute__((target("ssse3"))) static int
+teddy_ssse3(const uint8_t (*tlo)[16], const uint8_t (*thi)[16],
+	    const uint8_t (*tbyte)[256], int width,
+	    const unsigned char *data, int len, int &pos)
+{
+    const __m128i mask = _mm_set1_epi8(0x0F);
+    __m128i lo[3], hi[3];
+    for (int j = 0; j < width; ++j) {
+	lo[j] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(tlo[j]));
+	hi[j] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(thi[j]));
+    }
+    int i = 0;
+    for (; i + 16 + width - 1 <= len; i += 16) {
+	__m128i r = _mm_set1_epi8(-1);
+	for (int j = 0; j < width; ++j) {
+	    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i + j));
+	    __m128i vl = _mm_and_si128(v, mask);
+	    __m128i vh = _mm_and_si128(_mm_srli_epi16(v, 4), mask);
+	    r = _mm_and_si128(r, _mm_and_si128(_mm_shuffle_epi8(lo[j], vl),
+					       _mm_shuffle_epi8(hi[j], vh)));
+	}
+	unsigned m = _mm_movemask_epi8(_mm_cmpeq_epi8(r, _mm_setzero_si128())) ^ 0xFFFFU;
+	for (; m; m &= m - 1)
+	    if (exact_candidate(tbyte, width, data + i + __builtin_ctz(m)))
+		return i + __builtin_ctz(m);
+    }
+    pos = i;
+    return -1;
+}
+
+__attribute__((target("avx2"))) static int
+teddy_avx2(const uint8_t (*tlo)[16], const uint8_t (*thi)[16],
+	   const uint8_t (*tbyte)[256], int width,
+	   const unsigned char *data, int len, int &pos)
+{
+    const __m256i mask = _mm256_set1_epi8(0x0F);
+    __m256i lo[3], hi[3];
+    for (int j = 0; j < width; ++j) {
+	lo[j] = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(tlo[j])));
+	hi[j] = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(thi[j])));
+    }
+    int i = 0;
+    for (; i + 32 + width - 1 <= len; i += 32) {
+	__m256i r = _mm256_set1_epi8(-1);
+	for (int j = 0; j < width; ++j) {
+	    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i + j));
+	    __m256i vl = _mm256_and_si256(v, mask);
+	    __m256i vh = _mm256_and_si256(_mm256_srli_epi16(v, 4), mask);
+	    r = _mm256_and_si256(r, _mm256_and_si256(_mm256_shuffle_epi8(lo[j], vl),
+						     _mm256_shuffle_epi8(hi[j], vh)));
+	}
+	unsigned m = ~(unsigned) _mm256_movemask_epi8(_mm256_cmpeq_epi8(r, _mm256_setzero_si256()));
+	for (; m; m &= m - 1)
+	    if (exact_candidate(tbyte, width, data + i + __builtin_ctz(m)))
+		return i + __builtin_ctz(m);
+    }
+    pos = i;
+    return -1;
+}
+
+__attribute__((target("avx512bw"))) static int
+teddy_avx512(const uint8_t (*tlo)[16], const uint8_t (*thi)[16],
+	     const uint8_t (*tbyte)[256], int width,
+	     const unsigned char *data, int len, int &pos)
+{
+    const __m512i mask = _mm512_set1_epi8(0x0F);
+    __m512i lo[3], hi[3];
+    uint8_t rep[2][64];
+    for (int j = 0; j < width; ++j) {
+	for (int k = 0; k < 64; k += 16) {
+	    memcpy(&rep[0][k], tlo[j], 16);
+	    memcpy(&rep[1][k], thi[j], 16);
+	}
+	lo[j] = _mm512_loadu_si512(rep[0]);
+	hi[j] = _mm512_loadu_si512(rep[1]);
+    }
+    int i = 0;
+    for (; i + 64 + width - 1 <= len; i += 64) {
+	__m512i r = _mm512_set1_epi8(-1);
+	for (int j = 0; j < width; ++j) {
+	    __m512i v = _mm512_loadu_si512(data + i + j);
+	    __m512i vl = _mm512_and_si512(v, mask);
+	    __m512i vh = _mm512_and_si512(_mm512_srli_epi16(v, 4), mask);
+	    r = _mm512_and_si512(r, _mm512_and_si512(_mm512_shuffle_epi8(lo[j], vl),
+						     _mm512_shuffle_epi8(hi[j], vh)));
+	}
+	uint64_t m = _mm512_test_epi8_mask(r, r);
+	for (; m; m &= m - 1)
+	    if (exact_candidate(tbyte, width, data + i + __builtin_ctzll(m)))
+		return i + __builtin_ctzll(m);
+    }
+    pos = i;
+    return -1;
+}
+#endif
+
+int
+LiteralPrefilter::scan_simd(const unsigned char *data, int len) const
+{
+    int pos = 0, r = -1;
+#if LITERALPREFILTER_X86
+    if (_impl == IMPL_AVX512)
+	r = teddy_avx512(_nibble_lo, _nibble_hi, _byte, _width, data, len, pos);
+    else if (_impl == IMPL_AVX2)
+	r = teddy_avx2(_nibble_lo, _nibble_hi, _byte, _width, data, len, pos);
+    else
+	r = teddy_ssse3(_nibble_lo, _nibble_hi, _byte, _width, data, len, pos);
+#endif
+    return r >= 0 ? r : scan_scalar(data, pos, len);
+}
+
+CLICK_ENDDECLS
+ELEMENT_PROVIDES(LiteralPrefilter)
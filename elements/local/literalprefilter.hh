@@ -0,0 +1,87 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_LITERALPREFILTER_HH
+#define CLICK_LITERALPREFILTER_HH
+#include <click/string.hh>
+#include <click/vector.hh>
+CLICK_DECLS
+
+/** @class LiteralPrefilter
+ * @brief Fast filter for offsets where one of a set of literals may start.
+ *
+ * A LiteralPrefilter answers "where is the first place in this buffer that
+ * any of these literals might start?"  It may report offsets where no
+ * literal starts, but never skips one that does, so a slower exact matcher
+ * can start at the reported offset and skip buffers with no candidate.
+ *
+ * This is the Teddy algorithm.  The first width() bytes of each literal,
+ * where width() is at most 3 and no longer than the shortest literal, are
+ * checked.  Literals are split into 8 buckets of similar prefixes.  For each
+ * prefix position, two 16-entry tables map a byte's low and high nibble to
+ * the buckets with a compatible prefix byte there; a position is a
+ * candidate when some bucket survives at every prefix position.  With
+ * SSSE3, AVX2 or AVX-512BW, the table lookups are byte shuffles over 16, 32
+ * or 64 positions at a time; the widest instruction set the CPU supports is
+ * chosen at compile() time.  Otherwise exact 256-entry tables are used one
+ * byte at a time. */
+class LiteralPrefilter { public:
+
+    LiteralPrefilter();
+
+    /** @brief Add a non-empty literal.
+     * @param nocase if true, match letters regardless of case */
+    void add_literal(const String &literal, bool nocase = false);
+
+    /** @brief Build the tables.
+     * @param simd if false, use the portable implementation */
+    void compile(bool simd = true);
+
+    void clear();
+
+    bool compiled() const		{ return _width > 0; }
+    int nliterals() const		{ return _literals.size(); }
+    int width() const			{ return _width; }
+
+    /** @brief Return the name of the implementation chosen by compile(). */
+    const char *isa() const;
+
+    /** @brief Return the first candidate offset in @a data, or -1.
+     *
+     * Only offsets at most @a len - width() are candidates.  Returns 0 if
+     * the filter has no literals. */
+    inline int first_candidate(const unsigned char *data, int len) const;
+
+  private:
+
+    enum { NBUCKETS = 8, MAX_WIDTH = 3 };
+    enum { IMPL_SCALAR, IMPL_SSSE3, IMPL_AVX2, IMPL_AVX512 };
+
+    struct Literal {
+	String str;
+	bool nocase;
+    };
+
+    Vector<Literal> _literals;
+    int _width;
+    int _impl;
+    uint8_t _nibble_lo[MAX_WIDTH][16];
+    uint8_t _nibble_hi[MAX_WIDTH][16];
+    uint8_t _byte[MAX_WIDTH][256];
+
+    int scan_scalar(const unsigned char *data, int begin, int len) const;
+    int scan_simd(const unsigned char *data, int len) const;
+
+};
+
+inline int
+LiteralPrefilter::first_candidate(const unsigned char *data, int len) const
+{
+    if (!_literals.size())
+	return 0;
+    else if (_impl == IMPL_SCALAR)
+	return scan_scalar(data, 0, len);
+    else
+	return scan_simd(data, len);
+}
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,210 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * literalprefiltertest.{cc,hh} -- regression test element for LiteralPrefilter
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "literalprefiltertest.hh"
+#include "literalprefilter.hh"
+#include "acmatcher.hh"
+#include <click/error.hh>
+CLICK_DECLS
+
+LiteralPrefilterTest::LiteralPrefilterTest()
+{
+}
+
+namespace {
+
+struct Literal {
+    String str;
+    bool nocase;
+};
+
+struct Occurrences {
+    Vector<int> occ;
+    void operator()(int id, int end) {
+	occ.push_back(end * 1024 + id);
+    }
+};
+
+class Random { public:
+    Random() : _x(2463534242U) { }
+    uint32_t operator()() {
+	_x ^= _x << 13;
+	_x ^= _x >> 17;
+	_x ^= _x << 5;
+	return _x;
+    }
+    int operator()(int n) {
+	return (*this)() % n;
+    }
+  private:
+    uint32_t _x;
+};
+
+void
+add(Vector<Literal> &set, const String &str, bool nocase = false)
+{
+    Literal l;
+    l.str = str;
+    l.nocase = nocase;
+    set.push_back(l);
+}
+
+int
+check_set(const Vector<Literal> &set, int setno, bool simd, Random &random,
+	  ErrorHandler *errh)
+{
+    LiteralPrefilter pf;
+    ACMatcher m;
+    for (const Literal *l = set.begin(); l != set.end(); ++l) {
+	pf.add_literal(l->str, l->nocase);
+	m.add_pattern(l->str, l->nocase);
+    }
+    pf.compile(simd);
+    if (m.compile() < 0)
+	return errh->error("set %d: ACMatcher compile failed", setno);
+    if (!simd && strcmp(pf.isa(), "scalar") != 0)
+	return errh->error("set %d: SIMD false chose %s", setno, pf.isa());
+
+    // Filler bytes are either literal bytes, so that partial matches are
+    // common, or bytes no literal uses.
+    String alphabet;
+    for (const Literal *l = set.begin(); l != set.end(); ++l)
+	alphabet += l->str;
+
+    unsigned char data[200];
+    for (int trial = 0; trial < 2000; ++trial) {
+	int len = random(sizeof(data) + 1);
+	bool miss = (trial % 10 == 0);
+	for (int i = 0; i < len; ++i)
+	    if (miss || random(4) == 0)
+		data[i] = 0x80 + random(0x80);
+	    else
+		data[i] = alphabet[random(alphabet.length())];
+	for (int n = (miss ? 0 : random(4)); n > 0; --n) {
+	    const Literal &l = set[random(set.size())];
+	    if (l.str.length() > len)
+		continue;
+	    int pos = random(len - l.str.length() + 1);
+	    if (n == 1)
+		pos = len - l.str.length();
+	    for (int i = 0; i < l.str.length(); ++i) {
+		unsigned char c = l.str[i];
+		if (l.nocase && random(2) && c >= 'a' && c <= 'z')
+		    c -= 'a' - 'A';
+		else if (l.nocase && random(2) && c >= 'A' && c <= 'Z')
+		    c += 'a' - 'A';
+		data[pos + i] = c;
+	    }
+	}
+
+	Occurrences plain;
+	m.scan(data, len, plain);
+
+	Vector<int> candidate(len + 1, 0);
+	for (int pos = 0; pos < len; ) {
+	    int c = pf.first_candidate(data + pos, len - pos);
+	    if (c < 0)
+		break;
+	    if (pos + c > len - pf.width())
+		return errh->error("set %d %s trial %d: candidate %d past end %d", setno, pf.isa(), trial, pos + c, len);
+	    candidate[pos + c] = 1;
+	    pos += c + 1;
+	}
+	for (int *o = plain.occ.begin(); o != plain.occ.end(); ++o) {
+	    int start = *o / 1024 - m.pattern(*o % 1024).length();
+	    if (!candidate[start])
+		return errh->error("set %d %s trial %d: missed literal %d at %d", setno, pf.isa(), trial, *o % 1024, start);
+	}
+	if (miss && pf.first_candidate(data, len) >= 0)
+	    return errh->error("set %d %s trial %d: false candidate in %d bytes", setno, pf.isa(), trial, len);
+
+	Occurrences filtered;
+	for (int pos = 0; pos < len; ) {
+	    int c = pf.first_candidate(data + pos, len - pos);
+	    if (c < 0)
+		break;
+	    pos = m.scan_run(data, pos + c, len, filtered);
+	}
+	if (filtered.occ.size() != plain.occ.size()
+	    || memcmp(filtered.occ.begin(), plain.occ.begin(), plain.occ.size() * sizeof(int)) != 0)
+	    return errh->error("set %d %s trial %d: %d occurrences with prefilter, %d without", setno, pf.isa(), trial, filtered.occ.size(), plain.occ.size());
+    }
+    return 0;
+}
+
+}
+
+#define CHECK(x) if (!(x)) return errh->error("%s:%d: test %<%s%> failed", __FILE__, __LINE__, #x);
+
+int
+LiteralPrefilterTest::initialize(ErrorHandler *errh)
+{
+    LiteralPrefilter empty;
+    empty.compile();
+    CHECK(!empty.compiled());
+    CHECK(empty.first_candidate((const unsigned char *) "abc", 3) == 0);
+
+    LiteralPrefilter pf;
+    pf.add_literal("xyz");
+    pf.add_literal("a");
+    pf.compile();
+    CHECK(pf.width() == 1);
+    CHECK(pf.first_candidate((const unsigned char *) "bcdefga", 7) == 6);
+    CHECK(pf.first_candidate((const unsigned char *) "bcdefg", 6) == -1);
+    CHECK(pf.first_candidate((const unsigned char *) "", 0) == -1);
+
+    Vector<Vector<Literal> > sets(6, Vector<Literal>());
+    add(sets[0], "GET /");
+    add(sets[0], "POST ");
+    add(sets[0], "HEAD ");
+    // shorter than the maximum prefix width
+    add(sets[1], "a");
+    add(sets[1], "xyz");
+    add(sets[2], "ab");
+    add(sets[2], "attack");
+    add(sets[2], String("\000\001", 2));
+    add(sets[3], "Attack", true);
+    add(sets[3], "select", true);
+    add(sets[3], "UNION");
+    // more literals than buckets
+    Random random;
+    for (int i = 0; i < 40; ++i) {
+	char buf[8];
+	int len = 3 + random(6);
+	for (int j = 0; j < len; ++j)
+	    buf[j] = 'a' + random(8);
+	add(sets[4], String(buf, len), i % 5 == 0);
+    }
+    for (int i = 0; i < 20; ++i) {
+	char buf[6];
+	int len = 2 + random(5);
+	for (int j = 0; j < len; ++j)
+	    buf[j] = 'a' + random(4);
+	add(sets[5], String(buf, len));
+    }
+
+    for (int s = 0; s < sets.size(); ++s)
+	for (int simd = 1; simd >= 0; --simd)
+	    if (check_set(sets[s], s, simd, random, errh) < 0)
+		return -1;
+
+    errh->message("All tests pass!");
+    return 0;
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(ACMatcher LiteralPrefilter)
+EXPORT_ELEMENT(LiteralPrefilterTest)
@@ -0,0 +1,42 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_LITERALPREFILTERTEST_HH
+#define CLICK_LITERALPREFILTERTEST_HH
+#include <click/element.hh>
+CLICK_DECLS
+
+/*
+=c
+
+LiteralPrefilterTest()
+
+=s test
+
+runs regression tests for LiteralPrefilter
+
+=d
+
+LiteralPrefilterTest runs LiteralPrefilter regression tests at
+initialization time.  It does not route packets.
+
+For several literal sets, including literals shorter than the prefilter's
+3-byte maximum width, case-insensitive literals, and more literals than
+buckets, it scans pseudorandom buffers of up to 200 bytes with both the SIMD
+and the portable implementation.  Every offset where ACMatcher finds a
+literal must be a candidate, buffers made only of bytes no literal uses must
+have none, and prefilter-driven ACMatcher::scan_run() calls must report the
+same occurrences as a plain ACMatcher::scan().
+
+*/
+
+class LiteralPrefilterTest : public Element { public:
+
+    LiteralPrefilterTest();
+
+    const char *class_name() const		{ return "LiteralPrefilterTest"; }
+
+    int initialize(ErrorHandler *);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,381 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * regexmatch.{cc,hh} -- regular expression payload matching
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "regexmatch.hh"
+#include "snortrule.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/master.hh>
+#include <click/straccum.hh>
+#include <clicknet/ip.h>
+#include <clicknet/tcp.h>
+#include <clicknet/udp.h>
+CLICK_DECLS
+
+RegexMatch::RegexMatch()
+    : _proto(IP_PROTO_TCP), _length(-1), _memory(1 << 20), _anno(0),
+      _nthreads(1), _batcher(0), _anno_offset(-1), _slice_offset(-1),
+      _batch(0)
+{
+}
+
+RegexMatch::~RegexMatch()
+{
+}
+
+int
+RegexMatch::add_rule(uint32_t sid, const String &msg,
+		     const Vector<String> &pcres, const Vector<String> &contents,
+		     const Vector<int> &nocase, ErrorHandler *errh)
+{
+    int first = _expr_rule.size();
+    for (int i = 0; i < pcres.size(); ++i) {
+	if (_set.add_pcre(pcres[i], errh) < 0) {
+	    // Expressions already added for this rule stay unused.
+	    for (int j = first; j < _expr_rule.size(); ++j)
+		_expr_rule[j] = -1;
+	    return -1;
+	}
+	_expr_rule.push_back(_rules.size());
+    }
+    for (int i = 0; i < contents.size(); ++i) {
+	_set.add_literal(contents[i], nocase[i]);
+	_expr_rule.push_back(_rules.size());
+    }
+    Rule r;
+    r.sid = sid;
+    r.msg = msg;
+    r.nexprs = pcres.size() + contents.size();
+    _rules.push_back(r);
+    return 0;
+}
+
+int
+RegexMatch::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    String filename, proto = "tcp";
+    Vector<String> pcres;
+    Element *batcher = 0;
+    if (Args(conf, this, errh)
+	.read("FILE", FilenameArg(), filename)
+	.read_all("PCRE", StringArg(), pcres)
+	.read("PROTO", WordArg(), proto)
+	.read("LENGTH", _length)
+	.read("MEMORY", _memory)
+	.read("BATCHER", batcher)
+	.read("ANNO", _anno)
+	.read("THREADS", _nthreads)
+	.complete() < 0)
+	return -1;
+    proto = proto.lower();
+    if (proto == "tcp")
+	_proto = IP_PROTO_TCP;
+    else if (proto == "udp")
+	_proto = IP_PROTO_UDP;
+    else
+	return errh->error("PROTO must be tcp or udp");
+    if (batcher && !(_batcher = (BatchProducer *) batcher->cast("BatchProducer")))
+	return errh->error("BATCHER %<%s%> is not a batch producer", batcher->name().c_str());
+    if (_length < 0)
+	_length = (_batcher ? 256 : 65535);
+    if (_length == 0 || (_batcher && _length > CLICK_PBATCH_PACKET_BUFFER_SIZE))
+	return errh->error("LENGTH out of range");
+    if (_anno < 0 || _anno + 4 > 255)
+	return errh->error("ANNO out of range");
+    if (_nthreads < 1)
+	return errh->error("THREADS must be positive");
+
+    Vector<SnortRule> rules;
+    if (filename && SnortRule::read_file(filename, rules, errh) < 0)
+	return -1;
+    int nskipped = 0;
+    for (SnortRule *r = rules.begin(); r != rules.end(); ++r)
+	if (r->pcres.size() && (r->proto == "ip" || r->proto == proto)
+	    && add_rule(r->sid, r->msg, r->pcres, r->contents, r->content_nocase,
+			ErrorHandler::silent_handler()) < 0)
+	    ++nskipped;
+    if (nskipped)
+	errh->warning("skipped %d rules with unsupported PCREs", nskipped);
+    for (int i = 0; i < pcres.size(); ++i) {
+	Vector<String> pcre(1, pcres[i]), contents;
+	Vector<int> nocase;
+	if (add_rule(i + 1, String(), pcre, contents, nocase, errh) < 0)
+	    return -1;
+    }
+    if (!_rules.size())
+	return errh->error("no rules with PCRE");
+    _set.compile();
+
+    if (_batcher) {
+	if (_batcher->req_anno(_anno, 4, BatchProducer::anno_write))
+	    return errh->error("Register annotation request in batcher failed");
+	_psr.start = (_proto == IP_PROTO_TCP ? EthernetBatchProducer::tcp4_payload
+		      : EthernetBatchProducer::udp4_payload);
+	_psr.start_offset = 0;
+	_psr.len = _length;
+	_psr.end = _psr.start + _psr.len;
+	if (_batcher->req_slice_range(_psr) < 0)
+	    return errh->error("Request slice range failed: %d, %d, %d, %d",
+			       _psr.start, _psr.start_offset, _psr.len, _psr.end);
+    }
+    return 0;
+}
+
+void
+RegexMatch::init_scanner(Scanner &s) const
+{
+    s.rm = this;
+    s.dfa.initialize(&_set, _memory);
+    s.expr_stamp.assign(_set.size(), 0);
+    s.rule_stamp.assign(_rules.size(), 0);
+    s.rule_count.assign(_rules.size(), 0);
+    s.rule_hits.assign(_rules.size(), 0);
+    s.stamp = 0;
+    s.best = -1;
+    s.counts = Counts();
+}
+
+int
+RegexMatch::initialize(ErrorHandler *errh)
+{
+    if (_batcher) {
+	_anno_offset = _batcher->get_anno_offset(_anno);
+	if (_anno_offset < 0)
+	    return errh->error("Failed to get anno offset in batch");
+	_slice_offset = _batcher->get_slice_offset(_psr);
+	if (_slice_offset < 0)
+	    return errh->error("Failed to get slice offset in batch");
+	_workers.resize(_nthreads);
+	for (int i = 0; i < _nthreads; ++i)
+	    init_scanner(_workers[i]);
+	if (_pool.start(_nthreads) < 0)
+	    return errh->error("cannot create scan threads");
+    }
+
+    int nthreads = master()->nthreads();
+    _scanners.resize(nthreads < 1 ? 1 : nthreads);
+    for (int i = 0; i < _scanners.size(); ++i)
+	init_scanner(_scanners[i]);
+    return 0;
+}
+
+void
+RegexMatch::cleanup(CleanupStage)
+{
+    _pool.stop();
+}
+
+inline void
+RegexMatch::Scanner::start()
+{
+    if (++stamp == 0) {
+	expr_stamp.assign(expr_stamp.size(), 0);
+	rule_stamp.assign(rule_stamp.size(), 0);
+	stamp = 1;
+    }
+    best = -1;
+}
+
+inline void
+RegexMatch::Scanner::operator()(int id)
+{
+    int r = rm->_expr_rule[id];
+    if (expr_stamp[id] == stamp || r < 0)
+	return;
+    expr_stamp[id] = stamp;
+    if (rule_stamp[r] != stamp) {
+	rule_stamp[r] = stamp;
+	rule_count[r] = 0;
+    }
+    if (++rule_count[r] == rm->_rules[r].nexprs) {
+	++rule_hits[r];
+	if (best < 0 || r < best)
+	    best = r;
+    }
+}
+
+uint32_t
+RegexMatch::Scanner::match(const unsigned char *data, int len)
+{
+    start();
+    dfa.scan(data, len, *this);
+    ++counts.packets;
+    counts.bytes += len;
+    if (best < 0)
+	return 0;
+    ++counts.matches;
+    return rm->_rules[best].sid;
+}
+
+inline RegexMatch::Scanner &
+RegexMatch::thread_scanner()
+{
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD && HAVE___THREAD_STORAGE_CLASS
+    int id = click_current_thread_id;
+#else
+    int id = 0;
+#endif
+    return _scanners[(unsigned) id % (unsigned) _scanners.size()];
+}
+
+void
+RegexMatch::push(int, Packet *p)
+{
+    const click_ip *iph = p->ip_header();
+    const unsigned char *data = 0, *end = p->end_data();
+    if (p->has_network_header() && iph->ip_p == _proto
+	&& IP_FIRSTFRAG(iph) && p->transport_length() > 0) {
+	const unsigned char *ip_end = p->network_header() + ntohs(iph->ip_len);
+	if (ip_end < end)
+	    end = ip_end;
+	if (_proto == IP_PROTO_TCP
+	    && p->transport_length() >= (int) sizeof(click_tcp))
+	    data = p->transport_header() + (p->tcp_header()->th_off << 2);
+	else if (_proto == IP_PROTO_UDP
+		 && p->transport_length() >= (int) sizeof(click_udp))
+	    data = p->transport_header() + sizeof(click_udp);
+    }
+
+    uint32_t sid = 0;
+    if (data && data <= end) {
+	int len = end - data;
+	if (len > _length)
+	    len = _length;
+	sid = thread_scanner().match(data, len);
+    }
+    checked_output_push(sid ? 0 : 1, p);
+}
+
+void
+RegexMatch::scan(PBatch *p, int begin, int end, Scanner &s) const
+{
+    for (int i = begin; i < end; ++i) {
+	int len = (int) p->pptrs[i]->length() - _psr.start;
+	if (len > _length)
+	    len = _length;
+	uint32_t sid = 0;
+	if (len >= 0)
+	    sid = s.match(p->slice_hptr(i) + _slice_offset, len);
+	memcpy(p->anno_hptr(i) + _anno_offset, &sid, sizeof(sid));
+    }
+}
+
+void
+RegexMatch::scan_job(void *arg, int index)
+{
+    RegexMatch *rm = static_cast<RegexMatch *>(arg);
+    PBatch *p = rm->_batch;
+    rm->scan(p, rm->_pool.range(p->npkts, index),
+	     rm->_pool.range(p->npkts, index + 1), rm->_workers[index]);
+}
+
+void
+RegexMatch::bpush(int, PBatch *p)
+{
+    if (!_batcher)
+	click_chatter("%p{element}: batch not scanned, no BATCHER", this);
+    else if (p->npkts >= _nthreads) {
+	_batch = p;
+	_pool.run(scan_job, this);
+    } else
+	scan(p, 0, p->npkts, _workers[0]);
+    output(0).bpush(p);
+}
+
+enum { h_rules, h_cache, h_hit_rate, h_packets, h_matches, h_bytes, h_reset };
+
+String
+RegexMatch::read_handler(Element *e, void *thunk)
+{
+    RegexMatch *rm = static_cast<RegexMatch *>(e);
+    Vector<uint64_t> hits(rm->_rules.size(), 0);
+    Counts counts;
+    int nstates = 0;
+    uint64_t bytes = 0, flushes = 0, steps = 0, misses = 0;
+    for (int w = 0; w < 2; ++w) {
+	Vector<Scanner> &v = (w ? rm->_workers : rm->_scanners);
+	for (Scanner *s = v.begin(); s != v.end(); ++s) {
+	    for (int r = 0; r < hits.size(); ++r)
+		hits[r] += s->rule_hits[r];
+	    counts += s->counts;
+	    nstates += s->dfa.nstates();
+	    bytes += s->dfa.bytes();
+	    flushes += s->dfa.flushes();
+	    steps += s->dfa.steps();
+	    misses += s->dfa.misses();
+	}
+    }
+    double hit_rate = (steps ? (double) (steps - misses) / steps : 0.);
+
+    switch ((intptr_t) thunk) {
+    case h_rules: {
+	StringAccum sa;
+	for (int r = 0; r < rm->_rules.size(); ++r) {
+	    const Rule &rule = rm->_rules[r];
+	    sa << rule.sid << ' ' << hits[r] << ' ' << rule.nexprs << ' '
+	       << rule.msg << '\n';
+	}
+	return sa.take_string();
+    }
+    case h_cache: {
+	StringAccum sa;
+	sa << "states " << nstates << "\nbytes " << bytes
+	   << "\nflushes " << flushes << "\nhit_rate " << hit_rate << '\n';
+	return sa.take_string();
+    }
+    case h_hit_rate:
+	return String(hit_rate);
+    case h_packets:
+	return String(counts.packets);
+    case h_matches:
+	return String(counts.matches);
+    case h_bytes:
+	return String(counts.bytes);
+    default:
+	return String();
+    }
+}
+
+int
+RegexMatch::write_handler(const String &, Element *e, void *, ErrorHandler *)
+{
+    RegexMatch *rm = static_cast<RegexMatch *>(e);
+    for (int w = 0; w < 2; ++w) {
+	Vector<Scanner> &v = (w ? rm->_workers : rm->_scanners);
+	for (Scanner *s = v.begin(); s != v.end(); ++s) {
+	    s->counts = Counts();
+	    s->rule_hits.assign(s->rule_hits.size(), 0);
+	    s->dfa.clear_stats();
+	}
+    }
+    return 0;
+}
+
+void
+RegexMatch::add_handlers()
+{
+    add_read_handler("rules", read_handler, h_rules);
+    add_read_handler("cache", read_handler, h_cache);
+    add_read_handler("hit_rate", read_handler, h_hit_rate);
+    add_read_handler("packets", read_handler, h_packets);
+    add_read_handler("matches", read_handler, h_matches);
+    add_read_handler("bytes", read_handler, h_bytes);
+    add_write_handler("reset", write_handler, h_reset, Handler::BUTTON);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel RegexSet SnortRule WorkerPool)
+EXPORT_ELEMENT(RegexMatch)
@@ -0,0 +1,213 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_REGEXMATCH_HH
+#define CLICK_REGEXMATCH_HH
+#include <click/element.hh>
+#include <click/pbatch.hh>
+#include "regexset.hh"
+#include "workerpool.hh"
+CLICK_DECLS
+
+/*
+=c
+
+RegexMatch(I<keywords> FILE, PCRE, PROTO, LENGTH, MEMORY, BATCHER, ANNO,
+  THREADS)
+
+=s local
+
+matches packet payloads against regular expression signatures
+
+=d
+
+Scans TCP or UDP payloads for a set of regular expression signatures.
+
+Signatures come from FILE, a Snort-style rule file, and from PCRE
+arguments.  Rules in FILE are loaded if they have at least one C<pcre>
+option; a rule matches when all of its PCREs and contents appear in the
+payload.  Each PCRE argument adds a rule with SID equal to its position,
+starting at 1.  PCREs are written C</regex/flags> and use the subset of
+PCRE syntax described in RegexSet.  Snort's uppercase modifiers, such as
+C<R> and C<U>, are ignored, so rules that use them can match more packets
+than under Snort.  Rules in FILE with unsupported PCREs are skipped with a
+warning; unsupported PCRE arguments are errors.
+
+All expressions are compiled into one NFA.  Each thread matches with its
+own lazily built DFA: a DFA state is created the first time a payload
+reaches it, so a scan costs one table lookup per byte once the states it
+needs are cached.  A thread's cache is flushed and rebuilt when it would
+exceed MEMORY bytes, which bounds memory for expressions whose full DFA
+would be too large.
+
+Packets pushed on input 0 are scanned from their IP header.  Matching
+packets are emitted on output 0 and others on output 1, or dropped if there
+is no output 1.  Packets that are not first fragments of the selected
+protocol never match.
+
+With BATCHER, RegexMatch also accepts batches on input 0.  It asks BATCHER
+for a slice of LENGTH bytes starting at the TCP or UDP payload of an
+untagged Ethernet/IPv4 packet without IP options, writes the SID of the
+lowest-numbered matching rule (or 0) to a 4-byte batch annotation, and
+pushes the batch to output 0.  Each batch is split among THREADS threads.
+
+Keyword arguments are:
+
+=over 8
+
+=item FILE
+
+Filename.  Snort-style rule file.
+
+=item PCRE
+
+String.  A PCRE to match, such as C<"/GET \/[a-z]+\.php/i">.  May be given
+more than once.
+
+=item PROTO
+
+Either C<tcp> or C<udp>.  Selects the payload and the rules to load; rules
+for C<ip> are always loaded.  Default is C<tcp>.
+
+=item LENGTH
+
+Integer.  Maximum number of payload bytes to scan per packet.  Default is
+256 with BATCHER and 65535 otherwise.
+
+=item MEMORY
+
+Integer.  Maximum bytes of DFA cache per thread.  Default is 1048576.
+
+=item BATCHER
+
+Element name.  The Batcher that produces batches for this element.
+
+=item ANNO
+
+Integer.  Start of the batch annotation that receives the result.  Default
+is 0.
+
+=item THREADS
+
+Integer.  Number of threads that scan each batch, including the one that
+pushed it.  Default is 1.
+
+=back
+
+=h rules read-only
+
+Returns the loaded rules, one per line: SID, number of packets matched,
+number of expressions, message.
+
+=h cache read-only
+
+Returns DFA cache statistics summed over all threads: states, bytes,
+flushes, and hit rate.
+
+=h hit_rate read-only
+
+Fraction of scanned bytes whose DFA transition was already cached.
+
+=h packets read-only
+
+=h matches read-only
+
+Number of packets that matched a rule.
+
+=h bytes read-only
+
+Number of payload bytes scanned.
+
+=h reset write-only
+
+Resets the counters.
+
+=a BPatternMatch, RegexSet, Batcher */
+
+class RegexMatch : public Element { public:
+
+    RegexMatch();
+    ~RegexMatch();
+
+    const char *class_name() const	{ return "RegexMatch"; }
+    const char *port_count() const	{ return "1/1-2"; }
+    const char *processing() const	{ return PUSH; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    int initialize(ErrorHandler *errh);
+    void cleanup(CleanupStage stage);
+    void add_handlers();
+
+    void push(int port, Packet *p);
+    void bpush(int port, PBatch *p);
+
+  private:
+
+    struct Rule {
+	uint32_t sid;
+	String msg;
+	int nexprs;
+    };
+
+    struct Counts {
+	uint64_t packets;
+	uint64_t bytes;
+	uint64_t matches;
+	Counts()
+	    : packets(0), bytes(0), matches(0) {
+	}
+	void operator+=(const Counts &x) {
+	    packets += x.packets;
+	    bytes += x.bytes;
+	    matches += x.matches;
+	}
+    };
+
+    // Per-thread match state, as in BPatternMatch.
+    struct Scanner {
+	const RegexMatch *rm;
+	RegexSet::DFA dfa;
+	Vector<uint32_t> expr_stamp;
+	Vector<uint32_t> rule_stamp;
+	Vector<int> rule_count;
+	Vector<uint64_t> rule_hits;
+	uint32_t stamp;
+	int best;
+	Counts counts;
+	void start();
+	void operator()(int id);
+	uint32_t match(const unsigned char *data, int len);
+    };
+
+    RegexSet _set;
+    Vector<Rule> _rules;
+    Vector<int> _expr_rule;
+    int _proto;
+    int _length;
+    uint32_t _memory;
+    int _anno;
+    int _nthreads;
+
+    BatchProducer *_batcher;
+    PSliceRange _psr;
+    int16_t _anno_offset;
+    int16_t _slice_offset;
+
+    Vector<Scanner> _scanners;	// one per Click thread, for push()
+    Vector<Scanner> _workers;	// one per pool thread, for bpush()
+    WorkerPool _pool;
+    PBatch *_batch;
+
+    int add_rule(uint32_t sid, const String &msg, const Vector<String> &pcres,
+		 const Vector<String> &contents, const Vector<int> &nocase,
+		 ErrorHandler *errh);
+    void init_scanner(Scanner &s) const;
+    inline Scanner &thread_scanner();
+    void scan(PBatch *p, int begin, int end, Scanner &s) const;
+    static void scan_job(void *arg, int index);
+
+    static String read_handler(Element *e, void *thunk);
+    static int write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,740 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * regexset.{cc,hh} -- regular expression sets with a lazy DFA
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "regexset.hh"
+#include <click/error.hh>
+#include <click/glue.hh>
+#include <click/straccum.hh>
+CLICK_DECLS
+
+// Parse tree node types.
+enum { N_SET, N_CAT, N_ALT, N_REPEAT, N_EMPTY };
+
+struct RegexNode {
+    int type;
+    int a;			// N_SET: set; N_CAT, N_ALT, N_REPEAT: child
+    int b;			// N_CAT, N_ALT: second child
+    int min;			// N_REPEAT
+    int max;			// N_REPEAT, -1 if unbounded
+};
+
+struct RegexFrag {
+    int start;
+    int end;			// an S_EMPTY state whose out is unset
+};
+
+class RegexParser { public:
+
+    RegexParser(RegexSet *set, const String &pattern, ErrorHandler *errh)
+	: _nocase(false), _dotall(false), _extended(false), _set(set),
+	  _pattern(pattern), _s(pattern.begin()), _end(pattern.end()),
+	  _errh(errh) {
+    }
+
+    bool _nocase;
+    bool _dotall;
+    bool _extended;
+
+    int parse(RegexFrag &frag);
+
+  private:
+
+    typedef RegexSet::CharSet CharSet;
+
+    RegexSet *_set;
+    String _pattern;
+    const char *_s;
+    const char *_end;
+    ErrorHandler *_errh;
+    Vector<RegexNode> _nodes;
+
+    int node(int type, int a = 0, int b = 0, int min = 0, int max = 0);
+    int set_node(const CharSet &cs);
+    int error(const char *what);
+    void skip_extended();
+    bool at(char c);
+
+    int parse_alt();
+    int parse_cat();
+    int parse_repeat();
+    int parse_atom();
+    int parse_class(CharSet &cs);
+    int parse_escape(CharSet &cs, bool in_class);
+    int parse_class_char(CharSet &cs);
+    void add_char(CharSet &cs, int c) const;
+
+    int build(int n, RegexFrag &frag);
+
+};
+
+int
+RegexParser::node(int type, int a, int b, int min, int max)
+{
+    RegexNode n;
+    n.type = type;
+    n.a = a;
+    n.b = b;
+    n.min = min;
+    n.max = max;
+    _nodes.push_back(n);
+    return _nodes.size() - 1;
+}
+
+int
+RegexParser::set_node(const CharSet &cs)
+{
+    _set->_sets.push_back(cs);
+    return node(N_SET, _set->_sets.size() - 1);
+}
+
+int
+RegexParser::error(const char *what)
+{
+    _errh->error("regex %<%s%> at offset %d: %s", _pattern.c_str(),
+		 (int) (_s - _pattern.begin()), what);
+    return -1;
+}
+
+void
+RegexParser::skip_extended()
+{
+    if (_extended)
+	while (_s != _end && (isspace((unsigned char) *_s) || *_s == '#')) {
+	    if (*_s == '#')
+		while (_s != _end && *_s != '\n')
+		    ++_s;
+	    else
+		++_s;
+	}
+}
+
+bool
+RegexParser::at(char c)
+{
+    skip_extended();
+    return _s != _end && *_s == c;
+}
+
+void
+RegexParser::add_char(CharSet &cs, int c) const
+{
+    cs.add(c);
+    if (_nocase && c >= 'a' && c <= 'z')
+	cs.add(c - 'a' + 'A');
+    else if (_nocase && c >= 'A' && c <= 'Z')
+	cs.add(c - 'A' + 'a');
+}
+
+int
+RegexParser::parse_alt()
+{
+    int n = parse_cat();
+    while (n >= 0 && at('|')) {
+	++_s;
+	int m = parse_cat();
+	if (m < 0)
+	    return -1;
+	n = node(N_ALT, n, m);
+    }
+    return n;
+}
+
+int
+RegexParser::parse_cat()
+{
+    int n = -1;
+    while (!at('|') && !at(')') && _s != _end) {
+	int m = parse_repeat();
+	if (m < 0)
+	    return -1;
+	n = (n < 0 ? m : node(N_CAT, n, m));
+    }
+    return n < 0 ? node(N_EMPTY) : n;
+}
+
+static bool
+parse_count(const char *&s, const char *end, int &x)
+{
+    if (s == end || !isdigit((unsigned char) *s))
+	return false;
+    for (x = 0; s != end && isdigit((unsigned char) *s); ++s)
+	if ((x = x * 10 + *s - '0') > 100000)
+	    x = 100000;
+    return true;
+}
+
+int
+RegexParser::parse_repeat()
+{
+    int n = parse_atom();
+    while (n >= 0) {
+	skip_extended();
+	if (_s == _end)
+	    break;
+	int min, max;
+	if (*_s == '*')
+	    min = 0, max = -1, ++_s;
+	else if (*_s == '+')
+	    min = 1, max = -1, ++_s;
+	else if (*_s == '?')
+	    min = 0, max = 1, ++_s;
+	else if (*_s == '{') {
+	    // "{" that does not start a valid quantifier is a literal
+	    const char *s = _s + 1;
+	    if (!parse_count(s, _end, min))
+		break;
+	    max = min;
+	    if (s != _end && *s == ',') {
+		++s;
+		if (!parse_count(s, _end, max))
+		    max = -1;
+	    }
+	    if (s == _end || *s != '}')
+		break;
+	    _s = s + 1;
+	    if (max >= 0 && max < min)
+		return error("bad repeat count");
+	    if (min > RegexSet::MAX_REPEAT || max > RegexSet::MAX_REPEAT)
+		return error("repeat count too large");
+	} else
+	    break;
+	if (_s != _end && *_s == '?')
+	    ++_s;		// lazy; the same for matching anywhere
+	else if (_s != _end && *_s == '+')
+	    return error("possessive quantifiers not supported");
+	n = node(N_REPEAT, n, 0, min, max);
+    }
+    return n;
+}
+
+// Parse an escape.  Return the escaped byte, or 256 after adding a class
+// such as \d to @a cs.
+int
+RegexParser::parse_escape(CharSet &cs, bool in_class)
+{
+    if (++_s == _end)
+	return error("trailing backslash");
+    int c = (unsigned char) *_s++;
+    switch (c) {
+    case 'd': case 'D': case 'w': case 'W': case 's': case 'S':
+	for (int b = 0; b < 256; ++b) {
+	    bool in;
+	    if (c == 'd' || c == 'D')
+		in = (b >= '0' && b <= '9');
+	    else if (c == 'w' || c == 'W')
+		in = isalnum(b) || b == '_';
+	    else
+		in = (b == ' ' || (b >= '\t' && b <= '\r'));
+	    if (in == (c >= 'a'))
+		cs.add(b);
+	}
+	return 256;
+    case 't':
+	return '\t';
+    case 'n':
+	return '\n';
+    case 'r':
+	return '\r';
+    case 'f':
+	return '\f';
+    case 'v':
+	return '\v';
+    case 'a':
+	return '\a';
+    case 'e':
+	return 27;
+    case '0':
+	return 0;
+    case 'x': {
+	bool brace = (_s != _end && *_s == '{');
+	if (brace)
+	    ++_s;
+	c = 0;
+	int ndigits = 0;
+	for (; _s != _end && isxdigit((unsigned char) *_s) && (brace || ndigits < 2); ++_s, ++ndigits) {
+	    c = c * 16 + (isdigit((unsigned char) *_s) ? *_s - '0' : (*_s | 0x20) - 'a' + 10);
+	    if (c > 255)
+		return error("character out of range");
+	}
+	if (brace && (_s == _end || *_s != '}'))
+	    return error("bad \\x{...} escape");
+	else if (brace)
+	    ++_s;
+	return c;
+    }
+    case 'b':
+	if (in_class)
+	    return '\b';
+	/* fallthru */
+    default:
+	if (isalnum(c))
+	    return error("unsupported escape");
+	return c;
+    }
+}
+
+// Parse one character in a class, adding escaped classes to @a cs.
+int
+RegexParser::parse_class_char(CharSet &cs)
+{
+    if (*_s == '\\')
+	return parse_escape(cs, true);
+    else if (*_s == '[' && _s + 1 != _end && _s[1] == ':')
+	return error("POSIX classes not supported");
+    else
+	return (unsigned char) *_s++;
+}
+
+int
+RegexParser::parse_class(CharSet &cs)
+{
+    ++_s;			// skip '['
+    bool negate = (_s != _end && *_s == '^');
+    if (negate)
+	++_s;
+    bool first = true;
+    while (_s != _end && (*_s != ']' || first)) {
+	first = false;
+	int lo = parse_class_char(cs);
+	if (lo < 0)
+	    return -1;
+	else if (lo == 256)
+	    continue;
+	if (_s + 1 < _end && *_s == '-' && _s[1] != ']') {
+	    ++_s;
+	    int hi = parse_class_char(cs);
+	    if (hi < 0)
+		return -1;
+	    else if (hi == 256 || hi < lo)
+		return error("bad character range");
+	    for (int b = lo; b <= hi; ++b)
+		add_char(cs, b);
+	} else
+	    add_char(cs, lo);
+    }
+    if (_s == _end)
+	return error("missing %<]%>");
+    ++_s;
+    if (negate)
+	for (int i = 0; i < 8; ++i)
+	    cs.w[i] = ~cs.w[i];
+    return 0;
+}
+
+int
+RegexParser::parse_atom()
+{
+    skip_extended();
+    if (_s == _end)
+	return node(N_EMPTY);
+    CharSet cs;
+    memset(&cs, 0, sizeof(cs));
+    int c;
+    switch (*_s) {
+    case '(': {
+	++_s;
+	if (_s != _end && *_s == '?') {
+	    if (_s + 1 != _end && _s[1] == ':')
+		_s += 2;
+	    else
+		return error("unsupported group");
+	}
+	int n = parse_alt();
+	if (n < 0)
+	    return -1;
+	if (!at(')'))
+	    return error("missing %<)%>");
+	++_s;
+	return n;
+    }
+    case '[':
+	if (parse_class(cs) < 0)
+	    return -1;
+	return set_node(cs);
+    case '.':
+	++_s;
+	for (int i = 0; i < 8; ++i)
+	    cs.w[i] = ~0U;
+	if (!_dotall)
+	    cs.w['\n' >> 5] &= ~(1U << ('\n' & 31));
+	return set_node(cs);
+    case '\\':
+	if ((c = parse_escape(cs, false)) < 0)
+	    return -1;
+	else if (c < 256)
+	    add_char(cs, c);
+	return set_node(cs);
+    case '*': case '+': case '?':
+	return error("nothing to repeat");
+    case '^': case '$':
+	return error("anchors are supported only at the ends");
+    default:
+	add_char(cs, (unsigned char) *_s++);
+	return set_node(cs);
+    }
+}
+
+int
+RegexParser::build(int n, RegexFrag &f)
+{
+    RegexNode x = _nodes[n];
+    RegexFrag g;
+    if (_set->_states.size() > RegexSet::MAX_STATES)
+	return error("expression too large");
+    switch (x.type) {
+    case N_SET:
+	f.end = _set->new_state(RegexSet::S_EMPTY, -1, -1, 0);
+	f.start = _set->new_state(RegexSet::S_CHARS, f.end, -1, x.a);
+	return 0;
+    case N_EMPTY:
+	f.start = f.end = _set->new_state(RegexSet::S_EMPTY, -1, -1, 0);
+	return 0;
+    case N_CAT:
+	if (build(x.a, f) < 0 || build(x.b, g) < 0)
+	    return -1;
+	_set->_states[f.end].out = g.start;
+	f.end = g.end;
+	return 0;
+    case N_ALT:
+	if (build(x.a, f) < 0 || build(x.b, g) < 0)
+	    return -1;
+	f.start = _set->new_state(RegexSet::S_SPLIT, f.start, g.start, 0);
+	_set->_states[f.end].out = g.end;
+	f.end = g.end;
+	return 0;
+    case N_REPEAT: {
+	// x{m,n} is m copies of x, then n - m optional copies.
+	f.start = f.end = _set->new_state(RegexSet::S_EMPTY, -1, -1, 0);
+	for (int i = 0; i < x.min; ++i) {
+	    if (build(x.a, g) < 0)
+		return -1;
+	    _set->_states[f.end].out = g.start;
+	    f.end = g.end;
+	}
+	int nopt = (x.max < 0 ? 1 : x.max - x.min);
+	for (int i = 0; i < nopt; ++i) {
+	    if (build(x.a, g) < 0)
+		return -1;
+	    int end = _set->new_state(RegexSet::S_EMPTY, -1, -1, 0);
+	    int split = _set->new_state(RegexSet::S_SPLIT, g.start, end, 0);
+	    _set->_states[f.end].out = split;
+	    _set->_states[g.end].out = (x.max < 0 ? split : end);
+	    f.end = end;
+	}
+	return 0;
+    }
+    default:
+	return error("internal error");
+    }
+}
+
+int
+RegexParser::parse(RegexFrag &frag)
+{
+    int n = parse_alt();
+    if (n < 0)
+	return -1;
+    if (_s != _end)
+	return error("unmatched %<)%>");
+    return build(n, frag);
+}
+
+
+// Return true if @a p has alternation outside any group.
+static bool
+top_level_alternation(const String &p)
+{
+    int depth = 0;
+    bool in_class = false;
+    for (const char *s = p.begin(); s != p.end(); ++s)
+	if (*s == '\\' && s + 1 != p.end())
+	    ++s;
+	else if (in_class)
+	    in_class = (*s != ']');
+	else if (*s == '[') {
+	    in_class = true;
+	    if (s + 1 != p.end() && s[1] == '^')
+		++s;
+	    if (s + 1 != p.end() && s[1] == ']')
+		++s;
+	} else if (*s == '(')
+	    ++depth;
+	else if (*s == ')')
+	    --depth;
+	else if (*s == '|' && depth == 0)
+	    return true;
+    return false;
+}
+
+
+RegexSet::RegexSet()
+    : _compiled(false), _nclasses(0)
+{
+}
+
+int
+RegexSet::new_state(int type, int out, int out1, int arg)
+{
+    NState s;
+    s.type = type;
+    s.out = out;
+    s.out1 = out1;
+    s.arg = arg;
+    _states.push_back(s);
+    return _states.size() - 1;
+}
+
+int
+RegexSet::add(const String &pattern, const String &flags, ErrorHandler *errh)
+{
+    if (_compiled)
+	return errh->error("regex set already compiled");
+
+    bool anchored = false, end_anchored = false, multiline = false;
+    String p = pattern;
+    if (p && p[0] == '^') {
+	anchored = true;
+	p = p.substring(1);
+    }
+    if (p && p.back() == '$') {
+	int nbackslash = 0;
+	for (int i = p.length() - 2; i >= 0 && p[i] == '\\'; --i)
+	    ++nbackslash;
+	if (nbackslash % 2 == 0) {
+	    end_anchored = true;
+	    p = p.substring(0, p.length() - 1);
+	}
+    }
+
+    RegexParser parser(this, p, errh);
+    for (const char *f = flags.begin(); f != flags.end(); ++f)
+	if (*f == 'i')
+	    parser._nocase = true;
+	else if (*f == 's')
+	    parser._dotall = true;
+	else if (*f == 'x')
+	    parser._extended = true;
+	else if (*f == 'm')
+	    multiline = true;
+	else if (*f == 'A')
+	    anchored = true;
+	else if (!isupper((unsigned char) *f))
+	    return errh->error("regex %<%s%>: unsupported flag %<%c%>", pattern.c_str(), *f);
+    if (multiline && (anchored || end_anchored))
+	return errh->error("regex %<%s%>: anchors with flag %<m%> not supported", pattern.c_str());
+    if ((p.length() != pattern.length()) && top_level_alternation(p))
+	return errh->error("regex %<%s%>: anchors with top-level %<|%> not supported; use a group", pattern.c_str());
+
+    int nstates = _states.size(), nsets = _sets.size();
+    RegexFrag frag;
+    if (parser.parse(frag) < 0) {
+	_states.resize(nstates);
+	_sets.resize(nsets);
+	return -1;
+    }
+    int id = _end_anchored.size();
+    _states[frag.end].out = new_state(S_MATCH, -1, -1, id);
+    (anchored ? _anchored_starts : _floating_starts).push_back(frag.start);
+    _end_anchored.push_back(end_anchored);
+    return id;
+}
+
+int
+RegexSet::add_pcre(const String &pcre, ErrorHandler *errh)
+{
+    if (!pcre || pcre[0] != '/')
+	return errh->error("regex %<%s%> must be written /.../", pcre.c_str());
+    int slash = pcre.length() - 1;
+    while (slash > 0 && pcre[slash] != '/')
+	--slash;
+    if (slash == 0)
+	return errh->error("regex %<%s%> must be written /.../", pcre.c_str());
+    return add(pcre.substring(1, slash - 1), pcre.substring(slash + 1), errh);
+}
+
+int
+RegexSet::add_literal(const String &literal, bool nocase)
+{
+    StringAccum sa;
+    for (const char *s = literal.begin(); s != literal.end(); ++s)
+	sa.snprintf(5, "\\x%02x", (unsigned char) *s);
+    return add(sa.take_string(), nocase ? "i" : "", ErrorHandler::silent_handler());
+}
+
+void
+RegexSet::closure(int q, Vector<int> &out, Vector<unsigned> &mark,
+		  unsigned stamp, Vector<int> &stack) const
+{
+    stack.push_back(q);
+    while (stack.size()) {
+	int x = stack.back();
+	stack.pop_back();
+	if (x < 0 || mark[x] == stamp)
+	    continue;
+	mark[x] = stamp;
+	const NState &s = _states[x];
+	if (s.type == S_CHARS || s.type == S_MATCH)
+	    out.push_back(x);
+	else {
+	    if (s.type == S_SPLIT)
+		stack.push_back(s.out1);
+	    stack.push_back(s.out);
+	}
+    }
+}
+
+void
+RegexSet::compile()
+{
+    if (_compiled)
+	return;
+    _compiled = true;
+
+    // Split bytes into classes that every character set treats alike.
+    memset(_class, 0, sizeof(_class));
+    _nclasses = 1;
+    Vector<int> map_in, map_out;
+    for (const CharSet *cs = _sets.begin(); cs != _sets.end(); ++cs) {
+	map_in.assign(_nclasses, -1);
+	map_out.assign(_nclasses, -1);
+	int n = 0;
+	for (int b = 0; b < 256; ++b) {
+	    int &m = (cs->has(b) ? map_in : map_out)[_class[b]];
+	    if (m < 0)
+		m = n++;
+	    _class[b] = m;
+	}
+	_nclasses = n;
+    }
+    _class_byte.assign(_nclasses, 0);
+    for (int b = 255; b >= 0; --b)
+	_class_byte[_class[b]] = b;
+
+    Vector<unsigned> mark(_states.size(), 0);
+    Vector<int> stack;
+    for (int i = 0; i < _floating_starts.size(); ++i)
+	closure(_floating_starts[i], _floating, mark, 1, stack);
+    _initial = _floating;
+    for (int i = 0; i < _anchored_starts.size(); ++i)
+	closure(_anchored_starts[i], _initial, mark, 1, stack);
+    click_qsort(_floating.begin(), _floating.size());
+    click_qsort(_initial.begin(), _initial.size());
+}
+
+
+RegexSet::DFA::DFA()
+    : _set(0), _max_bytes(0), _bytes(0), _nclasses(0), _stamp(0), _steps(0),
+      _misses(0), _flushes(0)
+{
+}
+
+void
+RegexSet::DFA::initialize(const RegexSet *set, size_t max_bytes)
+{
+    _set = set;
+    _max_bytes = max_bytes;
+    _nclasses = set->_nclasses;
+    _mark.assign(set->_states.size(), 0);
+    _stamp = 0;
+    flush();
+    _flushes = 0;
+}
+
+void
+RegexSet::DFA::flush()
+{
+    _states.clear();
+    _trans.clear();
+    _set_pool.clear();
+    _match_pool.clear();
+    _index.clear();
+    _bytes = 0;
+    ++_flushes;
+    add_state(_set->_initial);
+}
+
+int
+RegexSet::DFA::add_state(const Vector<int> &set)
+{
+    State st;
+    st.set_first = _set_pool.size();
+    st.set_len = set.size();
+    st.match_first = _match_pool.size();
+    st.nfloating = st.nend = 0;
+    for (int i = 0; i < set.size(); ++i) {
+	_set_pool.push_back(set[i]);
+	const NState &q = _set->_states[set[i]];
+	if (q.type == S_MATCH && !_set->_end_anchored[q.arg]) {
+	    _match_pool.push_back(q.arg);
+	    ++st.nfloating;
+	}
+    }
+    for (int i = 0; i < set.size(); ++i) {
+	const NState &q = _set->_states[set[i]];
+	if (q.type == S_MATCH && _set->_end_anchored[q.arg]) {
+	    _match_pool.push_back(q.arg);
+	    ++st.nend;
+	}
+    }
+    int s = _states.size();
+    _states.push_back(st);
+    _trans.resize(_trans.size() + _nclasses, UNKNOWN);
+    _index.set(String(reinterpret_cast<const char *>(set.begin()), set.size() * sizeof(int)), s);
+    _bytes += sizeof(State) + _nclasses * sizeof(uint32_t)
+	+ (2 * set.size() + st.nfloating + st.nend) * sizeof(int) + 32;
+    return s;
+}
+
+uint32_t
+RegexSet::DFA::transition(int s, int c)
+{
+    ++_misses;
+    if (++_stamp == 0) {
+	_mark.assign(_mark.size(), 0);
+	_stamp = 1;
+    }
+
+    int byte = _set->_class_byte[c];
+    _next.clear();
+    const State &st = _states[s];
+    for (int i = st.set_first; i < st.set_first + st.set_len; ++i) {
+	const NState &q = _set->_states[_set_pool[i]];
+	if (q.type == S_CHARS && _set->_sets[q.arg].has(byte))
+	    _set->closure(q.out, _next, _mark, _stamp, _stack);
+    }
+    const Vector<int> &floating = _set->_floating;
+    for (int i = 0; i < floating.size(); ++i)
+	if (_mark[floating[i]] != _stamp)
+	    _next.push_back(floating[i]);
+    click_qsort(_next.begin(), _next.size());
+
+    String key(reinterpret_cast<const char *>(_next.begin()), _next.size() * sizeof(int));
+    if (int *t = _index.get_pointer(key)) {
+	_trans[s * _nclasses + c] = entry(*t);
+	return entry(*t);
+    }
+    if (_bytes > _max_bytes) {
+	// The current state goes away, so its transition is not recorded.
+	flush();
+	return entry(add_state(_next));
+    }
+    int t = add_state(_next);
+    _trans[s * _nclasses + c] = entry(t);
+    return entry(t);
+}
+
+CLICK_ENDDECLS
+ELEMENT_PROVIDES(RegexSet)
@@ -0,0 +1,197 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_REGEXSET_HH
+#define CLICK_REGEXSET_HH
+#include <click/string.hh>
+#include <click/vector.hh>
+#include <click/hashtable.hh>
+CLICK_DECLS
+class ErrorHandler;
+
+/** @class RegexSet
+ * @brief A set of regular expressions compiled into one NFA.
+ *
+ * Regular expressions use a subset of PCRE syntax: literals, escapes
+ * including \\d, \\w, \\s and \\xHH, character classes, ".", groups,
+ * alternation, and the quantifiers *, +, ?, {m}, {m,} and {m,n}, greedy or
+ * lazy.  "^" may begin an expression and "$" may end it; "$" matches only
+ * at the very end of the input, not before a final newline.  Backreferences,
+ * lookaround, word boundaries and possessive quantifiers are rejected.
+ * Flags i, s, x and A are supported; uppercase Snort modifiers other than A
+ * are ignored.
+ *
+ * A RegexSet only says which expressions match somewhere in a buffer, not
+ * where.  Matching uses a RegexSet::DFA, which builds deterministic states
+ * from the NFA as input needs them.  The RegexSet is read-only after
+ * compile(), so any number of threads can match with their own DFAs. */
+class RegexSet { public:
+
+    RegexSet();
+
+    /** @brief Add an expression and return its ID, or a negative error.
+     * @param pattern expression
+     * @param flags PCRE flag letters */
+    int add(const String &pattern, const String &flags, ErrorHandler *errh);
+
+    /** @brief Add an expression written as "/pattern/flags". */
+    int add_pcre(const String &pcre, ErrorHandler *errh);
+
+    /** @brief Add an expression that matches @a literal. */
+    int add_literal(const String &literal, bool nocase);
+
+    /** @brief Prepare the NFA for matching.  No more expressions may be
+     * added. */
+    void compile();
+
+    int size() const			{ return _end_anchored.size(); }
+    int nstates() const			{ return _states.size(); }
+    int nclasses() const		{ return _nclasses; }
+
+    class DFA;
+
+  private:
+
+    enum { S_CHARS, S_SPLIT, S_EMPTY, S_MATCH };
+    enum { MAX_STATES = 1 << 20, MAX_REPEAT = 1000 };
+
+    struct CharSet {
+	uint32_t w[8];
+	bool has(int c) const		{ return w[c >> 5] & (1U << (c & 31)); }
+	void add(int c)			{ w[c >> 5] |= 1U << (c & 31); }
+    };
+
+    struct NState {
+	int type;
+	int out;
+	int out1;
+	int arg;		// S_CHARS: set index; S_MATCH: expression ID
+    };
+
+    Vector<NState> _states;
+    Vector<CharSet> _sets;
+    Vector<int> _anchored_starts;
+    Vector<int> _floating_starts;
+    Vector<int> _end_anchored;
+    bool _compiled;
+
+    uint8_t _class[256];
+    int _nclasses;
+    Vector<uint8_t> _class_byte;	// a byte in each class
+
+    // sorted S_CHARS and S_MATCH states reachable without input
+    Vector<int> _initial;		// from every start
+    Vector<int> _floating;		// from the unanchored starts
+
+    int new_state(int type, int out, int out1, int arg);
+    void closure(int q, Vector<int> &out, Vector<unsigned> &mark, unsigned stamp,
+		 Vector<int> &stack) const;
+
+    friend class RegexParser;
+
+};
+
+/** @class RegexSet::DFA
+ * @brief Lazily built DFA over a RegexSet.
+ *
+ * Each DFA state is a set of NFA states.  States and transitions are built
+ * the first time input needs them and cached.  When the cache would exceed
+ * its memory limit, it is flushed and rebuilding starts again from the
+ * current state. */
+class RegexSet::DFA { public:
+
+    DFA();
+
+    /** @brief Prepare to match @a set using at most about @a max_bytes of
+     * state cache. */
+    void initialize(const RegexSet *set, size_t max_bytes);
+
+    /** @brief Report the expressions that match in @a data.
+     *
+     * Calls @a f(id) at least once for each expression @a id that matches
+     * a substring of @a data, and possibly more than once. */
+    template <typename F> inline void scan(const unsigned char *data, int len, F &f);
+
+    int nstates() const			{ return _states.size(); }
+    size_t bytes() const		{ return _bytes; }
+    uint64_t steps() const		{ return _steps; }
+    uint64_t misses() const		{ return _misses; }
+    uint64_t flushes() const		{ return _flushes; }
+    void clear_stats()			{ _steps = _misses = _flushes = 0; }
+
+  private:
+
+    enum { MATCH_BIT = 0x80000000U, UNKNOWN = 0xFFFFFFFFU };
+
+    struct State {
+	int set_first;
+	int set_len;
+	int match_first;
+	int nfloating;		// matches anywhere
+	int nend;		// matches only at the end of the input
+    };
+
+    const RegexSet *_set;
+    size_t _max_bytes;
+    size_t _bytes;
+    int _nclasses;
+
+    Vector<State> _states;
+    Vector<uint32_t> _trans;
+    Vector<int> _set_pool;
+    Vector<int> _match_pool;
+    HashTable<String, int> _index;
+
+    Vector<unsigned> _mark;
+    unsigned _stamp;
+    Vector<int> _next;
+    Vector<int> _stack;
+
+    uint64_t _steps;
+    uint64_t _misses;
+    uint64_t _flushes;
+
+    void flush();
+    int add_state(const Vector<int> &set);
+    uint32_t transition(int s, int c);
+    inline uint32_t entry(int s) const;
+    template <typename F> inline void report(int s, bool end, F &f) const;
+
+};
+
+inline uint32_t
+RegexSet::DFA::entry(int s) const
+{
+    return s | (_states[s].nfloating ? (uint32_t) MATCH_BIT : 0);
+}
+
+template <typename F> inline void
+RegexSet::DFA::report(int s, bool end, F &f) const
+{
+    const State &st = _states[s];
+    const int *m = _match_pool.begin() + st.match_first;
+    for (int i = 0; i < st.nfloating; ++i)
+	f(m[i]);
+    if (end)
+	for (int i = st.nfloating; i < st.nfloating + st.nend; ++i)
+	    f(m[i]);
+}
+
+template <typename F> inline void
+RegexSet::DFA::scan(const unsigned char *data, int len, F &f)
+{
+    uint32_t s = 0;
+    report(0, len == 0, f);
+    for (int i = 0; i < len; ++i) {
+	uint32_t t = _trans[s * _nclasses + _set->_class[data[i]]];
+	if (t == UNKNOWN)
+	    t = transition(s, _set->_class[data[i]]);
+	s = t & ~MATCH_BIT;
+	if (t & MATCH_BIT)
+	    report(s, false, f);
+    }
+    if (len)
+	report(s, true, f);
+    _steps += len;
+}
+
+CLICK_ENDDECLS
+#endif
@@ -55,26 +55,29 @@ bool
 RoundRobinUnqueue::run_task(Task *)
 {
   int tries = 0;
-  Packet *p_next = input(_next).pull();
+  Packet *burst[PULL_BURST];
 
-  while (p_next) {
-    Packet *p = p_next;
-    tries++;
-    if (tries < _burst || _burst == 0) {
-      p_next = input(_next).pull();
-    } else
-      p_next = 0;
+  while (tries < _burst || _burst == 0) {
+    int want = PULL_BURST;
+    if (_burst && _burst - tries < want)
+      want = _burst - tries;
+    int n = input(_next).pull_burst(burst, want);
+    for (int i = 0; i < n; i++) {
 #ifdef CLICK_LINUXMODULE
 #if __i386__ && HAVE_INTEL_CPU
-    if (p_next) {
-      struct sk_buff *skb = p_next->skb();
-      asm volatile("prefetcht0 %0" : : "m" (skb->len));
-      asm volatile("prefetcht0 %0" : : "m" (skb->cb[0]));
-    }
+      if (i + 1 < n) {
+	struct sk_buff *skb = burst[i + 1]->skb();
+	asm volatile("prefetcht0 %0" : : "m" (skb->len));
+	asm volatile("prefetcht0 %0" : : "m" (skb->cb[0]));
+      }
 #endif
 #endif
-    output(_next).push(p);
-    _packets++;
+      output(_next).push(burst[i]);
+    }
+    tries += n;
+    _packets += n;
+    if (n < want)
+      break;
   }
 
   if (_next == noutputs()-1)
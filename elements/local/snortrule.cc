@@ -0,0 +1,197 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * snortrule.{cc,hh} -- parse the payload-matching parts of Snort rules
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "snortrule.hh"
+#include <click/algorithm.hh>
+#include <click/args.hh>
+#include <click/confparse.hh>
+#include <click/error.hh>
+#include <click/straccum.hh>
+#include <click/userutils.hh>
+CLICK_DECLS
+
+static int
+hexval(char c)
+{
+    if (c >= '0' && c <= '9')
+	return c - '0';
+    else if ((c >= 'A' && c <= 'F') || (c >= 'a' && c <= 'f'))
+	return (c | 0x20) - 'a' + 10;
+    else
+	return -1;
+}
+
+int
+SnortRule::parse_content(const String &str, String &result, ErrorHandler *errh)
+{
+    StringAccum sa;
+    const char *s = str.begin(), *end = str.end();
+    while (s != end) {
+	if (*s == '\\' && s + 1 != end) {
+	    sa << s[1];
+	    s += 2;
+	} else if (*s == '|') {
+	    for (++s; s != end && *s != '|'; ) {
+		if (isspace((unsigned char) *s)) {
+		    ++s;
+		    continue;
+		}
+		int hi = (s + 1 != end ? hexval(s[0]) : -1);
+		int lo = (hi >= 0 ? hexval(s[1]) : -1);
+		if (lo < 0)
+		    return errh->error("bad hex byte in content %<%s%>", str.c_str());
+		sa << (char) ((hi << 4) | lo);
+		s += 2;
+	    }
+	    if (s == end)
+		return errh->error("unterminated %<|%> in content %<%s%>", str.c_str());
+	    ++s;
+	} else
+	    sa << *s++;
+    }
+    if (!sa.length())
+	return errh->error("empty content");
+    result = sa.take_string();
+    return 0;
+}
+
+static bool
+unquote(String &value)
+{
+    if (value.length() < 2 || value[0] != '"' || value.back() != '"')
+	return false;
+    value = value.substring(1, value.length() - 2);
+    return true;
+}
+
+// Parse one Snort rule, such as
+//   alert tcp any any -> any 80 (msg:"x"; content:"GET|20|"; nocase; sid:1;)
+int
+SnortRule::parse(const String &line, ErrorHandler *errh)
+{
+    const char *s = line.begin(), *end = line.end();
+    while (s != end && isspace((unsigned char) *s))
+	++s;
+    if (s == end || *s == '#')
+	return 0;
+
+    const char *paren = find(s, end, '(');
+    const char *rparen = end;
+    while (rparen > paren && rparen[-1] != ')')
+	--rparen;
+    if (paren == end || rparen == paren)
+	return errh->error("missing rule options");
+    --rparen;
+    Vector<String> header;
+    cp_spacevec(line.substring(s, paren), header);
+    if (header.size() < 2)
+	return errh->error("missing rule protocol");
+    proto = header[1].lower();
+
+    bool have_sid = false;
+    bool last_negated = false;
+    for (s = paren + 1; s < rparen; ) {
+	while (s != rparen && isspace((unsigned char) *s))
+	    ++s;
+	const char *kw = s;
+	while (s != rparen && *s != ':' && *s != ';' && !isspace((unsigned char) *s))
+	    ++s;
+	String key = line.substring(kw, s).lower();
+	while (s != rparen && isspace((unsigned char) *s))
+	    ++s;
+	String value;
+	if (s != rparen && *s == ':') {
+	    for (++s; s != rparen && isspace((unsigned char) *s); ++s)
+		/* nada */;
+	    const char *v = s;
+	    bool quoted = false;
+	    for (; s != rparen && (quoted || *s != ';'); ++s)
+		if (*s == '\\' && s + 1 != rparen)
+		    ++s;
+		else if (*s == '"')
+		    quoted = !quoted;
+	    const char *vend = s;
+	    while (vend != v && isspace((unsigned char) vend[-1]))
+		--vend;
+	    value = line.substring(v, vend);
+	}
+	if (s != rparen)
+	    ++s;		// skip ';'
+
+	if (key == "content") {
+	    last_negated = value && value[0] == '!';
+	    if (last_negated)
+		continue;
+	    String c;
+	    if (!unquote(value))
+		return errh->error("content must be quoted");
+	    if (parse_content(value, c, errh) < 0)
+		return -1;
+	    contents.push_back(c);
+	    content_nocase.push_back(0);
+	} else if (key == "nocase") {
+	    if (!last_negated && contents.size())
+		content_nocase.back() = 1;
+	} else if (key == "pcre") {
+	    if (value && value[0] == '!')
+		continue;
+	    if (!unquote(value))
+		return errh->error("pcre must be quoted");
+	    pcres.push_back(value);
+	} else if (key == "sid") {
+	    if (!IntArg().parse(value, sid))
+		return errh->error("bad sid %<%s%>", value.c_str());
+	    have_sid = true;
+	} else if (key == "msg") {
+	    unquote(value);
+	    StringAccum sa;
+	    for (const char *m = value.begin(); m != value.end(); ++m)
+		if (*m != '\\' || m + 1 == value.end())
+		    sa << *m;
+	    msg = sa.take_string();
+	}
+    }
+
+    if (!contents.size() && !pcres.size())
+	return 0;
+    if (!have_sid || sid == 0)
+	return errh->error("rule needs a nonzero sid");
+    return 1;
+}
+
+int
+SnortRule::read_file(const String &filename, Vector<SnortRule> &rules,
+		     ErrorHandler *errh)
+{
+    int before = errh->nerrors();
+    String text = file_string(filename, errh);
+    if (errh->nerrors() != before)
+	return -1;
+    const char *s = text.begin(), *end = text.end();
+    for (int lineno = 1; s != end; ++lineno) {
+	const char *eol = find(s, end, '\n');
+	LandmarkErrorHandler lerrh(errh, filename + ":" + String(lineno));
+	SnortRule r;
+	if (r.parse(text.substring(s, eol), &lerrh) > 0)
+	    rules.push_back(r);
+	s = (eol == end ? end : eol + 1);
+    }
+    return errh->nerrors() == before ? 0 : -1;
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel)
+ELEMENT_PROVIDES(SnortRule)
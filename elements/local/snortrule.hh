@@ -0,0 +1,46 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_SNORTRULE_HH
+#define CLICK_SNORTRULE_HH
+#include <click/string.hh>
+#include <click/vector.hh>
+CLICK_DECLS
+class ErrorHandler;
+
+/** @class SnortRule
+ * @brief The payload-matching parts of a Snort rule.
+ *
+ * Only the protocol and the C<content>, C<nocase>, C<pcre>, C<sid> and
+ * C<msg> options are kept.  Other options, negated contents and negated
+ * PCREs are ignored. */
+class SnortRule { public:
+
+    String proto;		// lowercase, e.g. "tcp"
+    uint32_t sid;
+    String msg;
+    Vector<String> contents;	// decoded bytes
+    Vector<int> content_nocase;
+    Vector<String> pcres;	// "/regex/flags", quotes removed
+
+    SnortRule()
+	: sid(0) {
+    }
+
+    /** @brief Parse one rule line.
+     * @return 1 if the line holds a rule with content or PCRE, 0 if it is
+     * blank, a comment or a rule with neither, and negative on error */
+    int parse(const String &line, ErrorHandler *errh);
+
+    /** @brief Decode a content string, including |hex| bytes. */
+    static int parse_content(const String &str, String &result, ErrorHandler *errh);
+
+    /** @brief Append the rules in @a filename to @a rules.
+     *
+     * Errors are reported with the file name and line number.  Returns 0,
+     * or -1 if there were any errors. */
+    static int read_file(const String &filename, Vector<SnortRule> &rules,
+			 ErrorHandler *errh);
+
+};
+
+CLICK_ENDDECLS
+#endif
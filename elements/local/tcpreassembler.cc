@@ -0,0 +1,639 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * tcpreassembler.{cc,hh} -- reassemble TCP streams from many flows
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "tcpreassembler.hh"
+#include <click/args.hh>
+#include <click/confparse.hh>
+#include <click/error.hh>
+#include <click/straccum.hh>
+#include <clicknet/ip.h>
+#include <clicknet/tcp.h>
+CLICK_DECLS
+
+struct TCPReassembler::Emitter {
+
+    TCPReassembler *r;
+    uint32_t fi;
+    Packet *tmpl;
+    uint32_t hlen;
+    WritablePacket *q;
+    uint32_t pos;		// bytes written to q
+    uint32_t used;		// stream bytes in q, not counting the prefix
+    uint32_t seq;		// sequence number of q's first payload byte
+
+    Emitter(TCPReassembler *r_, uint32_t fi_, Packet *p)
+	: r(r_), fi(fi_), tmpl(p), q(0) {
+	hlen = p->transport_header() - p->network_header()
+	    + (p->tcp_header()->th_off << 2);
+    }
+
+    bool start() {
+	Flow &f = r->_flows[fi];
+	q = Packet::make(Packet::default_headroom, 0,
+			 hlen + r->_overlap + r->_chunk, 0);
+	if (!q)
+	    return false;
+	memcpy(q->data(), tmpl->network_header(), hlen);
+	if (f.tail_len)
+	    r->copy_out(f.tail_block, 0, q->data() + hlen, f.tail_len);
+	pos = hlen + f.tail_len;
+	used = 0;
+	seq = f.next_seq - f.tail_len;
+	return true;
+    }
+
+    // Append stream data from @a data or, if it is null, from arena block
+    // chain @a block starting at @a off.
+    void append(const unsigned char *data, uint32_t block, uint32_t off,
+		uint32_t len) {
+	while (len) {
+	    if (!q && !start()) {
+		r->_counts.dropped += len;
+		r->_flows[fi].next_seq += len;
+		return;
+	    }
+	    uint32_t n = r->_chunk - used;
+	    if (n > len)
+		n = len;
+	    if (data) {
+		memcpy(q->data() + pos, data, n);
+		data += n;
+	    } else {
+		r->copy_out(block, off, q->data() + pos, n);
+		off += n;
+	    }
+	    pos += n;
+	    used += n;
+	    len -= n;
+	    r->_flows[fi].next_seq += n;
+	    if (used == r->_chunk)
+		finish();
+	}
+    }
+
+    void finish() {
+	if (!q)
+	    return;
+	q->take(q->length() - pos);
+	click_ip *iph = reinterpret_cast<click_ip *>(q->data());
+	uint32_t iphlen = iph->ip_hl << 2;
+	q->set_ip_header(iph, iphlen);
+	iph->ip_len = htons(q->length());
+	iph->ip_sum = 0;
+	iph->ip_sum = click_in_cksum(reinterpret_cast<unsigned char *>(iph), iphlen);
+	click_tcp *tcph = q->tcp_header();
+	tcph->th_seq = htonl(seq);
+	tcph->th_flags &= ~(TH_SYN | TH_FIN | TH_RST);
+	q->set_timestamp_anno(tmpl->timestamp_anno());
+
+	// Remember the end of the stream for the next packet's prefix.
+	Flow &f = r->_flows[fi];
+	uint32_t payload = pos - hlen;
+	if (r->_overlap && f.tail_block == NONE)
+	    f.tail_block = r->alloc_blocks(1, fi);
+	if (f.tail_block != NONE) {
+	    f.tail_len = (payload < r->_overlap ? payload : r->_overlap);
+	    r->copy_in(f.tail_block, 0, q->data() + pos - f.tail_len, f.tail_len);
+	}
+
+	r->_counts.delivered += used;
+	r->output(0).push(q);
+	q = 0;
+    }
+
+};
+
+TCPReassembler::TCPReassembler()
+    : _policy(POLICY_FIRST), _overlap(0), _chunk(8192), _max_flows(1 << 20),
+      _memory(64 << 20), _flow_memory(65536), _block(256), _timeout(60),
+      _midstream(true), _flow_free(NONE), _lru_head(NONE), _lru_tail(NONE),
+      _seg_free(NONE), _arena(0), _block_free(NONE), _blocks_used(0),
+      _timer(this)
+{
+    memset(&_counts, 0, sizeof(_counts));
+}
+
+TCPReassembler::~TCPReassembler()
+{
+}
+
+static bool
+parse_policy(const String &str, int &policy)
+{
+    if (str.lower() == "first")
+	policy = 0;
+    else if (str.lower() == "last")
+	policy = 1;
+    else
+	return false;
+    return true;
+}
+
+int
+TCPReassembler::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    String policy = "first";
+    Vector<String> host_policies;
+    if (Args(conf, this, errh)
+	.read("POLICY", WordArg(), policy)
+	.read_all("HOST_POLICY", StringArg(), host_policies)
+	.read("OVERLAP", _overlap)
+	.read("CHUNK", _chunk)
+	.read("MAX_FLOWS", _max_flows)
+	.read("MEMORY", _memory)
+	.read("FLOW_MEMORY", _flow_memory)
+	.read("BLOCK", _block)
+	.read("TIMEOUT", _timeout)
+	.read("MIDSTREAM", _midstream)
+	.complete() < 0)
+	return -1;
+    if (!parse_policy(policy, _policy))
+	return errh->error("POLICY must be first or last");
+    for (int i = 0; i < host_policies.size(); ++i) {
+	Vector<String> words;
+	cp_spacevec(host_policies[i], words);
+	HostPolicy hp;
+	if (words.size() != 2
+	    || !IPPrefixArg(true).parse(words[0], hp.addr, hp.mask, this)
+	    || !parse_policy(words[1], hp.policy))
+	    return errh->error("HOST_POLICY should be %<PREFIX first|last%>");
+	_host_policies.push_back(hp);
+    }
+    if (_block < 16)
+	return errh->error("BLOCK too small");
+    if (_overlap > _block)
+	return errh->error("OVERLAP must be at most BLOCK");
+    if (_chunk == 0 || _chunk + _overlap > 65000)
+	return errh->error("CHUNK out of range");
+    if (_memory / _block < 2)
+	return errh->error("MEMORY too small");
+    if (_max_flows == 0 || _max_flows >= NONE)
+	return errh->error("MAX_FLOWS out of range");
+    if (_timeout == 0)
+	return errh->error("TIMEOUT must be positive");
+    return 0;
+}
+
+int
+TCPReassembler::initialize(ErrorHandler *errh)
+{
+    uint32_t nblocks = _memory / _block;
+    if (!(_arena = new unsigned char[(size_t) nblocks * _block]))
+	return errh->error("out of memory");
+    _block_next.resize(nblocks);
+    for (uint32_t b = 0; b < nblocks; ++b)
+	_block_next[b] = (b + 1 < nblocks ? b + 1 : (uint32_t) NONE);
+    _block_free = 0;
+    _timer.initialize(this);
+    _timer.schedule_after_sec(1);
+    return 0;
+}
+
+void
+TCPReassembler::cleanup(CleanupStage)
+{
+    delete[] _arena;
+    _arena = 0;
+}
+
+int
+TCPReassembler::host_policy(IPAddress dst) const
+{
+    int policy = _policy;
+    IPAddress best_mask;
+    for (const HostPolicy *hp = _host_policies.begin(); hp != _host_policies.end(); ++hp)
+	if (dst.matches_prefix(hp->addr, hp->mask)
+	    && (best_mask.empty() || hp->mask.mask_more_specific(best_mask))) {
+	    policy = hp->policy;
+	    best_mask = hp->mask;
+	}
+    return policy;
+}
+
+
+// Flows
+
+void
+TCPReassembler::lru_unlink(uint32_t fi)
+{
+    Flow &f = _flows[fi];
+    if (f.lru_prev != NONE)
+	_flows[f.lru_prev].lru_next = f.lru_next;
+    else
+	_lru_head = f.lru_next;
+    if (f.lru_next != NONE)
+	_flows[f.lru_next].lru_prev = f.lru_prev;
+    else
+	_lru_tail = f.lru_prev;
+}
+
+void
+TCPReassembler::lru_push_front(uint32_t fi)
+{
+    Flow &f = _flows[fi];
+    f.lru_prev = NONE;
+    f.lru_next = _lru_head;
+    if (_lru_head != NONE)
+	_flows[_lru_head].lru_prev = fi;
+    else
+	_lru_tail = fi;
+    _lru_head = fi;
+}
+
+uint32_t
+TCPReassembler::new_flow(const IPFlowID &id, Packet *p)
+{
+    if ((uint32_t) _map.size() >= _max_flows) {
+	remove_flow(_lru_tail);
+	++_counts.evicted;
+    }
+    uint32_t fi = _flow_free;
+    if (fi != NONE)
+	_flow_free = _flows[fi].lru_next;
+    else {
+	fi = _flows.size();
+	_flows.push_back(Flow());
+    }
+    Flow &f = _flows[fi];
+    f.id = id;
+    f.next_seq = f.fin_seq = 0;
+    f.seg = f.tail_block = NONE;
+    f.buffered = f.tail_len = 0;
+    f.active = click_jiffies();
+    f.policy = host_policy(p->ip_header()->ip_dst);
+    f.flags = 0;
+    _map.set(id, fi);
+    lru_push_front(fi);
+    return fi;
+}
+
+void
+TCPReassembler::free_segments(Flow &f)
+{
+    while (f.seg != NONE) {
+	uint32_t si = f.seg;
+	free_blocks(_segs[si].block);
+	f.seg = _segs[si].next;
+	_segs[si].next = _seg_free;
+	_seg_free = si;
+    }
+    f.buffered = 0;
+    if (f.tail_block != NONE)
+	free_blocks(f.tail_block);
+    f.tail_block = NONE;
+    f.tail_len = 0;
+}
+
+void
+TCPReassembler::remove_flow(uint32_t fi)
+{
+    Flow &f = _flows[fi];
+    free_segments(f);
+    _map.erase(f.id);
+    lru_unlink(fi);
+    f.lru_next = _flow_free;
+    _flow_free = fi;
+}
+
+void
+TCPReassembler::run_timer(Timer *)
+{
+    uint32_t now = click_jiffies();
+    while (_lru_tail != NONE
+	   && now - _flows[_lru_tail].active >= _timeout * CLICK_HZ) {
+	remove_flow(_lru_tail);
+	++_counts.timed_out;
+    }
+    _timer.reschedule_after_sec(1);
+}
+
+
+// Arena
+
+uint32_t
+TCPReassembler::alloc_blocks(uint32_t n, uint32_t keep_flow)
+{
+    // Out of blocks: drop the data of the least recently active flows.
+    uint32_t fi = _lru_tail;
+    while (_block_next.size() - _blocks_used < n && fi != NONE) {
+	Flow &f = _flows[fi];
+	if (fi != keep_flow && (f.seg != NONE || f.tail_block != NONE)) {
+	    _counts.dropped += f.buffered;
+	    free_segments(f);
+	}
+	fi = f.lru_prev;
+    }
+    if (_block_next.size() - _blocks_used < n)
+	return NONE;
+
+    uint32_t first = _block_free, b = first;
+    for (uint32_t i = 1; i < n; ++i)
+	b = _block_next[b];
+    _block_free = _block_next[b];
+    _block_next[b] = NONE;
+    _blocks_used += n;
+    return first;
+}
+
+void
+TCPReassembler::free_blocks(uint32_t b)
+{
+    uint32_t first = b, n = 1;
+    for (; _block_next[b] != NONE; b = _block_next[b])
+	++n;
+    _block_next[b] = _block_free;
+    _block_free = first;
+    _blocks_used -= n;
+}
+
+void
+TCPReassembler::copy_in(uint32_t b, uint32_t off, const unsigned char *data,
+			uint32_t len)
+{
+    for (; off >= _block; off -= _block)
+	b = _block_next[b];
+    while (len) {
+	uint32_t n = _block - off;
+	if (n > len)
+	    n = len;
+	memcpy(_arena + (size_t) b * _block + off, data, n);
+	data += n;
+	len -= n;
+	off = 0;
+	b = _block_next[b];
+    }
+}
+
+void
+TCPReassembler::copy_out(uint32_t b, uint32_t off, unsigned char *data,
+			 uint32_t len) const
+{
+    for (; off >= _block; off -= _block)
+	b = _block_next[b];
+    while (len) {
+	uint32_t n = _block - off;
+	if (n > len)
+	    n = len;
+	memcpy(data, _arena + (size_t) b * _block + off, n);
+	data += n;
+	len -= n;
+	off = 0;
+	b = _block_next[b];
+    }
+}
+
+
+// Segments
+
+bool
+TCPReassembler::add_segment(uint32_t fi, uint32_t prev, uint32_t seq,
+			    const unsigned char *data, uint32_t len)
+{
+    uint32_t block = alloc_blocks((len + _block - 1) / _block, fi);
+    if (block == NONE) {
+	_counts.dropped += len;
+	return false;
+    }
+    copy_in(block, 0, data, len);
+
+    uint32_t si = _seg_free;
+    if (si != NONE)
+	_seg_free = _segs[si].next;
+    else {
+	si = _segs.size();
+	_segs.push_back(Segment());
+    }
+    Segment &s = _segs[si];
+    Flow &f = _flows[fi];
+    s.seq = seq;
+    s.len = len;
+    s.block = block;
+    if (prev == NONE) {
+	s.next = f.seg;
+	f.seg = si;
+    } else {
+	s.next = _segs[prev].next;
+	_segs[prev].next = si;
+    }
+    f.buffered += len;
+    return true;
+}
+
+void
+TCPReassembler::insert(uint32_t fi, uint32_t seq, const unsigned char *data,
+		       uint32_t len)
+{
+    uint32_t end = seq + len;
+    uint32_t prev = NONE, cur = _flows[fi].seg;
+    while (SEQ_LT(seq, end)) {
+	if (cur == NONE || SEQ_LEQ(end, _segs[cur].seq)) {
+	    add_segment(fi, prev, seq, data, end - seq);
+	    return;
+	}
+	Segment s = _segs[cur];
+	uint32_t s_end = s.seq + s.len;
+	if (SEQ_LEQ(s_end, seq)) {
+	    prev = cur;
+	    cur = s.next;
+	} else if (SEQ_LT(seq, s.seq)) {
+	    // the gap before s
+	    uint32_t n = s.seq - seq;
+	    if (add_segment(fi, prev, seq, data, n))
+		prev = (prev == NONE ? _flows[fi].seg : _segs[prev].next);
+	    seq += n;
+	    data += n;
+	} else {
+	    // the part that overlaps s
+	    uint32_t n = (SEQ_LT(end, s_end) ? end : s_end) - seq;
+	    if (_flows[fi].policy == POLICY_LAST)
+		copy_in(s.block, seq - s.seq, data, n);
+	    _counts.overlap += n;
+	    seq += n;
+	    data += n;
+	    prev = cur;
+	    cur = s.next;
+	}
+    }
+}
+
+void
+TCPReassembler::drain(uint32_t fi, Emitter &e)
+{
+    Flow &f = _flows[fi];
+    while (f.seg != NONE && SEQ_LEQ(_segs[f.seg].seq, f.next_seq)) {
+	uint32_t si = f.seg;
+	Segment &s = _segs[si];
+	uint32_t s_end = s.seq + s.len;
+	if (SEQ_GT(s_end, f.next_seq)) {
+	    uint32_t off = f.next_seq - s.seq;
+	    e.append(0, s.block, off, s_end - f.next_seq);
+	}
+	f.seg = s.next;
+	f.buffered -= s.len;
+	free_blocks(s.block);
+	s.next = _seg_free;
+	_seg_free = si;
+    }
+}
+
+
+void
+TCPReassembler::push(int, Packet *p)
+{
+    ++_counts.packets;
+    const click_ip *iph = p->ip_header();
+    if (!p->has_network_header() || iph->ip_p != IP_PROTO_TCP
+	|| !IP_FIRSTFRAG(iph) || p->transport_length() < (int) sizeof(click_tcp)) {
+	checked_output_push(1, p);
+	return;
+    }
+    const click_tcp *tcph = p->tcp_header();
+    const unsigned char *data = p->transport_header() + (tcph->th_off << 2);
+    const unsigned char *end = p->network_header() + ntohs(iph->ip_len);
+    if (end > p->end_data())
+	end = p->end_data();
+    uint32_t len = (data < end ? end - data : 0);
+    uint32_t seq = ntohl(tcph->th_seq);
+    uint8_t flags = tcph->th_flags;
+
+    IPFlowID id(p);
+    uint32_t *fip = _map.get_pointer(id);
+    uint32_t fi;
+    if (flags & TH_RST) {
+	if (fip)
+	    remove_flow(*fip);
+	checked_output_push(1, p);
+	return;
+    } else if (fip) {
+	fi = *fip;
+	Flow &f = _flows[fi];
+	if ((flags & TH_SYN) && seq + 1 != f.next_seq) {
+	    // a new connection with the same addresses and ports
+	    free_segments(f);
+	    f.next_seq = seq + 1;
+	    f.flags = 0;
+	}
+	f.active = click_jiffies();
+	if (_lru_head != fi) {
+	    lru_unlink(fi);
+	    lru_push_front(fi);
+	}
+    } else if ((flags & TH_SYN) || _midstream) {
+	fi = new_flow(id, p);
+	_flows[fi].next_seq = seq + ((flags & TH_SYN) ? 1 : 0);
+    } else {
+	checked_output_push(1, p);
+	return;
+    }
+
+    Flow &f = _flows[fi];
+    if (flags & TH_SYN)
+	++seq;
+    if (flags & TH_FIN) {
+	f.fin_seq = seq + len;
+	f.flags |= F_FIN;
+    }
+
+    // Drop data that was already delivered.
+    if (len && SEQ_LT(seq, f.next_seq)) {
+	uint32_t n = f.next_seq - seq;
+	if (n > len)
+	    n = len;
+	_counts.overlap += n;
+	seq += n;
+	data += n;
+	len -= n;
+    }
+
+    Emitter e(this, fi, p);
+    bool consumed = false;
+    if (len && seq == f.next_seq && f.seg == NONE && !_overlap
+	&& !(flags & TH_SYN) && data == p->transport_header() + (tcph->th_off << 2)
+	&& len <= _chunk) {
+	// In order with nothing buffered: the packet is its own chunk.
+	f.next_seq += len;
+	_counts.delivered += len;
+	if (noutputs() > 1)
+	    output(0).push(p->clone());
+	else {
+	    output(0).push(p);
+	    consumed = true;
+	}
+    } else if (len) {
+	if (seq == f.next_seq && f.seg == NONE)
+	    e.append(data, 0, 0, len);
+	else
+	    insert(fi, seq, data, len);
+	drain(fi, e);
+	// Too much buffered: skip the hole before the first segment.
+	while (f.buffered > _flow_memory && f.seg != NONE) {
+	    _counts.skipped += _segs[f.seg].seq - f.next_seq;
+	    f.next_seq = _segs[f.seg].seq;
+	    drain(fi, e);
+	}
+	e.finish();
+    }
+
+    if ((f.flags & F_FIN) && f.seg == NONE && SEQ_GEQ(f.next_seq, f.fin_seq))
+	remove_flow(fi);
+    if (!consumed)
+	checked_output_push(1, p);
+}
+
+enum { h_flows, h_memory, h_stats, h_reset };
+
+String
+TCPReassembler::read_handler(Element *e, void *thunk)
+{
+    TCPReassembler *r = static_cast<TCPReassembler *>(e);
+    switch ((intptr_t) thunk) {
+    case h_flows:
+	return String(r->_map.size());
+    case h_memory:
+	return String((uint64_t) r->_blocks_used * r->_block);
+    case h_stats: {
+	const Counts &c = r->_counts;
+	StringAccum sa;
+	sa << "packets " << c.packets << "\ndelivered " << c.delivered
+	   << "\noverlap " << c.overlap << "\nskipped " << c.skipped
+	   << "\ndropped " << c.dropped << "\nevicted " << c.evicted
+	   << "\ntimed_out " << c.timed_out << '\n';
+	return sa.take_string();
+    }
+    default:
+	return String();
+    }
+}
+
+int
+TCPReassembler::write_handler(const String &, Element *e, void *, ErrorHandler *)
+{
+    TCPReassembler *r = static_cast<TCPReassembler *>(e);
+    memset(&r->_counts, 0, sizeof(r->_counts));
+    return 0;
+}
+
+void
+TCPReassembler::add_handlers()
+{
+    add_read_handler("flows", read_handler, h_flows);
+    add_read_handler("memory", read_handler, h_memory);
+    add_read_handler("stats", read_handler, h_stats);
+    add_write_handler("reset", write_handler, h_reset, Handler::BUTTON);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(TCPReassembler)
@@ -0,0 +1,245 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_TCPREASSEMBLER_HH
+#define CLICK_TCPREASSEMBLER_HH
+#include <click/element.hh>
+#include <click/hashtable.hh>
+#include <click/ipflowid.hh>
+#include <click/timer.hh>
+CLICK_DECLS
+
+/*
+=c
+
+TCPReassembler(I<keywords> POLICY, HOST_POLICY, OVERLAP, CHUNK, MAX_FLOWS,
+  MEMORY, FLOW_MEMORY, BLOCK, TIMEOUT, MIDSTREAM)
+
+=s tcp
+
+reassembles TCP streams for payload matching
+
+=d
+
+Reorders the TCP segments of many connections and emits each direction of
+each connection as an in-order byte stream, so that a payload matcher
+downstream sees signatures that span segment boundaries.  Expects TCP/IP
+packets with IP and transport header annotations, such as those produced by
+CheckIPHeader.
+
+Each emitted packet carries the IP and TCP headers of the segment that
+completed it, followed by up to CHUNK bytes of stream data; its TCP
+sequence number is that of its first data byte.  With OVERLAP, each packet
+starts with the last OVERLAP bytes of the previous packet of the same
+stream, so a matcher that looks at one packet at a time still finds
+signatures up to OVERLAP + 1 bytes long that cross packet boundaries.  IP
+checksums of emitted packets are valid; TCP checksums are not.
+
+The input packets themselves are emitted on output 1 if it exists, and
+dropped otherwise.
+
+Flows are kept in one hash table keyed by the IP addresses and ports, so
+one element handles every connection.  Out-of-order data is copied into an
+arena of fixed-size BLOCKs allocated at initialization, which bounds
+memory regardless of the number of flows.  When a flow's buffered data
+would exceed FLOW_MEMORY, its stream skips ahead to the first buffered
+byte.  When the arena is full, the least recently active flows lose their
+buffered data.  Flows end on RST, after their FIN is delivered, after
+TIMEOUT seconds without packets, or when MAX_FLOWS flows already exist and
+the least recently active one is evicted.
+
+When a segment overlaps data that is buffered but not yet delivered, the
+flow's policy decides whose bytes win: C<first> keeps the buffered bytes,
+as BSD and Windows receivers do; C<last> keeps the new bytes, as Linux
+receivers do for most overlaps.  Data that overlaps already delivered bytes
+is always discarded.
+
+Keyword arguments are:
+
+=over 8
+
+=item POLICY
+
+Either C<first> or C<last>.  Default overlap policy.  Default is C<first>.
+
+=item HOST_POLICY
+
+String, C<PREFIX POLICY>, such as C<"10.0.0.0/8 last">.  Use POLICY for
+streams whose receiver's address is in PREFIX; the longest matching prefix
+wins.  May be given more than once.
+
+=item OVERLAP
+
+Integer.  Number of trailing bytes repeated at the start of the next
+emitted packet of a stream.  At most BLOCK.  Default is 0.
+
+=item CHUNK
+
+Integer.  Maximum stream bytes per emitted packet, not counting OVERLAP.
+Default is 8192.
+
+=item MAX_FLOWS
+
+Integer.  Maximum number of flows (stream directions).  Default is 1048576.
+
+=item MEMORY
+
+Integer.  Bytes in the segment arena.  Default is 67108864.
+
+=item FLOW_MEMORY
+
+Integer.  Maximum out-of-order bytes buffered per flow.  Default is 65536.
+
+=item BLOCK
+
+Integer.  Arena block size in bytes.  Default is 256.
+
+=item TIMEOUT
+
+Integer.  Seconds of inactivity after which a flow is removed.  Default is
+60.
+
+=item MIDSTREAM
+
+Boolean.  Whether to start reassembly at the first packet seen for a flow
+even if it is not a SYN.  If false, flows start only at SYNs.  Default is
+true.
+
+=back
+
+=h flows read-only
+
+Number of flows.
+
+=h memory read-only
+
+Bytes of arena in use.
+
+=h stats read-only
+
+Returns counters, one per line: packets, delivered bytes, overlapping
+bytes, skipped bytes, bytes dropped for lack of memory, evicted flows and
+timed out flows.
+
+=h reset write-only
+
+Resets the counters.
+
+=a TCPBuffer, RegexMatch, BPatternMatch, CheckIPHeader */
+
+class TCPReassembler : public Element { public:
+
+    TCPReassembler();
+    ~TCPReassembler();
+
+    const char *class_name() const	{ return "TCPReassembler"; }
+    const char *port_count() const	{ return "1/1-2"; }
+    const char *processing() const	{ return PUSH; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    int initialize(ErrorHandler *errh);
+    void cleanup(CleanupStage stage);
+    void add_handlers();
+
+    void push(int port, Packet *p);
+    void run_timer(Timer *timer);
+
+  private:
+
+    enum { NONE = 0xFFFFFFFFU };
+    enum { POLICY_FIRST, POLICY_LAST };
+    enum { F_FIN = 1 };
+
+    struct HostPolicy {
+	IPAddress addr;
+	IPAddress mask;
+	int policy;
+    };
+
+    // A run of buffered bytes, stored in a chain of arena blocks.  Each
+    // flow's segments are sorted and do not overlap.
+    struct Segment {
+	uint32_t seq;
+	uint32_t len;
+	uint32_t block;
+	uint32_t next;
+    };
+
+    struct Flow {
+	IPFlowID id;
+	uint32_t next_seq;	// next sequence number to deliver
+	uint32_t fin_seq;
+	uint32_t seg;		// first buffered segment
+	uint32_t buffered;	// buffered bytes
+	uint32_t tail_block;	// last OVERLAP delivered bytes
+	uint32_t tail_len;
+	uint32_t lru_prev;	// least recently active flows are at the tail
+	uint32_t lru_next;	// also links free flows
+	uint32_t active;	// click_jiffies() of last packet
+	uint8_t policy;
+	uint8_t flags;
+    };
+
+    struct Counts {
+	uint64_t packets;
+	uint64_t delivered;
+	uint64_t overlap;
+	uint64_t skipped;
+	uint64_t dropped;
+	uint64_t evicted;
+	uint64_t timed_out;
+    };
+
+    // Builds emitted packets for one stream.
+    struct Emitter;
+
+    int _policy;
+    Vector<HostPolicy> _host_policies;
+    uint32_t _overlap;
+    uint32_t _chunk;
+    uint32_t _max_flows;
+    uint32_t _memory;
+    uint32_t _flow_memory;
+    uint32_t _block;
+    uint32_t _timeout;
+    bool _midstream;
+
+    HashTable<IPFlowID, uint32_t> _map;
+    Vector<Flow> _flows;
+    uint32_t _flow_free;
+    uint32_t _lru_head;
+    uint32_t _lru_tail;
+
+    Vector<Segment> _segs;
+    uint32_t _seg_free;
+
+    unsigned char *_arena;
+    Vector<uint32_t> _block_next;
+    uint32_t _block_free;
+    uint32_t _blocks_used;
+
+    Timer _timer;
+    Counts _counts;
+
+    int host_policy(IPAddress dst) const;
+    uint32_t new_flow(const IPFlowID &id, Packet *p);
+    void remove_flow(uint32_t fi);
+    void lru_unlink(uint32_t fi);
+    void lru_push_front(uint32_t fi);
+    void free_segments(Flow &f);
+
+    uint32_t alloc_blocks(uint32_t n, uint32_t keep_flow);
+    void free_blocks(uint32_t b);
+    void copy_in(uint32_t b, uint32_t off, const unsigned char *data, uint32_t len);
+    void copy_out(uint32_t b, uint32_t off, unsigned char *data, uint32_t len) const;
+
+    bool add_segment(uint32_t fi, uint32_t prev, uint32_t seq,
+		     const unsigned char *data, uint32_t len);
+    void insert(uint32_t fi, uint32_t seq, const unsigned char *data, uint32_t len);
+    void drain(uint32_t fi, Emitter &e);
+
+    static String read_handler(Element *e, void *thunk);
+    static int write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh);
+
+};
+
+CLICK_ENDDECLS
+#endif
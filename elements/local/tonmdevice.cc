@@ -28,7 +28,7 @@
 CLICK_DECLS
 
 ToNMDevice::ToNMDevice()
-    : _task(this), _timer(&_task), _q(0), _pulls(0)
+    : _task(this), _timer(&_task), _qhead(0), _qtail(0), _pulls(0)
 {
     _fd = -1;
     _my_fd = false;
@@ -140,6 +140,9 @@ ToNMDevice::cleanup(CleanupStage)
 	_netmap.close(_fd);
 	_fd = -1;
     }
+
+    while (_qhead < _qtail)
+	_q[_qhead++]->kill();
 }
 
 
@@ -205,22 +208,18 @@ ToNMDevice::send_packet(Packet *p)
 int
 ToNMDevice::send_packets_nm()
 {
-    Packet *p = _q;
-    _q = 0;
+    Packet *p;
     int count = 0, r=0;
 
     do {
-	if (!p) {
-	    if (!(p = input(0).pull()))
-		break;
-	}
+	if (!(p = next_packet(_burst - count)))
+	    break;
 	
 	if ((r = netmap_send_packet(p)) >= 0) {
 	    p->kill();
-	    p=0;
 	} else {
 	    _backoff = 1;
-	    _q = p;
+	    --_qhead;
 	    break;
 	}
     } while (count < _burst);
@@ -243,16 +242,12 @@ ToNMDevice::run_task(Task *)
 	    return false;
     }
     
-    Packet *p = _q;
-    _q = 0;
+    Packet *p = 0;
     int count = 0;
 
     do {
-	if (!p) {
-	    ++_pulls;
-	    if (!(p = input(0).pull()))
-		break;
-	}
+	if (!(p = next_packet(_burst - count)))
+	    break;
 	if ((r = send_packet(p)) >= 0) {
 	    _backoff = 0;
 	    checked_output_push(0, p);
@@ -263,8 +258,7 @@ ToNMDevice::run_task(Task *)
     } while (count < _burst);
 
     if (r == -ENOBUFS || r == -EAGAIN) {
-	assert(!_q);
-	_q = p;
+	--_qhead;
 
 	if (!_backoff) {
 	    _backoff = 1;
@@ -286,7 +280,7 @@ ToNMDevice::run_task(Task *)
 	checked_output_push(1, p);
     }
 
-    if (p)
+    if (p || _qhead < _qtail)
 	_task.fast_reschedule();
     return count > 0;
 }
@@ -315,7 +309,7 @@ ToNMDevice::read_param(Element *e, void *thunk)
     case h_pulls:
 	return String(td->_pulls);
     case h_q:
-	return String((bool) td->_q);
+	return String(td->_qhead < td->_qtail);
     default:
 	return String();
     }
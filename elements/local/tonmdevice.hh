@@ -47,7 +47,10 @@ class ToNMDevice : public Element { public:
     int _ringid;
     NotifierSignal _signal;
 
-    Packet *_q;
+    // Packets pulled but not yet sent.
+    Packet *_q[PULL_BURST];
+    int _qhead;
+    int _qtail;
     int _burst;
 
     int _full_nm;
@@ -60,6 +63,7 @@ class ToNMDevice : public Element { public:
 
     enum { h_debug, h_signal, h_pulls, h_q };
     FromNMDevice *find_fromnmdevice() const;
+    inline Packet *next_packet(int max);
     int send_packet(Packet *p);
     static int write_param(
 	const String &in_s, Element *e, void *vparam, ErrorHandler *errh);
@@ -67,5 +71,21 @@ class ToNMDevice : public Element { public:
 
 };
 
+/* Return the next packet to send, pulling a burst of up to @a max packets
+   from upstream when none are left over from an earlier burst.  A packet
+   that cannot be sent is returned to the buffer with --_qhead. */
+inline Packet *
+ToNMDevice::next_packet(int max)
+{
+    if (_qhead == _qtail) {
+	++_pulls;
+	_qhead = 0;
+	_qtail = input(0).pull_burst(_q, max < PULL_BURST ? max : PULL_BURST);
+	if (!_qtail)
+	    return 0;
+    }
+    return _q[_qhead++];
+}
+
 CLICK_ENDDECLS
 #endif
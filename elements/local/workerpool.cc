@@ -0,0 +1,130 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * workerpool.{cc,hh} -- threads that split a job
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "workerpool.hh"
+#include <errno.h>
+CLICK_DECLS
+
+WorkerPool::WorkerPool()
+    : _nthreads(1), _workers(0), _job(0), _arg(0), _gen(0), _pending(0),
+      _quit(false)
+{
+    pthread_mutex_init(&_lock, 0);
+    pthread_cond_init(&_start_cond, 0);
+    pthread_cond_init(&_done_cond, 0);
+}
+
+WorkerPool::~WorkerPool()
+{
+    stop();
+    pthread_cond_destroy(&_done_cond);
+    pthread_cond_destroy(&_start_cond);
+    pthread_mutex_destroy(&_lock);
+}
+
+int
+WorkerPool::start(int nthreads)
+{
+    stop();
+    if (nthreads < 1)
+	return -EINVAL;
+    _quit = false;
+    if (nthreads > 1)
+	_workers = new Worker[nthreads - 1];
+    for (int i = 1; i < nthreads; ++i) {
+	Worker &w = _workers[i - 1];
+	w.pool = this;
+	w.index = i;
+	if (int r = pthread_create(&w.thread, 0, worker_thread, &w)) {
+	    _nthreads = i;
+	    stop();
+	    return -r;
+	}
+	_nthreads = i + 1;
+    }
+    return 0;
+}
+
+void
+WorkerPool::stop()
+{
+    if (_workers) {
+	pthread_mutex_lock(&_lock);
+	_quit = true;
+	pthread_cond_broadcast(&_start_cond);
+	pthread_mutex_unlock(&_lock);
+	for (int i = 1; i < _nthreads; ++i)
+	    pthread_join(_workers[i - 1].thread, 0);
+	delete[] _workers;
+	_workers = 0;
+    }
+    _nthreads = 1;
+}
+
+void *
+WorkerPool::worker_thread(void *arg)
+{
+    Worker *w = static_cast<Worker *>(arg);
+    WorkerPool *pool = w->pool;
+    pthread_mutex_lock(&pool->_lock);
+    unsigned gen = pool->_gen;
+    while (1) {
+	while (!pool->_quit && pool->_gen == gen)
+	    pthread_cond_wait(&pool->_start_cond, &pool->_lock);
+	if (pool->_quit)
+	    break;
+	gen = pool->_gen;
+	job_type job = pool->_job;
+	void *job_arg = pool->_arg;
+	pthread_mutex_unlock(&pool->_lock);
+
+	job(job_arg, w->index);
+
+	pthread_mutex_lock(&pool->_lock);
+	if (--pool->_pending == 0)
+	    pthread_cond_signal(&pool->_done_cond);
+    }
+    pthread_mutex_unlock(&pool->_lock);
+    return 0;
+}
+
+void
+WorkerPool::run(job_type job, void *arg)
+{
+    if (_nthreads == 1) {
+	job(arg, 0);
+	return;
+    }
+
+    pthread_mutex_lock(&_lock);
+    _job = job;
+    _arg = arg;
+    _pending = _nthreads - 1;
+    ++_gen;
+    pthread_cond_broadcast(&_start_cond);
+    pthread_mutex_unlock(&_lock);
+
+    job(arg, 0);
+
+    pthread_mutex_lock(&_lock);
+    while (_pending)
+	pthread_cond_wait(&_done_cond, &_lock);
+    pthread_mutex_unlock(&_lock);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel)
+ELEMENT_PROVIDES(WorkerPool)
@@ -0,0 +1,66 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_WORKERPOOL_HH
+#define CLICK_WORKERPOOL_HH
+#include <click/glue.hh>
+#include <pthread.h>
+CLICK_DECLS
+
+/** @class WorkerPool
+ * @brief Fixed set of threads that split one job at a time.
+ *
+ * run() calls the job once for each index from 0 to nthreads() - 1 and
+ * returns when all calls are done.  Index 0 runs on the calling thread and
+ * the others on the pool's own threads, so a pool of one thread just calls
+ * the job directly.  Jobs typically split a batch into contiguous ranges
+ * with range().  Only one thread may call run() at a time. */
+class WorkerPool { public:
+
+    typedef void (*job_type)(void *arg, int index);
+
+    WorkerPool();
+    ~WorkerPool();
+
+    /** @brief Start threads so that run() uses @a nthreads in all.
+     * @return 0 on success, negative errno on failure */
+    int start(int nthreads);
+
+    /** @brief Stop and join the pool's threads. */
+    void stop();
+
+    int nthreads() const		{ return _nthreads; }
+
+    void run(job_type job, void *arg);
+
+    /** @brief Return the start of part @a index of @a n items. */
+    int range(int n, int index) const {
+	return (int) ((int64_t) n * index / _nthreads);
+    }
+
+  private:
+
+    struct Worker {
+	WorkerPool *pool;
+	int index;
+	pthread_t thread;
+    };
+
+    int _nthreads;
+    Worker *_workers;
+    pthread_mutex_t _lock;
+    pthread_cond_t _start_cond;
+    pthread_cond_t _done_cond;
+    job_type _job;
+    void *_arg;
+    unsigned _gen;
+    int _pending;
+    bool _quit;
+
+    static void *worker_thread(void *arg);
+
+    WorkerPool(const WorkerPool &);
+    WorkerPool &operator=(const WorkerPool &);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -76,6 +76,18 @@ FullNoteQueue::pull(int)
 	return pull_failure();
 }
 
+int
+FullNoteQueue::pull_burst(int port, Packet **p, int max)
+{
+    int n = deq_burst(p, max);
+    if (n) {
+	_sleepiness = 0;
+	_full_note.wake();
+    } else if ((p[0] = pull(port)))
+	n = 1;
+    return n;
+}
+
 #if CLICK_DEBUG_SCHEDULING
 String
 FullNoteQueue::read_handler(Element *e, void *)
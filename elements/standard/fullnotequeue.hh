@@ -80,6 +80,7 @@ class FullNoteQueue : public NotifierQueue { public:
 
     void push(int port, Packet *p);
     Packet *pull(int port);
+    int pull_burst(int port, Packet **p, int max);
 
   protected:
 
@@ -0,0 +1,77 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * mpscqueue.{cc,hh} -- multiple-producer, single-consumer queue
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "mpscqueue.hh"
+#include <click/master.hh>
+CLICK_DECLS
+
+MPSCQueue::MPSCQueue()
+{
+}
+
+void *
+MPSCQueue::cast(const char *n)
+{
+    if (strcmp(n, "MPSCQueue") == 0)
+	return (MPSCQueue *)this;
+    else
+	return SPSCQueue::cast(n);
+}
+
+int
+MPSCQueue::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    _nslots = master()->nthreads();
+    if (_nslots < 1)
+	_nslots = 1;
+    return SPSCQueue::configure(conf, errh);
+}
+
+inline SPSCQueue::Slot &
+MPSCQueue::producer_slot()
+{
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD && HAVE___THREAD_STORAGE_CLASS
+    int id = click_current_thread_id;
+#elif CLICK_LINUXMODULE && HAVE_MULTITHREAD
+    int id = click_current_processor();
+#else
+    int id = 0;
+#endif
+    return _slots[(unsigned) id % (unsigned) _nslots];
+}
+
+void
+MPSCQueue::push(int, Packet *p)
+{
+    Slot &s = producer_slot();
+    s.lock.acquire();
+    push_slot(s, &p, 1);
+    s.lock.release();
+}
+
+int
+MPSCQueue::push_burst(Packet **p, int n)
+{
+    Slot &s = producer_slot();
+    s.lock.acquire();
+    int m = push_slot(s, p, n);
+    s.lock.release();
+    return m;
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(SPSCQueue)
+EXPORT_ELEMENT(MPSCQueue)
@@ -0,0 +1,71 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_MPSCQUEUE_HH
+#define CLICK_MPSCQUEUE_HH
+#include "spscqueue.hh"
+CLICK_DECLS
+
+/*
+=c
+
+MPSCQueue
+MPSCQueue(CAPACITY)
+
+=s storage
+
+stores packets in a multiple-producer, single-consumer FIFO queue
+
+=d
+
+Stores incoming packets in a queue that supports many concurrent pushers and
+one puller.  Each thread pushes into its own single-producer ring, which
+holds up to CAPACITY packets (rounded up to a power of two; default 1024).
+Packets are dropped when the pushing thread's ring is full.  The puller
+takes packets from the rings round-robin, so packets from one thread stay
+in order, but packets from different threads may be interleaved.
+
+Each ring has its own lock, which only pushers take.  Normally each thread
+uses a different ring, so the lock is uncontended and never leaves that
+thread's cache.  Threads that do not run a Click driver share thread 0's
+ring.
+
+MPSCQueue otherwise behaves like SPSCQueue, including notifiers, output 1 for
+drops, and the push_burst() and pull_burst() methods.
+
+=h length read-only
+
+Returns the current number of packets in the queue.
+
+=h capacity read-only
+
+Returns the capacity of each thread's ring.
+
+=h drops read-only
+
+Returns the number of packets dropped by the queue so far.
+
+=h reset_counts write-only
+
+When written, resets the C<drops> counter.
+
+=a SPSCQueue, ThreadSafeQueue, Queue */
+
+class MPSCQueue : public SPSCQueue { public:
+
+    MPSCQueue();
+
+    const char *class_name() const		{ return "MPSCQueue"; }
+    void *cast(const char *);
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+
+    void push(int port, Packet *p);
+    int push_burst(Packet **p, int n);
+
+  private:
+
+    inline Slot &producer_slot();
+
+};
+
+CLICK_ENDDECLS
+#endif
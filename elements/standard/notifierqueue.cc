@@ -91,6 +91,17 @@ NotifierQueue::pull(int)
     return p;
 }
 
+int
+NotifierQueue::pull_burst(int port, Packet **p, int max)
+{
+    int n = deq_burst(p, max);
+    if (n)
+	_sleepiness = 0;
+    else if ((p[0] = pull(port)))
+	n = 1;
+    return n;
+}
+
 #if CLICK_DEBUG_SCHEDULING
 String
 NotifierQueue::read_handler(Element *e, void *)
@@ -53,6 +53,16 @@ PrioSched::pull(int)
     return 0;
 }
 
+int
+PrioSched::pull_burst(int, Packet **p, int max)
+{
+    int n = 0;
+    for (int i = 0; i < ninputs() && n < max; i++)
+	if (_signals[i])
+	    n += input(i).pull_burst(p + n, max - n);
+    return n;
+}
+
 CLICK_ENDDECLS
 EXPORT_ELEMENT(PrioSched)
 ELEMENT_MT_SAFE(PrioSched)
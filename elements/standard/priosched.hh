@@ -35,6 +35,7 @@ class PrioSched : public Element { public:
     void cleanup(CleanupStage);
 
     Packet *pull(int port);
+    int pull_burst(int port, Packet **p, int max);
 
   private:
 
@@ -61,6 +61,20 @@ QuickNoteQueue::pull(int)
     return p;
 }
 
+int
+QuickNoteQueue::pull_burst(int port, Packet **p, int max)
+{
+    // The last pull() puts the empty notifier to sleep if necessary.
+    if (max <= 0)
+	return 0;
+    int n = deq_burst(p, max - 1);
+    if ((p[n] = pull(port)))
+	++n;
+    else if (n)
+	_full_note.wake();
+    return n;
+}
+
 CLICK_ENDDECLS
 ELEMENT_REQUIRES(FullNoteQueue)
 EXPORT_ELEMENT(QuickNoteQueue)
@@ -74,6 +74,7 @@ class QuickNoteQueue : public FullNoteQueue { public:
 
     // FullNoteQueue's push() suffices
     Packet *pull(int port);
+    int pull_burst(int port, Packet **p, int max);
 
 };
 
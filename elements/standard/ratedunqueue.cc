@@ -92,10 +92,16 @@ RatedUnqueue::run_task(Task *)
 	return false;
     _tb.refill();
     if (_tb.contains(1)) {
-	if (Packet *p = input(0).pull()) {
-	    _tb.remove(1);
-	    output(0).push(p);
-            _pushes++;
+	Packet *burst[PULL_BURST];
+	TokenBucket::token_type avail = _tb.size();
+	int want = PULL_BURST;
+	if (avail < (TokenBucket::token_type) PULL_BURST)
+	    want = (avail ? avail : 1);
+	if (int n = input(0).pull_burst(burst, want)) {
+	    _tb.remove(n);
+	    for (int i = 0; i < n; ++i)
+		output(0).push(burst[i]);
+            _pushes += n;
 	    worked = true;
 	} else { // no Packet available
             _failed_pulls++;
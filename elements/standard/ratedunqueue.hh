@@ -18,7 +18,9 @@ CLICK_DECLS
  * Pulls packets at the given RATE in packets per second, and pushes them out
  * its single output.  It is implemented with a token bucket.  The capacity of
  * this token bucket defaults to 20 milliseconds worth of tokens, but can be
- * customized by setting BURST_DURATION or BURST_SIZE.
+ * customized by setting BURST_DURATION or BURST_SIZE.  When the bucket holds
+ * several tokens, RatedUnqueue pulls up to that many packets at once, up to
+ * 32.
  *
  * Keyword arguments are:
  *
@@ -60,5 +60,30 @@ RRSched::pull(int)
     return 0;
 }
 
+int
+RRSched::pull_burst(int, Packet **p, int max)
+{
+    int n = ninputs();
+    if (n == 0)
+	return 0;
+    int share = (max + n - 1) / n;
+    int i = _next, got = 0;
+    // Stop after a full round without packets.
+    for (int idle = 0; got < max && idle < n; ) {
+	int want = (max - got < share ? max - got : share);
+	int k = (_signals[i] ? input(i).pull_burst(p + got, want) : 0);
+	i++;
+	if (i >= n)
+	    i = 0;
+	if (k) {
+	    got += k;
+	    idle = 0;
+	    _next = i;
+	} else
+	    idle++;
+    }
+    return got;
+}
+
 CLICK_ENDDECLS
 EXPORT_ELEMENT(RRSched)
@@ -19,6 +19,10 @@ CLICK_DECLS
  * last produced a packet. This amounts to a round robin
  * scheduler.
  *
+ * When pulled in bursts, RoundRobinSched visits its inputs in the same order,
+ * but pulls up to a 1/N share of the burst from each input it visits, where
+ * N is the number of inputs.
+ *
  * The inputs usually come from Queues or other pull schedulers.
  * RoundRobinSched uses notification to avoid pulling from empty inputs.
  *
@@ -38,6 +42,7 @@ class RRSched : public Element { public:
     void cleanup(CleanupStage);
 
     Packet *pull(int port);
+    int pull_burst(int port, Packet **p, int max);
 
   private:
 
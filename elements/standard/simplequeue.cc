@@ -166,6 +166,12 @@ SimpleQueue::pull(int)
     return deq();
 }
 
+int
+SimpleQueue::pull_burst(int, Packet **p, int max)
+{
+    return deq_burst(p, max);
+}
+
 
 String
 SimpleQueue::read_handler(Element *e, void *thunk)
@@ -72,6 +72,7 @@ class SimpleQueue : public Element, public Storage { public:
     inline bool enq(Packet*);
     inline void lifo_enq(Packet*);
     inline Packet* deq();
+    inline int deq_burst(Packet **p, int max);
 
     // to be used with care
     Packet* packet(int i) const			{ return _q[i]; }
@@ -96,6 +97,7 @@ class SimpleQueue : public Element, public Storage { public:
 
     void push(int port, Packet*);
     Packet* pull(int port);
+    int pull_burst(int port, Packet **p, int max);
 
   protected:
 
@@ -165,6 +167,22 @@ SimpleQueue::deq()
 	return 0;
 }
 
+inline int
+SimpleQueue::deq_burst(Packet **p, int max)
+{
+    Storage::index_type h = _head, t = _tail;
+    int n = size(h, t);
+    if (n > max)
+	n = max;
+    for (int i = 0; i < n; ++i, h = next_i(h))
+	p[i] = _q[h];
+    if (n) {
+	packet_memory_barrier(_q[prev_i(h)], _head);
+	_head = h;
+    }
+    return n;
+}
+
 template <typename Filter>
 Packet *
 SimpleQueue::yank1(Filter filter)
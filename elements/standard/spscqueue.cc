@@ -0,0 +1,237 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * spscqueue.{cc,hh} -- lock-free single-producer, single-consumer queue
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "spscqueue.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+CLICK_DECLS
+
+SPSCQueue::SPSCQueue()
+    : _slots(0), _nslots(1), _pull_slot(0), _sleepiness(0)
+{
+}
+
+SPSCQueue::~SPSCQueue()
+{
+}
+
+void *
+SPSCQueue::cast(const char *n)
+{
+    if (strcmp(n, "SPSCQueue") == 0)
+	return (SPSCQueue *)this;
+    else if (strcmp(n, Notifier::EMPTY_NOTIFIER) == 0)
+	return static_cast<Notifier *>(&_empty_note);
+    else if (strcmp(n, Notifier::FULL_NOTIFIER) == 0)
+	return static_cast<Notifier *>(&_full_note);
+    else
+	return Element::cast(n);
+}
+
+int
+SPSCQueue::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    _capacity = 1024;
+    if (Args(conf, this, errh).read_p("CAPACITY", _capacity).complete() < 0)
+	return -1;
+    if (_capacity == 0 || _capacity > 0x40000000U)
+	return errh->error("CAPACITY out of range");
+    _empty_note.initialize(Notifier::EMPTY_NOTIFIER, router());
+    _full_note.initialize(Notifier::FULL_NOTIFIER, router());
+    _full_note.set_active(true, false);
+    return 0;
+}
+
+int
+SPSCQueue::initialize(ErrorHandler *errh)
+{
+    _slots = new Slot[_nslots];
+    for (int i = 0; i < _nslots; ++i)
+	if (!_slots[i].ring.initialize(_capacity))
+	    return errh->error("out of memory");
+    _capacity = _slots[0].ring.capacity();
+    return 0;
+}
+
+void
+SPSCQueue::cleanup(CleanupStage)
+{
+    if (_slots)
+	for (int i = 0; i < _nslots; ++i) {
+	    Packet *p;
+	    while (_slots[i].ring.pop(p))
+		p->kill();
+	}
+    delete[] _slots;
+    _slots = 0;
+}
+
+int
+SPSCQueue::push_slot(Slot &s, Packet **p, int n)
+{
+    int m = s.ring.push_burst(p, n);
+
+    if (m) {
+	// Make the new packets visible before checking the notifier; a
+	// consumer going to sleep rechecks the ring after sleeping.
+	click_fence();
+	if (!_empty_note.active())
+	    _empty_note.wake();
+    }
+
+    if (m < n || s.ring.producer_full()) {
+	_full_note.sleep();
+	// Work around race condition between push() and pull(), as in
+	// FullNoteQueue.
+	if (s.ring.size() < s.ring.capacity())
+	    _full_note.wake();
+    }
+
+    if (m < n) {
+	if (s.drops == 0)
+	    click_chatter("%p{element}: overflow", this);
+	s.drops += n - m;
+	for (int i = m; i < n; ++i)
+	    checked_output_push(1, p[i]);
+    }
+    return m;
+}
+
+void
+SPSCQueue::push(int, Packet *p)
+{
+    push_slot(_slots[0], &p, 1);
+}
+
+int
+SPSCQueue::push_burst(Packet **p, int n)
+{
+    return push_slot(_slots[0], p, n);
+}
+
+inline void
+SPSCQueue::pull_success()
+{
+    _sleepiness = 0;
+    // No fence needed: if a producer found us full, more pulls follow.
+    if (!_full_note.active())
+	_full_note.wake();
+}
+
+inline Packet *
+SPSCQueue::pull_failure()
+{
+    if (_sleepiness >= SLEEPINESS_TRIGGER) {
+	_empty_note.sleep();
+	// Work around race condition between push() and pull().
+	// Notifier::sleep() is a locked operation, so the rechecks below
+	// see any packet whose producer saw the notifier still active.
+	for (int i = 0; i < _nslots; ++i)
+	    if (!_slots[i].ring.empty()) {
+		_empty_note.wake();
+		break;
+	    }
+    } else
+	++_sleepiness;
+    return 0;
+}
+
+Packet *
+SPSCQueue::pull(int)
+{
+    Packet *p;
+    for (int i = 0; i < _nslots; ++i) {
+	Slot &s = _slots[_pull_slot];
+	if (++_pull_slot == _nslots)
+	    _pull_slot = 0;
+	if (s.ring.pop(p)) {
+	    pull_success();
+	    return p;
+	}
+    }
+    return pull_failure();
+}
+
+int
+SPSCQueue::pull_burst(int, Packet **p, int n)
+{
+    int m = 0;
+    for (int i = 0; i < _nslots && m < n; ++i) {
+	m += _slots[_pull_slot].ring.pop_burst(p + m, n - m);
+	if (++_pull_slot == _nslots)
+	    _pull_slot = 0;
+    }
+    if (m)
+	pull_success();
+    else
+	pull_failure();
+    return m;
+}
+
+int
+SPSCQueue::size() const
+{
+    int s = 0;
+    for (int i = 0; i < _nslots; ++i)
+	s += _slots[i].ring.size();
+    return s;
+}
+
+uint32_t
+SPSCQueue::drops() const
+{
+    uint32_t d = 0;
+    for (int i = 0; i < _nslots; ++i)
+	d += _slots[i].drops;
+    return d;
+}
+
+String
+SPSCQueue::read_handler(Element *e, void *thunk)
+{
+    SPSCQueue *q = static_cast<SPSCQueue *>(e);
+    switch (reinterpret_cast<intptr_t>(thunk)) {
+    case 0:
+	return String(q->size());
+    case 1:
+	return String(q->capacity());
+    case 2:
+	return String(q->drops());
+    default:
+	return String();
+    }
+}
+
+int
+SPSCQueue::write_handler(const String &, Element *e, void *, ErrorHandler *)
+{
+    SPSCQueue *q = static_cast<SPSCQueue *>(e);
+    for (int i = 0; i < q->_nslots; ++i)
+	q->_slots[i].drops = 0;
+    return 0;
+}
+
+void
+SPSCQueue::add_handlers()
+{
+    add_read_handler("length", read_handler, 0);
+    add_read_handler("capacity", read_handler, 1, Handler::CALM);
+    add_read_handler("drops", read_handler, 2);
+    add_write_handler("reset_counts", write_handler, 0, Handler::BUTTON | Handler::NONEXCLUSIVE);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(SPSCQueue)
@@ -0,0 +1,121 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_SPSCQUEUE_HH
+#define CLICK_SPSCQUEUE_HH
+#include <click/element.hh>
+#include <click/notifier.hh>
+#include <click/spscring.hh>
+#include <click/sync.hh>
+CLICK_DECLS
+
+/*
+=c
+
+SPSCQueue
+SPSCQueue(CAPACITY)
+
+=s storage
+
+stores packets in a lock-free single-producer, single-consumer FIFO queue
+
+=d
+
+Stores incoming packets in a first-in-first-out queue.  Drops incoming
+packets if the queue already holds CAPACITY packets.  CAPACITY is rounded up
+to a power of two; the default is 1024.
+
+SPSCQueue is meant for handing packets from one thread to another.  At most
+one thread may push to it at a time, and at most one thread may pull from it
+at a time, but the pushing and pulling threads may differ.  Unlike
+ThreadSafeQueue, it performs no atomic operations on the packet path.  The
+producer's and consumer's indexes live on separate cache lines.  Each side
+caches the other's index and rereads it only when the queue looks full or
+empty, so a handoff bounces the queue's cache lines about once per burst
+rather than once per packet.  Use MPSCQueue for several concurrent pushers.
+
+Like Queue, SPSCQueue has non-full and non-empty notifiers, and emits
+dropped packets on output 1 if that output exists.  Elements that move
+packets in bursts can call push_burst() on an SPSCQueue directly, and
+input(i).pull_burst() pulls a burst from it.
+
+=h length read-only
+
+Returns the current number of packets in the queue.
+
+=h capacity read-only
+
+Returns the queue's capacity.
+
+=h drops read-only
+
+Returns the number of packets dropped by the queue so far.
+
+=h reset_counts write-only
+
+When written, resets the C<drops> counter.
+
+=a MPSCQueue, ThreadSafeQueue, Queue */
+
+class SPSCQueue : public Element { public:
+
+    SPSCQueue();
+    ~SPSCQueue();
+
+    const char *class_name() const		{ return "SPSCQueue"; }
+    const char *port_count() const		{ return PORTS_1_1X2; }
+    const char *processing() const		{ return "h/lh"; }
+    void *cast(const char *);
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    int initialize(ErrorHandler *errh);
+    void cleanup(CleanupStage stage);
+    void add_handlers();
+
+    void push(int port, Packet *p);
+    Packet *pull(int port);
+
+    /** @brief Push the @a n packets in @a p.
+     * @return the number of packets enqueued
+     *
+     * The queue takes ownership of all @a n packets.  Packets that do not
+     * fit are dropped (or emitted on output 1), like push() would. */
+    virtual int push_burst(Packet **p, int n);
+
+    int pull_burst(int port, Packet **p, int max);
+
+    int size() const;
+    uint32_t capacity() const			{ return _capacity; }
+    uint32_t drops() const;
+
+  protected:
+
+    struct Slot {
+	SPSCRing<Packet *> ring;
+	SimpleSpinlock lock;
+	uint32_t drops;
+	Slot()
+	    : drops(0) {
+	}
+    };
+
+    Slot *_slots;
+    int _nslots;
+    int _pull_slot;
+    uint32_t _capacity;
+    int _sleepiness;
+
+    ActiveNotifier _empty_note;
+    ActiveNotifier _full_note;
+
+    enum { SLEEPINESS_TRIGGER = 9 };
+
+    int push_slot(Slot &s, Packet **p, int n);
+    inline void pull_success();
+    inline Packet *pull_failure();
+
+    static String read_handler(Element *e, void *thunk);
+    static int write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh);
+
+};
+
+CLICK_ENDDECLS
+#endif
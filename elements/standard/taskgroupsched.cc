@@ -0,0 +1,377 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * taskgroupsched.{cc,hh} -- hierarchical CPU shares for task groups
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "taskgroupsched.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/router.hh>
+#include <click/master.hh>
+#include <click/routerthread.hh>
+#include <click/task.hh>
+#include <click/integers.hh>
+#include <click/straccum.hh>
+CLICK_DECLS
+
+// Cost assumed for tasks that have not yet run.
+#define DEFAULT_COST	1024
+
+static uint64_t
+divide64(uint64_t a, uint64_t b)
+{
+    while (b > 0xFFFFFFFFULL) {
+	a >>= 1;
+	b >>= 1;
+    }
+    return b ? int_divide(a, (uint32_t) b) : 0;
+}
+
+TaskGroupSched::TaskGroupSched()
+    : _nupdates(0), _timer(this)
+{
+}
+
+TaskGroupSched::~TaskGroupSched()
+{
+}
+
+int
+TaskGroupSched::find_group(const String &name) const
+{
+    for (int i = 0; i < _groups.size(); ++i)
+	if (_groups[i].name == name)
+	    return i;
+    return -1;
+}
+
+bool
+TaskGroupSched::parse_fraction(const String &str, uint32_t &x)
+{
+    if (str.length() > 1 && str.back() == '%')
+	return FixedPointArg(FRAC_BITS, -2).parse(str.substring(0, -1), x)
+	    && x <= FRAC_ONE;
+    else
+	return FixedPointArg(FRAC_BITS).parse(str, x) && x <= FRAC_ONE;
+}
+
+int
+TaskGroupSched::parse_group(const String &str, ErrorHandler *errh)
+{
+    Vector<String> words;
+    cp_spacevec(str, words);
+    if (words.size() == 0)
+	return errh->error("GROUP: missing name");
+
+    Group g;
+    g.name = words[0];
+    if (find_group(g.name) >= 0)
+	return errh->error("GROUP %<%s%> declared twice", g.name.c_str());
+    int slash = g.name.find_right('/');
+    if (slash == 0 || slash == g.name.length() - 1)
+	return errh->error("GROUP %<%s%>: bad name", g.name.c_str());
+    else if (slash > 0) {
+	String parent = g.name.substring(0, slash);
+	if ((g.parent = find_group(parent)) < 0)
+	    return errh->error("GROUP %<%s%>: parent %<%s%> not declared", g.name.c_str(), parent.c_str());
+	if (_groups[g.parent].has_elements)
+	    return errh->error("GROUP %<%s%>: parent %<%s%> has ELEMENTS", g.name.c_str(), parent.c_str());
+    }
+
+    int gi = _groups.size();
+    for (int i = 1; i < words.size(); ) {
+	const String &kw = words[i];
+	if (kw == "ELEMENTS") {
+	    for (++i; i < words.size() && words[i] != "SHARE"
+		     && words[i] != "MIN" && words[i] != "MAX"; ++i) {
+		Element *e = cp_element(words[i], this, errh, "ELEMENTS");
+		if (!e)
+		    return -1;
+		if (_element_group[e->eindex()] != 0)
+		    return errh->error("GROUP %<%s%>: %<%s%> already in group %<%s%>", g.name.c_str(), e->name().c_str(), _groups[_element_group[e->eindex()]].name.c_str());
+		_element_group[e->eindex()] = gi;
+		g.has_elements = true;
+	    }
+	    continue;
+	} else if (i + 1 >= words.size())
+	    return errh->error("GROUP %<%s%>: missing value for %<%s%>", g.name.c_str(), kw.c_str());
+
+	const String &val = words[i + 1];
+	bool ok;
+	if (kw == "SHARE")
+	    ok = FixedPointArg(FRAC_BITS).parse(val, g.share) && g.share > 0
+		&& g.share <= (1000U << FRAC_BITS);
+	else if (kw == "MIN")
+	    ok = parse_fraction(val, g.min);
+	else if (kw == "MAX")
+	    ok = parse_fraction(val, g.max);
+	else
+	    return errh->error("GROUP %<%s%>: unknown keyword %<%s%>", g.name.c_str(), kw.c_str());
+	if (!ok)
+	    return errh->error("GROUP %<%s%>: bad %s", g.name.c_str(), kw.c_str());
+	i += 2;
+    }
+    if (g.min > g.max)
+	return errh->error("GROUP %<%s%>: MIN greater than MAX", g.name.c_str());
+
+    if (g.parent >= 0)
+	++_groups[g.parent].nchildren;
+    _groups.push_back(g);
+    return 0;
+}
+
+int
+TaskGroupSched::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    Vector<String> groups;
+    _period = Timestamp::make_msec(10);
+    if (Args(conf, this, errh)
+	.read_all("GROUP", AnyArg(), groups)
+	.read("PERIOD", _period)
+	.complete() < 0)
+	return -1;
+    if (_period < Timestamp::make_msec(1))
+	return errh->error("PERIOD too small");
+
+    _groups.clear();
+    _groups.push_back(Group());
+    _groups[0].name = "other";
+    _element_group.assign(router()->nelements(), 0);
+    for (String *s = groups.begin(); s != groups.end(); ++s)
+	if (parse_group(*s, errh) < 0)
+	    return -1;
+    return 0;
+}
+
+void
+TaskGroupSched::set_accounting(bool on)
+{
+    for (int i = 0; i < master()->nthreads(); ++i)
+	master()->thread(i)->set_task_accounting(on);
+}
+
+int
+TaskGroupSched::initialize(ErrorHandler *errh)
+{
+#if HAVE_STRIDE_SCHED
+    set_accounting(true);
+    _timer.initialize(this);
+    _timer.schedule_after(_period);
+    (void) errh;
+    return 0;
+#else
+    return errh->error("TaskGroupSched requires stride scheduling");
+#endif
+}
+
+void
+TaskGroupSched::cleanup(CleanupStage)
+{
+    set_accounting(false);
+}
+
+inline uint64_t
+TaskGroupSched::weight(const Group &g)
+{
+    uint64_t w = ((uint64_t) g.share * g.boost) / BOOST_ONE;
+    return w ? w : 1;
+}
+
+void
+TaskGroupSched::adjust_boost(Group &g)
+{
+    // A group's bounds only matter when its siblings compete with it.
+    if (g.ntasks == 0
+	|| (g.parent >= 0 && _groups[g.parent].ntasks == g.ntasks))
+	return;
+    if (g.min && g.usage < g.min)
+	g.boost = g.boost < BOOST_MAX / 2 ? g.boost * 2 : (uint32_t) BOOST_MAX;
+    else if (g.max < FRAC_ONE && g.usage > g.max)
+	g.boost = g.boost > BOOST_MIN * 2 ? g.boost / 2 : (uint32_t) BOOST_MIN;
+    else if (g.boost > BOOST_ONE && g.usage > g.min + g.min / 2) {
+	// Comfortably within bounds: decay toward the configured share.
+	g.boost = (g.boost * 7) / 8;
+	if (g.boost < BOOST_ONE)
+	    g.boost = BOOST_ONE;
+    } else if (g.boost < BOOST_ONE && g.usage < g.max - g.max / 4) {
+	g.boost = (g.boost * 9) / 8 + 1;
+	if (g.boost > BOOST_ONE)
+	    g.boost = BOOST_ONE;
+    }
+}
+
+void
+TaskGroupSched::update()
+{
+#if HAVE_STRIDE_SCHED
+    ++_nupdates;
+    for (Group *g = _groups.begin(); g != _groups.end(); ++g) {
+	g->ntasks = 0;
+	g->period_cycles = 0;
+    }
+
+    // Measure each scheduled task.
+    Vector<Task *> tasks;
+    Vector<int> threads;
+    for (int i = 0; i < master()->nthreads(); ++i) {
+	master()->thread(i)->scheduled_tasks(router(), tasks);
+	threads.resize(tasks.size(), i);
+    }
+    // Insert first: insertion may rebalance the table.
+    for (Task **t = tasks.begin(); t != tasks.end(); ++t)
+	_tasks.find_insert(*t);
+    Vector<TaskInfo *> infos;
+    for (int k = 0; k < tasks.size(); ++k) {
+	Task *t = tasks[k];
+	TaskInfo &ti = _tasks.find(t).value();
+	click_cycles_t c = t->accounted_cycles();
+	uint32_t r = t->accounted_runs();
+	// A new task may reuse a deleted task's address.
+	if (ti.seen == 0 || c < ti.last_cycles || r < ti.last_runs)
+	    ti.last_cycles = ti.last_runs = 0;
+	uint64_t dc = c - ti.last_cycles;
+	uint32_t dr = r - ti.last_runs;
+	ti.last_cycles = c;
+	ti.last_runs = r;
+	if (dr) {
+	    uint32_t cost = divide64(dc, dr);
+	    ti.cost = ti.cost ? (3 * (uint64_t) ti.cost + cost) / 4 : cost;
+	    if (ti.cost == 0)
+		ti.cost = 1;
+	}
+	ti.owner = t->element();
+	ti.group = ti.owner && ti.owner->router() == router()
+	    ? _element_group[ti.owner->eindex()] : 0;
+	ti.thread = threads[k];
+	ti.seen = _nupdates;
+	Group &g = _groups[ti.group];
+	++g.ntasks;
+	g.period_cycles += dc;
+	infos.push_back(&ti);
+    }
+
+    // Children follow their parents, so this pass sums subtrees.
+    uint64_t total = 0;
+    for (int i = _groups.size() - 1; i >= 0; --i) {
+	Group &g = _groups[i];
+	if (g.parent >= 0) {
+	    _groups[g.parent].ntasks += g.ntasks;
+	    _groups[g.parent].period_cycles += g.period_cycles;
+	} else
+	    total += g.period_cycles;
+	g.cycles += g.period_cycles;
+    }
+
+    // Measure usage, adjust weights, and sum the weights of busy siblings.
+    Vector<uint64_t> weight_sum(_groups.size() + 1, 0);
+    for (Group *g = _groups.begin(); g != _groups.end(); ++g) {
+	uint64_t pc = g->parent >= 0 ? _groups[g->parent].period_cycles : total;
+	g->usage = divide64(g->period_cycles << FRAC_BITS, pc);
+	adjust_boost(*g);
+	if (g->ntasks)
+	    weight_sum[g->parent + 1] += weight(*g);
+    }
+
+    // Divide each parent's target among its busy children.
+    uint64_t max_raw = 0;
+    for (Group *g = _groups.begin(); g != _groups.end(); ++g) {
+	uint64_t pt = g->parent >= 0 ? _groups[g->parent].target : (uint32_t) FRAC_ONE;
+	g->target = g->ntasks ? divide64(pt * weight(*g), weight_sum[g->parent + 1]) : 0;
+    }
+
+    // A task's CPU time is proportional to tickets times cost per run, so
+    // give each task its equal part of the group's target divided by its
+    // cost.
+    Vector<uint64_t> raw(infos.size(), 0);
+    for (int k = 0; k < infos.size(); ++k) {
+	TaskInfo &ti = *infos[k];
+	Group &g = _groups[ti.group];
+	uint32_t cost = ti.cost ? ti.cost : DEFAULT_COST;
+	raw[k] = divide64((uint64_t) g.target << 20, (uint64_t) g.ntasks * cost);
+	if (raw[k] > max_raw)
+	    max_raw = raw[k];
+    }
+    for (int k = 0; k < infos.size(); ++k) {
+	uint64_t n = divide64(raw[k] * Task::MAX_TICKETS, max_raw);
+	int tickets = n < 1 ? 1 : (n > Task::MAX_TICKETS ? Task::MAX_TICKETS : (int) n);
+	infos[k]->tickets = tickets;
+	tasks[k]->set_tickets(tickets);
+    }
+
+    // Forget tasks that have not been scheduled for a while.
+    if (_nupdates % 128 == 0) {
+	for (HashTable<Task *, TaskInfo>::iterator it = _tasks.begin(); it; )
+	    if (_nupdates - it.value().seen > 128)
+		it = _tasks.erase(it);
+	    else
+		++it;
+    }
+#endif
+}
+
+void
+TaskGroupSched::run_timer(Timer *)
+{
+    update();
+    _timer.reschedule_after(_period);
+}
+
+String
+TaskGroupSched::unparse_percent(uint32_t frac)
+{
+    return cp_unparse_real2((uint32_t) ((frac * (uint64_t) 100) >> 6), FRAC_BITS - 6) + "%";
+}
+
+String
+TaskGroupSched::read_handler(Element *e, void *thunk)
+{
+    TaskGroupSched *tgs = static_cast<TaskGroupSched *>(e);
+    StringAccum sa;
+    if (thunk == 0) {
+	for (Group *g = tgs->_groups.begin(); g != tgs->_groups.end(); ++g)
+	    sa << g->name << ' ' << g->ntasks << ' ' << g->cycles << ' '
+	       << unparse_percent(g->usage) << ' '
+	       << unparse_percent(g->target) << '\n';
+    } else {
+	for (HashTable<Task *, TaskInfo>::iterator it = tgs->_tasks.begin(); it; ++it) {
+	    const TaskInfo &ti = it.value();
+	    if (ti.seen != tgs->_nupdates)
+		continue;
+	    sa << (ti.owner ? ti.owner->name() : String::make_stable("-"))
+	       << ' ' << tgs->_groups[ti.group].name << ' ' << ti.thread
+	       << ' ' << ti.tickets << ' ' << ti.cost << '\n';
+	}
+    }
+    return sa.take_string();
+}
+
+int
+TaskGroupSched::write_handler(const String &, Element *e, void *, ErrorHandler *)
+{
+    TaskGroupSched *tgs = static_cast<TaskGroupSched *>(e);
+    for (Group *g = tgs->_groups.begin(); g != tgs->_groups.end(); ++g)
+	g->cycles = 0;
+    return 0;
+}
+
+void
+TaskGroupSched::add_handlers()
+{
+    add_read_handler("groups", read_handler, 0);
+    add_read_handler("tasks", read_handler, 1);
+    add_write_handler("reset", write_handler, 0, Handler::BUTTON);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(TaskGroupSched)
@@ -0,0 +1,187 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_TASKGROUPSCHED_HH
+#define CLICK_TASKGROUPSCHED_HH
+#include <click/element.hh>
+#include <click/timer.hh>
+#include <click/hashtable.hh>
+CLICK_DECLS
+class Task;
+
+/*
+=c
+
+TaskGroupSched(GROUP NAME [SHARE s] [MIN m] [MAX m] [ELEMENTS e...], ...,
+  I<keywords> PERIOD)
+
+=s scheduling
+
+divides task CPU time among hierarchical groups
+
+=d
+
+Divides the CPU time spent running this router's tasks among groups of
+elements.  Each GROUP argument declares one group.  Its first word is the
+group's name, and the remaining words are keyword-value pairs:
+
+=over 8
+
+=item SHARE
+
+Real number.  The group's weight relative to its sibling groups.  Backlogged
+sibling groups receive task CPU time in proportion to their shares.
+Default is 1.
+
+=item MIN
+
+Fraction or percentage.  When the group has runnable tasks, it should
+receive at least this much of its parent's CPU time.  Default is 0.
+
+=item MAX
+
+Fraction or percentage.  When sibling groups have runnable tasks, the group
+should receive at most this much of its parent's CPU time.  Default is 100%.
+
+=item ELEMENTS
+
+Space-separated list of elements.  Their tasks belong to the group.
+
+=back
+
+Groups form a hierarchy by name: group "net/rx" is a subgroup of group
+"net", which must be declared first.  A group's share, MIN and MAX apply
+within its parent; top-level groups divide all of the router's task time.
+Only groups without subgroups may have ELEMENTS.  Tasks of elements not
+listed in any group belong to an implicit top-level group named "other" with
+SHARE 1.
+
+Every PERIOD, TaskGroupSched measures how many cycles each task spent
+running, and sets task tickets so that each group's tasks get its target
+share of CPU time.  Tickets are scaled by each task's measured cost per run,
+so a group's share is CPU time rather than number of runs.  A group whose
+use falls below MIN while it has runnable tasks has its weight doubled each
+period until it reaches MIN; a group above MAX has its weight halved.  The
+weights decay back toward their configured shares once the group is
+comfortably within bounds.  Like all stride scheduling in Click, this is
+work-conserving: a group can use more than its share, or more than MAX, when
+no other group has runnable tasks.
+
+Shares are measured across all threads together, so they are most meaningful
+among tasks on the same thread.  TaskGroupSched overrides the tickets set by
+ScheduleInfo.
+
+Keyword arguments are:
+
+=over 8
+
+=item PERIOD
+
+Time.  How often to measure and adjust.  Default is 10ms.
+
+=back
+
+=e
+
+  TaskGroupSched(GROUP ctl MIN 5% ELEMENTS tohost,
+                 GROUP data SHARE 8,
+                 GROUP data/rx MIN 50% ELEMENTS poll0 poll1,
+                 GROUP data/gpu MAX 40% ELEMENTS feeder);
+
+=h groups read-only
+
+Returns one line per group: name, number of tasks, cycles used since the last
+reset, percentage of the parent's task time used in the last period, and
+current target percentage of all task time.
+
+=h tasks read-only
+
+Returns one line per recently scheduled task: element name, group, thread,
+tickets, and average cycles per run.
+
+=h reset write-only
+
+Resets the cycle counts in the C<groups> handler.
+
+=a ScheduleInfo, BalancedThreadSched */
+
+class TaskGroupSched : public Element { public:
+
+    TaskGroupSched();
+    ~TaskGroupSched();
+
+    const char *class_name() const	{ return "TaskGroupSched"; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    int initialize(ErrorHandler *errh);
+    void cleanup(CleanupStage stage);
+    void add_handlers();
+
+    void run_timer(Timer *timer);
+
+  private:
+
+    enum { FRAC_BITS = 16, FRAC_ONE = 1 << FRAC_BITS };
+    enum { BOOST_ONE = 1 << 10, BOOST_MIN = BOOST_ONE >> 6,
+	   BOOST_MAX = BOOST_ONE << 6 };
+
+    struct Group {
+	String name;
+	int parent;
+	uint32_t share;		// FRAC_BITS fixed point
+	uint32_t min;		// fraction of parent, FRAC_BITS fixed point
+	uint32_t max;
+	uint32_t boost;		// BOOST_ONE is 1
+	int nchildren;
+	bool has_elements;
+
+	// updated every period
+	int ntasks;		// scheduled tasks in this group and below
+	uint64_t period_cycles;
+	uint32_t usage;		// fraction of parent in last period
+	uint32_t target;	// fraction of all task time
+
+	uint64_t cycles;	// since reset
+	Group()
+	    : parent(-1), share(FRAC_ONE), min(0), max(FRAC_ONE),
+	      boost(BOOST_ONE), nchildren(0), has_elements(false), ntasks(0),
+	      period_cycles(0), usage(0), target(0), cycles(0) {
+	}
+    };
+
+    struct TaskInfo {
+	Element *owner;
+	int group;
+	int thread;
+	int tickets;
+	click_cycles_t last_cycles;
+	uint32_t last_runs;
+	uint32_t cost;		// average cycles per run
+	unsigned seen;		// update number
+	TaskInfo()
+	    : owner(0), group(0), thread(0), tickets(0), last_cycles(0),
+	      last_runs(0), cost(0), seen(0) {
+	}
+    };
+
+    Vector<Group> _groups;
+    Vector<int> _element_group;
+    HashTable<Task *, TaskInfo> _tasks;
+    unsigned _nupdates;
+    Timer _timer;
+    Timestamp _period;
+
+    int find_group(const String &name) const;
+    int parse_group(const String &str, ErrorHandler *errh);
+    static bool parse_fraction(const String &str, uint32_t &x);
+    void set_accounting(bool on);
+    void update();
+    static inline uint64_t weight(const Group &g);
+    void adjust_boost(Group &g);
+    static String unparse_percent(uint32_t frac);
+
+    static String read_handler(Element *e, void *thunk);
+    static int write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -89,6 +89,33 @@ ThreadSafeQueue::pull(int)
     }
 }
 
+int
+ThreadSafeQueue::pull_burst(int port, Packet **p, int max)
+{
+    // Reserve up to max slots by advancing _xhead, as in pull()
+    Storage::index_type h, nh;
+    int n;
+    do {
+	h = _head;
+	n = size(h, _tail);
+	if (n > max)
+	    n = max;
+	else if (n == 0)
+	    return (p[0] = pull(port)) ? 1 : 0;
+	nh = next_i(h, n);
+    } while (_xhead.compare_swap(h, nh) != h);
+    // Other pullers spin until _head := nh
+
+    for (int i = 0; i < n; ++i, h = next_i(h))
+	p[i] = _q[h];
+    packet_memory_barrier(_q[prev_i(h)], _head);
+    _head = nh;
+
+    _sleepiness = 0;
+    _full_note.wake();
+    return n;
+}
+
 CLICK_ENDDECLS
 ELEMENT_REQUIRES(FullNoteQueue)
 EXPORT_ELEMENT(ThreadSafeQueue)
@@ -62,6 +62,7 @@ class ThreadSafeQueue : public FullNoteQueue { public:
 
     void push(int port, Packet *);
     Packet *pull(int port);
+    int pull_burst(int port, Packet **p, int max);
 
   private:
 
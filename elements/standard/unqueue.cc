@@ -69,10 +69,13 @@ Unqueue::run_task(Task *)
     }
 
     while (worked < limit && _active) {
-	if (Packet *p = input(0).pull()) {
-	    ++worked;
-	    ++_count;
-	    output(0).push(p);
+	Packet *burst[PULL_BURST];
+	int want = (limit - worked < PULL_BURST ? limit - worked : PULL_BURST);
+	if (int n = input(0).pull_burst(burst, want)) {
+	    worked += n;
+	    _count += n;
+	    for (int i = 0; i < n; ++i)
+		output(0).push(burst[i]);
 	} else if (!_signal)
 	    goto out;
 	else
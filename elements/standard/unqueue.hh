@@ -19,7 +19,9 @@ pull-to-push converter
 Pulls packets whenever they are available, then pushes them out
 its single output. Pulls a maximum of BURST packets every time
 it is scheduled. Default BURST is 1. If BURST
-is less than 0, pull until nothing comes back.
+is less than 0, pull until nothing comes back.  When BURST is more than 1,
+Unqueue pulls up to 32 packets at a time through the upstream pull path, then
+pushes them one by one.
 
 Keyword arguments are:
 
@@ -36,9 +36,11 @@ TCPFragmenter::~TCPFragmenter()
 int
 TCPFragmenter::configure(Vector<String> &conf, ErrorHandler *errh)
 {
-    uint16_t mtu;
+    uint16_t mtu = 0;
+    int mtu_anno = -1;
     if (Args(conf, this, errh)
 	.read("MTU", mtu)
+	.read("MTU_ANNO", AnnoArg(2), mtu_anno)
 	.complete() < 0)
 	return -1;
 
@@ -46,61 +48,89 @@ TCPFragmenter::configure(Vector<String> &conf, ErrorHandler *errh)
         return errh->error("MTU cannot be 0");
 
     _mtu = mtu;
+    _mtu_anno = mtu_anno;
 
     return 0;
 }
 
+void
+TCPFragmenter::finish_segment(WritablePacket *q, int offset, int index, bool last)
+{
+    click_ip *ip = q->ip_header();
+    click_tcp *tcp = q->tcp_header();
+    ip->ip_len = htons(q->end_data() - q->network_header());
+    ip->ip_id = htons(ntohs(ip->ip_id) + index);
+    ip->ip_sum = 0;
+#if HAVE_FAST_CHECKSUM
+    ip->ip_sum = ip_fast_csum((unsigned char *)ip, q->network_header_length() >> 2);
+#else
+    ip->ip_sum = click_in_cksum((unsigned char *)ip, q->network_header_length());
+#endif
+
+    tcp->th_seq = htonl(ntohl(tcp->th_seq) + offset);
+    if (index != 0)
+	tcp->th_flags &= ~TH_CWR;
+    if (!last)
+	tcp->th_flags &= ~(TH_FIN | TH_PUSH);
+    tcp->th_sum = 0;
+
+    // now calculate tcp header cksum
+    int plen = q->end_data() - (uint8_t*)tcp;
+    unsigned csum = click_in_cksum((unsigned char *)tcp, plen);
+    tcp->th_sum = click_in_cksum_pseudohdr(csum, ip, plen);
+}
+
 void
 TCPFragmenter::push(int, Packet *p)
 {
     int32_t tcp_len;
+    int hdr_len;
+    int mtu = _mtu;
     {
         const click_ip *ip = p->ip_header();
         const click_tcp *tcp = p->tcp_header();
         tcp_len = (ntohs(ip->ip_len)-(ip->ip_hl<<2)-(tcp->th_off<<2));
+        hdr_len = p->transport_header_offset() + (tcp->th_off<<2);
 
-        if (!_mtu || tcp_len < _mtu) {
+        if (_mtu_anno >= 0 && p->anno_u16(_mtu_anno))
+            mtu = p->anno_u16(_mtu_anno);
+        if (tcp_len <= mtu) {
             output(0).push(p);
             return;
         }
     }
 
-    for (int offset = 0; offset < tcp_len; offset += _mtu) {
-        Packet *p_clone;
-        if (offset + _mtu < tcp_len)
-            p_clone = p->clone();
-        else {
-            p_clone = p;
-            p = 0;
-        }
-        if (!p_clone)
-            break;
-        WritablePacket *q = p_clone->uniqueify();
-        p_clone = 0;
-        click_ip *ip = q->ip_header();
-        click_tcp *tcp = q->tcp_header();
-        uint8_t *tcp_data = ((uint8_t *)tcp) + (tcp->th_off<<2);
-        int this_len = tcp_len - offset > _mtu ? _mtu : tcp_len - offset;
-        if (offset != 0)
-            memcpy(tcp_data, tcp_data + offset, this_len);
-        q->take(tcp_len - this_len);
-        ip->ip_len = htons(q->end_data() - q->network_header());
-        ip->ip_sum = 0;
-#if HAVE_FAST_CHECKSUM
-        ip->ip_sum = ip_fast_csum((unsigned char *)ip, q->network_header_length() >> 2);
-#else
-        ip->ip_sum = click_in_cksum((unsigned char *)ip, q->network_header_length());
-#endif
-
-        tcp->th_seq = htonl(ntohl(tcp->th_seq) + offset);
-        tcp->th_sum = 0;
+    int nh_off = p->network_header_offset();
+    int nh_len = p->network_header_length();
+    int mac_off = p->has_mac_header() ? p->mac_header_offset() : -1;
 
-        // now calculate tcp header cksum
-        int plen = q->end_data() - (uint8_t*)tcp;
-        unsigned csum = click_in_cksum((unsigned char *)tcp, plen);
-        tcp->th_sum = click_in_cksum_pseudohdr(csum, ip, plen);
+    int index = 0, offset;
+    for (offset = 0; offset + mtu < tcp_len; offset += mtu, ++index) {
+        WritablePacket *q = Packet::make(Packet::default_headroom, 0, hdr_len + mtu, 0);
+        if (!q)
+            continue;
+        memcpy(q->data(), p->data(), hdr_len);
+        memcpy(q->data() + hdr_len, p->data() + hdr_len + offset, mtu);
+        q->copy_annotations(p);
+        q->set_network_header(q->data() + nh_off, nh_len);
+        if (mac_off >= 0)
+            q->set_mac_header(q->data() + mac_off);
+        finish_segment(q, offset, index, false);
         output(0).push(q);
     }
+
+    // the last segment reuses p: move its headers up to the last payload
+    WritablePacket *q = p->uniqueify();
+    if (!q)
+        return;
+    memmove(q->data() + offset, q->data(), hdr_len);
+    q->pull(offset);
+    q->take(q->length() - hdr_len - (tcp_len - offset));
+    q->set_network_header(q->data() + nh_off, nh_len);
+    if (mac_off >= 0)
+        q->set_mac_header(q->data() + mac_off);
+    finish_segment(q, offset, index, true);
+    output(0).push(q);
 }
 
 CLICK_ENDDECLS
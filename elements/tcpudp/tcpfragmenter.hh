@@ -6,7 +6,7 @@ CLICK_DECLS
 /*
 =c
 
-TCPFragmenter(MTU)
+TCPFragmenter(MTU, [I<keywords> MTU_ANNO])
 
 =s tcp
 
@@ -17,9 +17,30 @@ fragments TCP packets to a maximum TCP payload size
 TCP Packets with payload length greater than the MTU are fragmented into
 multiple packets each containing at most MTU bytes of TCP payload.  Each of
 these new packets will be a copy of the input packet except for checksums (ip
-and tcp), length (ip length), and tcp sequence number (for all fragments except
-the first).  This means that TCPFragmenter can operate on packets that have
-ethernet headers, and all ethernet headers will be copied to each fragment.
+and tcp), length (ip length), IP ID, tcp sequence number (for all fragments
+except the first), and flags: like segmentation offload, only the last
+segment keeps FIN and PSH, and only the first keeps CWR.  This means that
+TCPFragmenter can operate on packets that have ethernet headers, and all
+ethernet headers will be copied to each fragment.
+
+Each segment but the last is a new packet holding a copy of the headers and
+its own part of the payload.  The last segment reuses the input packet, with
+its headers moved up to the remaining payload, so segmenting a large packet
+copies each payload byte at most once.
+
+Keyword arguments are:
+
+=over 8
+
+=item MTU_ANNO
+
+Optional. A 2 byte annotation.  Packets whose MTU_ANNO is nonzero are
+segmented to that many bytes of payload instead of MTU, like segmentation
+offload with a per-packet segment size.  This lets a host or Socket path
+send large TCP buffers through the router and segment them right before
+ToDevice.
+
+=back
 
 =a IPFragmenter, TCPIPEncap
 */
@@ -40,6 +61,9 @@ class TCPFragmenter : public Element { public:
 
   private:
     uint16_t _mtu;
+    int8_t _mtu_anno;
+
+    static void finish_segment(WritablePacket *q, int offset, int index, bool last);
 };
 
 CLICK_ENDDECLS
@@ -22,6 +22,7 @@
 #include <click/error.hh>
 #include <click/args.hh>
 #include <click/master.hh>
+#include <click/timerset.hh>
 CLICK_DECLS
 
 TimerTest::TimerTest()
@@ -36,10 +37,13 @@ TimerTest::configure(Vector<String> &conf, ErrorHandler *errh)
     bool schedule = false;
     if (Args(conf, this, errh)
 	.read("BENCHMARK", _benchmark)
+	.read("TICK", _tick)
 	.read("DELAY", delay)
 	.read("SCHEDULE", schedule)
 	.complete() < 0)
 	return -1;
+    if (_tick.is_negative() || _tick > Timestamp(1, 0))
+	return errh->error("TICK must be between 0 and 1 second");
     _timer.initialize(this);
     if (schedule || delay)
 	_timer.schedule_after(delay);
@@ -60,15 +64,22 @@ TimerTest::initialize(ErrorHandler *)
 	click_chatter("Initializing explicit_do_nothing_timer");
 	explicit_do_nothing_timer.initialize(this);
     } else {
-	Timestamp now = Timestamp::now_steady();
 	Timer *ts = new Timer[_benchmark];
 	for (int i = 0; i < _benchmark; ++i) {
 	    ts[i].assign();
 	    ts[i].initialize(this);
 	}
-	benchmark_schedules(ts, _benchmark, now);
-	benchmark_changes(ts, _benchmark, now);
-	benchmark_fires(ts, _benchmark, now);
+	if (!_tick)
+	    benchmark(ts, _benchmark);
+	else {
+	    TimerSet &tset = ts->thread()->timer_set();
+	    Timestamp old_tick = tset.timer_wheel_tick();
+	    tset.set_timer_wheel_tick(Timestamp());
+	    benchmark(ts, _benchmark);
+	    tset.set_timer_wheel_tick(_tick);
+	    benchmark(ts, _benchmark);
+	    tset.set_timer_wheel_tick(old_tick);
+	}
 	delete[] ts;
     }
 
@@ -81,6 +92,25 @@ TimerTest::run_timer(Timer *t)
     click_chatter("%p{timestamp}: %p{element} fired", &t->expiry_steady(), this);
 }
 
+void
+TimerTest::benchmark(Timer *ts, int nts)
+{
+    Timestamp now = Timestamp::now_steady();
+    Timestamp t0 = Timestamp::now();
+    benchmark_schedules(ts, nts, now);
+    Timestamp t1 = Timestamp::now();
+    benchmark_changes(ts, nts, now);
+    Timestamp t2 = Timestamp::now();
+    benchmark_fires(ts, nts, now);
+    Timestamp t3 = Timestamp::now();
+    if (_tick) {
+	Timestamp tick = ts->thread()->timer_set().timer_wheel_tick();
+	t3 -= t2, t2 -= t1, t1 -= t0;
+	click_chatter("%p{element}: %s: schedule %p{timestamp}, change %p{timestamp}, fire %p{timestamp}",
+		      this, tick ? "wheel" : "heap", &t1, &t2, &t3);
+    }
+}
+
 void
 TimerTest::benchmark_schedules(Timer *ts, int nts, const Timestamp &now)
 {
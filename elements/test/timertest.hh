@@ -41,6 +41,13 @@ Integer.  If set to a positive number, then TimerTest runs a timer
 manipulation benchmark at installation time involving BENCHMARK total
 timers.  Default is 0 (don't benchmark).
 
+=item TICK
+
+Timestamp.  If nonzero, then the BENCHMARK runs twice, once with the
+thread's timer heap and once with a hierarchical timing wheel of granularity
+TICK, and TimerTest reports the time taken by each phase.  Default is 0
+(benchmark whichever structure the thread uses).
+
 =back
 
 =h scheduled rw
@@ -77,10 +84,12 @@ class TimerTest : public Element { public:
 
     Timer _timer;
     int _benchmark;
+    Timestamp _tick;
 
     void benchmark_schedules(Timer *ts, int nts, const Timestamp &now);
     void benchmark_changes(Timer *ts, int nts, const Timestamp &now);
     void benchmark_fires(Timer *ts, int nts, const Timestamp &now);
+    void benchmark(Timer *ts, int nts);
 
     enum { h_scheduled, h_expiry, h_schedule_after, h_unschedule };
     static String read_handler(Element *e, void *user_data);
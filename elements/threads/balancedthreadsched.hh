@@ -15,7 +15,7 @@
  * order based on cost, then binpack. Otherwise, tasks are decreasingly
  * sorted. By default, INCREASING is true.
  *
- * =a ThreadMonitor, StaticThreadSched
+ * =a ThreadMonitor, StaticThreadSched, WorkStealingSched
  */
 
 #include <click/element.hh>
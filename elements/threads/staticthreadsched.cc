@@ -69,5 +69,16 @@ StaticThreadSched::initial_home_thread_id(const Element *e)
 	return THREAD_UNKNOWN;
 }
 
+bool
+StaticThreadSched::initial_migratable(const Element *e)
+{
+    // elements bound to a thread stay there
+    int eidx = e->eindex();
+    if (eidx >= 0 && eidx < _thread_preferences.size()
+	&& _thread_preferences[eidx] != THREAD_UNKNOWN)
+	return false;
+    return _next_thread_sched && _next_thread_sched->initial_migratable(e);
+}
+
 CLICK_ENDDECLS
 EXPORT_ELEMENT(StaticThreadSched)
@@ -14,8 +14,11 @@ CLICK_DECLS
  * Statically binds elements to threads. If more than one StaticThreadSched
  * is specified, they will all run. The one that runs later may override an
  * earlier run.
+ *
+ * Elements bound to a thread by StaticThreadSched are never moved by
+ * WorkStealingSched.
  * =a
- * ThreadMonitor, BalancedThreadSched
+ * ThreadMonitor, BalancedThreadSched, WorkStealingSched
  */
 
 class StaticThreadSched : public Element, public ThreadSched { public:
@@ -28,6 +31,7 @@ class StaticThreadSched : public Element, public ThreadSched { public:
     int configure(Vector<String> &, ErrorHandler *);
 
     int initial_home_thread_id(const Element *e);
+    bool initial_migratable(const Element *e);
 
   private:
 
@@ -0,0 +1,161 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * workstealingsched.{cc,hh} -- idle threads take tasks from busy threads
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "workstealingsched.hh"
+#include <click/task.hh>
+#include <click/routerthread.hh>
+#include <click/master.hh>
+#include <click/router.hh>
+#include <click/straccum.hh>
+#include <click/error.hh>
+#include <click/args.hh>
+CLICK_DECLS
+
+WorkStealingSched::WorkStealingSched()
+    : _all(true), _next_thread_sched(0)
+{
+}
+
+WorkStealingSched::~WorkStealingSched()
+{
+}
+
+int
+WorkStealingSched::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    String elements;
+    _hysteresis = Timestamp::make_msec(10);
+    if (Args(conf, this, errh)
+	.read_p("ELEMENTS", AnyArg(), elements)
+	.read("HYSTERESIS", _hysteresis)
+	.complete() < 0)
+	return -1;
+
+    _all = !elements;
+    Vector<String> words;
+    cp_spacevec(elements, words);
+    for (int i = 0; i < words.size(); ++i) {
+	Element *e = cp_element(words[i], this, errh);
+	if (!e)
+	    return -1;
+	if (e->eindex() >= _migratable.size())
+	    _migratable.resize(e->eindex() + 1, 0);
+	_migratable[e->eindex()] = 1;
+    }
+
+    _next_thread_sched = router()->thread_sched();
+    router()->set_thread_sched(this);
+    return 0;
+}
+
+void
+WorkStealingSched::set_work_stealing(bool steal)
+{
+    Master *m = master();
+    for (int i = 0; i < m->nthreads(); ++i)
+	m->thread(i)->set_work_stealing(steal, _hysteresis.jiffies());
+}
+
+int
+WorkStealingSched::initialize(ErrorHandler *)
+{
+    set_work_stealing(true);
+    return 0;
+}
+
+void
+WorkStealingSched::cleanup(CleanupStage stage)
+{
+    if (stage >= CLEANUP_INITIALIZED)
+	set_work_stealing(false);
+}
+
+int
+WorkStealingSched::initial_home_thread_id(const Element *e)
+{
+    if (_next_thread_sched)
+	return _next_thread_sched->initial_home_thread_id(e);
+    else
+	return THREAD_UNKNOWN;
+}
+
+bool
+WorkStealingSched::initial_migratable(const Element *e)
+{
+    // respect elements bound by a later StaticThreadSched
+    if (_next_thread_sched
+	&& _next_thread_sched->initial_home_thread_id(e) != THREAD_UNKNOWN)
+	return false;
+    int eidx = e->eindex();
+    return _all || (eidx >= 0 && eidx < _migratable.size() && _migratable[eidx]);
+}
+
+enum { h_stats, h_tasks, h_hysteresis };
+
+String
+WorkStealingSched::read_handler(Element *e, void *thunk)
+{
+    WorkStealingSched *ws = static_cast<WorkStealingSched *>(e);
+    Master *m = ws->master();
+    StringAccum sa;
+    switch ((intptr_t) thunk) {
+    case h_stats:
+	for (int i = 0; i < m->nthreads(); ++i) {
+	    RouterThread *t = m->thread(i);
+	    sa << i << ' ' << t->steal_waits() << ' ' << t->steals_in()
+	       << ' ' << t->steals_out() << '\n';
+	}
+	break;
+    case h_tasks:
+	for (int i = 0; i < m->nthreads(); ++i) {
+	    Vector<Task *> tasks;
+	    m->thread(i)->scheduled_tasks(ws->router(), tasks);
+	    for (Task **tp = tasks.begin(); tp != tasks.end(); ++tp)
+		if ((*tp)->migratable())
+		    sa << (*tp)->element()->name() << ' ' << i << ' '
+		       << (*tp)->steals() << '\n';
+	}
+	break;
+    case h_hysteresis:
+	return ws->_hysteresis.unparse_interval();
+    }
+    return sa.take_string();
+}
+
+int
+WorkStealingSched::write_handler(const String &str, Element *e, void *, ErrorHandler *errh)
+{
+    WorkStealingSched *ws = static_cast<WorkStealingSched *>(e);
+    Timestamp t;
+    if (!cp_time(str, &t) || t < Timestamp())
+	return errh->error("syntax error");
+    ws->_hysteresis = t;
+    ws->set_work_stealing(true);
+    return 0;
+}
+
+void
+WorkStealingSched::add_handlers()
+{
+    add_read_handler("stats", read_handler, h_stats);
+    add_read_handler("tasks", read_handler, h_tasks);
+    add_read_handler("hysteresis", read_handler, h_hysteresis);
+    add_write_handler("hysteresis", write_handler, h_hysteresis);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(multithread)
+EXPORT_ELEMENT(WorkStealingSched)
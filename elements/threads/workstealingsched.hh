@@ -0,0 +1,94 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_WORKSTEALINGSCHED_HH
+#define CLICK_WORKSTEALINGSCHED_HH
+#include <click/element.hh>
+#include <click/standard/threadsched.hh>
+CLICK_DECLS
+
+/*
+ * =c
+ * WorkStealingSched([ELEMENTS, I<keywords> HYSTERESIS])
+ * =s threads
+ * lets idle threads take tasks from busy threads
+ * =d
+ *
+ * Enables work stealing on every thread.  A thread that runs out of tasks,
+ * or whose tasks have found no work for about a thousand driver iterations
+ * (polling tasks such as FromDevice on a quiet interface), asks for work;
+ * the next thread whose tasks are doing work gives it one of its scheduled
+ * migratable tasks.  The busy thread always keeps the task at the
+ * head of its run queue and gives away its least urgent migratable task, so
+ * a thread with a single task is never robbed.  A task is moved only by the
+ * thread it currently runs on, so it never runs on two threads at once.
+ *
+ * ELEMENTS is a space-separated list of elements whose tasks are migratable.
+ * If it is not given, every element's tasks are migratable, except for
+ * elements bound to a thread by StaticThreadSched.  Tasks are marked when
+ * they are initialized; an element may change its tasks' setting with
+ * Task::set_migratable().
+ *
+ * Keyword arguments are:
+ *
+ * =over 8
+ *
+ * =item HYSTERESIS
+ *
+ * Time.  A task that moved between threads, whether by work stealing or by
+ * another thread scheduler, is not stolen again for this long.  This keeps
+ * tasks near their caches when load is bursty.  Default is 10ms.
+ *
+ * =back
+ *
+ * Work stealing complements BalancedThreadSched, which rebalances tasks on a
+ * coarse timer: it reacts within one driver iteration, but only moves work
+ * toward idle threads.
+ *
+ * =h stats read-only
+ *
+ * Returns a table with one line per thread: thread ID, number of times the
+ * thread asked for work, number of tasks it received, and number of tasks it
+ * gave away.
+ *
+ * =h tasks read-only
+ *
+ * Returns one line per scheduled migratable task: the task's element, its
+ * current thread, and the number of times it was stolen.
+ *
+ * =h hysteresis read/write
+ *
+ * Returns or sets the HYSTERESIS argument.
+ *
+ * =a BalancedThreadSched, StaticThreadSched
+ */
+
+class WorkStealingSched : public Element, public ThreadSched { public:
+
+    WorkStealingSched();
+    ~WorkStealingSched();
+
+    const char *class_name() const	{ return "WorkStealingSched"; }
+
+    int configure(Vector<String> &, ErrorHandler *);
+    int initialize(ErrorHandler *);
+    void cleanup(CleanupStage);
+    void add_handlers();
+
+    int initial_home_thread_id(const Element *e);
+    bool initial_migratable(const Element *e);
+
+  private:
+
+    Vector<int> _migratable;
+    bool _all;
+    Timestamp _hysteresis;
+    ThreadSched *_next_thread_sched;
+
+    void set_work_stealing(bool steal);
+
+    static String read_handler(Element *e, void *thunk);
+    static int write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh);
+
+};
+
+CLICK_ENDDECLS
+#endif
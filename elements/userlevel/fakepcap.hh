@@ -78,6 +78,59 @@ struct fake_modified_pcap_pkthdr {
 	uint8_t pad;		/* pad to a 4-byte boundary */
 };
 
+/*
+ * pcapng ("next generation") files are a sequence of blocks. Each block
+ * starts with this header and ends with a copy of its total length. Blocks
+ * and options are padded to 4-byte boundaries.
+ */
+#define FAKE_PCAPNG_SHB_TYPE		0x0A0D0D0A	/* section header */
+#define FAKE_PCAPNG_IDB_TYPE		0x00000001	/* interface description */
+#define FAKE_PCAPNG_PB_TYPE		0x00000002	/* packet (obsolete) */
+#define FAKE_PCAPNG_SPB_TYPE		0x00000003	/* simple packet */
+#define FAKE_PCAPNG_EPB_TYPE		0x00000006	/* enhanced packet */
+#define FAKE_PCAPNG_BYTE_ORDER_MAGIC	0x1A2B3C4D
+#define FAKE_PCAPNG_VERSION_MAJOR	1
+#define FAKE_PCAPNG_VERSION_MINOR	0
+
+#define FAKE_PCAPNG_OPT_ENDOFOPT	0
+#define FAKE_PCAPNG_OPT_COMMENT		1
+#define FAKE_PCAPNG_OPT_IF_TSRESOL	9
+#define FAKE_PCAPNG_OPT_IF_TSOFFSET	14
+
+struct fake_pcapng_block_header {
+	uint32_t type;
+	uint32_t length;	/* total length, including header and trailer */
+};
+
+struct fake_pcapng_shb {
+	struct fake_pcapng_block_header hdr;
+	uint32_t byte_order_magic;
+	uint16_t version_major;
+	uint16_t version_minor;
+	uint32_t section_length[2];	/* 64-bit, -1 if unknown */
+};
+
+struct fake_pcapng_idb {
+	struct fake_pcapng_block_header hdr;
+	uint16_t linktype;
+	uint16_t reserved;
+	uint32_t snaplen;
+};
+
+struct fake_pcapng_epb {
+	struct fake_pcapng_block_header hdr;
+	uint32_t interface_id;
+	uint32_t ts_high;	/* timestamp in interface's if_tsresol units */
+	uint32_t ts_low;
+	uint32_t caplen;
+	uint32_t len;
+};
+
+struct fake_pcapng_option {
+	uint16_t code;
+	uint16_t length;	/* unpadded value length */
+};
+
 // Parsing and unparsing.
 int fake_pcap_parse_dlt(const String&);
 String fake_pcap_unparse_dlt(int);
@@ -0,0 +1,352 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+/*
+ * flamesampler.{cc,hh} -- sample element call stacks for flame graphs
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "flamesampler.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/router.hh>
+#include <click/master.hh>
+#include <click/straccum.hh>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+#if defined(__linux__)
+# include <sys/syscall.h>
+# ifndef sigev_notify_thread_id
+#  define sigev_notify_thread_id _sigev_un._tid
+# endif
+#endif
+CLICK_DECLS
+
+#if defined(__linux__) && defined(SIGEV_THREAD_ID) && defined(CLOCK_THREAD_CPUTIME_ID)
+# define FLAMESAMPLER_SUPPORTED 1
+#endif
+
+FlameSampler *FlameSampler::the_sampler;
+
+FlameSampler::FlameSampler()
+    : _slots(0), _nslots(0), _installed(false), _samples(0), _drain_timer(this)
+{
+}
+
+FlameSampler::~FlameSampler()
+{
+}
+
+int
+FlameSampler::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    _frequency = 99;
+    _capacity = 1024;
+    _active = true;
+    if (Args(conf, this, errh)
+	.read("FREQUENCY", _frequency)
+	.read("FILE", FilenameArg(), _filename)
+	.read("CAPACITY", _capacity)
+	.read("ACTIVE", _active)
+	.complete() < 0)
+	return -1;
+    if (_frequency == 0 || _frequency > 1000000)
+	return errh->error("FREQUENCY out of range");
+    if (_capacity == 0 || _capacity > 0x100000)
+	return errh->error("CAPACITY out of range");
+    return 0;
+}
+
+int
+FlameSampler::initialize(ErrorHandler *errh)
+{
+#if FLAMESAMPLER_SUPPORTED
+    if (the_sampler)
+	return errh->error("only one FlameSampler may run at a time");
+
+    _nslots = master()->nthreads();
+    _slots = new Slot[_nslots];
+    for (int i = 0; i < _nslots; ++i)
+	if (!_slots[i].ring.initialize(_capacity))
+	    return errh->error("out of memory");
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = signal_handler;
+    sa.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    if (sigaction(SIGPROF, &sa, &_old_action) < 0)
+	return errh->error("sigaction: %s", strerror(errno));
+    the_sampler = this;
+    _installed = true;
+    router()->set_profile_stack(true);
+
+    // Each thread creates its own CPU-time timer, since the timer measures
+    // the thread that creates it.
+    for (int i = 0; i < _nslots; ++i) {
+	_slots[i].task = new Task(this);
+	_slots[i].task->initialize(this, true);
+	_slots[i].task->move_thread(i);
+    }
+
+    _drain_timer.initialize(this);
+    _drain_timer.schedule_after_sec(1);
+    return 0;
+#else
+    return errh->error("FlameSampler is not supported on this platform");
+#endif
+}
+
+void
+FlameSampler::cleanup(CleanupStage stage)
+{
+#if FLAMESAMPLER_SUPPORTED
+    if (_slots)
+	for (int i = 0; i < _nslots; ++i)
+	    if (_slots[i].timer_created) {
+		timer_delete(_slots[i].timer);
+		_slots[i].timer_created = false;
+	    }
+    if (_installed) {
+	// A signal from a deleted timer may still be pending.
+	if (_old_action.sa_handler == SIG_DFL) {
+	    struct sigaction sa;
+	    memset(&sa, 0, sizeof(sa));
+	    sa.sa_handler = SIG_IGN;
+	    sigaction(SIGPROF, &sa, 0);
+	} else
+	    sigaction(SIGPROF, &_old_action, 0);
+	the_sampler = 0;
+	router()->set_profile_stack(false);
+	_installed = false;
+    }
+
+    if (stage >= CLEANUP_ROUTER_INITIALIZED && _filename) {
+	String s = report();
+	FILE *f;
+	if (_filename == "-")
+	    f = stdout;
+	else if (!(f = fopen(_filename.c_str(), "w")))
+	    click_chatter("%p{element}: %s: %s", this, _filename.c_str(), strerror(errno));
+	if (f) {
+	    fwrite(s.data(), 1, s.length(), f);
+	    if (f != stdout)
+		fclose(f);
+	    else
+		fflush(f);
+	}
+    }
+#else
+    (void) stage;
+#endif
+
+    if (_slots)
+	for (int i = 0; i < _nslots; ++i)
+	    delete _slots[i].task;
+    delete[] _slots;
+    _slots = 0;
+}
+
+bool
+FlameSampler::run_task(Task *task)
+{
+#if FLAMESAMPLER_SUPPORTED
+    int i = task->home_thread_id();
+    if (i < 0 || i >= _nslots || _slots[i].timer_created)
+	return false;
+    struct sigevent sev;
+    memset(&sev, 0, sizeof(sev));
+    sev.sigev_notify = SIGEV_THREAD_ID;
+    sev.sigev_signo = SIGPROF;
+    sev.sigev_value.sival_int = i;
+    sev.sigev_notify_thread_id = syscall(SYS_gettid);
+    if (timer_create(CLOCK_THREAD_CPUTIME_ID, &sev, &_slots[i].timer) < 0) {
+	click_chatter("%p{element}: timer_create: %s", this, strerror(errno));
+	return false;
+    }
+    _slots[i].timer_created = true;
+    if (_active)
+	set_timers(true);
+#else
+    (void) task;
+#endif
+    return false;
+}
+
+void
+FlameSampler::run_timer(Timer *)
+{
+    drain();
+    _drain_timer.reschedule_after_sec(1);
+}
+
+void
+FlameSampler::set_timers(bool active)
+{
+#if FLAMESAMPLER_SUPPORTED
+    struct itimerspec its;
+    uint64_t nsec = active ? 1000000000 / _frequency : 0;
+    its.it_interval.tv_sec = nsec / 1000000000;
+    its.it_interval.tv_nsec = nsec % 1000000000;
+    its.it_value = its.it_interval;
+    for (int i = 0; i < _nslots; ++i)
+	if (_slots[i].timer_created)
+	    timer_settime(_slots[i].timer, 0, &its, 0);
+#else
+    (void) active;
+#endif
+}
+
+void
+FlameSampler::signal_handler(int, siginfo_t *info, void *)
+{
+    // Runs on the interrupted thread, which owns its ProfileState stack
+    // and is the only producer for its ring.
+    FlameSampler *fs = the_sampler;
+    if (!fs || !info)
+	return;
+    int i = info->si_value.sival_int;
+    if (i < 0 || i >= fs->_nslots)
+	return;
+
+    RouterThread::ProfileState &ps = fs->master()->thread(i)->profile_state();
+    Sample s;
+    s.depth = ps.stack_depth;
+    int n = s.depth < STACK_DEPTH ? s.depth : (int) STACK_DEPTH;
+    for (int j = 0; j < n; ++j) {
+	Element *e = ps.stack[j];
+	if (!e)
+	    s.eindex[j] = FRAME_NULL;
+	else if (e->router() != fs->router())
+	    s.eindex[j] = FRAME_FOREIGN;
+	else
+	    s.eindex[j] = e->eindex();
+    }
+
+    Slot &slot = fs->_slots[i];
+    if (!slot.ring.push(s))
+	++slot.drops;
+}
+
+String
+FlameSampler::unparse_frame(int eindex) const
+{
+    if (eindex >= 0 && eindex < router()->nelements()) {
+	Element *e = router()->element(eindex);
+	return e->name() + " (" + e->class_name() + ")";
+    } else if (eindex == -1)
+	return String::make_stable("[router]");
+    else if (eindex == FRAME_FOREIGN)
+	return String::make_stable("[other router]");
+    else
+	return String::make_stable("[unknown]");
+}
+
+void
+FlameSampler::drain()
+{
+    _lock.acquire();
+    for (int i = 0; _slots && i < _nslots; ++i)
+	while (Sample *s = _slots[i].ring.front()) {
+	    StringAccum sa;
+	    sa << "thread " << i;
+	    if (s->depth <= 0)
+		sa << ";[driver]";
+	    int n = s->depth < STACK_DEPTH ? s->depth : (int) STACK_DEPTH;
+	    for (int j = 0; j < n; ++j)
+		sa << ';' << unparse_frame(s->eindex[j]);
+	    if (s->depth > STACK_DEPTH)
+		sa << ";[truncated]";
+	    _slots[i].ring.pop_front();
+	    ++_stacks[sa.take_string()];
+	    ++_samples;
+	}
+    _lock.release();
+}
+
+String
+FlameSampler::report()
+{
+    drain();
+    _lock.acquire();
+    Vector<String> lines;
+    for (HashTable<String, uint64_t>::iterator it = _stacks.begin(); it; ++it)
+	lines.push_back(it.key() + " " + String(it.value()) + "\n");
+    _lock.release();
+    click_qsort(lines.begin(), lines.size());
+    StringAccum sa;
+    for (String *l = lines.begin(); l != lines.end(); ++l)
+	sa << *l;
+    return sa.take_string();
+}
+
+String
+FlameSampler::read_handler(Element *e, void *thunk)
+{
+    FlameSampler *fs = static_cast<FlameSampler *>(e);
+    switch (reinterpret_cast<intptr_t>(thunk)) {
+    case 0:
+	return fs->report();
+    case 1:
+	fs->drain();
+	return String(fs->_samples);
+    case 2: {
+	uint32_t d = 0;
+	for (int i = 0; fs->_slots && i < fs->_nslots; ++i)
+	    d += fs->_slots[i].drops;
+	return String(d);
+    }
+    default:
+	return String();
+    }
+}
+
+int
+FlameSampler::write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh)
+{
+    FlameSampler *fs = static_cast<FlameSampler *>(e);
+    switch (reinterpret_cast<intptr_t>(thunk)) {
+    case 0:
+	if (!BoolArg().parse(str, fs->_active))
+	    return errh->error("syntax error");
+	fs->set_timers(fs->_active);
+	return 0;
+    case 1:
+	fs->drain();
+	fs->_lock.acquire();
+	fs->_stacks.clear();
+	fs->_samples = 0;
+	fs->_lock.release();
+	for (int i = 0; fs->_slots && i < fs->_nslots; ++i)
+	    fs->_slots[i].drops = 0;
+	return 0;
+    default:
+	return 0;
+    }
+}
+
+void
+FlameSampler::add_handlers()
+{
+    add_read_handler("flame", read_handler, 0);
+    add_read_handler("samples", read_handler, 1);
+    add_read_handler("drops", read_handler, 2);
+    add_data_handlers("active", Handler::OP_READ | Handler::CHECKBOX, &_active);
+    add_write_handler("active", write_handler, 0);
+    add_write_handler("reset", write_handler, 1, Handler::BUTTON);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel)
+ELEMENT_LIBS(-lrt)
+EXPORT_ELEMENT(FlameSampler)
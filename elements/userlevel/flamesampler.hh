@@ -0,0 +1,175 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+#ifndef CLICK_FLAMESAMPLER_HH
+#define CLICK_FLAMESAMPLER_HH
+#include <click/element.hh>
+#include <click/task.hh>
+#include <click/timer.hh>
+#include <click/spscring.hh>
+#include <click/sync.hh>
+#include <click/hashtable.hh>
+#include <click/routerthread.hh>
+#include <time.h>
+#include <signal.h>
+CLICK_DECLS
+
+/*
+=c
+
+FlameSampler([I<keywords> FREQUENCY, FILE, CAPACITY, ACTIVE])
+
+=s debugging
+
+samples element call stacks for flame graphs
+
+=d
+
+Periodically interrupts each Click thread and records which elements it is
+running.  The record is an element call stack: the element whose task or
+timer is running, followed by each element it called with push or pull,
+innermost last.  The C<flame> handler reports the samples in the "collapsed
+stack" format read by Brendan Gregg's F<flamegraph.pl> and compatible tools.
+Each line has a stack, with frames separated by semicolons, followed by a
+space and the number of samples that saw that stack:
+
+  thread 0;src (InfiniteSource);c (Counter);q (Queue) 140
+
+The first frame names the thread.  Other frames are "NAME (CLASS)".  Samples
+taken outside any task or timer, for instance while a thread waits for file
+descriptors or runs the scheduler, have the single frame "[driver]".  Stacks
+deeper than 32 frames end with "[truncated]".
+
+Threads are interrupted with a per-thread CPU-time interval timer and SIGPROF,
+so an idle thread takes no samples.  The signal handler only copies the
+thread's stack into a per-thread lock-free ring; samples are aggregated later,
+when a timer or a handler drains the rings.  While FlameSampler is active,
+every push and pull transfer updates the stack, which costs a few cycles per
+transfer; see also the global C<profile> handler, which counts cycles per
+element.
+
+Keyword arguments are:
+
+=over 8
+
+=item FREQUENCY
+
+Positive integer.  Samples per second of each thread's CPU time.  The default
+is 99, which avoids sampling in lockstep with activity that repeats on
+round-numbered intervals.
+
+=item FILE
+
+Filename.  If given, FlameSampler writes the C<flame> report to FILE when the
+router is cleaned up.  The filename "-" means standard output.
+
+=item CAPACITY
+
+Integer.  Number of samples each thread may buffer before they are
+aggregated.  Samples taken while the buffer is full are dropped.  Default is
+1024.
+
+=item ACTIVE
+
+Boolean.  If false, FlameSampler does not sample until its C<active> handler
+is set to true.  Default is true.
+
+=back
+
+FlameSampler uses Linux thread-directed timers, and is only available in
+user-level processes on Linux.  A router may contain at most one
+FlameSampler, and no other part of the process should use SIGPROF.
+
+=e
+
+  FlameSampler(FILE out.folded);
+
+After the router exits, run "flamegraph.pl out.folded > out.svg".
+
+=h flame read-only
+
+Returns the collapsed-stack report of the samples taken so far.
+
+=h samples read-only
+
+Returns the number of samples taken.
+
+=h drops read-only
+
+Returns the number of samples dropped because a thread's buffer was full.
+
+=h active read/write
+
+Returns or sets the ACTIVE setting.
+
+=h reset write-only
+
+Discards the samples taken so far.
+
+=a
+
+ProgressBar, Counter */
+
+class FlameSampler : public Element { public:
+
+    FlameSampler();
+    ~FlameSampler();
+
+    const char *class_name() const	{ return "FlameSampler"; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh);
+    int initialize(ErrorHandler *errh);
+    void cleanup(CleanupStage stage);
+    void add_handlers();
+
+    bool run_task(Task *task);
+    void run_timer(Timer *timer);
+
+  private:
+
+    enum { STACK_DEPTH = RouterThread::ProfileState::STACK_DEPTH };
+    enum { FRAME_NULL = -3, FRAME_FOREIGN = -2 };
+
+    struct Sample {
+	int depth;
+	int eindex[STACK_DEPTH];
+    };
+
+    struct Slot {
+	SPSCRing<Sample> ring;
+	Task *task;
+	timer_t timer;
+	bool timer_created;
+	uint32_t drops;
+	Slot()
+	    : task(0), timer_created(false), drops(0) {
+	}
+    };
+
+    Slot *_slots;
+    int _nslots;
+    uint32_t _frequency;
+    uint32_t _capacity;
+    bool _active;
+    String _filename;
+    bool _installed;
+    struct sigaction _old_action;
+
+    Spinlock _lock;
+    HashTable<String, uint64_t> _stacks;
+    uint64_t _samples;
+    Timer _drain_timer;
+
+    static FlameSampler *the_sampler;
+
+    static void signal_handler(int sig, siginfo_t *info, void *context);
+    void set_timers(bool active);
+    void drain();
+    String unparse_frame(int eindex) const;
+    String report();
+
+    static String read_handler(Element *e, void *thunk);
+    static int write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh);
+
+};
+
+CLICK_ENDDECLS
+#endif
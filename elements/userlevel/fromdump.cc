@@ -47,7 +47,8 @@ CLICK_DECLS
 	( (((y)&0xff)<<8) | ((u_short)((y)&0xff00)>>8) )
 
 FromDump::FromDump()
-    : _packet(0), _end_h(0), _count(0), _timer(this), _task(this)
+    : _packet(0), _pcapng(false), _packet_interface(0), _end_h(0), _count(0),
+      _timer(this), _task(this)
 {
 }
 
@@ -86,6 +87,7 @@ FromDump::configure(Vector<String> &conf, ErrorHandler *errh)
     bool per_node = false;
 #endif
     _packet_filepos = 0;
+    _interface_anno = PAINT_ANNO_OFFSET;
 
     if (_ff.configure_keywords(conf, this, errh) < 0)
 	return -1;
@@ -106,6 +108,7 @@ FromDump::configure(Vector<String> &conf, ErrorHandler *errh)
 	.read("PER_NODE", per_node)
 #endif
 	.read("FILEPOS", _packet_filepos)
+	.read("INTERFACE_ANNO", AnnoArg(1), _interface_anno)
 	.complete() < 0)
 	return -1;
 
@@ -226,6 +229,21 @@ FromDump::initialize(ErrorHandler *errh)
     if (!fh)
 	return _ff.error(errh, "not a tcpdump file (too short)");
 
+    if (fh->magic == FAKE_PCAPNG_SHB_TYPE) {
+	// pcapng: back up and parse the section header and first interface
+	_pcapng = true;
+	_ff.shift_pos(-(int) sizeof(fake_pcap_file_header));
+	Timestamp ts;
+	int len, caplen, skiplen;
+	int r = read_pcapng_block(errh, ts, len, caplen, skiplen, true);
+	if (r == 0)
+	    return _ff.error(errh, "pcapng file has no interface description");
+	else if (r < 0)
+	    return -1;
+	_linktype = _interfaces[0].linktype;
+	goto check_linktype;
+    }
+
     if (fh->magic == FAKE_PCAP_MAGIC || fh->magic == FAKE_MODIFIED_PCAP_MAGIC)
 	_swapped = false;
     else {
@@ -244,6 +262,7 @@ FromDump::initialize(ErrorHandler *errh)
     // map possible host link types to global link types
     _linktype = fake_pcap_canonical_dlt(fh->linktype, true);
 
+  check_linktype:
     // if forcing IP packets, check datalink type to ensure we understand it
     if (_force_ip) {
 	if (!fake_pcap_dlt_force_ipable(_linktype))
@@ -274,6 +293,8 @@ FromDump::take_state(Element *e, ErrorHandler *errh)
     _swapped = o->_swapped;
     _extra_pkthdr_crap = o->_extra_pkthdr_crap;
     _minor_version = o->_minor_version;
+    _pcapng = o->_pcapng;
+    _interfaces = o->_interfaces;
 
     _linktype = o->_linktype;
     if (_linktype == FAKE_DLT_RAW)
@@ -320,6 +341,188 @@ FromDump::prepare_times(const Timestamp &ts)
     _have_any_times = true;
 }
 
+Timestamp
+FromDump::pcapng_timestamp(const Interface &i, uint64_t t) const
+{
+    uint64_t sec, frac;
+    uint32_t nsec;
+    if (i.ts_shift >= 0) {
+	sec = t >> i.ts_shift;
+	frac = t & (i.ts_units - 1);
+	if (i.ts_shift > 32)
+	    nsec = ((frac >> (i.ts_shift - 32)) * 1000000000) >> 32;
+	else
+	    nsec = (frac * 1000000000) >> i.ts_shift;
+    } else {
+	sec = t / i.ts_units;
+	frac = t % i.ts_units;
+	if (i.ts_units > 1000000000)
+	    nsec = frac / (i.ts_units / 1000000000);
+	else
+	    nsec = frac * (1000000000 / i.ts_units);
+    }
+    return Timestamp::make_nsec(sec + i.ts_offset, nsec);
+}
+
+/* Read pcapng blocks until a packet block is found. Interface descriptions
+   and section headers are processed; other blocks are skipped. Returns 1
+   and sets the arguments on a packet, 0 at end of file, and negative on
+   error. If interface_only is true, returns 2 after the first interface
+   description instead. */
+int
+FromDump::read_pcapng_block(ErrorHandler *errh, Timestamp &ts, int &len,
+			    int &caplen, int &skiplen, bool interface_only)
+{
+    uint32_t buf[8];
+    while (1) {
+	const uint32_t *bh = reinterpret_cast<const uint32_t *>(_ff.get_aligned(sizeof(fake_pcapng_block_header), buf));
+	if (!bh)
+	    return 0;
+	uint32_t type = bh[0], blen = bh[1];
+
+	if (type == FAKE_PCAPNG_SHB_TYPE) {
+	    // each section may have a different byte order
+	    const uint32_t *m = reinterpret_cast<const uint32_t *>(_ff.get_aligned(8, buf + 2));
+	    if (!m)
+		return 0;
+	    if (m[0] == FAKE_PCAPNG_BYTE_ORDER_MAGIC)
+		_swapped = false;
+	    else if (m[0] == SWAPLONG(FAKE_PCAPNG_BYTE_ORDER_MAGIC))
+		_swapped = true;
+	    else
+		return _ff.error(errh, "not a pcapng file (bad byte order magic)");
+	    const uint16_t *v = reinterpret_cast<const uint16_t *>(m + 1);
+	    int major = (_swapped ? SWAPSHORT(v[0]) : v[0]);
+	    if (_swapped)
+		blen = SWAPLONG(blen);
+	    if (blen < sizeof(fake_pcapng_shb) + 4 || (blen & 3))
+		return _ff.error(errh, "bad pcapng section header");
+	    if (major != FAKE_PCAPNG_VERSION_MAJOR)
+		return _ff.error(errh, "unknown pcapng major version %d", major);
+	    _interfaces.clear();
+	    _ff.shift_pos(blen - sizeof(fake_pcapng_block_header) - 8);
+	    continue;
+	}
+
+	if (_swapped) {
+	    type = SWAPLONG(type);
+	    blen = SWAPLONG(blen);
+	}
+	if (blen < sizeof(fake_pcapng_block_header) + 4 || (blen & 3))
+	    return _ff.error(errh, "bad pcapng block length %u", blen);
+	uint32_t body = blen - sizeof(fake_pcapng_block_header) - 4;
+
+	if (type == FAKE_PCAPNG_IDB_TYPE) {
+	    if (body < 8)
+		return _ff.error(errh, "bad pcapng interface description");
+	    const uint32_t *ib = reinterpret_cast<const uint32_t *>(_ff.get_aligned(8, buf));
+	    if (!ib)
+		return 0;
+	    Interface i;
+	    uint16_t linktype = reinterpret_cast<const uint16_t *>(ib)[0];
+	    i.linktype = fake_pcap_canonical_dlt(_swapped ? SWAPSHORT(linktype) : linktype, true);
+	    i.snaplen = (_swapped ? SWAPLONG(ib[1]) : ib[1]);
+	    i.ts_units = 1000000;	// default resolution is microseconds
+	    i.ts_shift = -1;
+	    i.ts_offset = 0;
+
+	    // parse options for timestamp resolution and offset
+	    String opts = _ff.get_string(body - 8);
+	    const uint8_t *o = reinterpret_cast<const uint8_t *>(opts.data());
+	    const uint8_t *oend = o + opts.length();
+	    while (o + sizeof(fake_pcapng_option) <= oend) {
+		fake_pcapng_option opt;
+		memcpy(&opt, o, sizeof(opt));
+		if (_swapped) {
+		    opt.code = SWAPSHORT(opt.code);
+		    opt.length = SWAPSHORT(opt.length);
+		}
+		o += sizeof(opt);
+		if (opt.code == FAKE_PCAPNG_OPT_ENDOFOPT || o + opt.length > oend)
+		    break;
+		if (opt.code == FAKE_PCAPNG_OPT_IF_TSRESOL && opt.length >= 1) {
+		    int e = o[0] & 0x7F;
+		    if (o[0] & 0x80) {
+			if (e < 64)
+			    i.ts_units = (uint64_t) 1 << e, i.ts_shift = e;
+		    } else if (e <= 19) {
+			for (i.ts_units = 1; e > 0; e--)
+			    i.ts_units *= 10;
+		    }
+		} else if (opt.code == FAKE_PCAPNG_OPT_IF_TSOFFSET && opt.length >= 8) {
+		    uint32_t w[2];
+		    memcpy(w, o, 8);
+		    if (_swapped)
+			i.ts_offset = ((uint64_t) SWAPLONG(w[0]) << 32) | SWAPLONG(w[1]);
+		    else
+			memcpy(&i.ts_offset, o, 8);
+		}
+		o += (opt.length + 3) & ~3;
+	    }
+	    _ff.shift_pos(4);
+	    _interfaces.push_back(i);
+	    if (interface_only)
+		return 2;
+	    continue;
+	}
+
+	if (type == FAKE_PCAPNG_EPB_TYPE || type == FAKE_PCAPNG_PB_TYPE) {
+	    if (body < 20)
+		return _ff.error(errh, "bad pcapng packet block");
+	    const uint32_t *eb = reinterpret_cast<const uint32_t *>(_ff.get_aligned(20, buf));
+	    if (!eb)
+		return 0;
+	    uint32_t ifid, ts_high, ts_low, cl, ol;
+	    if (type == FAKE_PCAPNG_EPB_TYPE)
+		ifid = eb[0];
+	    else
+		ifid = reinterpret_cast<const uint16_t *>(eb)[0];
+	    ts_high = eb[1], ts_low = eb[2], cl = eb[3], ol = eb[4];
+	    if (_swapped) {
+		ifid = (type == FAKE_PCAPNG_EPB_TYPE ? SWAPLONG(ifid) : SWAPSHORT(ifid));
+		ts_high = SWAPLONG(ts_high);
+		ts_low = SWAPLONG(ts_low);
+		cl = SWAPLONG(cl);
+		ol = SWAPLONG(ol);
+	    }
+	    if (ifid >= (uint32_t) _interfaces.size())
+		return _ff.error(errh, "pcapng packet for undescribed interface %u", ifid);
+	    if (cl > body - 20)
+		return _ff.error(errh, "bad pcapng packet block");
+	    const Interface &i = _interfaces[ifid];
+	    ts = pcapng_timestamp(i, ((uint64_t) ts_high << 32) | ts_low);
+	    caplen = cl;
+	    len = ol;
+	    skiplen = body - 20 - cl + 4;
+	    _packet_interface = ifid;
+	    _linktype = i.linktype;
+	    return 1;
+	}
+
+	if (type == FAKE_PCAPNG_SPB_TYPE) {
+	    if (body < 4 || _interfaces.empty())
+		return _ff.error(errh, "bad pcapng simple packet block");
+	    const uint32_t *sb = reinterpret_cast<const uint32_t *>(_ff.get_aligned(4, buf));
+	    if (!sb)
+		return 0;
+	    uint32_t ol = (_swapped ? SWAPLONG(sb[0]) : sb[0]);
+	    uint32_t cl = (ol < body - 4 ? ol : body - 4);
+	    if (_interfaces[0].snaplen && cl > _interfaces[0].snaplen)
+		cl = _interfaces[0].snaplen;
+	    ts = Timestamp();	// simple packet blocks have no timestamp
+	    caplen = cl;
+	    len = ol;
+	    skiplen = body - 4 - cl + 4;
+	    _packet_interface = 0;
+	    _linktype = _interfaces[0].linktype;
+	    return 1;
+	}
+
+	// skip statistics, name resolution, and unknown blocks
+	_ff.shift_pos(body + 4);
+    }
+}
+
 bool
 FromDump::read_packet(ErrorHandler *errh)
 {
@@ -333,6 +536,17 @@ FromDump::read_packet(ErrorHandler *errh)
     // record file position
     _packet_filepos = _ff.file_pos();
 
+    // read a pcapng packet block
+    if (_pcapng) {
+	if (read_pcapng_block(errh, ts, len, caplen, skiplen, false) <= 0)
+	    return false;
+	if (caplen > len) {
+	    skiplen += caplen - len;
+	    caplen = len;
+	}
+	goto check_times;
+    }
+
     // read the packet header
     if (!(ph = reinterpret_cast<const fake_pcap_pkthdr *>(_ff.get_aligned(sizeof(*ph), &swapped_ph))))
 	return false;
@@ -365,10 +579,10 @@ FromDump::read_packet(ErrorHandler *errh)
 
     // compensate for modified pcap versions
     _ff.shift_pos(_extra_pkthdr_crap);
+    ts = fake_bpf_timeval_union::make_timestamp(&ph->ts);
 
     // check times
   check_times:
-    ts = fake_bpf_timeval_union::make_timestamp(&ph->ts);
     if (!_have_any_times)
 	prepare_times(ts);
     if (_have_first_time) {
@@ -401,6 +615,8 @@ FromDump::read_packet(ErrorHandler *errh)
     if (!p)
 	return false;
     SET_EXTRA_LENGTH_ANNO(p, len - caplen);
+    if (_pcapng && _interface_anno >= 0)
+	p->set_anno_u8(_interface_anno, _packet_interface);
     _ff.shift_pos(skiplen);
 
     p->set_mac_header(p->data());
@@ -504,7 +720,7 @@ FromDump::pull(int)
 
 enum {
     H_SAMPLING_PROB, H_ACTIVE, H_ENCAP, H_STOP, H_PACKET_FILEPOS,
-    H_EXTEND_INTERVAL, H_COUNT, H_RESET_COUNTS, H_RESET_TIMING
+    H_EXTEND_INTERVAL, H_COUNT, H_RESET_COUNTS, H_RESET_TIMING, H_INTERFACES
 };
 
 String
@@ -516,6 +732,8 @@ FromDump::read_handler(Element *e, void *thunk)
 	return cp_unparse_real2(fd->_sampling_prob, SAMPLING_SHIFT);
     case H_ENCAP:
 	return String(fake_pcap_unparse_dlt(fd->_linktype));
+    case H_INTERFACES:
+	return String(fd->_interfaces.size());
     default:
 	return "<error>";
     }
@@ -570,6 +788,7 @@ FromDump::add_handlers()
     add_data_handlers("active", Handler::OP_READ | Handler::CHECKBOX, &_active);
     add_write_handler("active", write_handler, H_ACTIVE);
     add_read_handler("encap", read_handler, H_ENCAP);
+    add_read_handler("interfaces", read_handler, H_INTERFACES);
     add_write_handler("stop", write_handler, H_STOP, Handler::BUTTON);
     add_data_handlers("packet_filepos", Handler::OP_READ, &_packet_filepos);
     add_write_handler("extend_interval", write_handler, H_EXTEND_INTERVAL);
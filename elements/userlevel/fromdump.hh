@@ -12,7 +12,7 @@ class HandlerCall;
 /*
 =c
 
-FromDump(FILENAME [, I<keywords> STOP, TIMING, SAMPLE, FORCE_IP, START, START_AFTER, END, END_AFTER, INTERVAL, END_CALL, FILEPOS, MMAP])
+FromDump(FILENAME [, I<keywords> STOP, TIMING, SAMPLE, FORCE_IP, START, START_AFTER, END, END_AFTER, INTERVAL, END_CALL, FILEPOS, MMAP, INTERFACE_ANNO])
 
 =s traces
 
@@ -27,6 +27,12 @@ more packets.
 FromDump also transparently reads gzip- and bzip2-compressed tcpdump files, if
 you have zcat(1) and bzcat(1) installed.
 
+FromDump reads pcapng files as well as classic libpcap files. pcapng files
+may contain several sections and several interfaces, each with its own
+encapsulation type and timestamp resolution; FromDump preserves nanosecond
+(and finer, truncated to nanosecond) timestamps, and stores the interface
+number of each packet in an annotation (see INTERFACE_ANNO).
+
 Keyword arguments are:
 
 =over 8
@@ -108,6 +114,19 @@ This can result in slightly better performance on some machines. FromDump's
 regular file discipline is pretty optimized, so the difference is often small
 in practice. Default is true on most operating systems, but false on Linux.
 
+Packets read through mmap point directly into the mapped file; FromDump never
+copies their data. A mapped region stays mapped until all packets that
+point into it are freed. These packets are always shared, so an element that
+modifies packet data (via uniqueify()) gets a private copy. Read-only
+pipelines, such as counters, AggregateIPFlows, and ToIPSummaryDump, never
+copy trace bytes.
+
+=item INTERFACE_ANNO
+
+Annotation name. For pcapng files, FromDump stores the low 8 bits of each
+packet's interface number in this one-byte annotation. Default is
+PAINT.
+
 =back
 
 You can supply at most one of START and START_AFTER, and at most one of END,
@@ -148,7 +167,13 @@ Value is a Boolean.
 
 =h encap read-only
 
-Returns the file's encapsulation type.
+Returns the file's encapsulation type. For pcapng files, this is the
+encapsulation type of the interface of the most recently read packet.
+
+=h interfaces read-only
+
+Returns the number of interfaces described in the current pcapng section,
+or 0 for classic libpcap files.
 
 =h filename read-only
 
@@ -227,12 +252,24 @@ class FromDump : public Element { public:
     bool _first_time_relative : 1;
     bool _last_time_relative : 1;
     bool _last_time_interval : 1;
+    bool _pcapng : 1;
     bool _active;
     unsigned _extra_pkthdr_crap;
     unsigned _sampling_prob;
     int _minor_version;
     int _linktype;
 
+    struct Interface {
+	int linktype;
+	uint32_t snaplen;
+	uint64_t ts_units;	// timestamp units per second
+	int ts_shift;		// log2(ts_units), or -1 if not a power of 2
+	int64_t ts_offset;
+    };
+    Vector<Interface> _interfaces;
+    uint32_t _packet_interface;
+    int _interface_anno;
+
     Timestamp _first_time;
     Timestamp _last_time;
     HandlerCall *_end_h;
@@ -252,6 +289,9 @@ class FromDump : public Element { public:
     off_t _packet_filepos;
 
     bool read_packet(ErrorHandler *);
+    int read_pcapng_block(ErrorHandler *, Timestamp &ts, int &len,
+			  int &caplen, int &skiplen, bool interface_only);
+    Timestamp pcapng_timestamp(const Interface &, uint64_t) const;
 
     void prepare_times(const Timestamp &);
     bool check_timing(Packet *p);
@@ -23,6 +23,7 @@
 #include "todump.hh"
 #include <click/args.hh>
 #include <click/router.hh>
+#include <click/straccum.hh>
 #if CLICK_NS
 # include <click/master.hh>
 #endif
@@ -31,11 +32,16 @@
 #include <click/packet_anno.hh>
 #include "fakepcap.hh"
 #include <click/userutils.hh>
+#include <stdlib.h>
 CLICK_DECLS
 
 ToDump::ToDump()
-    : _fp(0), _count(0), _task(this), _use_encap_from(0)
+    : _fp(0), _count(0), _drops(0), _file_seq(0), _task(this),
+      _use_encap_from(0), _buffers(0), _cur(0)
 {
+#if HAVE_MULTITHREAD
+    _writer_running = false;
+#endif
 }
 
 ToDump::~ToDump()
@@ -50,6 +56,15 @@ ToDump::configure(Vector<String> &conf, ErrorHandler *errh)
     _snaplen = 2000;
     _extra_length = true;
     _unbuffered = false;
+    _async = false;
+    _buffer_size = 4 << 20;
+    _nbuffers = 8;
+    _flush_interval = Timestamp(1);
+    _rotate_size = 0;
+    _rotate_interval = Timestamp();
+    _ninterfaces = 1;
+    _interface_anno = -1;
+    String format = "pcap";
 #if CLICK_NS
     bool per_node = false;
 #endif
@@ -61,6 +76,16 @@ ToDump::configure(Vector<String> &conf, ErrorHandler *errh)
 	.read("USE_ENCAP_FROM", AnyArg(), use_encap_from)
 	.read("EXTRA_LENGTH", _extra_length)
 	.read("UNBUFFERED", _unbuffered)
+	.read("ASYNC", _async)
+	.read("BUFFER_SIZE", _buffer_size)
+	.read("BUFFERS", _nbuffers)
+	.read("FLUSH_INTERVAL", _flush_interval)
+	.read("ROTATE_SIZE", _rotate_size)
+	.read("ROTATE_INTERVAL", _rotate_interval)
+	.read("FORMAT", WordArg(), format)
+	.read("INTERFACES", _ninterfaces)
+	.read("INTERFACE_ANNO", AnnoArg(1), _interface_anno)
+	.read("COMMENT", _comment)
 #if CLICK_NS
 	.read("PER_NODE", per_node)
 #endif
@@ -70,6 +95,30 @@ ToDump::configure(Vector<String> &conf, ErrorHandler *errh)
     if (_snaplen == 0)
 	_snaplen = 0xFFFFFFFFU;
 
+    if (_async) {
+#if HAVE_MULTITHREAD
+	if (_nbuffers < 2)
+	    return errh->error("'BUFFERS' must be at least 2");
+	if (_buffer_size < 65536)
+	    return errh->error("'BUFFER_SIZE' must be at least 65536");
+	_buffer_size &= ~4095U;
+#else
+	return errh->error("'ASYNC' requires multithreaded Click");
+#endif
+    }
+    format = format.lower();
+    if (format == "pcap")
+	_pcapng = false;
+    else if (format == "pcapng")
+	_pcapng = true;
+    else
+	return errh->error("bad 'FORMAT' (expected 'pcap' or 'pcapng')");
+    if (_ninterfaces < 1 || _ninterfaces > 256)
+	return errh->error("'INTERFACES' must be between 1 and 256");
+
+    if ((_rotate_size || _rotate_interval) && _filename == "-")
+	return errh->error("cannot rotate standard output");
+
     if (use_encap_from && encap_type)
 	return errh->error("specify at most one of 'ENCAP' and 'USE_ENCAP_FROM'");
     else if (use_encap_from) {
@@ -105,7 +154,10 @@ ToDump::hotswap_element() const
     if (Element *e = Element::hotswap_element())
 	if (ToDump *td = (ToDump *)e->cast("ToDump"))
 	    if (td->_filename == _filename
-		&& td->_linktype == _linktype)
+		&& td->_linktype == _linktype
+		&& td->_pcapng == _pcapng
+		&& !td->_async && !_async
+		&& !td->_file_seq)
 		return td;
     return 0;
 }
@@ -144,36 +196,42 @@ ToDump::initialize(ErrorHandler *errh)
 
 	// prepare files
 	assert(!_fp);
-	if (_filename != "-") {
-	    if (compressed_filename(_filename) > 0)
-		_fp = open_compress_pipe(_filename, errh);
-	    else
-		_fp = fopen(_filename.c_str(), "wb");
-	    if (!_fp)
-		return errh->error("%s: %s", _filename.c_str(), strerror(errno));
-	} else {
-	    _fp = stdout;
+	if (!(_fp = open_file(_filename, errh)))
+	    return -1;
+	if (_filename == "-")
 	    _filename = "<stdout>";
-	}
-
-	if (_unbuffered)
-	    setvbuf(_fp, (char *) 0, _IONBF, 0);
-
-	struct fake_pcap_file_header h;
-
-	h.magic = FAKE_PCAP_MAGIC;
-	h.version_major = FAKE_PCAP_VERSION_MAJOR;
-	h.version_minor = FAKE_PCAP_VERSION_MINOR;
-
-	h.thiszone = 0;		// timestamps are in GMT
-	h.sigfigs = 0;		// XXX accuracy of timestamps?
-	h.snaplen = _snaplen;
-	h.linktype = _linktype;
+	_cur_filename = _filename;
+    }
 
-	size_t wrote_header = fwrite(&h, sizeof(h), 1, _fp);
-	if (wrote_header != 1)
-	    return errh->error("%s: unable to write file header", _filename.c_str());
+#if HAVE_MULTITHREAD
+    // prepare buffers and writer thread
+    if (_async) {
+	_buffers = new Buffer[_nbuffers];
+	for (int i = 0; i < _nbuffers; i++) {
+	    void *data;
+	    if (posix_memalign(&data, 4096, _buffer_size) != 0) {
+		while (--i >= 0)
+		    free(_buffers[i].data);
+		delete[] _buffers;
+		_buffers = 0;
+		return errh->error("out of memory");
+	    }
+	    _buffers[i].data = (unsigned char *) data;
+	    _buffers[i].length = 0;
+	    _buffers[i].next = (i + 1 < _nbuffers ? &_buffers[i + 1] : 0);
+	}
+	_cur = 0;
+	_free = &_buffers[0];
+	_full_head = 0;
+	_full_tail = &_full_head;
+	_writer_stop = false;
+	pthread_mutex_init(&_lock, 0);
+	pthread_cond_init(&_cond, 0);
+	if (int err = pthread_create(&_writer, 0, writer_thread, this))
+	    return errh->error("cannot start writer thread: %s", strerror(err));
+	_writer_running = true;
     }
+#endif
 
     if (input_is_pull(0) && noutputs() == 0) {
 	ScheduleInfo::join_scheduler(this, &_task, errh);
@@ -189,46 +247,355 @@ ToDump::take_state(Element *e, ErrorHandler *)
     ToDump *td = static_cast<ToDump *>(e); // result of hotswap_element()
     _fp = td->_fp;
     td->_fp = 0;
+    _cur_filename = td->_cur_filename;
+    _file_bytes = td->_file_bytes;
+    _file_opened = td->_file_opened;
 }
 
 void
 ToDump::cleanup(CleanupStage)
 {
+#if HAVE_MULTITHREAD
+    if (_writer_running) {
+	// write out the partial buffer, then wait for the writer to drain
+	pthread_mutex_lock(&_lock);
+	if (_cur && _cur->length) {
+	    *_full_tail = _cur;
+	    _full_tail = &_cur->next;
+	    _cur->next = 0;
+	}
+	_cur = 0;
+	_writer_stop = true;
+	pthread_cond_signal(&_cond);
+	pthread_mutex_unlock(&_lock);
+	pthread_join(_writer, 0);
+	pthread_cond_destroy(&_cond);
+	pthread_mutex_destroy(&_lock);
+	_writer_running = false;
+    }
+#endif
+    if (_buffers) {
+	for (int i = 0; i < _nbuffers; i++)
+	    free(_buffers[i].data);
+	delete[] _buffers;
+	_buffers = 0;
+    }
     if (_fp && _fp != stdout)
 	fclose(_fp);
     _fp = 0;
 }
 
+String
+ToDump::file_header() const
+{
+    StringAccum sa;
+    if (!_pcapng) {
+	fake_pcap_file_header h;
+	h.magic = FAKE_PCAP_MAGIC;
+	h.version_major = FAKE_PCAP_VERSION_MAJOR;
+	h.version_minor = FAKE_PCAP_VERSION_MINOR;
+	h.thiszone = 0;		// timestamps are in GMT
+	h.sigfigs = 0;		// XXX accuracy of timestamps?
+	h.snaplen = _snaplen;
+	h.linktype = _linktype;
+	sa.append(reinterpret_cast<const char *>(&h), sizeof(h));
+	return sa.take_string();
+    }
+
+    // pcapng section header, with optional comment
+    uint32_t comment_space = (_comment ? ((_comment.length() + 3) & ~3) + 8 : 0);
+    fake_pcapng_shb shb;
+    shb.hdr.type = FAKE_PCAPNG_SHB_TYPE;
+    shb.hdr.length = sizeof(shb) + comment_space + 4;
+    shb.byte_order_magic = FAKE_PCAPNG_BYTE_ORDER_MAGIC;
+    shb.version_major = FAKE_PCAPNG_VERSION_MAJOR;
+    shb.version_minor = FAKE_PCAPNG_VERSION_MINOR;
+    shb.section_length[0] = shb.section_length[1] = 0xFFFFFFFFU;
+    sa.append(reinterpret_cast<const char *>(&shb), sizeof(shb));
+    if (_comment) {
+	fake_pcapng_option opt;
+	opt.code = FAKE_PCAPNG_OPT_COMMENT;
+	opt.length = _comment.length();
+	sa.append(reinterpret_cast<const char *>(&opt), sizeof(opt));
+	sa << _comment;
+	sa.append_fill(0, (4 - (_comment.length() & 3)) & 3);
+	sa.append_fill(0, sizeof(opt));	// opt_endofopt
+    }
+    sa.append(reinterpret_cast<const char *>(&shb.hdr.length), 4);
+
+    // one interface description per interface, all with nanosecond
+    // timestamps
+    for (int i = 0; i < _ninterfaces; i++) {
+	fake_pcapng_idb idb;
+	idb.hdr.type = FAKE_PCAPNG_IDB_TYPE;
+	idb.hdr.length = sizeof(idb) + 12 + 4;
+	idb.linktype = _linktype;
+	idb.reserved = 0;
+	idb.snaplen = (_snaplen == 0xFFFFFFFFU ? 0 : _snaplen);
+	sa.append(reinterpret_cast<const char *>(&idb), sizeof(idb));
+	fake_pcapng_option opt;
+	opt.code = FAKE_PCAPNG_OPT_IF_TSRESOL;
+	opt.length = 1;
+	sa.append(reinterpret_cast<const char *>(&opt), sizeof(opt));
+	sa << (char) 9;
+	sa.append_fill(0, 3 + sizeof(opt));	// padding, opt_endofopt
+	sa.append(reinterpret_cast<const char *>(&idb.hdr.length), 4);
+    }
+    return sa.take_string();
+}
+
+FILE *
+ToDump::open_file(const String &filename, ErrorHandler *errh)
+{
+    FILE *fp;
+    if (filename == "-")
+	fp = stdout;
+    else if (compressed_filename(filename) > 0)
+	fp = open_compress_pipe(filename, errh);
+    else
+	fp = fopen(filename.c_str(), "wb");
+    if (!fp) {
+	errh->error("%s: %s", filename.c_str(), strerror(errno));
+	return 0;
+    }
+
+    if (_unbuffered)
+	setvbuf(fp, (char *) 0, _IONBF, 0);
+
+    String h = file_header();
+    if (fwrite(h.data(), 1, h.length(), fp) != (size_t) h.length()) {
+	errh->error("%s: unable to write file header", filename.c_str());
+	if (fp != stdout)
+	    fclose(fp);
+	return 0;
+    }
+
+    _file_header_length = h.length();
+    _file_bytes = h.length();
+    _file_opened = Timestamp::now();
+    return fp;
+}
+
+bool
+ToDump::need_rotate(uint32_t len) const
+{
+    if (_rotate_size && _file_bytes > _file_header_length
+	&& _file_bytes + len > _rotate_size)
+	return true;
+    if (_rotate_interval && Timestamp::now() >= _file_opened + _rotate_interval)
+	return true;
+    return false;
+}
+
+int
+ToDump::rotate_file(ErrorHandler *errh)
+{
+    String filename = _filename + "." + String(_file_seq + 1);
+    FILE *fp = open_file(filename, errh);
+    if (!fp)
+	return -1;
+    if (_fp != stdout)
+	fclose(_fp);
+    _fp = fp;
+    _file_seq++;
+#if HAVE_MULTITHREAD
+    if (_writer_running) {
+	pthread_mutex_lock(&_lock);
+	_cur_filename = filename;
+	pthread_mutex_unlock(&_lock);
+    } else
+#endif
+	_cur_filename = filename;
+    return 0;
+}
+
+#if HAVE_MULTITHREAD
+void *
+ToDump::writer_thread(void *arg)
+{
+    static_cast<ToDump *>(arg)->writer_loop();
+    return 0;
+}
+
 void
-ToDump::write_packet(Packet *p)
+ToDump::writer_loop()
+{
+    pthread_mutex_lock(&_lock);
+    while (1) {
+	while (!_full_head && !_writer_stop)
+	    pthread_cond_wait(&_cond, &_lock);
+	Buffer *b = _full_head;
+	if (!b)
+	    break;
+	if (!(_full_head = b->next))
+	    _full_tail = &_full_head;
+	pthread_mutex_unlock(&_lock);
+
+	if (_active) {
+	    if ((_rotate_size || _rotate_interval) && need_rotate(b->length)
+		&& rotate_file(ErrorHandler::default_handler()) < 0)
+		_active = false;
+	    else if (fwrite(b->data, 1, b->length, _fp) != b->length) {
+		_active = false;
+		click_chatter("ToDump(%s): %s", _filename.c_str(), strerror(errno));
+	    } else
+		_file_bytes += b->length;
+	}
+	b->length = 0;
+
+	pthread_mutex_lock(&_lock);
+	b->next = _free;
+	_free = b;
+    }
+    pthread_mutex_unlock(&_lock);
+    fflush(_fp);
+}
+
+void
+ToDump::hand_off(Buffer *b)
 {
-    struct fake_pcap_pkthdr ph;
+    // Queue @a b for the writer, if any, and take a free buffer as _cur.
+    pthread_mutex_lock(&_lock);
+    if (b) {
+	b->next = 0;
+	*_full_tail = b;
+	_full_tail = &b->next;
+	pthread_cond_signal(&_cond);
+    }
+    if ((_cur = _free))
+	_free = _cur->next;
+    pthread_mutex_unlock(&_lock);
+}
+#endif
+
+struct ToDump::Record {
+    union {
+	fake_pcap_pkthdr pcap;
+	fake_pcapng_epb epb;
+    } h;
+    uint32_t hlen;
+    uint32_t caplen;
+    uint32_t trailer[2];
+    uint32_t tlen;
+
+    uint32_t length() const {
+	return hlen + caplen + tlen;
+    }
+    const uint8_t *trailer_data() const {
+	return reinterpret_cast<const uint8_t *>(trailer) + 8 - tlen;
+    }
+};
 
-    const Timestamp& ts = p->timestamp_anno();
-    if (!ts) {
-	Timestamp now = Timestamp::now();
-	ph.ts.tv.tv_sec = now.sec();
-	ph.ts.tv.tv_usec = now.usec();
+void
+ToDump::prepare_record(Packet *p, Record &r) const
+{
+    Timestamp ts = p->timestamp_anno();
+    if (!ts)
+	ts = Timestamp::now();
+
+    r.caplen = p->length();
+    uint32_t len = r.caplen + (_extra_length ? EXTRA_LENGTH_ANNO(p) : 0);
+    if (_snaplen && r.caplen > _snaplen)
+	r.caplen = _snaplen;
+
+    if (!_pcapng) {
+	r.h.pcap.ts.tv.tv_sec = ts.sec();
+	r.h.pcap.ts.tv.tv_usec = ts.usec();
+	r.h.pcap.caplen = r.caplen;
+	r.h.pcap.len = len;
+	r.hlen = sizeof(r.h.pcap);
+	r.tlen = 0;
     } else {
-	ph.ts.tv.tv_sec = ts.sec();
-	ph.ts.tv.tv_usec = ts.usec();
+	uint32_t ifid = 0;
+	if (_interface_anno >= 0) {
+	    ifid = p->anno_u8(_interface_anno);
+	    if (ifid >= (uint32_t) _ninterfaces)
+		ifid = 0;
+	}
+	uint64_t t = (uint64_t) ts.sec() * 1000000000 + ts.nsec();
+	r.tlen = ((4 - (r.caplen & 3)) & 3) + 4;
+	r.h.epb.hdr.type = FAKE_PCAPNG_EPB_TYPE;
+	r.h.epb.hdr.length = sizeof(r.h.epb) + r.caplen + r.tlen;
+	r.h.epb.interface_id = ifid;
+	r.h.epb.ts_high = t >> 32;
+	r.h.epb.ts_low = t;
+	r.h.epb.caplen = r.caplen;
+	r.h.epb.len = len;
+	r.hlen = sizeof(r.h.epb);
+	r.trailer[0] = 0;
+	r.trailer[1] = r.h.epb.hdr.length;
+    }
+}
+
+void
+ToDump::buffer_packet(Packet *p)
+{
+#if HAVE_MULTITHREAD
+    Record r;
+    prepare_record(p, r);
+
+    uint32_t len = r.length();
+    if (len > _buffer_size) {
+	_drops++;
+	return;
+    }
+
+    Timestamp now = Timestamp::recent();
+    if (_cur && _cur->length
+	&& (_cur->length + len > _buffer_size
+	    || now >= _cur->first + _flush_interval))
+	hand_off(_cur);
+    else if (!_cur)
+	hand_off(0);
+    if (!_cur) {
+	// never block the forwarding path on the disk
+	_drops++;
+	return;
+    }
+
+    if (!_cur->length)
+	_cur->first = now;
+    unsigned char *x = _cur->data + _cur->length;
+    memcpy(x, &r.h, r.hlen);
+    memcpy(x + r.hlen, p->data(), r.caplen);
+    memcpy(x + r.hlen + r.caplen, r.trailer_data(), r.tlen);
+    _cur->length += len;
+    _count++;
+#else
+    (void) p;
+#endif
+}
+
+void
+ToDump::write_packet(Packet *p)
+{
+    if (_async) {
+	buffer_packet(p);
+	return;
     }
 
-    unsigned to_write = p->length();
-    ph.len = to_write + (_extra_length ? EXTRA_LENGTH_ANNO(p) : 0);
-    if (_snaplen && to_write > _snaplen)
-	to_write = _snaplen;
-    ph.caplen = to_write;
+    Record r;
+    prepare_record(p, r);
+
+    if ((_rotate_size || _rotate_interval)
+	&& need_rotate(r.length())
+	&& rotate_file(ErrorHandler::default_handler()) < 0) {
+	_active = false;
+	return;
+    }
 
     // XXX writing to pipe?
-    if (fwrite(&ph, sizeof(ph), 1, _fp) == 0
-	|| fwrite(p->data(), 1, to_write, _fp) == 0) {
+    if (fwrite(&r.h, r.hlen, 1, _fp) == 0
+	|| fwrite(p->data(), 1, r.caplen, _fp) == 0
+	|| (r.tlen && fwrite(r.trailer_data(), r.tlen, 1, _fp) == 0)) {
 	if (errno != EAGAIN) {
 	    _active = false;
 	    click_chatter("ToDump(%s): %s", _filename.c_str(), strerror(errno));
 	}
-    } else
+    } else {
+	_file_bytes += r.length();
 	_count++;
+    }
 }
 
 void
@@ -263,7 +630,8 @@ ToDump::run_task(Task *)
     return p != 0;
 }
 
-enum { H_FILENAME = 0, H_COUNT = 1, H_RESET_COUNTS = 2 };
+enum { H_FILENAME = 0, H_COUNT = 1, H_RESET_COUNTS = 2, H_DROPS = 3,
+       H_CURRENT_FILENAME = 4 };
 
 String
 ToDump::read_handler(Element *e, void *thunk)
@@ -274,6 +642,19 @@ ToDump::read_handler(Element *e, void *thunk)
 	return td->_filename;
     case H_COUNT:
 	return String(td->_count);
+    case H_DROPS:
+	return String(td->_drops);
+    case H_CURRENT_FILENAME: {
+#if HAVE_MULTITHREAD
+	if (td->_writer_running) {
+	    pthread_mutex_lock(&td->_lock);
+	    String s = td->_cur_filename;
+	    pthread_mutex_unlock(&td->_lock);
+	    return s;
+	}
+#endif
+	return td->_cur_filename;
+    }
     default:
 	return "<error>";
     }
@@ -284,6 +665,7 @@ ToDump::write_handler(const String &, Element *e, void *, ErrorHandler *)
 {
     ToDump *td = static_cast<ToDump *>(e);
     td->_count = 0;
+    td->_drops = 0;
     return 0;
 }
 
@@ -292,6 +674,8 @@ ToDump::add_handlers()
 {
     add_read_handler("filename", read_handler, H_FILENAME);
     add_read_handler("count", read_handler, H_COUNT);
+    add_read_handler("drops", read_handler, H_DROPS);
+    add_read_handler("current_filename", read_handler, H_CURRENT_FILENAME);
     add_write_handler("reset_counts", write_handler, H_RESET_COUNTS, Handler::BUTTON);
     if (input_is_pull(0) && noutputs() == 0)
 	add_task_handlers(&_task);
@@ -6,12 +6,17 @@
 #include <click/task.hh>
 #include <click/notifier.hh>
 #include <stdio.h>
+#if HAVE_MULTITHREAD
+# include <pthread.h>
+#endif
 CLICK_DECLS
 
 /*
 =c
 
-ToDump(FILENAME [, I<keywords> SNAPLEN, ENCAP, USE_ENCAP_FROM, EXTRA_LENGTH])
+ToDump(FILENAME [, I<keywords> SNAPLEN, ENCAP, USE_ENCAP_FROM, EXTRA_LENGTH,
+ASYNC, BUFFER_SIZE, BUFFERS, FLUSH_INTERVAL, ROTATE_SIZE, ROTATE_INTERVAL,
+FORMAT, INTERFACES, INTERFACE_ANNO, COMMENT])
 
 =s traces
 
@@ -66,6 +71,60 @@ Boolean. Set to true if you want ToDump to use unbuffered IO when saving data to
 a file.  This is unlikely to work with compressed dump formats. Default is
 false.
 
+=item FORMAT
+
+Either C<pcap>, for classic libpcap files, or C<pcapng>. pcapng files record
+nanosecond timestamps. Default is C<pcap>.
+
+=item INTERFACES
+
+Integer. For pcapng files, the number of interfaces to describe in each
+file; all interfaces have the same ENCAP and SNAPLEN. Default is 1.
+
+=item INTERFACE_ANNO
+
+Annotation name. For pcapng files, each packet is recorded on the interface
+named by this one-byte annotation. Values of INTERFACES or more are recorded
+on interface 0. By default, every packet is recorded on interface 0.
+
+=item COMMENT
+
+String. For pcapng files, a comment to record in each section header.
+
+=item ASYNC
+
+Boolean. Set to true if you want ToDump to hand file writes to a dedicated
+writer thread. Packet records are copied into large page-aligned buffers on
+the forwarding thread; full buffers are written by the writer thread. If every
+buffer is waiting to be written, ToDump drops the packet from the dump (it is
+still emitted on the output) and increments the "drops" count rather than
+blocking. Requires multithreaded user-level Click. Default is false.
+
+=item BUFFER_SIZE
+
+Integer. Size in bytes of each ASYNC buffer. Default is 4194304 (4MB).
+
+=item BUFFERS
+
+Integer. Number of ASYNC buffers. Default is 8.
+
+=item FLUSH_INTERVAL
+
+Timestamp. In ASYNC mode, a partially filled buffer older than this is handed
+to the writer thread when the next packet arrives. Default is 1 second.
+
+=item ROTATE_SIZE
+
+Integer. If nonzero, start a new file once the current file holds at least
+this many bytes. Successive files are named FILENAME, FILENAME.1, FILENAME.2,
+and so on; each starts with its own file header. In ASYNC mode files are
+rotated at buffer boundaries. Default is 0 (no rotation).
+
+=item ROTATE_INTERVAL
+
+Timestamp. If nonzero, start a new file once the current file has been open
+this long. Default is 0 (no rotation).
+
 =back
 
 This element is only available at user level.
@@ -78,14 +137,23 @@ ToDump stores packets' true length annotations when available.
 
 Returns the number of packets emitted so far.
 
+=h drops read-only
+
+Returns the number of packets not written because no ASYNC buffer was free.
+
 =h reset_counts write-only
 
-Resets "count" to 0.
+Resets "count" and "drops" to 0.
 
 =h filename read-only
 
 Returns the filename.
 
+=h current_filename read-only
+
+Returns the name of the file currently being written. Differs from
+"filename" only when rotation is enabled.
+
 =a
 
 FromDump, FromDevice.u, ToDevice.u, tcpdump(1) */
@@ -115,12 +183,18 @@ class ToDump : public Element { public:
   private:
 
     String _filename;
+    String _cur_filename;
     FILE *_fp;
     unsigned _snaplen;
     int _linktype;
-    bool _active;
+    volatile bool _active;
     bool _extra_length;
     bool _unbuffered;
+    bool _async;
+    bool _pcapng;
+    int _ninterfaces;
+    int _interface_anno;
+    String _comment;
 
 #if HAVE_INT64_TYPES
     typedef uint64_t counter_t;
@@ -128,14 +202,58 @@ class ToDump : public Element { public:
     typedef uint32_t counter_t;
 #endif
     counter_t _count;
+    counter_t _drops;
+
+    // file rotation
+    counter_t _rotate_size;
+    Timestamp _rotate_interval;
+    counter_t _file_bytes;
+    counter_t _file_header_length;
+    Timestamp _file_opened;
+    int _file_seq;
 
     Task _task;
     NotifierSignal _signal;
     Element **_use_encap_from;
 
+    // asynchronous writer
+    struct Buffer {
+	unsigned char *data;
+	uint32_t length;
+	Timestamp first;
+	Buffer *next;
+    };
+    uint32_t _buffer_size;
+    int _nbuffers;
+    Timestamp _flush_interval;
+    Buffer *_buffers;
+    Buffer *_cur;
+#if HAVE_MULTITHREAD
+    Buffer *_free;
+    Buffer *_full_head;
+    Buffer **_full_tail;
+    bool _writer_stop;
+    bool _writer_running;
+    pthread_t _writer;
+    pthread_mutex_t _lock;
+    pthread_cond_t _cond;
+
+    static void *writer_thread(void *);
+    void writer_loop();
+    void hand_off(Buffer *);
+#endif
+
     static String read_handler(Element *, void *);
     static int write_handler(const String &, Element *, void *, ErrorHandler *);
+    struct Record;
+
+    String file_header() const;
+    FILE *open_file(const String &, ErrorHandler *);
+    int rotate_file(ErrorHandler *);
+    bool need_rotate(uint32_t len) const;
     void write_packet(Packet *);
+    void prepare_record(Packet *, Record &) const;
+    void buffer_packet(Packet *);
 
 };
 
@@ -42,6 +42,9 @@ class Element { public:
     virtual PBatch *bpull(int port) CLICK_WARN_UNUSED_RESULT;
     virtual PBatch *batched_simple_action(PBatch *pb);    
 
+    enum { PULL_BURST = 32 };
+    virtual int pull_burst(int port, Packet **p, int max) CLICK_WARN_UNUSED_RESULT;
+
     virtual bool run_task(Task *task);	// return true iff did useful work
     virtual void run_timer(Timer *timer);
 #if CLICK_USERLEVEL
@@ -215,6 +218,31 @@ class Element { public:
     virtual int llrpc(unsigned command, void* arg);
     int local_llrpc(unsigned command, void* arg);
 
+    /** @brief Per-thread push and pull profile for an element.
+     *
+     * Collected while the router's profile_sample is nonzero.  One transfer
+     * into the element in profile_sample is sampled: it adds profile_sample
+     * to calls, so calls, batches, and packets are estimates.  Sampled
+     * transfers are timed, as are the transfers they make while they run,
+     * so own_cycles can exclude time spent in other elements.  Each thread
+     * updates only its own counters, so no atomic operations are needed. */
+    struct ProfileCounters {
+	uint32_t countdown;		// Calls before the next sampled call.
+	uint64_t calls;			// Push and pull calls into this element.
+	uint64_t batches;		// Calls that moved a packet batch.
+	uint64_t packets;		// Packets moved by those calls.
+	uint64_t timed;			// Timed calls.
+	click_cycles_t cycles;		// Cycles in timed calls.
+	click_cycles_t own_cycles;	// Cycles in self in timed calls.
+	uint64_t misses;		// Cache misses in self in timed calls.
+    } CLICK_ALIGNED(CLICK_CACHE_LINE_SIZE);
+
+    /** @brief Return this element's profile counters, one per thread, or
+     * null if the router has never been profiled. */
+    const ProfileCounters *profile_counters() const {
+	return _profile_counters;
+    }
+
     class Port { public:
 
 	inline bool active() const;
@@ -223,6 +251,7 @@ class Element { public:
 
 	inline void push(Packet* p) const;
 	inline Packet* pull() const;
+	inline int pull_burst(Packet **p, int max) const;
 	inline void bpush(PBatch *pb) const;
 	inline PBatch* bpull() const;
 
@@ -253,6 +282,12 @@ class Element { public:
 	inline Port();
 	inline void assign(bool isoutput, Element *owner, Element *e, int port);
 
+	void profiled_push(Packet *p) const;
+	Packet *profiled_pull() const;
+	int profiled_pull_burst(Packet **p, int max) const;
+	void profiled_bpush(PBatch *pb) const;
+	PBatch *profiled_bpull() const;
+
 	friend class Element;
 
     };
@@ -275,6 +310,9 @@ class Element { public:
     Router* _router;
     int _eindex;
 
+    ProfileCounters *_profile;		// Non-null while being profiled.
+    ProfileCounters *_profile_counters;
+
 #if CLICK_STATS >= 2
     // STATISTICS
     unsigned _xfer_calls;	// Push and pull calls into this element.
@@ -312,6 +350,8 @@ class Element { public:
     void add_default_handlers(bool writable_config);
     inline void add_data_handlers(const char *name, int flags, HandlerCallback callback, void *data);
 
+    static String read_profile_handler(Element *, void *);
+
     friend class Router;
 #if CLICK_STATS >= 2
     friend class Task;
@@ -605,7 +645,8 @@ Element::Port::port() const
  * downstream.  To push a copy and keep a copy, see Packet::clone().
  *
  * output(i).push(p) basically behaves like the following code, although it
- * maintains additional statistics depending on how CLICK_STATS is defined:
+ * maintains additional statistics depending on how CLICK_STATS is defined
+ * and whether the router is being profiled:
  *
  * @code
  * output(i).element()->push(output(i).port(), p);
@@ -633,6 +674,10 @@ Element::Port::push(Packet* p) const
     _e->_xfer_own_cycles += own_delta;
     _owner->_child_cycles += all_delta;
 #else
+    if (unlikely(_e->_profile)) {
+	profiled_push(p);
+	return;
+    }
 # if HAVE_BOUND_PORT_TRANSFER
     _bound.push(_e, _port, p);
 # else
@@ -665,6 +710,10 @@ Element::Port::bpush(PBatch* pb) const
     _e->_xfer_own_cycles += own_delta;
     _owner->_child_cycles += all_delta;
 #else
+    if (unlikely(_e->_profile)) {
+	profiled_bpush(pb);
+	return;
+    }
 # if HAVE_BOUND_PORT_TRANSFER
 #error "Batching on bound port not supported. @Element::Port::bpush()"   
 # else
@@ -683,7 +732,8 @@ Element::Port::bpush(PBatch* pb) const
  * code like @link Element::input input(i) @endlink .pull().
  *
  * input(i).pull() basically behaves like the following code, although it
- * maintains additional statistics depending on how CLICK_STATS is defined:
+ * maintains additional statistics depending on how CLICK_STATS is defined
+ * and whether the router is being profiled:
  *
  * @code
  * input(i).element()->pull(input(i).port())
@@ -709,10 +759,14 @@ Element::Port::pull() const
     _e->_xfer_own_cycles += own_delta;
     _owner->_child_cycles += all_delta;
 #else
+    Packet *p;
+    if (unlikely(_e->_profile))
+	p = profiled_pull();
+    else
 # if HAVE_BOUND_PORT_TRANSFER
-    Packet *p = _bound.pull(_e, _port);
+	p = _bound.pull(_e, _port);
 # else
-    Packet *p = _e->pull(_port);
+	p = _e->pull(_port);
 # endif
 #endif
 #if CLICK_STATS >= 1
@@ -722,6 +776,43 @@ Element::Port::pull() const
     return p;
 }
 
+/** @brief Pull up to @a max packets over this port into @a p.
+ * @return the number of packets pulled
+ *
+ * Like pull(), but asks the previous element's @link Element::pull_burst()
+ * pull_burst() @endlink function for up to @a max packets at once.  Fewer
+ * than @a max packets, possibly none, may be returned even if more are
+ * available upstream.  Callers usually pass at most Element::PULL_BURST.
+ *
+ * This port must be an active() pull input port.
+ */
+inline int
+Element::Port::pull_burst(Packet **p, int max) const
+{
+    assert(_e);
+#if CLICK_STATS >= 2
+    click_cycles_t start_cycles = click_get_cycles(),
+	old_child_cycles = _e->_child_cycles;
+    int n = _e->pull_burst(_port, p, max);
+    _e->output(_port)._packets += n;
+    click_cycles_t all_delta = click_get_cycles() - start_cycles,
+	own_delta = all_delta - (_e->_child_cycles - old_child_cycles);
+    _e->_xfer_calls += 1;
+    _e->_xfer_own_cycles += own_delta;
+    _owner->_child_cycles += all_delta;
+#else
+    int n;
+    if (unlikely(_e->_profile))
+	n = profiled_pull_burst(p, max);
+    else
+	n = _e->pull_burst(_port, p, max);
+#endif
+#if CLICK_STATS >= 1
+    _packets += n;
+#endif
+    return n;
+}
+
 /** @brief Pull a packet batch over this port and return it.
  */
 inline PBatch*
@@ -744,10 +835,14 @@ Element::Port::bpull() const
     _e->_xfer_own_cycles += own_delta;
     _owner->_child_cycles += all_delta;
 #else
+    PBatch *pb;
+    if (unlikely(_e->_profile))
+	pb = profiled_bpull();
+    else
 # if HAVE_BOUND_PORT_TRANSFER
 #error "Batching on bound port not supported. @Element::Port::bpull()"   
 # else
-    PBatch *pb = _e->bpull(_port);
+	pb = _e->bpull(_port);
 # endif
 #endif
 #if CLICK_STATS >= 1
@@ -27,6 +27,7 @@ class FromFile { public:
     void set_lineno(int lineno)		{ _lineno = lineno; }
 
     off_t file_pos() const		{ return _file_offset + _pos; }
+    off_t file_size() const;
 
     int configure_keywords(Vector<String> &conf, Element *, ErrorHandler *);
     int initialize(ErrorHandler *, bool allow_nonexistent = false);
@@ -79,6 +80,7 @@ class FromFile { public:
 
 #ifdef ALLOW_MMAP
     int read_buffer_mmap(ErrorHandler *);
+    int remap_at_pos();
 #endif
     int read_buffer(ErrorHandler *);
     bool read_packet(ErrorHandler *);
@@ -76,6 +76,9 @@ class Master { public:
     Spinlock _master_lock;
 #endif
     atomic_uint32_t _master_paused;
+#if HAVE_MULTITHREAD
+    atomic_uint32_t _steal_waiting;	// number of threads asking for work
+#endif
     inline void lock_master();
     inline void unlock_master();
 
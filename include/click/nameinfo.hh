@@ -85,6 +85,15 @@ class NameInfo { public:
     static NameDB *getdb(uint32_t type, const Element *context,
 			 size_t value_size, bool create);
 
+    /** @brief Prepare name databases for concurrent queries.
+     * @param context compound element context
+     *
+     * Some databases reorganize themselves during queries.  After this call,
+     * queries of the global databases and of the databases of @a context's
+     * router do not modify them, so threads may query concurrently, until
+     * the next definition. */
+    static void prepare_concurrent_query(const Element *context);
+
     /** @brief Install a name database.
      * @param db name database
      * @param context compound element context
@@ -323,6 +332,12 @@ class NameDB { public:
      * as <code>define(name, &value, 4)</code>. */
     inline bool define_int(const String &name, int32_t value);
 
+    /** @brief Prepare this database for concurrent queries.
+     *
+     * After this call, query() and revquery() must not modify the database
+     * until the next define().  The default implementation does nothing. */
+    virtual void prepare_concurrent_query();
+
 #if CLICK_NAMEDB_CHECK
     /** @cond never */
     virtual void check(ErrorHandler *);
@@ -438,6 +453,8 @@ class DynamicNameDB : public NameDB { public:
      * The @a value_size parameter must equal this database's value size. */
     bool define(const String &name, const void *value, size_t value_size);
 
+    void prepare_concurrent_query();
+
 #if CLICK_NAMEDB_CHECK
     /** @cond never */
     void check(ErrorHandler *);
@@ -348,6 +348,22 @@ public:
 	    producer->annos_offset+producer->anno_len*idx);
     }
 
+    // Puts p at index to, with the slice, annotation and length of
+    // index from.  Elements that drop packets from a batch compact it
+    // with this, so the per-index host data stays with its packet.
+    inline void move_packet(int from, int to, Packet *p) {
+	pptrs[to] = p;
+	if (from == to)
+	    return;
+	if (producer->slices_offset >= 0)
+	    memcpy(slice_hptr(to), slice_hptr(from),
+		   producer->get_slice_stride());
+	if (producer->annos_offset >= 0)
+	    memcpy(anno_hptr(to), anno_hptr(from), producer->anno_len);
+	if (producer->lens_offset >= 0)
+	    *length_hptr(to) = *length_hptr(from);
+    }
+
     inline void* get_priv_data(size_t offset) {
 	if (priv_data)
 	    return g4c_ptr_add(priv_data, offset);
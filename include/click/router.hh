@@ -90,6 +90,18 @@ class Router { public:
     inline void set_thread_sched(ThreadSched* scheduler);
     inline int home_thread_id(const Element *e) const;
 
+    // PROFILING
+    uint32_t profile_sample() const	{ return _profile_sample; }
+    void set_profile_sample(uint32_t sample);
+    bool profile_stack() const		{ return _profile_stack; }
+    void set_profile_stack(bool on);
+    void reset_profile();
+    void profile_report(StringAccum &sa) const;
+
+    // STARTUP TIMING
+    void set_parse_time(const Timestamp &t)	{ _parse_time = t; }
+    void startup_report(StringAccum &sa) const;
+
     /** @cond never */
     // Needs to be public for NameInfo, but not useful outside
     inline NameInfo* name_info() const;
@@ -292,6 +304,12 @@ class Router { public:
     mutable NameInfo* _name_info;
     Vector<int> _flow_code_override_eindex;
     Vector<String> _flow_code_override;
+    uint32_t _profile_sample;
+    bool _profile_stack;
+    Timestamp _parse_time;
+    Timestamp _configure_time;
+    Timestamp _initialize_time;
+    Timestamp _hotswap_time;
 
     Router* _next_router;
 
@@ -325,6 +343,15 @@ class Router { public:
 
     int hard_home_thread_id(const Element *e) const;
 
+    int configure_element(int eindex, ErrorHandler *errh);
+    void configure_concurrently(const int *eindexes, int n, int nthreads,
+				Vector<int> &element_stage, ErrorHandler *errh);
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD
+    static void *configure_thread(void *thunk);
+#endif
+
+    void update_profile(bool restart_countdown);
+
     int element_lerror(ErrorHandler*, Element*, const char*, ...) const;
 
     // private handler methods
@@ -68,6 +68,66 @@ class RouterThread { public:
     void set_cpu_share(unsigned min_share, unsigned max_share);
 #endif
 
+    // Task accounting: when on, each Task run is timed; see
+    // Task::accounted_cycles().
+    bool task_accounting() const	{ return _task_accounting; }
+    void set_task_accounting(bool on)	{ _task_accounting = on; }
+
+#if HAVE_MULTITHREAD
+    bool work_stealing() const		{ return _steal; }
+    click_jiffies_t steal_hysteresis() const { return _steal_hysteresis; }
+    void set_work_stealing(bool steal, click_jiffies_t hysteresis);
+    uint32_t steal_waits() const	{ return _steal_waits; }
+    uint32_t steals_in() const		{ return _steals_in.value(); }
+    uint32_t steals_out() const		{ return _steals_out; }
+#endif
+
+#if CLICK_USERLEVEL
+    // Idle policy: after spin() iterations without work, pause for up to
+    // pause() iterations, then block for at most sleep() per iteration.
+    enum { IDLE_BUSY, IDLE_SPIN, IDLE_PAUSE, IDLE_SLEEP, NIDLE };
+    unsigned idle_spin() const		{ return _idle_spin; }
+    unsigned idle_pause() const		{ return _idle_pause; }
+    const Timestamp &idle_sleep() const	{ return _idle_sleep; }
+    void set_idle_policy(unsigned spin, unsigned pause, const Timestamp &sleep);
+    int idle_state() const		{ return _idle_state; }
+    Timestamp idle_time(int state) const;
+    static const char *idle_state_name(int state);
+#endif
+
+    // Element profiling state; see Element::ProfileCounters and
+    // Router::set_profile_stack().
+    struct ProfileState {
+	int depth;			// timed transfers in progress
+	click_cycles_t child_cycles;	// cycles in timed children
+	click_cycles_t overhead;	// cycles spent timing children
+	uint64_t child_misses;		// cache misses in timed children
+	click_cycles_t floor;		// cost of reading the cycle counter
+
+	// Element call chain: the element whose task or timer is running,
+	// then each element called by push or pull.  Entries past
+	// STACK_DEPTH are counted but not stored.  Only this thread writes
+	// the stack, so a signal handler on this thread may read it.
+	enum { STACK_DEPTH = 32 };
+	bool stack_on;
+	volatile int stack_depth;
+	Element *stack[STACK_DEPTH];
+
+	inline void push_frame(Element *e) {
+	    int d = stack_depth;
+	    if (d < STACK_DEPTH)
+		stack[d] = e;
+	    click_compiler_fence();
+	    stack_depth = d + 1;
+	}
+	inline void pop_frame() {
+	    stack_depth = stack_depth - 1;
+	}
+    };
+    ProfileState &profile_state()	{ return _profile_state; }
+    uint64_t profile_cache_misses();
+    bool profile_cache_misses_available() const;
+
 #if CLICK_LINUXMODULE || CLICK_BSDMODULE
     bool greedy() const			{ return _greedy; }
     void set_greedy(bool g)		{ _greedy = g; }
@@ -143,6 +203,27 @@ class RouterThread { public:
     int _adaptive_restride_iter;
 #endif
 
+#if CLICK_USERLEVEL
+    // IDLE POLICY
+    Timestamp _idle_sleep;		// zero means never back off
+    unsigned _idle_spin;
+    unsigned _idle_pause;
+    unsigned _idle_iters;		// consecutive iterations without work
+    unsigned _idle_load;		// recent fraction of iterations with work
+    int _idle_state;
+    bool _idle_work;
+    Timestamp _idle_state_start;
+    Timestamp _idle_time[NIDLE];
+#endif
+
+    // PROFILING
+    ProfileState _profile_state;
+    bool _task_accounting;
+#if CLICK_USERLEVEL
+    int _perf_fd;			// -2 means not yet opened
+    void *_perf_page;
+#endif
+
     // EXTERNAL STATE GROUP
     Spinlock _task_lock CLICK_ALIGNED(CLICK_CACHE_LINE_SIZE);
     atomic_uint32_t _task_blocker;
@@ -152,6 +233,18 @@ class RouterThread { public:
     Task::Pending *_pending_tail;
     SpinlockIRQ _pending_lock;
 
+#if HAVE_MULTITHREAD
+    // WORK STEALING
+    atomic_uint32_t _steal_waiting;	// 1 iff idle and asking for work
+    atomic_uint32_t _steals_in;
+    bool _steal;
+    bool _steal_work;			// a task did work in the last run_tasks()
+    unsigned _steal_idle_iters;		// iterations since a task did work
+    click_jiffies_t _steal_hysteresis;
+    uint32_t _steal_waits;
+    uint32_t _steals_out;
+#endif
+
     // SHARED STATE GROUP
     Master *_master CLICK_ALIGNED(CLICK_CACHE_LINE_SIZE);
     int _id;
@@ -218,6 +311,15 @@ class RouterThread { public:
     inline void run_tasks(int ntasks);
     inline void process_pending();
     inline void run_os();
+#if CLICK_USERLEVEL
+    inline void run_idle_policy();
+    inline void set_idle_state(int state);
+#endif
+#if HAVE_MULTITHREAD
+    inline void steal_tasks();
+    inline void stop_stealing();
+    void donate_task();
+#endif
 #if HAVE_ADAPTIVE_SCHEDULER
     void client_set_tickets(int client, int tickets);
     inline void client_update_pass(int client, const Timestamp &before);
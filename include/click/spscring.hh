@@ -0,0 +1,244 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_SPSCRING_HH
+#define CLICK_SPSCRING_HH
+#include <click/glue.hh>
+#include <click/machine.hh>
+CLICK_DECLS
+
+/** @file <click/spscring.hh>
+ * @brief A lock-free single-producer, single-consumer ring.
+ */
+
+/** @class SPSCRing
+ * @brief A bounded lock-free FIFO for one producer and one consumer.
+ *
+ * The producer owns the head index and the consumer owns the tail index.
+ * The two indexes live on separate cache lines.  Each side also keeps a
+ * private copy of the other side's index, and refreshes it only when the
+ * ring looks full (producer) or empty (consumer).  In steady state, then, a
+ * transfer writes one shared cache line per burst and reads the other side's
+ * line only occasionally, rather than bouncing both lines on every item.
+ *
+ * Indexes are free-running 32-bit counters, so every slot is usable and the
+ * capacity is a power of two.  T should be a pointer or other small trivially
+ * copyable type, such as Packet * or PBatch *.
+ *
+ * push(), push_burst() may be called only by the producer, and front(),
+ * pop(), pop_burst() only by the consumer.  size() and empty() may be called
+ * by anyone, but are exact only when neither side is active. */
+template <typename T>
+class SPSCRing { public:
+
+    inline SPSCRing();
+    inline ~SPSCRing();
+
+    /** @brief Allocate the ring.
+     * @param capacity minimum capacity, rounded up to a power of two
+     * @return true on success
+     *
+     * Any items in the ring are forgotten.  Not thread safe. */
+    bool initialize(uint32_t capacity);
+
+    uint32_t capacity() const		{ return _mask + 1; }
+    inline uint32_t size() const;
+    inline bool empty() const;
+
+    inline bool push(T x);
+    inline uint32_t push_burst(const T *x, uint32_t n);
+    inline bool producer_full() const;
+
+    inline T *front();
+    inline void pop_front();
+    inline bool pop(T &x);
+    inline uint32_t pop_burst(T *x, uint32_t n);
+
+  private:
+
+    // PRODUCER
+    volatile uint32_t _head CLICK_ALIGNED(CLICK_CACHE_LINE_SIZE);
+    uint32_t _tail_cache;
+
+    // CONSUMER
+    volatile uint32_t _tail CLICK_ALIGNED(CLICK_CACHE_LINE_SIZE);
+    uint32_t _head_cache;
+
+    // SHARED, read-only after initialize()
+    T *_ring CLICK_ALIGNED(CLICK_CACHE_LINE_SIZE);
+    uint32_t _mask;
+
+    static inline void ordering_fence() {
+#if defined(__i386__) || defined(__x86_64__)
+	// x86 does not reorder stores with stores or loads with loads.
+	click_compiler_fence();
+#else
+	click_fence();
+#endif
+    }
+
+    SPSCRing(const SPSCRing<T> &);
+    SPSCRing<T> &operator=(const SPSCRing<T> &);
+
+};
+
+template <typename T>
+inline
+SPSCRing<T>::SPSCRing()
+    : _head(0), _tail_cache(0), _tail(0), _head_cache(0), _ring(0), _mask(0)
+{
+}
+
+template <typename T>
+inline
+SPSCRing<T>::~SPSCRing()
+{
+    delete[] _ring;
+}
+
+template <typename T>
+bool
+SPSCRing<T>::initialize(uint32_t capacity)
+{
+    uint32_t cap = 1;
+    while (cap < capacity && cap < 0x80000000U)
+	cap <<= 1;
+    T *ring = new T[cap];
+    if (!ring)
+	return false;
+    delete[] _ring;
+    _ring = ring;
+    _mask = cap - 1;
+    _head = _tail_cache = _tail = _head_cache = 0;
+    return true;
+}
+
+template <typename T>
+inline uint32_t
+SPSCRing<T>::size() const
+{
+    return _head - _tail;
+}
+
+template <typename T>
+inline bool
+SPSCRing<T>::empty() const
+{
+    return _head == _tail;
+}
+
+/** @brief Append @a x.  Producer only.
+ * @return true if @a x was added, false if the ring was full */
+template <typename T>
+inline bool
+SPSCRing<T>::push(T x)
+{
+    uint32_t h = _head;
+    if (unlikely(h - _tail_cache > _mask)) {
+	_tail_cache = _tail;
+	if (h - _tail_cache > _mask)
+	    return false;
+    }
+    _ring[h & _mask] = x;
+    ordering_fence();
+    _head = h + 1;
+    return true;
+}
+
+/** @brief Append up to @a n items from @a x.  Producer only.
+ * @return the number of items added, which are a prefix of @a x */
+template <typename T>
+inline uint32_t
+SPSCRing<T>::push_burst(const T *x, uint32_t n)
+{
+    uint32_t h = _head;
+    uint32_t room = _mask + 1 - (h - _tail_cache);
+    if (room < n) {
+	_tail_cache = _tail;
+	room = _mask + 1 - (h - _tail_cache);
+	if (room < n)
+	    n = room;
+    }
+    for (uint32_t i = 0; i < n; ++i)
+	_ring[(h + i) & _mask] = x[i];
+    ordering_fence();
+    _head = h + n;
+    return n;
+}
+
+/** @brief Return true if the ring was full when the producer last looked.
+ * Producer only.
+ *
+ * This does not reread the consumer's index, so it may return true after
+ * the consumer has made room. */
+template <typename T>
+inline bool
+SPSCRing<T>::producer_full() const
+{
+    return _head - _tail_cache > _mask;
+}
+
+/** @brief Return a pointer to the oldest item, or null if the ring is empty.
+ * Consumer only.
+ *
+ * The item stays in the ring until pop_front(). */
+template <typename T>
+inline T *
+SPSCRing<T>::front()
+{
+    uint32_t t = _tail;
+    if (_head_cache == t) {
+	_head_cache = _head;
+	if (_head_cache == t)
+	    return 0;
+    }
+    ordering_fence();
+    return &_ring[t & _mask];
+}
+
+/** @brief Remove the oldest item.  Consumer only.
+ * @pre front() returned non-null */
+template <typename T>
+inline void
+SPSCRing<T>::pop_front()
+{
+    ordering_fence();
+    _tail = _tail + 1;
+}
+
+/** @brief Remove the oldest item into @a x.  Consumer only.
+ * @return true if an item was removed, false if the ring was empty */
+template <typename T>
+inline bool
+SPSCRing<T>::pop(T &x)
+{
+    if (T *p = front()) {
+	x = *p;
+	pop_front();
+	return true;
+    } else
+	return false;
+}
+
+/** @brief Remove up to @a n of the oldest items into @a x.  Consumer only.
+ * @return the number of items removed */
+template <typename T>
+inline uint32_t
+SPSCRing<T>::pop_burst(T *x, uint32_t n)
+{
+    uint32_t t = _tail;
+    uint32_t avail = _head_cache - t;
+    if (avail < n) {
+	_head_cache = _head;
+	avail = _head_cache - t;
+	if (avail < n)
+	    n = avail;
+    }
+    ordering_fence();
+    for (uint32_t i = 0; i < n; ++i)
+	x[i] = _ring[(t + i) & _mask];
+    ordering_fence();
+    _tail = t + n;
+    return n;
+}
+
+CLICK_ENDDECLS
+#endif
@@ -26,6 +26,10 @@ class Storage { public:
     index_type prev_i(index_type i) const {
 	return (i!=0 ? i-1 : _capacity);
     }
+    index_type next_i(index_type i, index_type n) const {
+	// n must be at most _capacity
+	return (i < _capacity + 1 - n ? i+n : i+n - _capacity - 1);
+    }
 
     // to be used with care
     void set_capacity(index_type c)	{ _capacity = c; }
@@ -250,6 +250,42 @@ class Task : private TaskLink { public:
      */
     void move_thread(int new_thread_id);
 
+#if HAVE_MULTITHREAD
+    /** @brief Return true iff the Task may be moved by work stealing.
+     *
+     * When work stealing is enabled (see WorkStealingSched), an idle thread
+     * may take migratable tasks from busy threads.  Tasks are initially
+     * migratable iff the router's ThreadSched says so.
+     * @sa set_migratable, steals */
+    inline bool migratable() const {
+	return _migratable;
+    }
+
+    /** @brief Set whether the Task may be moved by work stealing.
+     * @sa migratable */
+    inline void set_migratable(bool migratable) {
+	_migratable = migratable;
+    }
+
+    /** @brief Return the number of times the Task was stolen by an idle
+     * thread. */
+    inline unsigned steals() const {
+	return _steals;
+    }
+#endif
+
+
+    /** @brief Return the cycles this Task has spent running while its
+     * thread had task accounting on.
+     * @sa RouterThread::set_task_accounting(), accounted_runs() */
+    click_cycles_t accounted_cycles() const {
+	return _accounted_cycles;
+    }
+    /** @brief Return the number of times this Task has run while its
+     * thread had task accounting on. */
+    uint32_t accounted_runs() const {
+	return _accounted_runs;
+    }
 
 #if HAVE_STRIDE_SCHED
     inline int tickets() const;
@@ -306,12 +342,18 @@ class Task : private TaskLink { public:
 #if HAVE_MULTITHREAD
     DirectEWMA _cycles;
     unsigned _cycle_runs;
+    bool _migratable;
+    unsigned _steals;
+    click_jiffies_t _move_jiffies;
 #endif
 
     RouterThread *_thread;
 
     Element *_owner;
 
+    click_cycles_t _accounted_cycles;
+    uint32_t _accounted_runs;
+
     union Pending {
 	Task *t;
 	uintptr_t x;
@@ -374,9 +416,9 @@ Task::Task(TaskCallback f, void *user_data)
       _runs(0), _work_done(0),
 #endif
 #if HAVE_MULTITHREAD
-      _cycle_runs(0),
+      _cycle_runs(0), _migratable(false), _steals(0), _move_jiffies(0),
 #endif
-      _thread(0), _owner(0)
+      _thread(0), _owner(0), _accounted_cycles(0), _accounted_runs(0)
 {
     _status.home_thread_id = -1;
     _status.is_scheduled = _status.is_strong_unscheduled = false;
@@ -397,9 +439,9 @@ Task::Task(Element* e)
       _runs(0), _work_done(0),
 #endif
 #if HAVE_MULTITHREAD
-      _cycle_runs(0),
+      _cycle_runs(0), _migratable(false), _steals(0), _move_jiffies(0),
 #endif
-      _thread(0), _owner(0)
+      _thread(0), _owner(0), _accounted_cycles(0), _accounted_runs(0)
 {
     _status.home_thread_id = -1;
     _status.is_scheduled = _status.is_strong_unscheduled = false;
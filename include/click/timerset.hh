@@ -25,6 +25,16 @@ class TimerSet { public:
     unsigned timer_stride() const		{ return _timer_stride; }
     void set_max_timer_stride(unsigned timer_stride);
 
+    Timestamp timer_wheel_tick() const		{ return _wheel_tick; }
+    int set_timer_wheel_tick(const Timestamp &tick);
+
+    unsigned timer_count() const {
+	return _wheel_tick ? _wheel_size : _timer_heap.size();
+    }
+    uint64_t timer_operations() const		{ return _timer_ops; }
+    uint64_t timer_fires() const		{ return _timer_fires; }
+    click_cycles_t timer_cycles() const		{ return _timer_cycles; }
+
     void kill_router(Router *router);
 
     void run_timers(RouterThread *thread, Master *master);
@@ -54,6 +64,12 @@ class TimerSet { public:
 	}
     };
 
+    // The timing wheel has wheel_levels levels of wheel_slots slots.  A
+    // timer due at tick T lives at the level of the highest byte in which T
+    // differs from _wheel_now, in the slot named by that byte of T.
+    enum { wheel_bits = 8, wheel_slots = 1 << wheel_bits,
+	   wheel_levels = 4, wheel_mask = wheel_slots - 1 };
+
     // Most likely _timer_expiry now fits in a cache line
     Timestamp _timer_expiry CLICK_ALIGNED(8);
 
@@ -62,6 +78,18 @@ class TimerSet { public:
     unsigned _timer_count;
     Vector<heap_element> _timer_heap;
     Vector<Timer *> _timer_runchunk;
+
+    Timestamp _wheel_tick;		// zero means use _timer_heap
+    uint32_t _wheel_tick_nsec;
+    uint64_t _wheel_now;
+    Timer *_wheel[wheel_levels][wheel_slots];
+    uint32_t _wheel_bitmap[wheel_levels][wheel_slots / 32];
+    Timer *_wheel_overflow;
+    unsigned _wheel_size;
+
+    uint64_t _timer_ops;
+    uint64_t _timer_fires;
+    click_cycles_t _timer_cycles;
     SimpleSpinlock _timer_lock;
 #if CLICK_LINUXMODULE
     struct task_struct *_timer_task;
@@ -71,16 +99,34 @@ class TimerSet { public:
     Timestamp _timer_check;
     uint32_t _timer_check_reports;
 
-    inline void run_one_timer(Timer *);
+    inline void run_one_timer(Timer *t, RouterThread *thread);
+    void run_heap_timers(RouterThread *thread);
+    void run_timer_runchunk(RouterThread *thread);
 
     void set_timer_expiry() {
-	if (_timer_heap.size())
+	if (_wheel_tick)
+	    set_wheel_expiry();
+	else if (_timer_heap.size())
 	    _timer_expiry = _timer_heap.unchecked_at(0).expiry_s;
 	else
 	    _timer_expiry = Timestamp();
     }
     void check_timer_expiry(Timer *t);
 
+    uint64_t wheel_tick_of(const Timestamp &t) const {
+	return int_divide((uint64_t) t.nsecval(), _wheel_tick_nsec);
+    }
+    Timer **wheel_list(int i) {
+	return i < wheel_levels * wheel_slots ? &_wheel[0][0] + i : &_wheel_overflow;
+    }
+    void wheel_insert(Timer *t);
+    void wheel_remove(Timer *t);
+    int wheel_next_slot(int level, unsigned from) const;
+    bool wheel_next_tick(uint64_t &tick) const;
+    void wheel_cascade();
+    void set_wheel_expiry();
+    void run_wheel_timers(RouterThread *thread);
+
     inline void lock_timers();
     inline bool attempt_lock_timers();
     inline void unlock_timers();
@@ -149,14 +195,5 @@ TimerSet::fence()
     unlock_timers();
 }
 
-inline Timer *
-TimerSet::next_timer()
-{
-    lock_timers();
-    Timer *t = _timer_heap.empty() ? 0 : _timer_heap.unchecked_at(0).t;
-    unlock_timers();
-    return t;
-}
-
 CLICK_ENDDECLS
 #endif
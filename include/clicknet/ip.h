@@ -127,7 +127,8 @@ struct click_ip {
  * @param x data to checksum
  * @param len number of bytes to checksum
  *
- * @a x must be two-byte aligned. */
+ * At user level on x86, long ranges are summed with AVX2 when the CPU
+ * supports it.  @a x need not be aligned. */
 uint16_t click_in_cksum(const unsigned char *x, int len);
 uint16_t click_in_cksum_pseudohdr_raw(uint32_t csum, uint32_t src, uint32_t dst, int proto, int packet_len);
 #else
@@ -182,6 +183,22 @@ click_update_in_cksum(uint16_t *csum, uint16_t old_hw, uint16_t new_hw)
     *csum = ~(sum + (sum >> 16));
 }
 
+/** @brief Incrementally adjust an Internet checksum for a changed word.
+ * @param[in, out] csum points to checksum
+ * @param old_w old 32-bit word, as stored in the packet
+ * @param new_w new 32-bit word, as stored in the packet
+ *
+ * Equivalent to calling click_update_in_cksum() for each halfword of the
+ * word, as when an IP address or TCP sequence number changes. */
+static inline void
+click_update_in_cksum32(uint16_t *csum, uint32_t old_w, uint32_t new_w)
+{
+    uint32_t sum = (~*csum & 0xFFFF) + (~old_w >> 16) + (~old_w & 0xFFFF)
+	+ (new_w >> 16) + (new_w & 0xFFFF);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    *csum = ~(sum + (sum >> 16));
+}
+
 /** @brief Potentially fix a zero-valued Internet checksum.
  * @param[in, out] csum points to checksum
  * @param x data to checksum
@@ -516,6 +516,7 @@ click_read_router(String filename, bool is_expr, ErrorHandler *errh, bool initia
     }
 
     // lex
+    Timestamp parse_start = Timestamp::now_steady();
     Lexer *l = click_lexer();
     RequireLexerExtra lextra(&archive);
     int cookie = l->begin_parse(config_str, filename, &lextra, errh);
@@ -523,6 +524,8 @@ click_read_router(String filename, bool is_expr, ErrorHandler *errh, bool initia
 	l->ystep();
     Router *router = l->create_router(master ? master : new Master(1));
     l->end_parse(cookie);
+    if (router)
+	router->set_parse_time(Timestamp::now_steady() - parse_start);
 
     // initialize if requested
     if (initialize)
@@ -417,7 +417,7 @@ void BetterIPCounter3::push(int port, Packet *p) {
 
 /** @brief Construct an Element. */
 Element::Element()
-    : _router(0), _eindex(-1)
+    : _router(0), _eindex(-1), _profile(0), _profile_counters(0)
 {
     nelements_allocated++;
     _ports[0] = _ports[1] = &_inline_ports[0];
@@ -435,6 +435,7 @@ Element::~Element()
 	delete[] _ports[0];
     if (_ports[1] < _inline_ports || _ports[1] > _inline_ports + INLINE_PORTS)
 	delete[] _ports[1];
+    delete[] _profile_counters;
 }
 
 // CHARACTERISTICS
@@ -1214,6 +1215,15 @@ Element::processing_vector(int* in_v, int* out_v, ErrorHandler* errh) const
  * RoundRobinSched has 0 inputs, are idle rather than busy, and waste no
  * CPU time.</dd>
  *
+ * <dt><tt>C</tt></dt> <dd>This element's configure() method may run
+ * concurrently with other <tt>C</tt>-flagged elements' configure() methods.
+ * Such a method must only modify the element itself; it may read the router
+ * and query name databases, but must not define names, create notifiers or
+ * attachments, or call other elements.  When the router runs on more than
+ * one thread, <tt>C</tt>-flagged elements are configured in parallel after
+ * the other elements in their configure phase.  Large routing tables and
+ * classifiers set this flag to speed up startup and hot-swapping.</dd>
+ *
  * </dl>
  */
 const char*
@@ -2089,6 +2099,23 @@ Element::write_cycles_handler(const String &, Element *e, void *, ErrorHandler *
 }
 #endif
 
+String
+Element::read_profile_handler(Element *e, void *)
+{
+    StringAccum sa;
+    if (const ProfileCounters *pcs = e->profile_counters()) {
+	sa << "thread,calls,batches,packets,timed,cycles,own_cycles,misses\n";
+	for (int i = 0; i < e->master()->nthreads(); ++i) {
+	    const ProfileCounters &pc = pcs[i];
+	    if (pc.calls)
+		sa << i << ',' << pc.calls << ',' << pc.batches << ','
+		   << pc.packets << ',' << pc.timed << ',' << pc.cycles << ','
+		   << pc.own_cycles << ',' << pc.misses << '\n';
+	}
+    }
+    return sa.take_string();
+}
+
 void
 Element::add_default_handlers(bool allow_write_config)
 {
@@ -2099,6 +2126,7 @@ Element::add_default_handlers(bool allow_write_config)
     add_write_handler("config", write_config_handler, 0);
   add_read_handler("ports", read_ports_handler, 0, Handler::h_calm);
   add_read_handler("handlers", read_handlers_handler, 0, Handler::h_calm);
+  add_read_handler("profile", read_profile_handler, 0);
 #if CLICK_STATS >= 1
   add_read_handler("icounts", read_icounts_handler, 0);
   add_read_handler("ocounts", read_ocounts_handler, 0);
@@ -2916,6 +2944,35 @@ Element::pull(int port)
     return p;
 }
 
+/** @brief Pull up to @a max packets from pull output @a port.
+ *
+ * @param port the output port number receiving the pull request.
+ * @param p array of at least @a max packet pointers
+ * @param max maximum number of packets to return
+ * @return the number of packets stored in @a p
+ *
+ * A downstream element initiated a transfer of several packets from this
+ * element over a pull connection, using input(i).pull_burst().  This element
+ * should store up to @a max packets in @a p and return how many it stored.
+ * Returning fewer than @a max packets is always allowed.
+ *
+ * The default implementation calls pull() until it returns null or @a max
+ * packets have been pulled.  Elements that can produce several packets more
+ * cheaply than by repeated pull() calls, such as queues and schedulers,
+ * should override it; then one pass through the pull path moves a whole
+ * burst.  An override should behave like repeated calls to pull(), except
+ * that notifiers need be updated only once per burst, and schedulers may
+ * take consecutive packets from the same input.
+ */
+int
+Element::pull_burst(int port, Packet **p, int max)
+{
+    int n = 0;
+    while (n < max && (p[n] = pull(port)))
+	++n;
+    return n;
+}
+
 /** @brief Process a packet for a simple packet filter.
  *
  * @param p the input packet
@@ -3029,4 +3086,194 @@ Element::run_timer(Timer *timer)
     (void) timer;
 }
 
+// PROFILING
+
+// While a router is profiled, Port transfers into its elements go through
+// the profiled_ functions below.  A transfer costs a countdown decrement
+// unless it is sampled (one transfer in profile_sample per element and
+// thread) or made during a timed transfer on the same thread.  Sampled
+// transfers are counted and timed.  Transfers made during a timed transfer
+// are timed too, so each timed call can subtract the time spent in the
+// timed calls it makes, leaving its own cycles.  The cost of reading the
+// cycle and cache miss counters is also subtracted.  When the router tracks
+// element call stacks, every transfer also pushes the called element on
+// the thread's stack.
+
+namespace {
+struct ProfileFrame {
+    Element::ProfileCounters *pc;
+    RouterThread *thread;
+    RouterThread::ProfileState *ps;	// null if not profiled
+    bool stacked;
+    uint32_t period;		// nonzero iff sampled
+    click_cycles_t begin_cycles;
+    click_cycles_t start_cycles;
+    uint64_t start_misses;
+    click_cycles_t save_child_cycles;
+    click_cycles_t save_overhead;
+    uint64_t save_child_misses;
+};
+}
+
+static inline int
+profile_thread_id(Master *m)
+{
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD && HAVE___THREAD_STORAGE_CLASS
+    int id = click_current_thread_id;
+#elif CLICK_LINUXMODULE && HAVE_MULTITHREAD
+    int id = click_current_processor();
+#else
+    int id = 0;
+#endif
+    // Threads other than driver threads share thread 0's counters.
+    return (unsigned) id < (unsigned) m->nthreads() ? id : 0;
+}
+
+/* Return true if this call into @a e should be timed. */
+static inline bool
+profile_begin(ProfileFrame &f, Element *e, Element::ProfileCounters *pcs)
+{
+    if (!pcs) {
+	f.ps = 0;
+	return false;
+    }
+    Master *m = e->master();
+    int tid = profile_thread_id(m);
+    f.pc = &pcs[tid];
+    f.thread = m->thread(tid);
+    RouterThread::ProfileState &ps = f.thread->profile_state();
+    f.ps = &ps;
+    if ((f.stacked = ps.stack_on))
+	ps.push_frame(e);
+
+    if (likely(--f.pc->countdown != 0)) {
+	if (likely(!ps.depth))
+	    return false;
+	f.period = 0;
+    } else if (uint32_t sample = e->router()->profile_sample())
+	f.period = f.pc->countdown = sample;
+    else {
+	// Only tracking stacks.
+	f.pc->countdown = ~0U;
+	if (!ps.depth)
+	    return false;
+	f.period = 0;
+    }
+
+    f.begin_cycles = click_get_cycles();
+    f.save_child_cycles = ps.child_cycles;
+    f.save_overhead = ps.overhead;
+    f.save_child_misses = ps.child_misses;
+    ps.child_cycles = ps.overhead = 0;
+    ps.child_misses = 0;
+    ++ps.depth;
+    f.start_misses = f.thread->profile_cache_misses();
+    f.start_cycles = click_get_cycles();
+    return true;
+}
+
+static inline void
+profile_end(ProfileFrame &f, int npackets, bool batch)
+{
+    click_cycles_t end_cycles = click_get_cycles();
+    uint64_t misses = f.thread->profile_cache_misses() - f.start_misses;
+    RouterThread::ProfileState &ps = f.thread->profile_state();
+
+    click_cycles_t cycles = end_cycles - f.start_cycles, skew = ps.overhead + ps.floor;
+    cycles = (cycles > skew ? cycles - skew : 0);
+    Element::ProfileCounters *pc = f.pc;
+    if (f.period) {
+	pc->calls += f.period;
+	pc->packets += (uint64_t) npackets * f.period;
+	if (batch)
+	    pc->batches += f.period;
+    }
+    ++pc->timed;
+    pc->cycles += cycles;
+    if (cycles > ps.child_cycles)
+	pc->own_cycles += cycles - ps.child_cycles;
+    if (misses > ps.child_misses)
+	pc->misses += misses - ps.child_misses;
+
+    --ps.depth;
+    ps.child_cycles = f.save_child_cycles + cycles;
+    ps.child_misses = f.save_child_misses + misses;
+    ps.overhead = f.save_overhead + ps.overhead + ps.floor
+	+ (f.start_cycles - f.begin_cycles) + (click_get_cycles() - end_cycles);
+}
+
+static inline void
+profile_leave(ProfileFrame &f)
+{
+    if (f.ps && f.stacked)
+	f.ps->pop_frame();
+}
+
+void
+Element::Port::profiled_push(Packet *p) const
+{
+    ProfileFrame f;
+    bool timed = profile_begin(f, _e, _e->_profile);
+#if HAVE_BOUND_PORT_TRANSFER
+    _bound.push(_e, _port, p);
+#else
+    _e->push(_port, p);
+#endif
+    if (timed)
+	profile_end(f, 1, false);
+    profile_leave(f);
+}
+
+Packet *
+Element::Port::profiled_pull() const
+{
+    ProfileFrame f;
+    bool timed = profile_begin(f, _e, _e->_profile);
+#if HAVE_BOUND_PORT_TRANSFER
+    Packet *p = _bound.pull(_e, _port);
+#else
+    Packet *p = _e->pull(_port);
+#endif
+    if (timed)
+	profile_end(f, p ? 1 : 0, false);
+    profile_leave(f);
+    return p;
+}
+
+int
+Element::Port::profiled_pull_burst(Packet **p, int max) const
+{
+    ProfileFrame f;
+    bool timed = profile_begin(f, _e, _e->_profile);
+    int n = _e->pull_burst(_port, p, max);
+    if (timed)
+	profile_end(f, n, true);
+    profile_leave(f);
+    return n;
+}
+
+void
+Element::Port::profiled_bpush(PBatch *pb) const
+{
+    ProfileFrame f;
+    bool timed = profile_begin(f, _e, _e->_profile);
+    int npackets = pb->npkts;
+    _e->bpush(_port, pb);
+    if (timed)
+	profile_end(f, npackets, true);
+    profile_leave(f);
+}
+
+PBatch *
+Element::Port::profiled_bpull() const
+{
+    ProfileFrame f;
+    bool timed = profile_begin(f, _e, _e->_profile);
+    PBatch *pb = _e->bpull(_port);
+    if (timed)
+	profile_end(f, pb ? pb->npkts : 0, true);
+    profile_leave(f);
+    return pb;
+}
+
 CLICK_ENDDECLS
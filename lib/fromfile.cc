@@ -168,6 +168,35 @@ FromFile::read_buffer_mmap(ErrorHandler *errh)
 
     return 1;
 }
+
+int
+FromFile::remap_at_pos()
+{
+    // Map a new unit starting at the page that contains the current
+    // position, so a record that straddles two units can still share the
+    // mapping instead of being copied. On failure, leave state unchanged;
+    // the caller copies the record instead, so that is not an error.
+    off_t want = _file_offset + _pos;
+    WritablePacket *old_packet = _data_packet;
+    const uint8_t *old_buffer = _buffer;
+    uint32_t old_len = _len;
+    off_t old_file_offset = _file_offset, old_mmap_off = _mmap_off;
+
+    _mmap_off = want - (want % getpagesize());
+    if (read_buffer_mmap(ErrorHandler::silent_handler()) > 0) {
+	if (old_packet)
+	    old_packet->kill();
+	_pos = want - _file_offset;
+	return 1;
+    }
+
+    _data_packet = old_packet;
+    _buffer = old_buffer;
+    _len = old_len;
+    _file_offset = old_file_offset;
+    _mmap_off = old_mmap_off;
+    return 0;
+}
 #endif
 
 int
@@ -316,7 +345,7 @@ int
 FromFile::seek(off_t want, ErrorHandler* errh)
 {
     if (want >= _file_offset && want < (off_t) (_file_offset + _len)) {
-	_pos = want;
+	_pos = want - _file_offset;
 	return 0;
     }
 
@@ -497,6 +526,10 @@ FromFile::get_string(size_t size, ErrorHandler *errh)
 Packet *
 FromFile::get_packet(size_t size, uint32_t sec, uint32_t subsec, ErrorHandler *errh)
 {
+#ifdef ALLOW_MMAP
+    if (_mmap && _pos + size > _len && _mmap_unit)
+	(void) remap_at_pos();
+#endif
     if (_pos + size <= _len) {
 	if (Packet *p = _data_packet->clone()) {
 	    p->shrink_data(_buffer + _pos, size);
@@ -552,13 +585,23 @@ FromFile::filename_handler(Element *e, void *thunk)
     return fd->print_filename();
 }
 
+off_t
+FromFile::file_size() const
+{
+    struct stat s;
+    if (_fd >= 0 && fstat(_fd, &s) >= 0 && S_ISREG(s.st_mode))
+	return s.st_size;
+    else
+	return -1;
+}
+
 String
 FromFile::filesize_handler(Element *e, void *thunk)
 {
     FromFile *fd = reinterpret_cast<FromFile *>((uint8_t *)e + (intptr_t)thunk);
-    struct stat s;
-    if (fd->_fd >= 0 && fstat(fd->_fd, &s) >= 0 && S_ISREG(s.st_mode))
-	return String(s.st_size);
+    off_t size = fd->file_size();
+    if (size >= 0)
+	return String(size);
     else
 	return "-";
 }
@@ -17,37 +17,113 @@
 #endif
 
 #if !CLICK_LINUXMODULE
+# if CLICK_USERLEVEL && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#  define IN_CKSUM_AVX2 1
+#  include <immintrin.h>
+# endif
+
+/*
+ * The Internet checksum is byte-order independent, and summing 32-bit words
+ * into a 64-bit accumulator, then folding, gives the same result as summing
+ * 16-bit words (RFC 1071).  The accumulator cannot overflow for any length
+ * an int can hold.
+ */
+static inline uint64_t
+in_cksum_scalar(const unsigned char *x, int len, uint64_t sum)
+{
+    uint32_t w[4];
+    uint16_t hw = 0;
+    for (; len >= 16; x += 16, len -= 16) {
+	memcpy(w, x, 16);
+	sum += (uint64_t) w[0] + w[1] + w[2] + w[3];
+    }
+    for (; len >= 4; x += 4, len -= 4) {
+	memcpy(w, x, 4);
+	sum += w[0];
+    }
+    if (len >= 2) {
+	memcpy(&hw, x, 2);
+	sum += hw;
+	x += 2;
+	len -= 2;
+    }
+    /* mop up an odd byte, if necessary */
+    if (len == 1) {
+	hw = 0;
+	*(unsigned char *) &hw = *x;
+	sum += hw;
+    }
+    return sum;
+}
+
+# if IN_CKSUM_AVX2
+/* Sums the 16-bit words of len bytes, a multiple of 64, in 32-bit lanes.
+   Each pass adds at most 4 * 0xFFFF to a lane, so the lanes are flushed
+   every 8192 passes, well before they could overflow. */
+__attribute__((target("avx2"))) static uint64_t
+in_cksum_avx2(const unsigned char *x, int len)
+{
+    const __m256i mask = _mm256_set1_epi32(0xFFFF);
+    uint64_t sum = 0;
+    while (len > 0) {
+	__m256i a = _mm256_setzero_si256(), b = _mm256_setzero_si256();
+	int n = (len < 8192 * 64 ? len : 8192 * 64);
+	len -= n;
+	for (; n > 0; x += 64, n -= 64) {
+	    __m256i v = _mm256_loadu_si256((const __m256i *) x);
+	    __m256i u = _mm256_loadu_si256((const __m256i *) (x + 32));
+	    a = _mm256_add_epi32(a, _mm256_and_si256(v, mask));
+	    b = _mm256_add_epi32(b, _mm256_srli_epi32(v, 16));
+	    a = _mm256_add_epi32(a, _mm256_and_si256(u, mask));
+	    b = _mm256_add_epi32(b, _mm256_srli_epi32(u, 16));
+	}
+	uint32_t lanes[16];
+	int i;
+	_mm256_storeu_si256((__m256i *) lanes, a);
+	_mm256_storeu_si256((__m256i *) (lanes + 8), b);
+	for (i = 0; i < 16; ++i)
+	    sum += lanes[i];
+    }
+    return sum;
+}
+
+static int
+in_cksum_have_avx2(void)
+{
+    static int have_avx2 = -1;
+    if (have_avx2 < 0) {
+	__builtin_cpu_init();
+	have_avx2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+    }
+    return have_avx2;
+}
+# endif
+
 uint16_t
 click_in_cksum(const unsigned char *addr, int len)
 {
-    int nleft = len;
-    const uint16_t *w = (const uint16_t *)addr;
-    uint32_t sum = 0;
-    uint16_t answer = 0;
-
-    /*
-     * Our algorithm is simple, using a 32 bit accumulator (sum), we add
-     * sequential 16 bit words to it, and at the end, fold back all the
-     * carry bits from the top 16 bits into the lower 16 bits.
-     */
-    while (nleft > 1)  {
-	sum += *w++;
-	nleft -= 2;
-    }
+    uint64_t sum = 0;
 
-    /* mop up an odd byte, if necessary */
-    if (nleft == 1) {
-	*(unsigned char *)(&answer) = *(const unsigned char *)w ;
-	sum += answer;
+# if IN_CKSUM_AVX2
+    /* Below a few hundred bytes, as for IP headers, the scalar loop wins. */
+    if (len >= 256 && in_cksum_have_avx2()) {
+	int n = len & ~63;
+	sum = in_cksum_avx2(addr, n);
+	addr += n;
+	len -= n;
     }
+# endif
+    sum = in_cksum_scalar(addr, len, sum);
 
-    /* add back carry outs from top 16 bits to low 16 bits */
-    sum = (sum & 0xffff) + (sum >> 16);
+    /* add back carry outs from top bits to low 16 bits */
+    sum = (sum & 0xFFFFFFFF) + (sum >> 32);
+    sum = (sum & 0xFFFFFFFF) + (sum >> 32);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    sum = (sum & 0xFFFF) + (sum >> 16);
     sum += (sum >> 16);
     /* guaranteed now that the lower 16 bits of sum are correct */
 
-    answer = ~sum;              /* truncate to 16 bits */
-    return answer;
+    return ~sum & 0xFFFF;
 }
 
 uint16_t
@@ -43,6 +43,9 @@ Master::Master(int nthreads)
 {
     _refcount = 0;
     _master_paused = 0;
+#if HAVE_MULTITHREAD
+    _steal_waiting = 0;
+#endif
 
     _nthreads = nthreads + 1;
     _threads = new RouterThread *[_nthreads];
@@ -149,6 +149,11 @@ NameDB::revquery(const void *, size_t)
     return String();
 }
 
+void
+NameDB::prepare_concurrent_query()
+{
+}
+
 bool
 StaticNameDB::query(const String &name, void *value, size_t vsize)
 {
@@ -276,6 +281,16 @@ DynamicNameDB::define(const String& name, const void* value, size_t vsize)
 	return false;
 }
 
+void
+DynamicNameDB::prepare_concurrent_query()
+{
+    // A sorted database is searched without modification.
+    if (_names.size() == 0)
+	_sorted = 100;
+    else
+	sort();
+}
+
 
 String
 DynamicNameDB::revquery(const void *value, size_t vsize)
@@ -428,6 +443,17 @@ NameInfo::getdb(uint32_t type, const Element *e, size_t vsize, bool create)
     return the_name_info->namedb(type, vsize, String(), install);
 }
 
+void
+NameInfo::prepare_concurrent_query(const Element *e)
+{
+    if (e)
+	if (NameInfo *ni = e->router()->name_info())
+	    for (NameDB **db = ni->_namedbs.begin(); db != ni->_namedbs.end(); ++db)
+		(*db)->prepare_concurrent_query();
+    for (NameDB **db = the_name_info->_namedbs.begin(); db != the_name_info->_namedbs.end(); ++db)
+	(*db)->prepare_concurrent_query();
+}
+
 void
 NameInfo::installdb(NameDB *db, const Element *prefix)
 {
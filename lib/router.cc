@@ -29,6 +29,7 @@
 #include <click/elemfilter.hh>
 #include <click/routervisitor.hh>
 #include <click/confparse.hh>
+#include <click/args.hh>
 #include <click/timer.hh>
 #include <click/master.hh>
 #include <click/notifier.hh>
@@ -46,6 +47,9 @@
 #endif
 #if CLICK_USERLEVEL
 # include <unistd.h>
+# if HAVE_MULTITHREAD
+#  include <pthread.h>
+# endif
 #endif
 #if CLICK_NS
 # include "../elements/ns/fromsimdevice.hh"
@@ -83,7 +87,8 @@ Router::Router(const String &configuration, Master *master)
       _configuration(configuration),
       _notifier_signals(0),
       _arena_factory(new HashMap_ArenaFactory),
-      _hotswap_router(0), _thread_sched(0), _name_info(0), _next_router(0)
+      _hotswap_router(0), _thread_sched(0), _name_info(0), _profile_sample(0),
+      _profile_stack(false), _next_router(0)
 {
     _refcount = 0;
     _runcount = 0;
@@ -1037,6 +1042,133 @@ configure_order_compar(const void *athunk, const void *bthunk, void *copthunk)
     return configure_order_phase[*a] - configure_order_phase[*b];
 }
 
+int
+Router::configure_element(int i, ErrorHandler *errh)
+{
+    RouterContextErrh cerrh(errh, "While configuring", element(i));
+    assert(!cerrh.nerrors());
+    Vector<String> conf;
+    cp_argvec(_element_configurations[i], conf);
+    int r = _elements[i]->configure(conf, &cerrh);
+    if (r < 0 && !cerrh.nerrors()) {
+	if (r == -ENOMEM)
+	    cerrh.error("out of memory");
+	else
+	    cerrh.error("unspecified error");
+    }
+    return r;
+}
+
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD
+/* Collects one element's configuration errors so they can be reported in
+   configure order once all threads finish. */
+class ConfigureErrorBuffer : public ErrorHandler { public:
+
+    void *emit(const String &str, void *, bool more) {
+	_sa << str;
+	if (more)
+	    _sa << '\n';
+	else
+	    _messages.push_back(_sa.take_string());
+	return 0;
+    }
+
+    void replay(ErrorHandler *errh) {
+	for (String *m = _messages.begin(); m != _messages.end(); ++m)
+	    errh->xmessage(*m);
+    }
+
+  private:
+
+    StringAccum _sa;
+    Vector<String> _messages;
+
+};
+
+struct ConfigureJob {
+    Router *router;
+    const int *eindex;
+    const int *which;
+    int n;
+    atomic_uint32_t next;
+    int *result;
+    ConfigureErrorBuffer *errh;
+};
+
+void *
+Router::configure_thread(void *thunk)
+{
+    ConfigureJob *job = static_cast<ConfigureJob *>(thunk);
+    int k;
+    while ((k = job->next.fetch_and_add(1)) < job->n) {
+	int w = job->which[k];
+	job->result[w] = job->router->configure_element(job->eindex[w], &job->errh[w]);
+    }
+    return 0;
+}
+#endif
+
+/* Configures the @a n elements in @a eindexes, which share a configure
+   phase. Elements flagged "C" are configured concurrently, using up to @a
+   nthreads threads, once the others are done. Errors are reported in
+   @a eindexes order. */
+void
+Router::configure_concurrently(const int *eindexes, int n, int nthreads,
+			       Vector<int> &element_stage, ErrorHandler *errh)
+{
+#if CLICK_USERLEVEL && HAVE_MULTITHREAD
+    Vector<int> result(n, 0);
+    ConfigureErrorBuffer *buffers = new ConfigureErrorBuffer[n];
+    Vector<int> concurrent;
+    for (int k = 0; k < n; ++k)
+	if (_elements[eindexes[k]]->flag_value('C') > 0)
+	    concurrent.push_back(k);
+	else
+	    result[k] = configure_element(eindexes[k], &buffers[k]);
+
+    if (nthreads > concurrent.size())
+	nthreads = concurrent.size();
+    // Make lazily sorted lookup structures safe for concurrent readers.
+    (void) find(String(), String());
+    NameInfo::prepare_concurrent_query(_root_element);
+
+    ConfigureJob job;
+    job.router = this;
+    job.eindex = eindexes;
+    job.which = concurrent.begin();
+    job.n = concurrent.size();
+    job.next = 0;
+    job.result = result.begin();
+    job.errh = buffers;
+
+    Vector<pthread_t> threads;
+    for (int t = 1; t < nthreads; ++t) {
+	pthread_t p;
+	if (pthread_create(&p, 0, configure_thread, &job) == 0)
+	    threads.push_back(p);
+    }
+    configure_thread(&job);
+    for (pthread_t *p = threads.begin(); p != threads.end(); ++p)
+	pthread_join(*p, 0);
+
+    for (int k = 0; k < n; ++k) {
+	buffers[k].replay(errh);
+	if (result[k] < 0)
+	    element_stage[eindexes[k]] = Element::CLEANUP_CONFIGURE_FAILED;
+	else
+	    element_stage[eindexes[k]] = Element::CLEANUP_CONFIGURED;
+    }
+    delete[] buffers;
+#else
+    (void) nthreads;
+    for (int k = 0; k < n; ++k)
+	if (configure_element(eindexes[k], errh) < 0)
+	    element_stage[eindexes[k]] = Element::CLEANUP_CONFIGURE_FAILED;
+	else
+	    element_stage[eindexes[k]] = Element::CLEANUP_CONFIGURED;
+#endif
+}
+
 inline Handler*
 Router::xhandler(int hi) const
 {
@@ -1088,8 +1220,8 @@ Router::initialize(ErrorHandler *errh)
 
     // set up configuration order
     _element_configure_order.assign(nelements(), 0);
+    Vector<int> configure_phase(nelements(), 0);
     if (_element_configure_order.size()) {
-	Vector<int> configure_phase(nelements(), 0);
 	for (int i = 0; i < _elements.size(); i++) {
 	    configure_phase[i] = _elements[i]->configure_phase();
 	    _element_configure_order[i] = i;
@@ -1119,33 +1251,47 @@ Router::initialize(ErrorHandler *errh)
 #endif
 
     // Configure all elements in configure order. Remember the ones that failed
+    Timestamp start_time = Timestamp::now_steady();
     if (all_ok) {
-	Vector<String> conf;
 	// Set the random seed to a "truly random" value by default.
 	click_random_srandom();
-	for (int ord = 0; ord < _elements.size(); ord++) {
-	    int i = _element_configure_order[ord], r;
+	int nthreads = _master->nthreads();
+	for (int ord = 0; ord < _elements.size(); ) {
+	    // A configure phase containing elements flagged "C" is handed to
+	    // configure_concurrently, which configures those elements
+	    // concurrently once the others are done.
+	    int phase = configure_phase[_element_configure_order[ord]];
+	    int first = ord;
+	    bool any_concurrent = false;
+	    for (; ord < _elements.size()
+		     && configure_phase[_element_configure_order[ord]] == phase;
+		 ++ord)
+		if (nthreads > 1
+		    && _elements[_element_configure_order[ord]]->flag_value('C') > 0)
+		    any_concurrent = true;
+	    if (any_concurrent) {
+		configure_concurrently(&_element_configure_order[first],
+				       ord - first, nthreads, element_stage, errh);
+		continue;
+	    }
+	    for (int k = first; k < ord; ++k) {
+		int i = _element_configure_order[k];
 #if CLICK_DMALLOC
-	    sprintf(dmalloc_buf, "c%d  ", i);
-	    CLICK_DMALLOC_REG(dmalloc_buf);
+		sprintf(dmalloc_buf, "c%d  ", i);
+		CLICK_DMALLOC_REG(dmalloc_buf);
 #endif
-	    RouterContextErrh cerrh(errh, "While configuring", element(i));
-	    assert(!cerrh.nerrors());
-	    conf.clear();
-	    cp_argvec(_element_configurations[i], conf);
-	    if ((r = _elements[i]->configure(conf, &cerrh)) < 0) {
-		element_stage[i] = Element::CLEANUP_CONFIGURE_FAILED;
-		all_ok = false;
-		if (!cerrh.nerrors()) {
-		    if (r == -ENOMEM)
-			cerrh.error("out of memory");
-		    else
-			cerrh.error("unspecified error");
-		}
-	    } else
-		element_stage[i] = Element::CLEANUP_CONFIGURED;
+		if (configure_element(i, errh) < 0)
+		    element_stage[i] = Element::CLEANUP_CONFIGURE_FAILED;
+		else
+		    element_stage[i] = Element::CLEANUP_CONFIGURED;
+	    }
 	}
+	for (int i = 0; i < _elements.size(); i++)
+	    if (element_stage[i] == Element::CLEANUP_CONFIGURE_FAILED)
+		all_ok = false;
     }
+    Timestamp configured_time = Timestamp::now_steady();
+    _configure_time = configured_time - start_time;
 
 #if CLICK_DMALLOC
     CLICK_DMALLOC_REG("iHoo");
@@ -1181,6 +1327,8 @@ Router::initialize(ErrorHandler *errh)
     CLICK_DMALLOC_REG("iXXX");
 #endif
 
+    _initialize_time = Timestamp::now_steady() - configured_time;
+
     // If there were errors, uninitialize any elements that we initialized
     // successfully and return -1 (error). Otherwise, we're all set!
     if (all_ok) {
@@ -1226,6 +1374,7 @@ Router::activate(bool foreground, ErrorHandler *errh)
 
     // Take state if appropriate
     if (_hotswap_router && _hotswap_router->_state == ROUTER_LIVE) {
+	Timestamp start_time = Timestamp::now_steady();
 	// Unschedule tasks and timers
 	master()->kill_router(_hotswap_router);
 
@@ -1236,6 +1385,7 @@ Router::activate(bool foreground, ErrorHandler *errh)
 		e->take_state(other, &cerrh);
 	    }
 	}
+	_hotswap_time = Timestamp::now_steady() - start_time;
     }
     if (_hotswap_router) {
 	_hotswap_router->unuse();
@@ -1927,6 +2077,12 @@ ThreadSched::initial_home_thread_id(const Element *)
     return 0;
 }
 
+bool
+ThreadSched::initial_migratable(const Element *)
+{
+    return false;
+}
+
 /** @cond never */
 /** @brief  Create (if necessary) and return the NameInfo object for this router.
  *
@@ -2150,6 +2306,225 @@ Router::element_ports_string(const Element *e) const
 }
 
 
+// PROFILING
+
+/** @brief Set the element profiling sample period to @a sample.
+ *
+ * When @a sample is nonzero, about one push or pull transfer in @a sample
+ * into each of this router's elements is counted and timed, per element and
+ * per thread; see Element::ProfileCounters.  When @a sample is zero,
+ * profiling stops, but the collected counters remain available.
+ *
+ * Profiling is not available in CLICK_STATS >= 2 builds, which time every
+ * transfer; use the element_cycles.csv handler there. */
+void
+Router::set_profile_sample(uint32_t sample)
+{
+    _profile_sample = sample;
+
+    // Timed calls subtract the cost of reading the cycle counter.
+    click_cycles_t floor = ~(click_cycles_t) 0;
+    for (int i = 0; i < 64; ++i) {
+	click_cycles_t c0 = click_get_cycles();
+	click_cycles_t c1 = click_get_cycles();
+	if (c1 - c0 < floor)
+	    floor = c1 - c0;
+    }
+    for (int t = 0; t < _master->nthreads(); ++t)
+	_master->thread(t)->profile_state().floor = floor;
+
+    update_profile(true);
+}
+
+/** @brief Set whether threads track the element call stack.
+ *
+ * When @a on is true, each thread maintains the chain of elements it is
+ * running, starting from the element whose task or timer fired, in
+ * RouterThread::ProfileState.  Samplers such as FlameSampler read it. */
+void
+Router::set_profile_stack(bool on)
+{
+    _profile_stack = on;
+    for (int t = 0; t < _master->nthreads(); ++t)
+	_master->thread(t)->profile_state().stack_on = on;
+    update_profile(false);
+}
+
+void
+Router::update_profile(bool restart_countdown)
+{
+    int nthreads = _master->nthreads();
+    bool on = _profile_sample || _profile_stack;
+    for (int ei = 0; ei < _elements.size(); ++ei) {
+	Element *e = _elements[ei];
+	if (!on) {
+	    e->_profile = 0;
+	    continue;
+	}
+	Element::ProfileCounters *pcs = e->_profile_counters;
+	if (!pcs) {
+	    pcs = new Element::ProfileCounters[nthreads];
+	    memset(pcs, 0, sizeof(Element::ProfileCounters) * nthreads);
+	    restart_countdown = true;
+	}
+	if (restart_countdown)
+	    for (int t = 0; t < nthreads; ++t)
+		// Stagger the first timed calls so that elements on a path
+		// are not always timed together.
+		pcs[t].countdown = _profile_sample ? 1 + (ei * 2654435761U + t) % _profile_sample : ~0U;
+	if (!e->_profile_counters) {
+	    click_fence();
+	    e->_profile_counters = pcs;
+	}
+#if CLICK_STATS < 2
+	e->_profile = pcs;
+#endif
+    }
+}
+
+/** @brief Zero the element profiling counters.
+ *
+ * Counters updated concurrently by running threads may lose a few
+ * events. */
+void
+Router::reset_profile()
+{
+    int nthreads = _master->nthreads();
+    for (int ei = 0; ei < _elements.size(); ++ei)
+	if (Element::ProfileCounters *pcs = _elements[ei]->_profile_counters)
+	    for (int t = 0; t < nthreads; ++t) {
+		uint32_t countdown = pcs[t].countdown;
+		memset(&pcs[t], 0, sizeof(pcs[t]));
+		pcs[t].countdown = countdown;
+	    }
+}
+
+namespace {
+struct ProfileRow {
+    int eindex;
+    uint64_t calls;
+    uint64_t packets;
+    uint64_t timed;
+    click_cycles_t cycles;
+    click_cycles_t own_cycles;
+    click_cycles_t own_per_call;
+    uint64_t misses;
+};
+
+int
+profile_row_compar(const void *a, const void *b, void *)
+{
+    const ProfileRow *pa = static_cast<const ProfileRow *>(a);
+    const ProfileRow *pb = static_cast<const ProfileRow *>(b);
+    if (pa->own_cycles != pb->own_cycles)
+	return pa->own_cycles > pb->own_cycles ? -1 : 1;
+    return pa->eindex - pb->eindex;
+}
+
+// Return about a / b, avoiding 64-bit division.
+uint64_t
+profile_divide(uint64_t a, uint64_t b)
+{
+    while (b > 0xFFFFFFFFU) {
+	a >>= 1;
+	b >>= 1;
+    }
+    return b ? int_divide(a, (uint32_t) b) : 0;
+}
+
+// Return about a * 1000 / b, avoiding overflow and 64-bit division.
+uint32_t
+profile_permille(uint64_t a, uint64_t b)
+{
+    while (a >= ((uint64_t) 1 << 54)) {
+	a >>= 1;
+	b >>= 1;
+    }
+    return profile_divide(a * 1000, b);
+}
+}
+
+/** @brief Unparse the element profile into @a sa.
+ *
+ * The result is CSV with one line per element that received a transfer,
+ * summed over threads and sorted by estimated own cycles, most expensive
+ * first.  Cycle and miss totals are extrapolated from the timed calls. */
+void
+Router::profile_report(StringAccum &sa) const
+{
+    int nthreads = _master->nthreads();
+    Vector<ProfileRow> rows;
+    click_cycles_t total_own = 0;
+    for (int ei = 0; ei < _elements.size(); ++ei) {
+	const Element::ProfileCounters *pcs = _elements[ei]->_profile_counters;
+	if (!pcs)
+	    continue;
+	ProfileRow r;
+	memset(&r, 0, sizeof(r));
+	r.eindex = ei;
+	for (int t = 0; t < nthreads; ++t) {
+	    r.calls += pcs[t].calls;
+	    r.packets += pcs[t].packets;
+	    r.timed += pcs[t].timed;
+	    r.cycles += pcs[t].cycles;
+	    r.own_cycles += pcs[t].own_cycles;
+	    r.misses += pcs[t].misses;
+	}
+	if (!r.calls)
+	    continue;
+	if (r.timed) {
+	    r.own_per_call = profile_divide(r.own_cycles, r.timed);
+	    r.cycles = profile_divide(r.cycles, r.timed) * r.calls;
+	    r.own_cycles = r.own_per_call * r.calls;
+	    r.misses = int_divide(profile_divide(r.misses * 1000, r.timed) * r.calls, 1000U);
+	}
+	total_own += r.own_cycles;
+	rows.push_back(r);
+    }
+    if (rows.size())
+	click_qsort(rows.begin(), rows.size(), sizeof(ProfileRow), profile_row_compar);
+
+    bool misses = false;
+    for (int t = 0; t < nthreads; ++t)
+	misses = misses || _master->thread(t)->profile_cache_misses_available();
+
+    sa << "name,class,calls,packets,cycles,own_cycles,own_cycles_per_call,own_percent,misses,drops\n";
+    for (ProfileRow *r = rows.begin(); r != rows.end(); ++r) {
+	Element *e = _elements[r->eindex];
+	sa << _element_names[r->eindex] << ',' << e->class_name() << ','
+	   << r->calls << ',' << r->packets << ','
+	   << r->cycles << ',' << r->own_cycles << ',' << r->own_per_call << ',';
+	if (total_own) {
+	    uint32_t permille = profile_permille(r->own_cycles, total_own);
+	    sa << (permille / 10) << '.' << (permille % 10);
+	}
+	sa << ',';
+	if (misses)
+	    sa << r->misses;
+	sa << ',';
+	const Handler *h = handler(e, "drops");
+	if (h && h->readable())
+	    sa << cp_uncomment(h->call_read(e));
+	sa << '\n';
+    }
+}
+
+/** @brief Unparse this router's startup times into @a sa.
+ *
+ * The result has one line per stage: "parse", "configure", "initialize",
+ * and "hotswap", each followed by the seconds that stage took.  The
+ * "hotswap" stage is the time taken to move state from the previous router
+ * during a hot-swap. */
+void
+Router::startup_report(StringAccum &sa) const
+{
+    sa << "parse " << _parse_time << '\n'
+       << "configure " << _configure_time << '\n'
+       << "initialize " << _initialize_time << '\n'
+       << "hotswap " << _hotswap_time << '\n';
+}
+
+
 // STATIC INITIALIZATION, DEFAULT GLOBAL HANDLERS
 
 /** @brief  Returns the router's initial configuration string.
@@ -2169,7 +2544,9 @@ Router::configuration_string() const
 enum { GH_VERSION, GH_CONFIG, GH_FLATCONFIG, GH_LIST, GH_REQUIREMENTS,
        GH_DRIVER, GH_ACTIVE_PORTS, GH_ACTIVE_PORT_STATS, GH_STRING_PROFILE,
        GH_STRING_PROFILE_LONG, GH_SCHEDULING_PROFILE, GH_STOP,
-       GH_ELEMENT_CYCLES, GH_CLASS_CYCLES, GH_RESET_CYCLES };
+       GH_ELEMENT_CYCLES, GH_CLASS_CYCLES, GH_RESET_CYCLES, GH_TIMERS,
+       GH_TIMER_WHEEL, GH_IDLE, GH_IDLE_POLICY, GH_PROFILE,
+       GH_PROFILE_SAMPLE, GH_RESET_PROFILE, GH_STARTUP };
 
 #if CLICK_STATS >= 2
 struct stats_info {
@@ -2225,6 +2602,61 @@ Router::router_read_handler(Element *e, void *thunk)
 	break;
 #endif
 
+    case GH_TIMERS:
+	if (!r)
+	    break;
+	sa << "thread,tick,timers,operations,fires,cycles\n";
+	for (int i = -1; i < r->master()->nthreads(); ++i) {
+	    const TimerSet &ts = r->master()->thread(i)->timer_set();
+	    sa << i << ',' << ts.timer_wheel_tick() << ','
+	       << ts.timer_count() << ',' << ts.timer_operations() << ','
+	       << ts.timer_fires() << ',' << ts.timer_cycles() << '\n';
+	}
+	break;
+
+    case GH_TIMER_WHEEL:
+	if (r)
+	    return r->master()->thread(0)->timer_set().timer_wheel_tick().unparse();
+	break;
+
+    case GH_PROFILE:
+	if (r)
+	    r->profile_report(sa);
+	break;
+
+    case GH_PROFILE_SAMPLE:
+	if (r)
+	    return String(r->profile_sample());
+	break;
+
+    case GH_STARTUP:
+	if (r)
+	    r->startup_report(sa);
+	break;
+
+#if CLICK_USERLEVEL
+    case GH_IDLE:
+	if (!r)
+	    break;
+	sa << "thread,state,busy,spin,pause,sleep\n";
+	for (int i = 0; i < r->master()->nthreads(); ++i) {
+	    RouterThread *t = r->master()->thread(i);
+	    sa << i << ',' << RouterThread::idle_state_name(t->idle_state());
+	    for (int s = 0; s < RouterThread::NIDLE; ++s)
+		sa << ',' << t->idle_time(s);
+	    sa << '\n';
+	}
+	break;
+
+    case GH_IDLE_POLICY:
+	if (r) {
+	    RouterThread *t = r->master()->thread(0);
+	    sa << t->idle_spin() << ' ' << t->idle_pause() << ' '
+	       << t->idle_sleep().unparse_interval();
+	}
+	break;
+#endif
+
 #if CLICK_STATS >= 1
     case GH_ACTIVE_PORTS:
 	if (r)
@@ -2379,6 +2811,46 @@ Router::router_write_handler(const String &s, Element *e, void *thunk, ErrorHand
 	for (int i = 0; i < (r ? r->nelements() : 0); i++)
 	    r->_elements[i]->reset_cycles();
 	break;
+#endif
+    case GH_TIMER_WHEEL: {
+	Timestamp tick;
+	if (!TimestampArg().parse(cp_uncomment(s), tick)
+	    || tick.is_negative() || tick > Timestamp(1, 0))
+	    return errh->error("expected timing wheel tick between 0 and 1 second");
+	for (int i = -1; i < r->master()->nthreads(); ++i)
+	    r->master()->thread(i)->timer_set().set_timer_wheel_tick(tick);
+	break;
+    }
+    case GH_PROFILE_SAMPLE: {
+	uint32_t sample;
+	if (!IntArg().parse(cp_uncomment(s), sample))
+	    return errh->error("expected sample period");
+#if CLICK_STATS >= 2
+	if (sample)
+	    return errh->error("profiling not available with CLICK_STATS >= 2, use element_cycles.csv");
+#endif
+	r->set_profile_sample(sample);
+	break;
+    }
+    case GH_RESET_PROFILE:
+	r->reset_profile();
+	break;
+#if CLICK_USERLEVEL
+    case GH_IDLE_POLICY: {
+	unsigned spin, pause;
+	Timestamp sleep;
+	if (Args(errh).push_back_words(cp_uncomment(s))
+	    .read_mp("SPIN", spin)
+	    .read_mp("PAUSE", pause)
+	    .read_mp("SLEEP", sleep)
+	    .complete() < 0)
+	    return -1;
+	if (sleep.is_negative())
+	    return errh->error("SLEEP must be nonnegative");
+	for (int i = 0; i < r->master()->nthreads(); ++i)
+	    r->master()->thread(i)->set_idle_policy(spin, pause, sleep);
+	break;
+    }
 #endif
     default:
 	break;
@@ -2399,6 +2871,19 @@ Router::static_initialize()
 	add_read_handler(0, "handlers", Element::read_handlers_handler, 0);
 	add_read_handler(0, "list", router_read_handler, (void *)GH_LIST);
 	add_write_handler(0, "stop", router_write_handler, (void *)GH_STOP);
+	add_read_handler(0, "timers", router_read_handler, (void *)GH_TIMERS);
+	add_read_handler(0, "timer_wheel", router_read_handler, (void *)GH_TIMER_WHEEL);
+	add_write_handler(0, "timer_wheel", router_write_handler, (void *)GH_TIMER_WHEEL);
+	add_read_handler(0, "profile", router_read_handler, (void *)GH_PROFILE);
+	add_read_handler(0, "profile_sample", router_read_handler, (void *)GH_PROFILE_SAMPLE);
+	add_write_handler(0, "profile_sample", router_write_handler, (void *)GH_PROFILE_SAMPLE);
+	add_write_handler(0, "reset_profile", router_write_handler, (void *)GH_RESET_PROFILE, Handler::BUTTON);
+	add_read_handler(0, "startup_times", router_read_handler, (void *)GH_STARTUP);
+#if CLICK_USERLEVEL
+	add_read_handler(0, "idle", router_read_handler, (void *)GH_IDLE);
+	add_read_handler(0, "idle_policy", router_read_handler, (void *)GH_IDLE_POLICY);
+	add_write_handler(0, "idle_policy", router_write_handler, (void *)GH_IDLE_POLICY);
+#endif
 #if CLICK_STATS >= 1
 	add_read_handler(0, "active_ports", router_read_handler, (void *)GH_ACTIVE_PORTS);
 	add_read_handler(0, "active_port_stats", router_read_handler, (void *)GH_ACTIVE_PORT_STATS);
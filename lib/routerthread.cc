@@ -40,6 +40,15 @@ CLICK_CXX_UNPROTECT
 # include <click/cxxunprotect.h>
 #elif CLICK_USERLEVEL
 # include <fcntl.h>
+# if defined(__linux__)
+#  include <linux/perf_event.h>
+#  include <sys/mman.h>
+#  include <sys/syscall.h>
+#  include <unistd.h>
+#  ifdef __NR_perf_event_open
+#   define HAVE_PERF_EVENT_OPEN 1
+#  endif
+# endif
 #endif
 CLICK_DECLS
 
@@ -83,6 +92,15 @@ RouterThread::RouterThread(Master *master, int id)
 
     _task_blocker = 0;
     _task_blocker_waiting = 0;
+#if HAVE_MULTITHREAD
+    _steal_waiting = 0;
+    _steals_in = 0;
+    _steal = false;
+    _steal_work = false;
+    _steal_idle_iters = 0;
+    _steal_hysteresis = 0;
+    _steal_waits = _steals_out = 0;
+#endif
 #if HAVE_ADAPTIVE_SCHEDULER
     _max_click_share = 80 * Task::MAX_UTILIZATION / 100;
     _min_click_share = Task::MAX_UTILIZATION / 200;
@@ -103,6 +121,19 @@ RouterThread::RouterThread(Master *master, int id)
     _iters_per_os = 2;		// userlevel: iterations per select()
 				// kernel: iterations per OS schedule()
 
+#if CLICK_USERLEVEL
+    _idle_spin = _idle_pause = _idle_iters = _idle_load = 0;
+    _idle_state = IDLE_BUSY;
+    _idle_work = false;
+#endif
+
+    memset(&_profile_state, 0, sizeof(_profile_state));
+    _task_accounting = false;
+#if CLICK_USERLEVEL
+    _perf_fd = -2;
+    _perf_page = 0;
+#endif
+
 #if CLICK_LINUXMODULE || CLICK_BSDMODULE
     _greedy = false;
 #endif
@@ -134,6 +165,12 @@ RouterThread::RouterThread(Master *master, int id)
 RouterThread::~RouterThread()
 {
     assert(!active());
+#if HAVE_PERF_EVENT_OPEN
+    if (_perf_page)
+	munmap(_perf_page, sysconf(_SC_PAGESIZE));
+    if (_perf_fd >= 0)
+	close(_perf_fd);
+#endif
 }
 
 inline void
@@ -301,6 +338,289 @@ RouterThread::client_update_pass(int client, const Timestamp &t_before)
 
 #endif
 
+/******************************/
+/* Idle policy                */
+/******************************/
+
+#if CLICK_USERLEVEL
+
+// Polling tasks reschedule themselves even when they find nothing to do, so
+// a thread running them never blocks.  With an idle policy, a thread whose
+// tasks have done no work for idle_spin() iterations spins with a growing
+// pause backoff for idle_pause() more iterations, then blocks in select()
+// for at most idle_sleep() per iteration until some task does work again.
+// Both budgets stretch by up to IDLE_LOAD_STRETCH times when the thread has
+// been busy recently, so peak load keeps spinning while off-peak load sleeps.
+
+#define IDLE_LOAD_SCALE		1024
+#define IDLE_LOAD_SHIFT		6	/* EWMA weight 1/64 per iteration */
+#define IDLE_LOAD_STRETCH	4
+#define IDLE_PAUSE_MAX_SHIFT	6	/* at most 64 pauses per iteration */
+
+void
+RouterThread::set_idle_policy(unsigned spin, unsigned pause, const Timestamp &sleep)
+{
+    _idle_spin = spin;
+    _idle_pause = pause;
+    _idle_sleep = sleep;
+    wake();
+}
+
+Timestamp
+RouterThread::idle_time(int state) const
+{
+    assert(state >= 0 && state < NIDLE);
+    Timestamp t = _idle_time[state];
+    if (state == _idle_state && _idle_state_start)
+	t += Timestamp::now_steady() - _idle_state_start;
+    return t;
+}
+
+const char *
+RouterThread::idle_state_name(int state)
+{
+    static const char * const names[] = { "busy", "spin", "pause", "sleep" };
+    return state >= 0 && state < NIDLE ? names[state] : "unknown";
+}
+
+inline void
+RouterThread::set_idle_state(int state)
+{
+    if (state != _idle_state) {
+	Timestamp now = Timestamp::now_steady();
+	if (_idle_state_start)
+	    _idle_time[_idle_state] += now - _idle_state_start;
+	_idle_state_start = now;
+	_idle_state = state;
+    }
+}
+
+inline void
+RouterThread::run_idle_policy()
+{
+    bool work = _idle_work;
+    _idle_work = false;
+    if (work)
+	_idle_load += (IDLE_LOAD_SCALE - _idle_load) >> IDLE_LOAD_SHIFT;
+    else
+	_idle_load -= _idle_load >> IDLE_LOAD_SHIFT;
+
+    if (work) {
+	_idle_iters = 0;
+	set_idle_state(IDLE_BUSY);
+	return;
+    } else if (!active()) {
+	// nothing scheduled: block as usual
+	set_idle_state(IDLE_SLEEP);
+	return;
+    }
+
+    unsigned stretch = IDLE_LOAD_SCALE + IDLE_LOAD_STRETCH * _idle_load;
+    unsigned spin = (uint64_t) _idle_spin * stretch / IDLE_LOAD_SCALE;
+    unsigned pause = (uint64_t) _idle_pause * stretch / IDLE_LOAD_SCALE;
+    unsigned iters = _idle_iters;
+    if (iters < spin + pause)
+	++_idle_iters;
+
+    if (iters < spin)
+	set_idle_state(IDLE_SPIN);
+    else if (iters < spin + pause) {
+	set_idle_state(IDLE_PAUSE);
+	unsigned shift = iters - spin;
+	if (shift > IDLE_PAUSE_MAX_SHIFT)
+	    shift = IDLE_PAUSE_MAX_SHIFT;
+	for (unsigned i = 1U << shift; i; --i)
+	    click_relax_fence();
+    } else
+	set_idle_state(IDLE_SLEEP);
+}
+
+#endif
+
+/******************************/
+/* Work stealing              */
+/******************************/
+
+#if HAVE_MULTITHREAD
+
+// An idle thread with work stealing enabled sets its _steal_waiting flag and
+// counts itself in Master::_steal_waiting.  A busy thread that sees a waiting
+// thread claims it and moves one of its own migratable tasks there.  The busy
+// thread performs the move because only a task's current thread may change
+// its Task::_thread; so a stolen task finishes its current run before it is
+// removed from the old run queue, and it never runs on two threads at once.
+
+#define STEAL_IDLE_ITERS	1024	/* workless iterations before asking */
+
+void
+RouterThread::set_work_stealing(bool steal, click_jiffies_t hysteresis)
+{
+    _steal_hysteresis = hysteresis;
+    _steal = steal;
+    // let a blocked thread notice the change
+    wake();
+}
+
+inline void
+RouterThread::stop_stealing()
+{
+    if (_steal_waiting.compare_swap(1, 0) == 1)
+	--_master->_steal_waiting;
+}
+
+inline void
+RouterThread::steal_tasks()
+{
+    // Polling tasks stay scheduled even without traffic, so a thread also
+    // counts as idle once its tasks have done no work for STEAL_IDLE_ITERS
+    // iterations.  Only a thread whose tasks just did work gives tasks away,
+    // so idle pollers do not trade tasks among themselves.
+    if (_steal_work)
+	_steal_idle_iters = 0;
+    else if (_steal_idle_iters < STEAL_IDLE_ITERS)
+	++_steal_idle_iters;
+
+    if (!active() || _steal_idle_iters >= STEAL_IDLE_ITERS) {
+	if (!_steal)
+	    stop_stealing();
+	else if (_steal_waiting.compare_swap(0, 1) == 0) {
+	    ++_master->_steal_waiting;
+	    ++_steal_waits;
+	}
+    } else {
+	if (_steal_waiting.value())
+	    stop_stealing();
+	if (_steal && _steal_work && _master->_steal_waiting.value())
+	    donate_task();
+    }
+}
+
+void
+RouterThread::donate_task()
+{
+    // Keep the task at the head of the queue, which is about to run; pick
+    // the least urgent eligible task among the rest.
+    Task *t = task_begin();
+    if (t == task_end())
+	return;
+
+    Task::Status want_status;
+    want_status.home_thread_id = thread_id();
+    want_status.is_scheduled = true;
+    want_status.is_strong_unscheduled = false;
+    click_jiffies_t now = click_jiffies();
+
+    Task *victim = 0;
+    for (t = task_next(t); t != task_end(); t = task_next(t))
+	if (t->_migratable
+	    && t->_status.status == want_status.status
+	    && now - t->_move_jiffies >= _steal_hysteresis
+# if HAVE_STRIDE_SCHED
+	    && (!victim || PASS_GT(t->_pass, victim->_pass))
+# endif
+	    )
+	    victim = t;
+    if (!victim)
+	return;
+
+    int n = _master->nthreads();
+    for (int i = 1; i < n; ++i) {
+	RouterThread *thief = _master->thread((_id + i) % n);
+	if (thief->_steal_waiting.value()
+	    && thief->_steal_waiting.compare_swap(1, 0) == 1) {
+	    --_master->_steal_waiting;
+	    ++victim->_steals;
+	    ++_steals_out;
+	    ++thief->_steals_in;
+	    victim->move_thread(thief->thread_id());
+	    return;
+	}
+    }
+}
+
+#endif
+
+/******************************/
+/* Element profiling          */
+/******************************/
+
+// Element profiling counts cache misses with a per-thread perf event.  The
+// event is opened lazily by the thread itself, because it counts only the
+// thread that opened it.  When the kernel lets user code read the counter
+// with rdpmc, a read costs tens of cycles; otherwise it costs a system call.
+
+#if HAVE_PERF_EVENT_OPEN && (defined(__i386__) || defined(__x86_64__))
+static inline uint64_t
+perf_rdpmc(uint32_t counter)
+{
+    uint32_t lo, hi;
+    asm volatile("rdpmc" : "=a" (lo), "=d" (hi) : "c" (counter));
+    return lo | ((uint64_t) hi << 32);
+}
+#endif
+
+uint64_t
+RouterThread::profile_cache_misses()
+{
+#if HAVE_PERF_EVENT_OPEN
+    if (unlikely(_perf_fd == -2)) {
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = PERF_COUNT_HW_CACHE_MISSES;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	_perf_fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+	if (_perf_fd >= 0) {
+	    void *page = mmap(0, sysconf(_SC_PAGESIZE), PROT_READ, MAP_SHARED, _perf_fd, 0);
+	    _perf_page = (page == MAP_FAILED ? 0 : page);
+	} else
+	    _perf_fd = -1;
+    }
+    if (_perf_fd < 0)
+	return 0;
+
+# if defined(__i386__) || defined(__x86_64__)
+    if (volatile struct perf_event_mmap_page *pc = (volatile struct perf_event_mmap_page *) _perf_page) {
+	uint32_t seq, idx;
+	int64_t count;
+	do {
+	    seq = pc->lock;
+	    click_compiler_fence();
+	    idx = pc->index;
+	    count = pc->offset;
+	    if (pc->cap_user_rdpmc && idx) {
+		int shift = 64 - pc->pmc_width;
+		count += (int64_t) (perf_rdpmc(idx - 1) << shift) >> shift;
+	    }
+	    click_compiler_fence();
+	} while (pc->lock != seq);
+	if (idx)
+	    return count;
+    }
+# endif
+
+    uint64_t count;
+    if (read(_perf_fd, &count, sizeof(count)) != sizeof(count))
+	return 0;
+    return count;
+#else
+    return 0;
+#endif
+}
+
+bool
+RouterThread::profile_cache_misses_available() const
+{
+#if HAVE_PERF_EVENT_OPEN
+    return _perf_fd >= 0;
+#else
+    return false;
+#endif
+}
+
+
 /******************************/
 /* Debugging                  */
 /******************************/
@@ -399,6 +719,9 @@ RouterThread::run_tasks(int ntasks)
     int runs;
 #endif
     bool work_done;
+#if CLICK_USERLEVEL || HAVE_MULTITHREAD
+    bool any_work = false;
+#endif
 
     for (; ntasks >= 0; --ntasks) {
 	t = task_begin();
@@ -419,7 +742,25 @@ RouterThread::run_tasks(int ntasks)
 #endif
 
 	t->_status.is_scheduled = false;
-	work_done = t->fire();
+	bool accounting = _task_accounting;
+	click_cycles_t accounting_start = 0;
+	if (unlikely(accounting))
+	    accounting_start = click_get_cycles();
+	if (unlikely(_profile_state.stack_on)) {
+	    _profile_state.push_frame(t->element());
+	    work_done = t->fire();
+	    _profile_state.pop_frame();
+	} else
+	    work_done = t->fire();
+	// other threads read _accounted_cycles unlocked, so add the whole
+	// delta at once
+	if (unlikely(accounting)) {
+	    t->_accounted_cycles += click_get_cycles() - accounting_start;
+	    ++t->_accounted_runs;
+	}
+#if CLICK_USERLEVEL || HAVE_MULTITHREAD
+	any_work |= work_done;
+#endif
 
 #if HAVE_MULTITHREAD
 	if (runs > PROFILE_ELEMENT) {
@@ -488,6 +829,12 @@ RouterThread::run_tasks(int ntasks)
 #if HAVE_ADAPTIVE_SCHEDULER
     client_update_pass(C_CLICK, t_before);
 #endif
+#if CLICK_USERLEVEL
+    _idle_work |= any_work;
+#endif
+#if HAVE_MULTITHREAD
+    _steal_work = any_work;
+#endif
 }
 
 inline void
@@ -643,6 +990,20 @@ RouterThread::driver()
 	    run_tasks(_tasks_per_iter);
 	} while (0);
 
+#if HAVE_MULTITHREAD
+	// share work with idle threads
+	if (_steal || _steal_waiting.value())
+	    steal_tasks();
+#endif
+
+#if CLICK_USERLEVEL
+	// back off when tasks find no work
+	if (_idle_sleep)
+	    run_idle_policy();
+	else if (_idle_state != IDLE_BUSY)
+	    set_idle_state(IDLE_BUSY);
+#endif
+
 #if CLICK_USERLEVEL
 	// run signals
 	run_signals();
@@ -664,7 +1025,11 @@ RouterThread::driver()
 	// run operating system
 	do {
 #if !HAVE_ADAPTIVE_SCHEDULER && !BSD_NETISRSCHED
-	    if (iter % _iters_per_os)
+	    if (iter % _iters_per_os
+# if CLICK_USERLEVEL
+		&& _idle_state != IDLE_SLEEP
+# endif
+		)
 		break;
 #elif HAVE_ADAPTIVE_SCHEDULER
 	    if (!PASS_GT(_clients[C_CLICK].pass, _clients[C_KERNEL].pass))
@@ -684,6 +1049,9 @@ RouterThread::driver()
 
     driver_unlock_tasks();
 
+#if HAVE_MULTITHREAD
+    stop_stealing();
+#endif
 #if HAVE_ADAPTIVE_SCHEDULER
     _cur_click_share = 0;
 #endif
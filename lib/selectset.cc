@@ -33,6 +33,9 @@
 #  define EV_SET_UDATA_CAST	/* nothing */
 # endif
 #endif
+#if HAVE_ALLOW_EPOLL
+# include <sys/epoll.h>
+#endif
 CLICK_DECLS
 
 namespace {
@@ -58,6 +61,11 @@ SelectSet::SelectSet()
 # endif
 #endif
 
+#if HAVE_ALLOW_EPOLL
+    if ((_epoll = epoll_create(256)) >= 0)
+	fcntl(_epoll, F_SETFD, FD_CLOEXEC);
+#endif
+
 #if !HAVE_ALLOW_POLL
     FD_ZERO(&_read_select_fd_set);
     FD_ZERO(&_write_select_fd_set);
@@ -85,6 +93,10 @@ SelectSet::~SelectSet()
 #if HAVE_ALLOW_KQUEUE
     if (_kqueue >= 0)
 	close(_kqueue);
+#endif
+#if HAVE_ALLOW_EPOLL
+    if (_epoll >= 0)
+	close(_epoll);
 #endif
     if (_wake_pipe[0] >= 0) {
 	close(_wake_pipe[0]);
@@ -138,6 +150,9 @@ SelectSet::register_select(int fd, bool add_read, bool add_write)
 	_pollfds.back().events = 0;
     }
     int pi = _selinfo[fd].pollfd;
+#if HAVE_ALLOW_EPOLL
+    int old_events = _pollfds[pi].events;
+#endif
 
     // add the elements
     if (add_read)
@@ -145,6 +160,11 @@ SelectSet::register_select(int fd, bool add_read, bool add_write)
     if (add_write)
 	_pollfds[pi].events |= POLLOUT;
 
+#if HAVE_ALLOW_EPOLL
+    if (_epoll >= 0)
+	update_epoll(fd, old_events, _pollfds[pi].events);
+#endif
+
 #if HAVE_ALLOW_KQUEUE
     if (_kqueue >= 0) {
 	// Add events to the kqueue
@@ -181,6 +201,9 @@ SelectSet::register_select(int fd, bool add_read, bool add_write)
 	static int warned = 0;
 # if HAVE_ALLOW_KQUEUE
 	if (_kqueue < 0)
+# endif
+# if HAVE_ALLOW_EPOLL
+	if (_epoll < 0)
 # endif
 	    if (!warned) {
 		click_chatter("SelectSet::add_select(%d): fd >= FD_SETSIZE", fd);
@@ -252,6 +275,9 @@ SelectSet::remove_pollfd(int pi, int event)
 
     // remove event
     int fd = _pollfds[pi].fd;
+#if HAVE_ALLOW_EPOLL
+    int old_events = _pollfds[pi].events;
+#endif
     _pollfds[pi].events &= ~event;
     if (event == POLLIN)
 	_selinfo[fd].read = 0;
@@ -268,6 +294,10 @@ SelectSet::remove_pollfd(int pi, int event)
 	    click_chatter("SelectSet::remove_pollfd(fd %d): kevent: %s", _pollfds[pi].fd, strerror(errno));
     }
 #endif
+#if HAVE_ALLOW_EPOLL
+    if (_epoll >= 0)
+	update_epoll(fd, old_events, _pollfds[pi].events);
+#endif
 #if !HAVE_ALLOW_POLL
     // remove event from select list
     if (fd < FD_SETSIZE) {
@@ -326,6 +356,22 @@ SelectSet::remove_select(int fd, Element *element, int mask)
     return 0;
 }
 
+inline int
+SelectSet::select_delay(RouterThread *thread, Timestamp &t)
+{
+    // A thread whose scheduled tasks find no work may block, as if it had no
+    // tasks, but no longer than its idle_sleep().
+    bool active = thread->active();
+    bool sleeping = active && thread->_idle_state == RouterThread::IDLE_SLEEP;
+    int delay_type = thread->timer_set().next_timer_delay(active && !sleeping, t);
+    if (sleeping && delay_type != 0
+	&& (delay_type < 0 || t > thread->_idle_sleep)) {
+	t = thread->_idle_sleep;
+	delay_type = 1;
+    }
+    return delay_type;
+}
+
 inline bool
 SelectSet::post_select(RouterThread *thread, bool acquire)
 {
@@ -390,7 +436,7 @@ SelectSet::run_selects_kqueue(RouterThread *thread)
     // Decide how long to wait.
     struct timespec wait, *wait_ptr = &wait;
     Timestamp t;
-    int delay_type = thread->timer_set().next_timer_delay(thread->active(), t);
+    int delay_type = select_delay(thread, t);
     if (delay_type == 0)
 	wait.tv_sec = wait.tv_nsec = 0;
     else if (delay_type > 0)
@@ -424,6 +470,88 @@ SelectSet::run_selects_kqueue(RouterThread *thread)
 }
 #endif /* HAVE_ALLOW_KQUEUE */
 
+#if HAVE_ALLOW_EPOLL
+void
+SelectSet::update_epoll(int fd, int old_events, int new_events)
+{
+    if (old_events == new_events)
+	return;
+
+    struct epoll_event ev;
+    ev.events = 0;
+    if (new_events & POLLIN)
+	ev.events |= EPOLLIN;
+    if (new_events & POLLOUT)
+	ev.events |= EPOLLOUT;
+    ev.data.u64 = 0;
+    ev.data.fd = fd;
+
+    if (!new_events) {
+	// A closed file descriptor has already left the epoll set.
+	if (epoll_ctl(_epoll, EPOLL_CTL_DEL, fd, &ev) < 0
+	    && errno != EBADF && errno != ENOENT)
+	    click_chatter("SelectSet::remove_pollfd(fd %d): epoll_ctl: %s", fd, strerror(errno));
+	return;
+    }
+
+    int r = epoll_ctl(_epoll, old_events ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &ev);
+    // The fd may have been closed and reopened without a remove_select().
+    if (r < 0 && old_events && errno == ENOENT)
+	r = epoll_ctl(_epoll, EPOLL_CTL_ADD, fd, &ev);
+    if (r < 0) {
+	// Not all file descriptors are epollable (regular files, for
+	// instance).  So if we encounter a problem, fall back to select() or
+	// poll().
+	close(_epoll);
+	_epoll = -1;
+    }
+}
+
+void
+SelectSet::run_selects_epoll(RouterThread *thread)
+{
+# if HAVE_MULTITHREAD
+    click_fence();
+    _select_lock.release();
+# endif
+
+    // Decide how long to wait.
+    int timeout;
+    Timestamp t;
+    int delay_type = select_delay(thread, t);
+    if (delay_type == 0)
+	timeout = 0;
+    else if (delay_type > 0)
+	timeout = (t.sec() >= INT_MAX / 1000 ? INT_MAX - 1000 : t.msecval());
+    else
+	timeout = -1;
+    thread->set_thread_state_for_blocking(delay_type);
+
+    struct epoll_event ev[256];
+    int n = epoll_wait(_epoll, &ev[0], 256, timeout);
+    int was_errno = errno;
+
+    if (post_select(thread, true))
+	return;
+
+    thread->set_thread_state(RouterThread::S_RUNSELECT);
+    if (n < 0 && was_errno != EINTR)
+	perror("epoll_wait");
+    else
+	// epoll reports each file descriptor at most once per call, and
+	// call_selected() checks _selinfo, so descriptors removed by an
+	// earlier callback in this batch are skipped.
+	for (struct epoll_event *p = &ev[0]; p < &ev[n]; ++p) {
+	    int mask = 0;
+	    if (p->events & ~EPOLLOUT)
+		mask |= Element::SELECT_READ;
+	    if (p->events & ~EPOLLIN)
+		mask |= Element::SELECT_WRITE;
+	    call_selected(p->data.fd, mask);
+	}
+}
+#endif /* HAVE_ALLOW_EPOLL */
+
 #if HAVE_ALLOW_POLL
 void
 SelectSet::run_selects_poll(RouterThread *thread)
@@ -441,7 +569,7 @@ SelectSet::run_selects_poll(RouterThread *thread)
     // Decide how long to wait.
     int timeout;
     Timestamp t;
-    int delay_type = thread->timer_set().next_timer_delay(thread->active(), t);
+    int delay_type = select_delay(thread, t);
     if (delay_type == 0)
 	timeout = 0;
     else if (delay_type > 0)
@@ -497,7 +625,7 @@ SelectSet::run_selects_select(RouterThread *thread)
     // Decide how long to wait.
     struct timeval wait, *wait_ptr = &wait;
     Timestamp t;
-    int delay_type = thread->timer_set().next_timer_delay(thread->active(), t);
+    int delay_type = select_delay(thread, t);
     if (delay_type == 0)
 	timerclear(&wait);
     else if (delay_type > 0)
@@ -561,7 +689,8 @@ SelectSet::run_selects(RouterThread *thread)
     // Return early (just run signals) if there are no selectors and there are
     // tasks to run.  NB there will always be at least one _pollfd (the
     // _wake_pipe).
-    if (_pollfds.size() < 2 && thread->active()) {
+    if (_pollfds.size() < 2 && thread->active()
+	&& thread->_idle_state != RouterThread::IDLE_SLEEP) {
 #if HAVE_MULTITHREAD
 	_select_lock.release();
 #endif
@@ -577,6 +706,12 @@ SelectSet::run_selects(RouterThread *thread)
 	    break;
 	}
 #endif
+#if HAVE_ALLOW_EPOLL
+	if (_epoll >= 0) {
+	    run_selects_epoll(thread);
+	    break;
+	}
+#endif
 #if HAVE_ALLOW_POLL
 	run_selects_poll(thread);
 #else
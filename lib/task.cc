@@ -25,6 +25,7 @@
 #include <click/router.hh>
 #include <click/routerthread.hh>
 #include <click/master.hh>
+#include <click/standard/threadsched.hh>
 CLICK_DECLS
 
 /** @file task.hh
@@ -200,6 +201,11 @@ Task::initialize(Element *owner, bool schedule)
 #if HAVE_STRIDE_SCHED
     set_tickets(DEFAULT_TICKETS);
 #endif
+#if HAVE_MULTITHREAD
+    if (ThreadSched *ts = router->thread_sched())
+	_migratable = ts->initial_migratable(owner);
+    _move_jiffies = click_jiffies();
+#endif
 
     _status.home_thread_id = _thread->thread_id();
     _status.is_scheduled = schedule;
@@ -284,6 +290,9 @@ Task::move_thread_second_half()
 	remove_from_scheduled_list();
 	remove_pending_locked(old_thread);
 	_thread = master()->thread(_status.home_thread_id);
+#if HAVE_MULTITHREAD
+	_move_jiffies = click_jiffies();
+#endif
 	old_thread->_pending_lock.release(flags);
 
 	if (_status.is_scheduled)
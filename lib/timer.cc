@@ -163,7 +163,9 @@ CLICK_DECLS
 
  The Click core stores timers in a heap, so most timer operations (including
  scheduling and unscheduling) take @e O(log @e n) time and Click can handle
- very large numbers of timers.
+ very large numbers of timers.  A thread's TimerSet can instead use a
+ hierarchical timing wheel, where these operations take @e O(1) time (see
+ TimerSet::set_timer_wheel_tick()).
 
  Timers generally run in increasing order by expiration time.  That is, if
  timer @a a's expiry() is less than timer @a b's expiry(), then @a a will
@@ -193,38 +195,38 @@ Timer::task_hook(Timer *, void *thunk)
 
 
 Timer::Timer()
-    : _schedpos1(0), _thunk(0), _owner(0), _thread(0)
+    : _schedpos1(0), _wheel_next(0), _wheel_pprev(0), _thunk(0), _owner(0), _thread(0)
 {
     static_assert(sizeof(TimerSet::heap_element) == 16, "size_element should be 16 bytes long.");
     _hook.callback = do_nothing_hook;
 }
 
 Timer::Timer(const do_nothing_t &)
-    : _schedpos1(0), _thunk((void *) 1), _owner(0), _thread(0)
+    : _schedpos1(0), _wheel_next(0), _wheel_pprev(0), _thunk((void *) 1), _owner(0), _thread(0)
 {
     _hook.callback = do_nothing_hook;
 }
 
 Timer::Timer(TimerCallback f, void *user_data)
-    : _schedpos1(0), _thunk(user_data), _owner(0), _thread(0)
+    : _schedpos1(0), _wheel_next(0), _wheel_pprev(0), _thunk(user_data), _owner(0), _thread(0)
 {
     _hook.callback = f;
 }
 
 Timer::Timer(Element* element)
-    : _schedpos1(0), _thunk(element), _owner(0), _thread(0)
+    : _schedpos1(0), _wheel_next(0), _wheel_pprev(0), _thunk(element), _owner(0), _thread(0)
 {
     _hook.callback = element_hook;
 }
 
 Timer::Timer(Task* task)
-    : _schedpos1(0), _thunk(task), _owner(0), _thread(0)
+    : _schedpos1(0), _wheel_next(0), _wheel_pprev(0), _thunk(task), _owner(0), _thread(0)
 {
     _hook.callback = task_hook;
 }
 
 Timer::Timer(const Timer &x)
-    : _schedpos1(0), _hook(x._hook), _thunk(x._thunk), _owner(0), _thread(0)
+    : _schedpos1(0), _wheel_next(0), _wheel_pprev(0), _hook(x._hook), _thunk(x._thunk), _owner(0), _thread(0)
 {
 }
 
@@ -262,15 +264,39 @@ Timer::schedule_at_steady(const Timestamp &when)
     assert(_owner && initialized());
     TimerSet &ts = _thread->timer_set();
     ts.lock_timers();
+#if CLICK_STATS >= 2
+    click_cycles_t start_cycles = click_get_cycles();
+#endif
+    ++ts._timer_ops;
 
     // set expiration timer (ensure nonzero)
     _expiry_s = when ? when : Timestamp::epsilon();
     ts.check_timer_expiry(this);
 
+    // timing wheel: O(1) unlink and relink
+    int old_schedpos1 = _schedpos1;
+    if (ts._wheel_tick) {
+	if (_schedpos1 > 0)
+	    ts.wheel_remove(this);
+	else {
+	    if (_schedpos1 < 0)
+		ts._timer_runchunk[-_schedpos1 - 1] = 0;
+	    ++ts._wheel_size;
+	}
+	_schedpos1 = 1;
+	ts.wheel_insert(this);
+	// The wheel's expiry may be stale-early, which is harmless; update it
+	// only if this timer will now expire first.
+	if (!ts._timer_expiry || _expiry_s < ts._timer_expiry) {
+	    ts._timer_expiry = _expiry_s;
+	    _thread->wake();
+	}
+	goto done;
+    }
+
     // manipulate list; this is essentially a "decrease-key" operation
     // any reschedule removes a timer from the runchunk (XXX -- even backwards
     // reschedulings)
-    int old_schedpos1 = _schedpos1;
     if (_schedpos1 <= 0) {
 	if (_schedpos1 < 0)
 	    ts._timer_runchunk[-_schedpos1 - 1] = 0;
@@ -288,7 +314,10 @@ Timer::schedule_at_steady(const Timestamp &when)
     if (_schedpos1 == 1)
 	_thread->wake();
 
-    // done
+  done:
+#if CLICK_STATS >= 2
+    ts._timer_cycles += click_get_cycles() - start_cycles;
+#endif
     ts.unlock_timers();
 }
 
@@ -305,8 +334,15 @@ Timer::unschedule()
 	return;
     TimerSet &ts = _thread->timer_set();
     ts.lock_timers();
+#if CLICK_STATS >= 2
+    click_cycles_t start_cycles = click_get_cycles();
+#endif
+    ++ts._timer_ops;
     int old_schedpos1 = _schedpos1;
-    if (_schedpos1 > 0) {
+    if (_schedpos1 > 0 && ts._wheel_tick) {
+	ts.wheel_remove(this);
+	--ts._wheel_size;
+    } else if (_schedpos1 > 0) {
 	remove_heap<4>(ts._timer_heap.begin(), ts._timer_heap.end(),
 		       ts._timer_heap.begin() + _schedpos1 - 1,
 		       TimerSet::heap_less(), TimerSet::heap_place());
@@ -316,6 +352,9 @@ Timer::unschedule()
     } else if (_schedpos1 < 0)
 	ts._timer_runchunk[-_schedpos1 - 1] = 0;
     _schedpos1 = 0;
+#if CLICK_STATS >= 2
+    ts._timer_cycles += click_get_cycles() - start_cycles;
+#endif
     ts.unlock_timers();
 }
 
@@ -35,6 +35,14 @@ TimerSet::TimerSet()
 #endif
     _timer_stride = _max_timer_stride;
     _timer_count = 0;
+    _wheel_tick_nsec = 0;
+    _wheel_now = 0;
+    memset(_wheel, 0, sizeof(_wheel));
+    memset(_wheel_bitmap, 0, sizeof(_wheel_bitmap));
+    _wheel_overflow = 0;
+    _wheel_size = 0;
+    _timer_ops = _timer_fires = 0;
+    _timer_cycles = 0;
 #if CLICK_LINUXMODULE
     _timer_check_reports = 5;
 #else
@@ -55,6 +63,17 @@ TimerSet::kill_router(Router *router)
 {
     lock_timers();
     assert(!_timer_runchunk.size());
+    for (int i = 0; i <= wheel_levels * wheel_slots; ++i) {
+	Timer **pprev = wheel_list(i);
+	while (Timer *t = *pprev)
+	    if (t->router() == router) {
+		wheel_remove(t);
+		--_wheel_size;
+		t->_owner = 0;
+		t->_schedpos1 = 0;
+	    } else
+		pprev = &t->_wheel_next;
+    }
     for (heap_element *thp = _timer_heap.end();
 	 thp > _timer_heap.begin(); ) {
 	--thp;
@@ -78,6 +97,207 @@ TimerSet::set_max_timer_stride(unsigned timer_stride)
 	_timer_stride = _max_timer_stride;
 }
 
+/** @brief Switch this TimerSet between a heap and a timing wheel.
+ * @param tick wheel granularity, or zero to use the heap
+ * @return 0 on success, or -EINVAL if @a tick is negative or longer than
+ * one second
+ *
+ * The heap orders all timers exactly, but schedule and unschedule cost
+ * O(log n).  The hierarchical timing wheel schedules and unschedules in
+ * O(1), and is preferable for very large numbers of timers; timers are
+ * grouped into @a tick-sized slots, and only the timers within a slot are
+ * ordered by exact expiry.  Existing timers move to the new structure. */
+int
+TimerSet::set_timer_wheel_tick(const Timestamp &tick)
+{
+    if (tick.is_negative() || tick > Timestamp(1, 0))
+	return -EINVAL;
+    lock_timers();
+
+    Vector<Timer *> timers;
+    for (heap_element *thp = _timer_heap.begin(); thp != _timer_heap.end(); ++thp)
+	timers.push_back(thp->t);
+    _timer_heap.clear();
+    for (int i = 0; i <= wheel_levels * wheel_slots; ++i)
+	for (Timer *t = *wheel_list(i); t; t = t->_wheel_next)
+	    timers.push_back(t);
+    memset(_wheel, 0, sizeof(_wheel));
+    memset(_wheel_bitmap, 0, sizeof(_wheel_bitmap));
+    _wheel_overflow = 0;
+    _wheel_size = 0;
+
+    _wheel_tick = tick;
+    _wheel_tick_nsec = tick.nsecval();
+    if (_wheel_tick)
+	_wheel_now = wheel_tick_of(Timestamp::now_steady());
+
+    for (Timer **tp = timers.begin(); tp != timers.end(); ++tp)
+	if (_wheel_tick) {
+	    (*tp)->_schedpos1 = 1;
+	    wheel_insert(*tp);
+	    ++_wheel_size;
+	} else {
+	    _timer_heap.push_back(heap_element(*tp));
+	    push_heap<4>(_timer_heap.begin(), _timer_heap.end(),
+			 heap_less(), heap_place());
+	}
+    set_timer_expiry();
+
+    unlock_timers();
+    return 0;
+}
+
+void
+TimerSet::wheel_insert(Timer *t)
+{
+    uint64_t when = wheel_tick_of(t->_expiry_s);
+    if (when < _wheel_now)
+	when = _wheel_now;
+
+    // place at the level of the highest byte in which 'when' and
+    // '_wheel_now' differ
+    uint64_t diff = when ^ _wheel_now;
+    Timer **head;
+    if (diff >> (wheel_levels * wheel_bits))
+	head = &_wheel_overflow;
+    else {
+	int level = 0;
+	while (diff >> ((level + 1) * wheel_bits))
+	    ++level;
+	unsigned slot = (when >> (level * wheel_bits)) & wheel_mask;
+	head = &_wheel[level][slot];
+	_wheel_bitmap[level][slot >> 5] |= 1U << (slot & 31);
+    }
+
+    t->_wheel_next = *head;
+    if (*head)
+	(*head)->_wheel_pprev = &t->_wheel_next;
+    *head = t;
+    t->_wheel_pprev = head;
+}
+
+void
+TimerSet::wheel_remove(Timer *t)
+{
+    Timer **pprev = t->_wheel_pprev;
+    *pprev = t->_wheel_next;
+    if (t->_wheel_next)
+	t->_wheel_next->_wheel_pprev = pprev;
+
+    // clear the bitmap bit if the slot just emptied
+    uintptr_t i = pprev - &_wheel[0][0];
+    if (!*pprev && i < (uintptr_t) (wheel_levels * wheel_slots))
+	_wheel_bitmap[i / wheel_slots][(i & wheel_mask) >> 5] &= ~(1U << (i & 31));
+}
+
+int
+TimerSet::wheel_next_slot(int level, unsigned from) const
+{
+    for (unsigned w = from >> 5; w < wheel_slots / 32; ++w) {
+	uint32_t bits = _wheel_bitmap[level][w];
+	if (w == from >> 5)
+	    bits &= ~0U << (from & 31);
+	if (bits)
+	    return (w << 5) + ffs_lsb(bits) - 1;
+    }
+    return -1;
+}
+
+/* Find the first tick after _wheel_now at which a slot needs attention:
+   either a level-0 slot comes due, or a higher-level slot must cascade. */
+bool
+TimerSet::wheel_next_tick(uint64_t &tick) const
+{
+    for (int level = 0; level < wheel_levels; ++level) {
+	int shift = level * wheel_bits;
+	unsigned from = ((_wheel_now >> shift) & wheel_mask) + 1;
+	int slot = from < wheel_slots ? wheel_next_slot(level, from) : -1;
+	if (slot >= 0) {
+	    tick = (((_wheel_now >> shift) & ~(uint64_t) wheel_mask) + slot) << shift;
+	    return true;
+	}
+    }
+    if (_wheel_overflow) {
+	int shift = wheel_levels * wheel_bits;
+	tick = ((_wheel_now >> shift) + 1) << shift;
+	return true;
+    }
+    return false;
+}
+
+void
+TimerSet::wheel_cascade()
+{
+    // When _wheel_now reaches the start of a higher-level slot, that slot's
+    // timers move down to finer levels.
+    int shift = wheel_levels * wheel_bits;
+    Timer *list = 0;
+    if (!(_wheel_now & ((uint64_t(1) << shift) - 1))) {
+	list = _wheel_overflow;
+	_wheel_overflow = 0;
+    }
+    for (int level = wheel_levels - 1; level >= 0; --level) {
+	while (list) {
+	    Timer *next = list->_wheel_next;
+	    wheel_insert(list);
+	    list = next;
+	}
+	shift = level * wheel_bits;
+	if (level == 0 || (_wheel_now & ((uint64_t(1) << shift) - 1)))
+	    continue;
+	unsigned slot = (_wheel_now >> shift) & wheel_mask;
+	list = _wheel[level][slot];
+	_wheel[level][slot] = 0;
+	_wheel_bitmap[level][slot >> 5] &= ~(1U << (slot & 31));
+    }
+}
+
+void
+TimerSet::set_wheel_expiry()
+{
+    unsigned now_slot = _wheel_now & wheel_mask;
+    uint64_t tick;
+    if (!_wheel_size)
+	_timer_expiry = Timestamp();
+    else if (wheel_next_slot(0, now_slot) == (int) now_slot) {
+	// the current slot may hold timers that expire later in this tick
+	Timer *t = _wheel[0][now_slot];
+	_timer_expiry = t->_expiry_s;
+	for (t = t->_wheel_next; t; t = t->_wheel_next)
+	    if (t->_expiry_s < _timer_expiry)
+		_timer_expiry = t->_expiry_s;
+    } else if (wheel_next_tick(tick))
+	_timer_expiry = Timestamp::make_nsec(tick * _wheel_tick_nsec);
+    else
+	_timer_expiry = Timestamp();
+}
+
+Timer *
+TimerSet::next_timer()
+{
+    lock_timers();
+    Timer *t = 0;
+    if (!_wheel_tick) {
+	if (_timer_heap.size())
+	    t = _timer_heap.unchecked_at(0).t;
+    } else {
+	// the earliest timer is in the first nonempty list
+	for (int level = 0; level < wheel_levels && !t; ++level) {
+	    unsigned cur = (_wheel_now >> (level * wheel_bits)) & wheel_mask;
+	    int slot = wheel_next_slot(level, cur);
+	    if (slot >= 0)
+		t = _wheel[level][slot];
+	}
+	if (!t)
+	    t = _wheel_overflow;
+	for (Timer *x = t; x; x = x->_wheel_next)
+	    if (x->_expiry_s < t->_expiry_s)
+		t = x;
+    }
+    unlock_timers();
+    return t;
+}
+
 void
 TimerSet::check_timer_expiry(Timer *t)
 {
@@ -92,7 +312,7 @@ TimerSet::check_timer_expiry(Timer *t)
 }
 
 inline void
-TimerSet::run_one_timer(Timer *t)
+TimerSet::run_one_timer(Timer *t, RouterThread *thread)
 {
 #if CLICK_STATS >= 2
     Element *owner = t->_owner;
@@ -100,7 +320,14 @@ TimerSet::run_one_timer(Timer *t)
 	start_child_cycles = owner->_child_cycles;
 #endif
 
-    t->_hook.callback(t, t->_thunk);
+    ++_timer_fires;
+    RouterThread::ProfileState &ps = thread->profile_state();
+    if (unlikely(ps.stack_on)) {
+	ps.push_frame(t->element());
+	t->_hook.callback(t, t->_thunk);
+	ps.pop_frame();
+    } else
+	t->_hook.callback(t, t->_thunk);
 
 #if CLICK_STATS >= 2
     click_cycles_t all_delta = click_get_cycles() - start_cycles,
@@ -110,12 +337,139 @@ TimerSet::run_one_timer(Timer *t)
 #endif
 }
 
+void
+TimerSet::run_timer_runchunk(RouterThread *thread)
+{
+    Vector<Timer*>::iterator i = _timer_runchunk.begin();
+    for (; !thread->stop_flag() && i != _timer_runchunk.end(); ++i)
+	if (*i) {
+	    (*i)->_schedpos1 = 0;
+	    run_one_timer(*i, thread);
+	}
+
+    // reschedule unrun timers if stopped early
+    for (; i != _timer_runchunk.end(); ++i)
+	if (*i) {
+	    (*i)->_schedpos1 = 0;
+	    (*i)->schedule_at_steady((*i)->_expiry_s);
+	}
+    _timer_runchunk.clear();
+}
+
+static int
+timer_expiry_compare(const void *ap, const void *bp, void *)
+{
+    const Timer *a = *static_cast<Timer * const *>(ap);
+    const Timer *b = *static_cast<Timer * const *>(bp);
+    if (a->expiry_steady() != b->expiry_steady())
+	return a->expiry_steady() < b->expiry_steady() ? -1 : 1;
+    else
+	return 0;
+}
+
+void
+TimerSet::run_wheel_timers(RouterThread *thread)
+{
+#if CLICK_STATS >= 2
+    click_cycles_t start_cycles = click_get_cycles();
+#endif
+
+    // Step _wheel_now forward to the current tick, skipping empty slots
+    // and collecting expired timers from each level-0 slot on the way.
+    uint64_t target = wheel_tick_of(_timer_check), next;
+    while (1) {
+	wheel_cascade();
+	Timer **pprev = &_wheel[0][_wheel_now & wheel_mask];
+	while (Timer *t = *pprev)
+	    if (t->_expiry_s <= _timer_check) {
+		wheel_remove(t);
+		--_wheel_size;
+		_timer_runchunk.push_back(t);
+	    } else
+		pprev = &t->_wheel_next;
+	if (_wheel_now >= target)
+	    break;
+	if (!wheel_next_tick(next) || next > target)
+	    next = target;
+	_wheel_now = next;
+    }
+
+    // Timers run in exact expiry order within the batch.
+    if (_timer_runchunk.size() > 1)
+	click_qsort(_timer_runchunk.begin(), _timer_runchunk.size(),
+		    sizeof(Timer *), timer_expiry_compare, 0);
+    for (int i = 0; i < _timer_runchunk.size(); ++i)
+	_timer_runchunk[i]->_schedpos1 = -i - 1;
+    set_timer_expiry();
+
+#if CLICK_STATS >= 2
+    _timer_cycles += click_get_cycles() - start_cycles;
+#endif
+    run_timer_runchunk(thread);
+}
+
+void
+TimerSet::run_heap_timers(RouterThread *thread)
+{
+    heap_element *th = _timer_heap.begin();
+#if CLICK_STATS >= 2
+    click_cycles_t start_cycles;
+#endif
+
+    // actually run timers
+    int max_timers = 64;
+    do {
+	Timer *t = th->t;
+	assert(t->expiry_steady() == th->expiry_s);
+#if CLICK_STATS >= 2
+	start_cycles = click_get_cycles();
+#endif
+	pop_heap<4>(_timer_heap.begin(), _timer_heap.end(), heap_less(), heap_place());
+	_timer_heap.pop_back();
+	set_timer_expiry();
+	t->_schedpos1 = 0;
+#if CLICK_STATS >= 2
+	_timer_cycles += click_get_cycles() - start_cycles;
+#endif
+
+	run_one_timer(t, thread);
+    } while (_timer_heap.size() > 0 && !thread->stop_flag()
+	     && (th = _timer_heap.begin(), th->expiry_s <= _timer_check)
+	     && --max_timers >= 0);
+
+    // If we ran out of timers to run, then perhaps there's an
+    // infinite timer loop or one timer is very far behind system
+    // time.  Eventually the system would catch up and run all timers,
+    // but in the meantime other timers could starve.  We detect this
+    // case and run ALL expired timers, reducing possible damage.
+    if (max_timers < 0 && !thread->stop_flag()) {
+#if CLICK_STATS >= 2
+	start_cycles = click_get_cycles();
+#endif
+	_timer_runchunk.reserve(32);
+	do {
+	    Timer *t = th->t;
+	    pop_heap<4>(_timer_heap.begin(), _timer_heap.end(), heap_less(), heap_place());
+	    _timer_heap.pop_back();
+	    t->_schedpos1 = -_timer_runchunk.size() - 1;
+
+	    _timer_runchunk.push_back(t);
+	} while (_timer_heap.size() > 0
+		 && (th = _timer_heap.begin(), th->expiry_s <= _timer_check));
+	set_timer_expiry();
+#if CLICK_STATS >= 2
+	_timer_cycles += click_get_cycles() - start_cycles;
+#endif
+	run_timer_runchunk(thread);
+    }
+}
+
 void
 TimerSet::run_timers(RouterThread *thread, Master *master)
 {
     if (!_timer_lock.attempt())
 	return;
-    if (!master->paused() && _timer_heap.size() > 0 && !thread->stop_flag()) {
+    if (!master->paused() && timer_count() > 0 && !thread->stop_flag()) {
 	thread->set_thread_state(RouterThread::S_RUNTIMER);
 #if CLICK_LINUXMODULE
 	_timer_task = current;
@@ -123,11 +477,10 @@ TimerSet::run_timers(RouterThread *thread, Master *master)
 	_timer_processor = click_current_processor();
 #endif
 	_timer_check = Timestamp::now_steady();
-	heap_element *th = _timer_heap.begin();
 
-	if (th->expiry_s <= _timer_check) {
+	if (_timer_expiry <= _timer_check) {
 	    // potentially adjust timer stride
-	    Timestamp adj_expiry = th->expiry_s + Timer::adjustment();
+	    Timestamp adj_expiry = _timer_expiry + Timer::adjustment();
 	    if (adj_expiry <= _timer_check) {
 		_timer_count = 0;
 		if (_timer_stride > 1)
@@ -138,54 +491,10 @@ TimerSet::run_timers(RouterThread *thread, Master *master)
 		    _timer_stride = _max_timer_stride;
 	    }
 
-	    // actually run timers
-	    int max_timers = 64;
-	    do {
-		Timer *t = th->t;
-		assert(t->expiry_steady() == th->expiry_s);
-		pop_heap<4>(_timer_heap.begin(), _timer_heap.end(), heap_less(), heap_place());
-		_timer_heap.pop_back();
-		set_timer_expiry();
-		t->_schedpos1 = 0;
-
-		run_one_timer(t);
-	    } while (_timer_heap.size() > 0 && !thread->stop_flag()
-		     && (th = _timer_heap.begin(), th->expiry_s <= _timer_check)
-		     && --max_timers >= 0);
-
-	    // If we ran out of timers to run, then perhaps there's an
-	    // infinite timer loop or one timer is very far behind system
-	    // time.  Eventually the system would catch up and run all timers,
-	    // but in the meantime other timers could starve.  We detect this
-	    // case and run ALL expired timers, reducing possible damage.
-	    if (max_timers < 0 && !thread->stop_flag()) {
-		_timer_runchunk.reserve(32);
-		do {
-		    Timer *t = th->t;
-		    pop_heap<4>(_timer_heap.begin(), _timer_heap.end(), heap_less(), heap_place());
-		    _timer_heap.pop_back();
-		    t->_schedpos1 = -_timer_runchunk.size() - 1;
-
-		    _timer_runchunk.push_back(t);
-		} while (_timer_heap.size() > 0
-			 && (th = _timer_heap.begin(), th->expiry_s <= _timer_check));
-		set_timer_expiry();
-
-		Vector<Timer*>::iterator i = _timer_runchunk.begin();
-		for (; !thread->stop_flag() && i != _timer_runchunk.end(); ++i)
-		    if (*i) {
-			(*i)->_schedpos1 = 0;
-			run_one_timer(*i);
-		    }
-
-		// reschedule unrun timers if stopped early
-		for (; i != _timer_runchunk.end(); ++i)
-		    if (*i) {
-			(*i)->_schedpos1 = 0;
-			(*i)->schedule_at_steady((*i)->_expiry_s);
-		    }
-		_timer_runchunk.clear();
-	    }
+	    if (_wheel_tick)
+		run_wheel_timers(thread);
+	    else
+		run_heap_timers(thread);
 	}
 
 #if CLICK_LINUXMODULE